@@ -0,0 +1,39 @@
+// Channel throughput between tasks: one producer feeding N consumers, and N
+// producers feeding one consumer, over an unbounded and a bounded channel.
+// Built by the bench_channels target, which is left out of the default build.
+#include "object.hpp"
+#include "threads.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+
+using namespace std;
+
+int main(int argc, char** argv) {
+    size_t total = argc > 1 ? strtoul(argv[1], nullptr, 10) : 400000;
+    int n        = argc > 2 ? atoi(argv[2]) : 4;
+    shared_ptr<Object> item(new Integer(1));
+    for (size_t capacity : {size_t(0), size_t(64)}) {
+        for (bool fanOut : {true, false}) {
+            shared_ptr<Channel> channel(new Channel(capacity));
+            int producers = fanOut ? 1 : n;
+            int consumers = fanOut ? n : 1;
+            auto start    = chrono::steady_clock::now();
+            for (int p = 0; p < producers; p++)
+                Scheduler::shared().spawn([=]() {
+                    for (size_t i = 0; i < total / producers; i++)
+                        channel->send(item);
+                });
+            for (int c = 0; c < consumers; c++)
+                Scheduler::shared().spawn([=]() {
+                    for (size_t i = 0; i < total / consumers; i++)
+                        channel->receive();
+                });
+            Scheduler::waitAll();
+            double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+            cout << (capacity == 0 ? "chan()   " : "chan(64) ") << (fanOut ? "1-to-" : "") << n
+                 << (fanOut ? "" : "-to-1") << ": " << (size_t)(total / seconds) << " msgs/s\n";
+        }
+    }
+}
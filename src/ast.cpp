@@ -1,11 +1,22 @@
 #include "ast.hpp"
 
+#include "inference.hpp"
 #include "parser.hpp"
 
+#include <mutex>
 #include <sstream>
+#include <unordered_set>
 
 using namespace std;
 
+Symbol intern(const string& name) {
+    // elements of an unordered_set never move, so their addresses are stable
+    static unordered_set<string> symbols{};
+    static mutex symbolsMutex;
+    lock_guard<mutex> lock(symbolsMutex);
+    return &*symbols.insert(name).first;
+}
+
 AST::AST(string& input) {
     this->parser = unique_ptr<Parser>(new Parser(input));
 }
@@ -22,6 +33,12 @@ ArrayLiteral::ArrayLiteral() {
     this->type     = arrayLiteral;
 }
 
+AwaitExpression::AwaitExpression() {
+    this->nodetype = expression;
+    this->type     = awaitExpression;
+    this->value    = nullptr;
+}
+
 AssignmentExpressionStatement::AssignmentExpressionStatement() {
     this->name     = nullptr;
     this->value    = nullptr;
@@ -41,8 +58,10 @@ BooleanLiteral::BooleanLiteral() {
 
 CallExpression::CallExpression() {
     this->nodetype  = expression;
-    this->type      = callExpression;
-    this->_function = nullptr;
+    this->type           = callExpression;
+    this->_function      = nullptr;
+    this->cachedBuiltin  = nullptr;
+    this->generic        = false;
 }
 
 DoExpression::DoExpression() {
@@ -61,7 +80,9 @@ ExpressionStatement::ExpressionStatement() {
 ForExpression::ForExpression() {
     this->nodetype = expression;
     this->type     = forExpression;
+    this->iterable = nullptr;
     this->body     = nullptr;
+    this->parallel = false;
 }
 
 FloatLiteral::FloatLiteral() {
@@ -74,11 +95,12 @@ FunctionLiteral::FunctionLiteral() {
     this->nodetype = expression;
     this->name     = nullptr;
     this->body     = nullptr;
+    this->async    = false;
 }
 
 FunctionStatement::FunctionStatement() {
     this->type     = functionStatement;
-    this->nodetype = expression;
+    this->nodetype = statement;
     this->name     = nullptr;
     this->body     = nullptr;
 }
@@ -120,6 +142,7 @@ InfixExpression::InfixExpression() {
     this->_right   = nullptr;
     this->type     = infixExpression;
     this->nodetype = expression;
+    this->generic  = false;
 }
 
 IntegerLiteral::IntegerLiteral() {
@@ -146,12 +169,27 @@ PrefixExpression::PrefixExpression() {
     this->nodetype = expression;
 }
 
+SliceExpression::SliceExpression() {
+    this->nodetype = expression;
+    this->type     = sliceExpression;
+    this->_left    = nullptr;
+    this->start    = nullptr;
+    this->end      = nullptr;
+    this->step     = nullptr;
+}
+
 ReturnStatement::ReturnStatement() {
     this->returnValue = nullptr;
     this->type        = returnStatement;
     this->nodetype    = statement;
 }
 
+SpawnExpression::SpawnExpression() {
+    this->nodetype = expression;
+    this->type     = spawnExpression;
+    this->call     = nullptr;
+}
+
 StringLiteral::StringLiteral() {
     this->type     = stringLiteral;
     this->nodetype = expression;
@@ -179,12 +217,13 @@ void AST::parseProgram() {
 
         this->parser->nextToken();
     }
+    if (this->parser->errors.empty()) inferTypes(this->Statements, this->parser->errors);
 
     this->checkParserErrors();
 }
 
 void Statement::setDataType(string lit) {
-    if (lit == "int") this->datatype = INT;
+    if (lit == "int" || lit == "long") this->datatype = INT;
     else if (lit == "float") this->datatype = FLOAT;
     else if (lit == "bool") this->datatype = BOOLEAN;
     else if (lit == "string") this->datatype = STRING;
@@ -192,7 +231,7 @@ void Statement::setDataType(string lit) {
 }
 
 void Expression::setDataType(string lit) {
-    if (lit == "int") this->datatype = INT;
+    if (lit == "int" || lit == "long") this->datatype = INT;
     else if (lit == "float") this->datatype = FLOAT;
     else if (lit == "bool") this->datatype = BOOLEAN;
     else if (lit == "string") this->datatype = STRING;
@@ -212,7 +251,8 @@ void Expression::setExpressionNode(Token tok) {
 void IdentifierLiteral::setExpressionNode(Token tok) {
     this->token = tok;
     this->setDataType(tok.literal);
-    this->value = tok.literal;
+    this->value  = tok.literal;
+    this->symbol = intern(this->value);
 }
 
 void PrefixExpression::setExpressionNode(Token tok) {
@@ -242,6 +282,7 @@ void StringLiteral::setExpressionNode(Token tok) {
     this->token    = tok;
     this->value    = tok.literal;
     this->datatype = STRING;
+    if (this->value.size() <= MAX_INTERNED_LENGTH) this->symbol = intern(this->value);
 }
 
 void BooleanLiteral::setExpressionNode(Token tok) {
@@ -332,6 +373,17 @@ string PrefixExpression::printString() {
     return ss.str();
 }
 
+string SliceExpression::printString() {
+    ostringstream ss;
+    ss << "(" << this->_left->printString() << "[";
+    if (this->start != nullptr) ss << this->start->printString();
+    ss << ":";
+    if (this->end != nullptr) ss << this->end->printString();
+    if (this->step != nullptr) ss << ":" << this->step->printString();
+    ss << "]) ";
+    return ss.str();
+}
+
 string InfixExpression::printString() {
     ostringstream ss;
 
@@ -388,6 +440,7 @@ string FunctionLiteral::printString() {
     for (int i = 0; i < this->parameters.size(); i++)
         params.push_back(this->parameters[i]->printString());
 
+    if (this->async) ss << "async ";
     ss << DatatypeMap.at(this->datatype) << " " << this->name->token.literal << "(";
 
     for (string param : params)
@@ -1,8 +1,19 @@
 #pragma once
 #include "parser.hpp"
 
+#include <atomic>
 #include <memory>
 
+class Object;
+
+// Interned identifier names and short string constants. Equal strings share
+// one Symbol, so they are compared and hashed by pointer.
+typedef const std::string* Symbol;
+Symbol intern(const std::string&);
+
+// longest string literal that is interned
+const size_t MAX_INTERNED_LENGTH = 64;
+
 enum NodeType {
     expression,
     statement,
@@ -20,6 +31,7 @@ enum StatementType {
 
 enum ExpressionType {
     arrayLiteral,
+    awaitExpression,
     booleanExpression,
     callExpression,
     doExpression,
@@ -34,8 +46,32 @@ enum ExpressionType {
     integerLiteral,
     postfixExpression,
     prefixExpression,
+    sliceExpression,
+    spawnExpression,
     stringLiteral,
     whileExpression,
+
+    // quickened node kinds; a node rewrites itself into one of these after
+    // observing its operand types and falls back to the generic kind when a
+    // guard fails
+    builtinCallExpression,
+    functionCallExpression,
+    intAddExpression,
+    intSubExpression,
+    intMulExpression,
+    intDivExpression,
+    intLessExpression,
+    intGreaterExpression,
+    intEqualExpression,
+    intNotEqualExpression,
+    floatAddExpression,
+    floatSubExpression,
+    floatMulExpression,
+    floatDivExpression,
+    floatLessExpression,
+    floatGreaterExpression,
+    floatEqualExpression,
+    floatNotEqualExpression,
 };
 
 typedef struct AST {
@@ -53,7 +89,7 @@ typedef struct AST {
 typedef struct Node {
     ~Node() = default;
     int nodetype;
-    int datatype;
+    int datatype{-1};
     std::string literal;
 } Node;
 
@@ -75,6 +111,8 @@ typedef struct Expression : Node {
 
     Token token;
     ExpressionType type;
+    // set by type inference when the whole subtree runs on native values; see inference.hpp
+    bool unboxed{false};
 
     virtual void setExpressionNode(Token);
     virtual std::string printString();
@@ -91,6 +129,15 @@ typedef struct ArrayLiteral : Expression {
     std::string printString();
 } ArrayLiteral;
 
+typedef struct AwaitExpression : Expression {
+    AwaitExpression();
+    ~AwaitExpression() = default;
+
+    Token token;
+    std::shared_ptr<Expression> value;
+
+} AwaitExpression;
+
 typedef struct AssignmentExpressionStatement : Statement {
     AssignmentExpressionStatement();
     ~AssignmentExpressionStatement() = default;
@@ -130,6 +177,13 @@ typedef struct CallExpression : Expression {
     std::shared_ptr<Expression> _function;
     std::vector<std::shared_ptr<Expression>> arguments;
 
+    // Type feedback: the Function seen so far. It is held weakly, so the call
+    // site keeps nothing alive, and compared by owner, so another function
+    // allocated at the same address can never pass for it.
+    std::weak_ptr<Object> cachedFunction;
+    std::shared_ptr<Object> cachedBuiltin;
+    bool generic;
+
     std::string printString();
 } CallExpression;
 
@@ -157,7 +211,7 @@ typedef struct FloatLiteral : Expression {
     FloatLiteral();
 
     Token token;
-    float value;
+    double value;
 
     void setExpressionNode(Token);
     inline std::string printString() { return std::to_string(this->value); };
@@ -174,9 +228,17 @@ typedef struct ForExpression : Expression {
     std::shared_ptr<Expression> start;
     std::shared_ptr<Expression> end;
     std::shared_ptr<Expression> increment;
+    // `for (x in value)` walks an array or lines() instead of a range, and
+    // leaves start, end and increment unset
+    std::shared_ptr<Expression> iterable;
     std::vector<std::shared_ptr<Expression>> expressions;
     std::vector<std::shared_ptr<Statement>> statements;
     std::shared_ptr<BlockStatement> body;
+    // pfor: iterations run on the thread pool, and each reduce(op : name)
+    // clause gives the operator (+, *, min or max) combining one variable
+    bool parallel;
+    std::vector<std::string> reduceOperators;
+    std::vector<std::shared_ptr<IdentifierLiteral>> reduceNames;
 
 } ForExpression;
 
@@ -188,6 +250,8 @@ typedef struct FunctionLiteral : Expression {
     std::shared_ptr<IdentifierLiteral> name;
     std::vector<std::shared_ptr<IdentifierLiteral>> parameters;
     std::shared_ptr<BlockStatement> body;
+    // declared `async fn`; calling it starts a task instead of running the body
+    bool async;
 
     std::string printString();
     void setExpressionNode(Token);
@@ -237,6 +301,7 @@ typedef struct IdentifierLiteral : Expression {
 
     Token token;
     std::string value;
+    Symbol symbol{nullptr};
 
     void setExpressionNode(Token);
     inline std::string printString() { return this->value; };
@@ -273,6 +338,9 @@ typedef struct InfixExpression : Expression {
     std::shared_ptr<Expression> _left;
     std::shared_ptr<Expression> _right;
 
+    // set once a guard has failed; the node then stays generic
+    bool generic;
+
     void setExpressionNode(Token);
     std::string printString();
 } InfixExpression;
@@ -322,6 +390,20 @@ typedef struct PrefixExpression : Expression {
     std::string printString();
 } PrefixExpression;
 
+// `left[start:end]` or `left[start:end:step]`; any of them may be left out
+typedef struct SliceExpression : Expression {
+    SliceExpression();
+    ~SliceExpression() = default;
+
+    Token token;
+    std::shared_ptr<Expression> _left;
+    std::shared_ptr<Expression> start;
+    std::shared_ptr<Expression> end;
+    std::shared_ptr<Expression> step;
+
+    std::string printString();
+} SliceExpression;
+
 typedef struct ReturnStatement : Statement {
     ReturnStatement();
     ~ReturnStatement() = default;
@@ -332,11 +414,26 @@ typedef struct ReturnStatement : Statement {
     std::string printString();
 } ReturnStatement;
 
+typedef struct SpawnExpression : Expression {
+    SpawnExpression();
+    ~SpawnExpression() = default;
+
+    Token token;
+    std::shared_ptr<CallExpression> call;
+
+} SpawnExpression;
+
 typedef struct StringLiteral : Expression {
     StringLiteral();
 
     Token token;
     std::string value;
+    // set for short literals only
+    Symbol symbol{nullptr};
+    // The String the symbol is interned as, stored once by the tree-walker and
+    // only read after ready is seen set.
+    std::shared_ptr<Object> constant;
+    std::atomic<bool> constantReady{false};
 
     void setExpressionNode(Token);
     inline std::string printString() { return this->value; };
@@ -378,11 +475,11 @@ const std::unordered_map<int, std::string> ExpressionMap = {
 };
 
 const std::unordered_map<int, std::string> DatatypeMap = {
-    {0, "int"    },
-    {1, "float"  },
-    {2, "boolean"},
-    {3, "string" },
-    {4, "void"   },
+    {::INT,     "int"    },
+    {::FLOAT,   "float"  },
+    {::BOOLEAN, "boolean"},
+    {::STRING,  "string" },
+    {::VOID,    "void"   },
 };
 
 enum Precedences {
@@ -1,8 +1,19 @@
 #include "builtins.hpp"
 
+#include "csv.hpp"
+#include "evaluator.hpp"
 #include "globals.hpp"
+#include "io.hpp"
+#include "json.hpp"
+#include "native.hpp"
 #include "object.hpp"
+#include "regex.hpp"
+#include "simd.hpp"
+#include "sort.hpp"
+#include "threads.hpp"
 
+#include <cmath>
+#include <cstring>
 #include <iostream>
 
 using namespace std;
@@ -18,11 +29,57 @@ shared_ptr<Object> evalBuiltinFunction(
         case builtin_min: return built_in_min(args, env);
         case builtin_push: return built_in_push(args, env);
         case builtin_pop: return built_in_pop(args, env);
+        case builtin_substr: return built_in_substr(args, env);
+        case builtin_split: return built_in_split(args, env);
+        case builtin_find: return built_in_find(args, env);
+        case builtin_sum: return built_in_sum(args, env);
+        case builtin_argmin: return built_in_argmin(args, env);
+        case builtin_argmax: return built_in_argmax(args, env);
+        case builtin_sort: return built_in_sort(args, env);
+        case builtin_sorted: return built_in_sorted(args, env);
+        case builtin_pmap: return built_in_pmap(args, env);
+        case builtin_pfilter: return built_in_pfilter(args, env);
+        case builtin_preduce: return built_in_preduce(args, env);
+        case builtin_dot: return built_in_dot(args, env);
+        case builtin_join: return built_in_join(args, env);
+        case builtin_sleep: return built_in_sleep(args, env);
+        case builtin_chan: return built_in_chan(args, env);
+        case builtin_send: return built_in_send(args, env);
+        case builtin_recv: return built_in_recv(args, env);
+        case builtin_select: return built_in_select(args, env);
+        case builtin_readfile: return built_in_readfile(args, env);
+        case builtin_writefile: return built_in_writefile(args, env);
+        case builtin_open: return built_in_open(args, env);
+        case builtin_read: return built_in_read(args, env);
+        case builtin_lines: return built_in_lines(args, env);
+        case builtin_json_parse: return built_in_json_parse(args, env);
+        case builtin_json_stringify: return built_in_json_stringify(args, env);
+        case builtin_json_lines: return built_in_json_lines(args, env);
+        case builtin_csv_read: return built_in_csv_read(args, env);
+        case builtin_csv_rows: return built_in_csv_rows(args, env);
+        case builtin_match: return built_in_match(args, env);
+        case builtin_search: return built_in_search(args, env);
+        case builtin_findall: return built_in_findall(args, env);
+        case builtin_replace: return built_in_replace(args, env);
+        case builtin_import_native: return built_in_import_native(args, env);
         // case builtin_quit: return built_in_quit(env);
-        default: return newError("not a valid function");
+        default:
+            if (bf->builtin_type >= builtin_native) return callNative(bf->builtin_type - builtin_native, args, env);
+            return newError("not a valid function");
     }
 };
 
+int builtinSymbol(Symbol name) {
+    static const unordered_map<Symbol, int> symbols = []() {
+        unordered_map<Symbol, int> result{};
+        for (auto& builtin : builtins)
+            result[intern(builtin.first)] = builtin.second;
+        return result;
+    }();
+    auto found = symbols.find(name);
+    return found == symbols.end() ? -1 : found->second;
+}
+
 shared_ptr<Object> built_in_len(vector<shared_ptr<Object>> args, shared_ptr<Environment> env) {
     if (args.size() != 1) {
         return newError(
@@ -31,13 +88,13 @@ shared_ptr<Object> built_in_len(vector<shared_ptr<Object>> args, shared_ptr<Envi
     }
     if (args[0]->inspectType() == ObjectType.STRING_OBJ) {
         shared_ptr<String> s = static_pointer_cast<String>(args[0]);
-        shared_ptr<Integer> newi(new Integer(s->value.length()));
+        shared_ptr<Integer> newi(new Integer(s->length));
         env->gc.push_back(newi);
         return newi;
     }
     if (args[0]->inspectType() == ObjectType.ARRAY_OBJ) {
         shared_ptr<Array> a = static_pointer_cast<Array>(args[0]);
-        shared_ptr<Integer> newi(new Integer(a->elements.size()));
+        shared_ptr<Integer> newi(new Integer(a->size()));
         env->gc.push_back(newi);
         return newi;
     }
@@ -45,45 +102,150 @@ shared_ptr<Object> built_in_len(vector<shared_ptr<Object>> args, shared_ptr<Envi
     return nullptr;
 }
 shared_ptr<Object> built_in_print(vector<shared_ptr<Object>> args, shared_ptr<Environment> env) {
-    stringstream ss;
-    for (auto arg : args)
-        ss << arg->inspectObject();
     shared_ptr<Print> newp(new Print());
-    newp->value = ss.str();
+    for (auto& arg : args)
+        newp->value += arg->inspectObject();
 
-    wprintw(PAD, "\n%s", ss.str().c_str());
-    CURSOR_Y += 1;
+    // scripts run without a curses pad, so their output goes straight to stdout;
+    // functions run by the parallel builtins print whole lines at a time
+    static mutex output;
+    lock_guard<mutex> guard(output);
+    if (PAD == nullptr) cout << newp->value << '\n';
+    else {
+        wprintw(PAD, "\n%s", newp->value.c_str());
+        CURSOR_Y += 1;
+    }
     env->gc.push_back(newp);
 
     return newp;
 }
 
-shared_ptr<Object> built_in_max(vector<shared_ptr<Object>> args, shared_ptr<Environment> env) {
-    int result{};
-    if (args.size() == 1) return args[0];
+// runs a kernel over a packed array and boxes what it returns
+shared_ptr<Object> packedReduction(
+    const Array& a, int (*intKernel)(const int*, size_t), double (*floatKernel)(const double*, size_t),
+    shared_ptr<Environment> env
+) {
+    shared_ptr<Object> result;
+    if (a.kind == intArray) {
+        vector<int> scratch;
+        result = shared_ptr<Object>(new Integer(intKernel(a.intData(scratch), a.size())));
+    } else {
+        vector<double> scratch;
+        result = shared_ptr<Object>(new Float(floatKernel(a.floatData(scratch), a.size())));
+    }
+    env->gc.push_back(result);
+    return result;
+}
 
-    for (auto arg : args) {
-        shared_ptr<Integer> i = static_pointer_cast<Integer>(arg);
-        int num               = stoi(i->inspectObject());
-        num > result ? result = num : result = result;
+// Checks that a reduction got either one array or one or more numbers and
+// collects the numbers, unless the array is packed and left to the kernels.
+shared_ptr<Object> numericArguments(
+    string name, const vector<shared_ptr<Object>>& args, bool allowEmpty, vector<shared_ptr<Object>>& numbers
+) {
+    if (args.empty())
+        return newError("Wrong number of arguments for " + name + "(). Expected at least 1, got 0");
+    if (args.size() == 1 && args[0]->type == ARRAY_OBJ) {
+        shared_ptr<Array> a = static_pointer_cast<Array>(args[0]);
+        if (a->size() == 0 && !allowEmpty) return newError("Argument 1 to " + name + "() must not be empty.");
+        if (a->kind == intArray || a->kind == floatArray) return nullptr;
+        numbers = a->elements();
+        for (auto& number : numbers)
+            if (!isNumeric(number))
+                return newError(
+                    "Argument 1 to " + name + "() must hold only INTEGER or FLOAT. Found " + number->inspectType()
+                );
+        return nullptr;
     }
-    shared_ptr<String> news(new String(to_string(result)));
-    env->gc.push_back(news);
-    return news;
+    for (size_t i = 0; i < args.size(); i++)
+        if (!isNumeric(args[i]))
+            return newError(
+                "Argument " + to_string(i + 1) + " to " + name + "() must be INTEGER or FLOAT. Instead got " +
+                args[i]->inspectType()
+            );
+    numbers = args;
+    return nullptr;
 }
 
-shared_ptr<Object> built_in_min(vector<shared_ptr<Object>> args, shared_ptr<Environment> env) {
-    int result{};
-    if (args.size() == 1) return args[0];
+// the position of the first smallest or largest number; ties keep the earliest
+size_t extremeIndex(const vector<shared_ptr<Object>>& numbers, bool smallest) {
+    size_t best       = 0;
+    double bestNumber = numericValue(numbers[0]);
+    for (size_t i = 1; i < numbers.size(); i++) {
+        double number = numericValue(numbers[i]);
+        if (smallest ? number < bestNumber : number > bestNumber) {
+            best       = i;
+            bestNumber = number;
+        }
+    }
+    return best;
+}
 
-    for (auto arg : args) {
-        shared_ptr<Integer> i = static_pointer_cast<Integer>(arg);
-        int num               = stoi(i->inspectObject());
-        num < result ? result = num : result = result;
+shared_ptr<Object> evalExtreme(
+    string name, vector<shared_ptr<Object>> args, bool smallest, shared_ptr<Environment> env
+) {
+    vector<shared_ptr<Object>> numbers{};
+    shared_ptr<Object> err = numericArguments(name, args, false, numbers);
+    if (err != nullptr) return err;
+    if (numbers.empty()) {
+        const SimdKernels& kernels = simdKernels();
+        return packedReduction(
+            *static_pointer_cast<Array>(args[0]), smallest ? kernels.minInt : kernels.maxInt,
+            smallest ? kernels.minFloat : kernels.maxFloat, env
+        );
     }
-    shared_ptr<String> news(new String(to_string(result)));
-    env->gc.push_back(news);
-    return news;
+    // the winning number keeps its own type
+    return numbers[extremeIndex(numbers, smallest)];
+}
+
+shared_ptr<Object> evalExtremeIndex(
+    string name, vector<shared_ptr<Object>> args, bool smallest, shared_ptr<Environment> env
+) {
+    if (args.size() != 1)
+        return newError("Wrong number of arguments for " + name + "(). Expected 1, got " + to_string(args.size()));
+    if (args[0]->type != ARRAY_OBJ)
+        return newError("Argument 1 to " + name + "() must be ARRAY. Instead got " + args[0]->inspectType());
+    vector<shared_ptr<Object>> numbers{};
+    shared_ptr<Object> err = numericArguments(name, args, false, numbers);
+    if (err != nullptr) return err;
+
+    size_t index;
+    if (numbers.empty()) {
+        // the extreme value first, then where it first occurs
+        const SimdKernels& kernels = simdKernels();
+        shared_ptr<Array> a        = static_pointer_cast<Array>(args[0]);
+        if (a->kind == intArray) {
+            vector<int> scratch;
+            const int* values = a->intData(scratch);
+            int extreme       = (smallest ? kernels.minInt : kernels.maxInt)(values, a->size());
+            index             = kernels.findInt(values, a->size(), extreme);
+        } else {
+            vector<double> scratch;
+            const double* values = a->floatData(scratch);
+            double extreme       = (smallest ? kernels.minFloat : kernels.maxFloat)(values, a->size());
+            index                = kernels.findFloat(values, a->size(), extreme);
+            // NaN compares unequal to itself, so fall back to a plain scan
+            if (index == a->size()) index = extremeIndex(a->elements(), smallest);
+        }
+    } else index = extremeIndex(numbers, smallest);
+    shared_ptr<Integer> newi(new Integer(index));
+    env->gc.push_back(newi);
+    return newi;
+}
+
+shared_ptr<Object> built_in_max(vector<shared_ptr<Object>> args, shared_ptr<Environment> env) {
+    return evalExtreme("max", args, false, env);
+}
+
+shared_ptr<Object> built_in_min(vector<shared_ptr<Object>> args, shared_ptr<Environment> env) {
+    return evalExtreme("min", args, true, env);
+}
+
+shared_ptr<Object> built_in_argmax(vector<shared_ptr<Object>> args, shared_ptr<Environment> env) {
+    return evalExtremeIndex("argmax", args, false, env);
+}
+
+shared_ptr<Object> built_in_argmin(vector<shared_ptr<Object>> args, shared_ptr<Environment> env) {
+    return evalExtremeIndex("argmin", args, true, env);
 }
 
 shared_ptr<Object> built_in_push(vector<shared_ptr<Object>> args, shared_ptr<Environment> env) {
@@ -95,9 +257,26 @@ shared_ptr<Object> built_in_push(vector<shared_ptr<Object>> args, shared_ptr<Env
         return newError(
             "Argument 1 to push() must be ARRAY. Instead got " + args[0]->inspectType()
         );
-    std::vector<shared_ptr<Object>> arg = static_pointer_cast<Array>(args[0])->elements;
-    arg.push_back(args[1]);
-    shared_ptr<Array> arr(new Array(arg));
+    shared_ptr<Array> a = static_pointer_cast<Array>(args[0]);
+    shared_ptr<Array> arr;
+    // packed arrays stay packed without boxing every element on the way
+    if (a->kind == intArray && args[1]->type == INTEGER_OBJ) {
+        vector<int> scratch;
+        const int* values = a->intData(scratch);
+        vector<int> result(values, values + a->size());
+        result.push_back(static_pointer_cast<Integer>(args[1])->value);
+        arr = shared_ptr<Array>(new Array(move(result)));
+    } else if (a->kind == floatArray && args[1]->type == FLOAT_OBJ) {
+        vector<double> scratch;
+        const double* values = a->floatData(scratch);
+        vector<double> result(values, values + a->size());
+        result.push_back(static_pointer_cast<Float>(args[1])->value);
+        arr = shared_ptr<Array>(new Array(move(result)));
+    } else {
+        std::vector<shared_ptr<Object>> arg = a->elements();
+        arg.push_back(args[1]);
+        arr = shared_ptr<Array>(new Array(arg));
+    }
     env->gc.push_back(arr);
     return arr;
 }
@@ -109,9 +288,744 @@ shared_ptr<Object> built_in_pop(vector<shared_ptr<Object>> args, shared_ptr<Envi
         );
     if (args[0]->inspectType() != ObjectType.ARRAY_OBJ)
         return newError("Argument 1 to pop() must be ARRAY. Instead got " + args[0]->inspectType());
-    std::vector<shared_ptr<Object>> arg = static_pointer_cast<Array>(args[0])->elements;
-    arg.pop_back();
-    shared_ptr<Array> arr(new Array(arg));
+    shared_ptr<Array> a = static_pointer_cast<Array>(args[0]);
+    if (a->size() == 0) return newError("pop() from an empty ARRAY.");
+    // everything but the last element is a view of the same buffer
+    shared_ptr<Array> arr(new Array(*a, a->offset, a->size() - 1, a->step));
+    env->gc.push_back(arr);
+    return arr;
+}
+
+shared_ptr<Object> built_in_find(vector<shared_ptr<Object>> args, shared_ptr<Environment> env) {
+    if (args.size() != 2 && args.size() != 3)
+        return newError("Wrong number of arguments for find(). Expected 2 or 3, got " + to_string(args.size()));
+    if (args[0]->type != STRING_OBJ)
+        return newError("Argument 1 to find() must be STRING. Instead got " + args[0]->inspectType());
+    if (args[1]->type != STRING_OBJ)
+        return newError("Argument 2 to find() must be STRING. Instead got " + args[1]->inspectType());
+    if (args.size() == 3 && args[2]->type != INTEGER_OBJ)
+        return newError("Argument 3 to find() must be INTEGER. Instead got " + args[2]->inspectType());
+    // the position of the first match at or after the optional start, or -1
+    string_view haystack = static_pointer_cast<String>(args[0])->value();
+    long start           = args.size() == 3 ? static_pointer_cast<Integer>(args[2])->value : 0;
+    if (start < 0) start = max(start + (long)haystack.size(), 0L);
+    size_t found = haystack.find(static_pointer_cast<String>(args[1])->value(), start);
+    shared_ptr<Integer> newi(new Integer(found == string_view::npos ? -1 : (int)found));
+    env->gc.push_back(newi);
+    return newi;
+}
+
+shared_ptr<Object> built_in_split(vector<shared_ptr<Object>> args, shared_ptr<Environment> env) {
+    if (args.size() != 1 && args.size() != 2)
+        return newError("Wrong number of arguments for split(). Expected 1 or 2, got " + to_string(args.size()));
+    if (args[0]->type != STRING_OBJ)
+        return newError("Argument 1 to split() must be STRING. Instead got " + args[0]->inspectType());
+    if (args.size() == 2 && args[1]->type != STRING_OBJ)
+        return newError("Argument 2 to split() must be STRING. Instead got " + args[1]->inspectType());
+    shared_ptr<String> s = static_pointer_cast<String>(args[0]);
+    string_view text     = s->value();
+    vector<shared_ptr<Object>> parts{};
+
+    if (args.size() == 1) {
+        // without a separator, runs of whitespace separate the parts
+        const char* whitespace = " \t\n\r\v\f";
+        size_t start           = text.find_first_not_of(whitespace);
+        while (start != string_view::npos) {
+            size_t end = text.find_first_of(whitespace, start);
+            if (end == string_view::npos) end = text.size();
+            parts.push_back(stringView(s, start, end - start, env));
+            start = text.find_first_not_of(whitespace, end);
+        }
+    } else {
+        string_view separator = static_pointer_cast<String>(args[1])->value();
+        if (separator.empty()) return newError("Argument 2 to split() must not be empty.");
+        size_t start = 0;
+        while (true) {
+            size_t end = text.find(separator, start);
+            if (end == string_view::npos) end = text.size();
+            parts.push_back(stringView(s, start, end - start, env));
+            if (end == text.size()) break;
+            start = end + separator.size();
+        }
+    }
+    shared_ptr<Array> arr(new Array(parts));
+    env->gc.push_back(arr);
+    return arr;
+}
+
+shared_ptr<Object> built_in_substr(vector<shared_ptr<Object>> args, shared_ptr<Environment> env) {
+    if (args.size() != 2 && args.size() != 3)
+        return newError(
+            "Wrong number of arguments for substr(). Expected 2 or 3, got " + to_string(args.size())
+        );
+    if (args[0]->type != STRING_OBJ)
+        return newError("Argument 1 to substr() must be STRING. Instead got " + args[0]->inspectType());
+    for (int i = 1; i < args.size(); i++)
+        if (args[i]->type != INTEGER_OBJ)
+            return newError(
+                "Argument " + to_string(i + 1) + " to substr() must be INTEGER. Instead got " +
+                args[i]->inspectType()
+            );
+    // like a slice, the start counts from the end when negative and both the
+    // start and the length are clamped to the string
+    shared_ptr<String> s = static_pointer_cast<String>(args[0]);
+    long size            = s->length;
+    long start           = static_pointer_cast<Integer>(args[1])->value;
+    if (start < 0) start += size;
+    start       = min(max(start, 0L), size);
+    long length = args.size() == 3 ? static_pointer_cast<Integer>(args[2])->value : size - start;
+    length      = min(max(length, 0L), size - start);
+    return stringView(s, start, length, env);
+}
+
+shared_ptr<Object> built_in_sum(vector<shared_ptr<Object>> args, shared_ptr<Environment> env) {
+    vector<shared_ptr<Object>> numbers{};
+    shared_ptr<Object> err = numericArguments("sum", args, true, numbers);
+    if (err != nullptr) return err;
+    // integers add up to an integer, anything else to a float
+    long long intTotal{0};
+    double floatTotal{0};
+    bool floats = false;
+    if (numbers.empty() && static_pointer_cast<Array>(args[0])->size() > 0) {
+        const Array& a = *static_pointer_cast<Array>(args[0]);
+        vector<int> intScratch;
+        vector<double> floatScratch;
+        if (a.kind == intArray) intTotal = simdKernels().sumInt(a.intData(intScratch), a.size());
+        else floatTotal = simdKernels().sumFloat(a.floatData(floatScratch), a.size());
+        floats = a.kind != intArray;
+    }
+    for (auto& number : numbers) {
+        if (number->type == INTEGER_OBJ) intTotal += static_pointer_cast<Integer>(number)->value;
+        else floats = true;
+        floatTotal += numericValue(number);
+    }
+    if (!floats && (intTotal > INT_MAX || intTotal < INT_MIN))
+        return newError("Integer overflow in sum(): the total is " + to_string(intTotal));
+    shared_ptr<Object> result;
+    if (floats) result = make_shared<Float>(floatTotal);
+    else result = make_shared<Integer>((int)intTotal);
+    env->gc.push_back(result);
+    return result;
+}
+
+shared_ptr<Object> built_in_dot(vector<shared_ptr<Object>> args, shared_ptr<Environment> env) {
+    if (args.size() != 2)
+        return newError("Wrong number of arguments for dot(). Expected 2, got " + to_string(args.size()));
+    for (int i = 0; i < 2; i++)
+        if (args[i]->type != ARRAY_OBJ)
+            return newError(
+                "Argument " + to_string(i + 1) + " to dot() must be ARRAY. Instead got " + args[i]->inspectType()
+            );
+    shared_ptr<Array> a = static_pointer_cast<Array>(args[0]);
+    shared_ptr<Array> b = static_pointer_cast<Array>(args[1]);
+    if (a->size() != b->size())
+        return newError(
+            "Arguments to dot() must have the same length, got " + to_string(a->size()) + " and " +
+            to_string(b->size())
+        );
+    shared_ptr<Object> result;
+    if (a->size() == 0 || (a->kind == intArray && b->kind == intArray)) {
+        vector<int> scratchA, scratchB;
+        int product = a->size() == 0 ? 0 : simdKernels().dotInt(a->intData(scratchA), b->intData(scratchB), a->size());
+        result      = shared_ptr<Object>(new Integer(product));
+    } else {
+        vector<double> scratchA, scratchB;
+        const double* valuesA = a->floatData(scratchA);
+        const double* valuesB = b->floatData(scratchB);
+        if (valuesA == nullptr || valuesB == nullptr)
+            return newError("Arguments to dot() must hold only INTEGER or FLOAT.");
+        result = shared_ptr<Object>(new Float(simdKernels().dotFloat(valuesA, valuesB, a->size())));
+    }
+    env->gc.push_back(result);
+    return result;
+}
+
+// NaN sorts after every other number instead of breaking the ordering
+inline bool numberLess(double a, double b) { return a < b || (isnan(b) && !isnan(a)); }
+
+// Sorts an array's elements into a new array. Packed arrays are sorted on
+// their native values. Other arrays, and any array sorted by a key function,
+// are sorted as (key, position) pairs: the key function runs once per element
+// rather than once per comparison, and equal keys keep their order.
+shared_ptr<Object> sortedArray(
+    string name, const vector<shared_ptr<Object>>& args, shared_ptr<Environment> env, shared_ptr<Array>& result
+) {
+    if (args.size() != 1 && args.size() != 2)
+        return newError(
+            "Wrong number of arguments for " + name + "(). Expected 1 or 2, got " + to_string(args.size())
+        );
+    if (args[0]->type != ARRAY_OBJ)
+        return newError("Argument 1 to " + name + "() must be ARRAY. Instead got " + args[0]->inspectType());
+    if (args.size() == 2 && args[1]->type != FUNCTION_OBJ && args[1]->type != BUILTIN_OBJ)
+        return newError("Argument 2 to " + name + "() must be FUNCTION. Instead got " + args[1]->inspectType());
+    shared_ptr<Array> a = static_pointer_cast<Array>(args[0]);
+
+    if (args.size() == 1 && a->kind == intArray) {
+        vector<int> scratch;
+        const int* data = a->intData(scratch);
+        vector<int> values(data, data + a->size());
+        parallelSort(values, [](int x, int y) { return x < y; });
+        result = shared_ptr<Array>(new Array(move(values)));
+        return nullptr;
+    }
+    if (args.size() == 1 && a->kind == floatArray) {
+        vector<double> scratch;
+        const double* data = a->floatData(scratch);
+        vector<double> values(data, data + a->size());
+        if (any_of(values.begin(), values.end(), [](double x) { return isnan(x); }))
+            parallelSort(values, numberLess);
+        else parallelSort(values, [](double x, double y) { return x < y; });
+        result = shared_ptr<Array>(new Array(move(values)));
+        return nullptr;
+    }
+
+    vector<shared_ptr<Object>> elements = a->elements();
+    vector<shared_ptr<Object>> keys{};
+    keys.reserve(elements.size());
+    bool numbers = true, strings = true;
+    for (auto& element : elements) {
+        shared_ptr<Object> key = args.size() == 2 ? applyFunction(args[1], {element}, env) : element;
+        if (isError(key)) return key;
+        numbers = numbers && (isNumeric(key) || key->type == BOOLEAN_TRUE || key->type == BOOLEAN_FALSE);
+        strings = strings && key->type == STRING_OBJ;
+        if (!numbers && !strings)
+            return newError(
+                name + "() can only order numbers, booleans or strings, not a mix of them. Found " +
+                key->inspectType()
+            );
+        keys.push_back(key);
+    }
+
+    vector<shared_ptr<Object>> ordered{};
+    ordered.reserve(elements.size());
+    if (numbers) {
+        vector<pair<double, size_t>> pairs(keys.size());
+        for (size_t i = 0; i < keys.size(); i++)
+            pairs[i] = {isNumeric(keys[i]) ? numericValue(keys[i]) : keys[i]->type == BOOLEAN_TRUE, i};
+        parallelSort(pairs, [](const pair<double, size_t>& x, const pair<double, size_t>& y) {
+            if (numberLess(x.first, y.first)) return true;
+            if (numberLess(y.first, x.first)) return false;
+            return x.second < y.second;
+        });
+        for (auto& key : pairs)
+            ordered.push_back(elements[key.second]);
+    } else {
+        vector<pair<string_view, size_t>> pairs(keys.size());
+        for (size_t i = 0; i < keys.size(); i++)
+            pairs[i] = {static_pointer_cast<String>(keys[i])->value(), i};
+        parallelSort(pairs, [](const pair<string_view, size_t>& x, const pair<string_view, size_t>& y) {
+            return x < y;
+        });
+        for (auto& key : pairs)
+            ordered.push_back(elements[key.second]);
+    }
+    result = shared_ptr<Array>(new Array(move(ordered)));
+    return nullptr;
+}
+
+shared_ptr<Object> built_in_sorted(vector<shared_ptr<Object>> args, shared_ptr<Environment> env) {
+    shared_ptr<Array> result;
+    shared_ptr<Object> err = sortedArray("sorted", args, env, result);
+    if (err != nullptr) return err;
+    env->gc.push_back(result);
+    return result;
+}
+
+shared_ptr<Object> built_in_sort(vector<shared_ptr<Object>> args, shared_ptr<Environment> env) {
+    shared_ptr<Array> result;
+    shared_ptr<Object> err = sortedArray("sort", args, env, result);
+    if (err != nullptr) return err;
+    // the array takes over the sorted buffer, leaving the old one to any views of it
+    shared_ptr<Array> a = static_pointer_cast<Array>(args[0]);
+    *a                  = *result;
+    return a;
+}
+
+// calls a function passed to a parallel builtin, turning a missing result into an error
+shared_ptr<Object> applyParallel(
+    string name, shared_ptr<Object> fn, vector<shared_ptr<Object>> args, shared_ptr<Environment> env
+) {
+    shared_ptr<Object> result = applyFunction(fn, args, env);
+    if (result == nullptr) return newError("Function passed to " + name + "() returned no value.");
+    return result;
+}
+
+shared_ptr<Object> checkParallelArguments(string name, const vector<shared_ptr<Object>>& args, size_t expected) {
+    if (args.size() != expected)
+        return newError(
+            "Wrong number of arguments for " + name + "(). Expected " + to_string(expected) + ", got " +
+            to_string(args.size())
+        );
+    if (args[0]->type != ARRAY_OBJ)
+        return newError("Argument 1 to " + name + "() must be ARRAY. Instead got " + args[0]->inspectType());
+    if (args[1]->type != FUNCTION_OBJ && args[1]->type != BUILTIN_OBJ)
+        return newError("Argument 2 to " + name + "() must be FUNCTION. Instead got " + args[1]->inspectType());
+    return nullptr;
+}
+
+shared_ptr<Object> built_in_pmap(vector<shared_ptr<Object>> args, shared_ptr<Environment> env) {
+    shared_ptr<Object> err = checkParallelArguments("pmap", args, 2);
+    if (err != nullptr) return err;
+    vector<shared_ptr<Object>> elements = static_pointer_cast<Array>(args[0])->elements();
+    vector<shared_ptr<Object>> results(elements.size());
+    err = parallelChunks(elements.size(), env, [&](size_t start, size_t end, shared_ptr<Environment> local) {
+        for (size_t i = start; i < end; i++) {
+            results[i] = applyParallel("pmap", args[1], {elements[i]}, local);
+            if (isError(results[i])) return results[i];
+        }
+        return shared_ptr<Object>(nullptr);
+    });
+    if (err != nullptr) return err;
+    shared_ptr<Array> arr(new Array(move(results)));
+    env->gc.push_back(arr);
+    return arr;
+}
+
+shared_ptr<Object> built_in_pfilter(vector<shared_ptr<Object>> args, shared_ptr<Environment> env) {
+    shared_ptr<Object> err = checkParallelArguments("pfilter", args, 2);
+    if (err != nullptr) return err;
+    vector<shared_ptr<Object>> elements = static_pointer_cast<Array>(args[0])->elements();
+    vector<char> keep(elements.size());
+    err = parallelChunks(elements.size(), env, [&](size_t start, size_t end, shared_ptr<Environment> local) {
+        for (size_t i = start; i < end; i++) {
+            shared_ptr<Object> result = applyParallel("pfilter", args[1], {elements[i]}, local);
+            if (isError(result)) return result;
+            keep[i] = isTruthy(result);
+        }
+        return shared_ptr<Object>(nullptr);
+    });
+    if (err != nullptr) return err;
+    vector<shared_ptr<Object>> kept{};
+    for (size_t i = 0; i < elements.size(); i++)
+        if (keep[i]) kept.push_back(elements[i]);
+    shared_ptr<Array> arr(new Array(move(kept)));
+    env->gc.push_back(arr);
+    return arr;
+}
+
+// Each chunk is folded on its own, starting from its first element, and the
+// chunk results are then folded into the initial value in order, so the
+// function has to be associative for the result to match a sequential fold.
+shared_ptr<Object> built_in_preduce(vector<shared_ptr<Object>> args, shared_ptr<Environment> env) {
+    shared_ptr<Object> err = checkParallelArguments("preduce", args, 3);
+    if (err != nullptr) return err;
+    vector<shared_ptr<Object>> elements = static_pointer_cast<Array>(args[0])->elements();
+    vector<shared_ptr<Object>> partials(elements.size());
+    err = parallelChunks(elements.size(), env, [&](size_t start, size_t end, shared_ptr<Environment> local) {
+        shared_ptr<Object> result = elements[start];
+        for (size_t i = start + 1; i < end; i++) {
+            result = applyParallel("preduce", args[1], {result, elements[i]}, local);
+            if (isError(result)) return result;
+        }
+        partials[start] = result;
+        return shared_ptr<Object>(nullptr);
+    });
+    if (err != nullptr) return err;
+    shared_ptr<Object> result = args[2];
+    for (auto& partial : partials) {
+        if (partial == nullptr) continue;
+        result = applyParallel("preduce", args[1], {result, partial}, env);
+        if (isError(result)) return result;
+    }
+    return result;
+}
+
+shared_ptr<Object> built_in_join(vector<shared_ptr<Object>> args, shared_ptr<Environment> env) {
+    if (args.size() != 1)
+        return newError("Wrong number of arguments for join(). Expected 1, got " + to_string(args.size()));
+    if (args[0]->type == TASK_OBJ) return awaitTask(static_pointer_cast<Task>(args[0]), env);
+    if (args[0]->type != ARRAY_OBJ)
+        return newError("Argument 1 to join() must be TASK or ARRAY. Instead got " + args[0]->inspectType());
+
+    // an array of tasks is joined in order, giving an array of their results
+    vector<shared_ptr<Object>> tasks = static_pointer_cast<Array>(args[0])->elements();
+    for (auto& task : tasks)
+        if (task->type != TASK_OBJ)
+            return newError("Elements of the array passed to join() must be TASK. Instead got " + task->inspectType());
+    vector<shared_ptr<Object>> results{};
+    for (auto& task : tasks)
+        results.push_back(awaitTask(static_pointer_cast<Task>(task), env));
+    shared_ptr<Array> arr(new Array(move(results)));
+    env->gc.push_back(arr);
+    return arr;
+}
+
+// Inside a task this parks the task, leaving its thread free for others.
+shared_ptr<Object> built_in_sleep(vector<shared_ptr<Object>> args, shared_ptr<Environment> env) {
+    if (args.size() != 1)
+        return newError("Wrong number of arguments for sleep(). Expected 1, got " + to_string(args.size()));
+    if (args[0]->type != INTEGER_OBJ && args[0]->type != FLOAT_OBJ)
+        return newError("Argument 1 to sleep() must be INTEGER or FLOAT. Instead got " + args[0]->inspectType());
+    double milliseconds = numericValue(args[0]);
+    if (milliseconds > 0) Scheduler::shared().sleep(chrono::milliseconds((long long)milliseconds));
+    shared_ptr<Object> null(new Null());
+    env->gc.push_back(null);
+    return null;
+}
+
+// chan() never fills up; chan(n) holds up to n values, and sending to it waits while it is full
+shared_ptr<Object> built_in_chan(vector<shared_ptr<Object>> args, shared_ptr<Environment> env) {
+    if (args.size() > 1)
+        return newError("Wrong number of arguments for chan(). Expected 0 or 1, got " + to_string(args.size()));
+    size_t capacity = 0;
+    if (args.size() == 1) {
+        if (args[0]->type != INTEGER_OBJ || static_pointer_cast<Integer>(args[0])->value < 1)
+            return newError(
+                "Argument 1 to chan() must be a positive INTEGER. Instead got " + args[0]->inspectObject()
+            );
+        capacity = static_pointer_cast<Integer>(args[0])->value;
+    }
+    shared_ptr<Channel> channel(new Channel(capacity));
+    env->gc.push_back(channel);
+    return channel;
+}
+
+// The value is handed over as it is rather than copied, like any other
+// assignment; arrays and hashes sent on are shared with the receiver.
+shared_ptr<Object> built_in_send(vector<shared_ptr<Object>> args, shared_ptr<Environment> env) {
+    if (args.size() != 2)
+        return newError("Wrong number of arguments for send(). Expected 2, got " + to_string(args.size()));
+    if (args[0]->type != CHANNEL_OBJ)
+        return newError("Argument 1 to send() must be CHANNEL. Instead got " + args[0]->inspectType());
+    static_pointer_cast<Channel>(args[0])->send(move(args[1]));
+    shared_ptr<Object> null(new Null());
+    env->gc.push_back(null);
+    return null;
+}
+
+shared_ptr<Object> built_in_recv(vector<shared_ptr<Object>> args, shared_ptr<Environment> env) {
+    if (args.size() != 1)
+        return newError("Wrong number of arguments for recv(). Expected 1, got " + to_string(args.size()));
+    if (args[0]->type != CHANNEL_OBJ)
+        return newError("Argument 1 to recv() must be CHANNEL. Instead got " + args[0]->inspectType());
+    return static_pointer_cast<Channel>(args[0])->receive();
+}
+
+// select(channels) waits for a value on any of the channels and gives
+// [position of the channel, value]
+shared_ptr<Object> built_in_select(vector<shared_ptr<Object>> args, shared_ptr<Environment> env) {
+    if (args.size() != 1)
+        return newError("Wrong number of arguments for select(). Expected 1, got " + to_string(args.size()));
+    if (args[0]->type != ARRAY_OBJ)
+        return newError("Argument 1 to select() must be ARRAY. Instead got " + args[0]->inspectType());
+    vector<shared_ptr<Channel>> channels{};
+    for (auto& el : static_pointer_cast<Array>(args[0])->elements()) {
+        if (el->type != CHANNEL_OBJ)
+            return newError(
+                "Elements of the array passed to select() must be CHANNEL. Instead got " + el->inspectType()
+            );
+        channels.push_back(static_pointer_cast<Channel>(el));
+    }
+    if (channels.empty()) return newError("select() needs at least one channel to wait on");
+
+    shared_ptr<Object> value;
+    size_t chosen = Channel::select(channels, value);
+    shared_ptr<Array> arr(new Array({shared_ptr<Object>(new Integer(chosen)), value}));
+    env->gc.push_back(arr);
+    return arr;
+}
+
+// Inside a task the read parks the task, so many reads can be waited on at once.
+shared_ptr<Object> built_in_readfile(vector<shared_ptr<Object>> args, shared_ptr<Environment> env) {
+    if (args.size() != 1)
+        return newError("Wrong number of arguments for readfile(). Expected 1, got " + to_string(args.size()));
+    if (args[0]->type != STRING_OBJ)
+        return newError("Argument 1 to readfile() must be STRING. Instead got " + args[0]->inspectType());
+    string path = string(static_pointer_cast<String>(args[0])->value());
+    string contents{};
+    int error = readFile(path, contents);
+    if (error != 0) return newError("Could not read " + path + ": " + strerror(error));
+    shared_ptr<String> str(new String(move(contents)));
+    env->gc.push_back(str);
+    return str;
+}
+
+// writefile(path, text) replaces the file and gives the number of bytes written
+shared_ptr<Object> built_in_writefile(vector<shared_ptr<Object>> args, shared_ptr<Environment> env) {
+    if (args.size() != 2)
+        return newError("Wrong number of arguments for writefile(). Expected 2, got " + to_string(args.size()));
+    if (args[0]->type != STRING_OBJ)
+        return newError("Argument 1 to writefile() must be STRING. Instead got " + args[0]->inspectType());
+    string path = string(static_pointer_cast<String>(args[0])->value());
+    string text = args[1]->type == STRING_OBJ ? string(static_pointer_cast<String>(args[1])->value())
+                                              : args[1]->inspectObject();
+    int error   = writeFile(path, text);
+    if (error != 0) return newError("Could not write " + path + ": " + strerror(error));
+    shared_ptr<Integer> written(new Integer(text.size()));
+    env->gc.push_back(written);
+    return written;
+}
+
+// the mapped contents of a path, or of a file open() gave; nullptr when the argument is neither
+shared_ptr<Object> mappedContents(string name, shared_ptr<Object> arg, shared_ptr<const string_view>& contents) {
+    if (arg->type == FILE_OBJ) {
+        contents = static_pointer_cast<File>(arg)->contents;
+        return nullptr;
+    }
+    if (arg->type != STRING_OBJ)
+        return newError("Argument 1 to " + name + "() must be STRING or FILE. Instead got " + arg->inspectType());
+    string path = string(static_pointer_cast<String>(arg)->value());
+    int error   = mapFile(path, contents);
+    if (error != 0) return newError("Could not open " + path + ": " + strerror(error));
+    return nullptr;
+}
+
+// open(path) maps a file once, for any number of read() and lines() calls
+shared_ptr<Object> built_in_open(vector<shared_ptr<Object>> args, shared_ptr<Environment> env) {
+    if (args.size() != 1)
+        return newError("Wrong number of arguments for open(). Expected 1, got " + to_string(args.size()));
+    if (args[0]->type != STRING_OBJ)
+        return newError("Argument 1 to open() must be STRING. Instead got " + args[0]->inspectType());
+    shared_ptr<const string_view> contents{};
+    shared_ptr<Object> err = mappedContents("open", args[0], contents);
+    if (err != nullptr) return err;
+    shared_ptr<File> file(new File(string(static_pointer_cast<String>(args[0])->value()), contents));
+    env->gc.push_back(file);
+    return file;
+}
+
+// read(file) gives the whole file as one string, a view of the mapping
+shared_ptr<Object> built_in_read(vector<shared_ptr<Object>> args, shared_ptr<Environment> env) {
+    if (args.size() != 1)
+        return newError("Wrong number of arguments for read(). Expected 1, got " + to_string(args.size()));
+    shared_ptr<const string_view> contents{};
+    shared_ptr<Object> err = mappedContents("read", args[0], contents);
+    if (err != nullptr) return err;
+    shared_ptr<String> str(new String(contents, 0, contents->size()));
+    env->gc.push_back(str);
+    return str;
+}
+
+// lines(file) is only iterated; the lines are found as the loop reaches them
+shared_ptr<Object> built_in_lines(vector<shared_ptr<Object>> args, shared_ptr<Environment> env) {
+    if (args.size() != 1)
+        return newError("Wrong number of arguments for lines(). Expected 1, got " + to_string(args.size()));
+    shared_ptr<const string_view> contents{};
+    shared_ptr<Object> err = mappedContents("lines", args[0], contents);
+    if (err != nullptr) return err;
+    shared_ptr<Lines> lines(new Lines(contents));
+    env->gc.push_back(lines);
+    return lines;
+}
+
+// json_parse(text) builds the value a JSON document describes
+shared_ptr<Object> built_in_json_parse(vector<shared_ptr<Object>> args, shared_ptr<Environment> env) {
+    if (args.size() != 1)
+        return newError("Wrong number of arguments for json_parse(). Expected 1, got " + to_string(args.size()));
+    if (args[0]->type != STRING_OBJ)
+        return newError("Argument 1 to json_parse() must be STRING. Instead got " + args[0]->inspectType());
+    shared_ptr<String> text  = static_pointer_cast<String>(args[0]);
+    shared_ptr<Object> value = parseJson(text->buffer, text->offset, text->length);
+    env->gc.push_back(value);
+    return value;
+}
+
+// json_stringify(value) gives the JSON text of a value made of hashes, arrays, strings, numbers and booleans
+shared_ptr<Object> built_in_json_stringify(vector<shared_ptr<Object>> args, shared_ptr<Environment> env) {
+    if (args.size() != 1)
+        return newError("Wrong number of arguments for json_stringify(). Expected 1, got " + to_string(args.size()));
+    string text{};
+    string error = writeJson(args[0], text);
+    if (!error.empty()) return newError("Could not write JSON; " + error);
+    shared_ptr<String> str(new String(move(text)));
+    env->gc.push_back(str);
+    return str;
+}
+
+// json_lines(file) is like lines(), but parses each line that is not blank as a JSON document
+shared_ptr<Object> built_in_json_lines(vector<shared_ptr<Object>> args, shared_ptr<Environment> env) {
+    if (args.size() != 1)
+        return newError("Wrong number of arguments for json_lines(). Expected 1, got " + to_string(args.size()));
+    shared_ptr<const string_view> contents{};
+    shared_ptr<Object> err = mappedContents("json_lines", args[0], contents);
+    if (err != nullptr) return err;
+    shared_ptr<Lines> lines(new Lines(contents));
+    lines->format = jsonLines;
+    env->gc.push_back(lines);
+    return lines;
+}
+
+// the options csv_read() and csv_rows() take as a hash: {"delimiter": ";", "header": false}
+shared_ptr<Object> csvOptions(string name, vector<shared_ptr<Object>>& args, char& delimiter, bool& header) {
+    if (args.size() != 1 && args.size() != 2)
+        return newError(
+            "Wrong number of arguments for " + name + "(). Expected 1 or 2, got " + to_string(args.size())
+        );
+    if (args.size() == 1) return nullptr;
+    if (args[1]->type != HASH_OBJ)
+        return newError("Argument 2 to " + name + "() must be HASH. Instead got " + args[1]->inspectType());
+    for (auto& pair : static_pointer_cast<Hash>(args[1])->pairs) {
+        shared_ptr<Object> key   = pair.second->key;
+        shared_ptr<Object> value = pair.second->value;
+        string option            = key->type == STRING_OBJ ? string(static_pointer_cast<String>(key)->value()) : "";
+        if (option == "delimiter") {
+            string_view text = value->type == STRING_OBJ ? static_pointer_cast<String>(value)->value() : "";
+            // the scanner pads blocks with NUL, and quotes and newlines mean something else
+            if (text.size() != 1 || text[0] == '\0' || text[0] == '"' || text[0] == '\n' || text[0] == '\r')
+                return newError(name + "() option delimiter must be a single character other than a quote or newline");
+            delimiter = text[0];
+        } else if (option == "header") {
+            if (value->type != BOOLEAN_TRUE && value->type != BOOLEAN_FALSE)
+                return newError(name + "() option header must be BOOLEAN. Instead got " + value->inspectType());
+            header = value->type == BOOLEAN_TRUE;
+        } else return newError(name + "() has no option " + key->inspectObject());
+    }
+    return nullptr;
+}
+
+// csv_read(file, options) reads a whole CSV file into a hash of columns, each a packed array where it can be
+shared_ptr<Object> built_in_csv_read(vector<shared_ptr<Object>> args, shared_ptr<Environment> env) {
+    char delimiter         = ',';
+    bool header            = true;
+    shared_ptr<Object> err = csvOptions("csv_read", args, delimiter, header);
+    if (err != nullptr) return err;
+    shared_ptr<const string_view> contents{};
+    err = mappedContents("csv_read", args[0], contents);
+    if (err != nullptr) return err;
+    shared_ptr<Object> table = readCsv(contents, delimiter, header);
+    env->gc.push_back(table);
+    return table;
+}
+
+// csv_rows(file, options) is only iterated; each record is split as the loop reaches it
+shared_ptr<Object> built_in_csv_rows(vector<shared_ptr<Object>> args, shared_ptr<Environment> env) {
+    char delimiter         = ',';
+    bool header            = true;
+    shared_ptr<Object> err = csvOptions("csv_rows", args, delimiter, header);
+    if (err != nullptr) return err;
+    shared_ptr<const string_view> contents{};
+    err = mappedContents("csv_rows", args[0], contents);
+    if (err != nullptr) return err;
+    shared_ptr<Lines> rows(new Lines(contents));
+    rows->format    = csvLines;
+    rows->delimiter = delimiter;
+    rows->header    = header;
+    env->gc.push_back(rows);
+    return rows;
+}
+
+// checks the arguments of a regex builtin, all strings, and compiles the pattern that is the second
+shared_ptr<Object>
+    compiledPattern(string name, vector<shared_ptr<Object>>& args, size_t count, shared_ptr<Regex>& regex) {
+    if (args.size() != count)
+        return newError(
+            "Wrong number of arguments for " + name + "(). Expected " + to_string(count) + ", got " +
+            to_string(args.size())
+        );
+    for (size_t i = 0; i < count; i++)
+        if (args[i]->type != STRING_OBJ)
+            return newError(
+                "Argument " + to_string(i + 1) + " to " + name + "() must be STRING. Instead got " +
+                args[i]->inspectType()
+            );
+    string error{};
+    regex = Regex::cached(static_pointer_cast<String>(args[1])->value(), error);
+    if (regex == nullptr) return newError("Could not compile the pattern for " + name + "(): " + error);
+    return nullptr;
+}
+
+// what group of a match holds, as a view of the subject, or null when the group took no part in it
+shared_ptr<Object> matchGroup(shared_ptr<String> subject, const vector<size_t>& bounds, size_t group) {
+    size_t start = bounds[2 * group], end = bounds[2 * group + 1];
+    if (start == string_view::npos || end == string_view::npos) return shared_ptr<Object>(new Null());
+    return make_shared<String>(subject->buffer, subject->offset + start, end - start);
+}
+
+// match(s, pattern) tells whether all of s matches pattern
+shared_ptr<Object> built_in_match(vector<shared_ptr<Object>> args, shared_ptr<Environment> env) {
+    shared_ptr<Regex> regex{};
+    shared_ptr<Object> err = compiledPattern("match", args, 2, regex);
+    if (err != nullptr) return err;
+    return nativeToBoolean(regex->matches(static_pointer_cast<String>(args[0])->value()));
+}
+
+// search(s, pattern) gives the first match as [match, group 1, group 2, ...], or null when there is none
+shared_ptr<Object> built_in_search(vector<shared_ptr<Object>> args, shared_ptr<Environment> env) {
+    shared_ptr<Regex> regex{};
+    shared_ptr<Object> err = compiledPattern("search", args, 2, regex);
+    if (err != nullptr) return err;
+    shared_ptr<String> subject = static_pointer_cast<String>(args[0]);
+    vector<size_t> bounds{};
+    shared_ptr<Object> result{};
+    if (!regex->search(subject->value(), 0, bounds)) result = shared_ptr<Object>(new Null());
+    else {
+        vector<shared_ptr<Object>> groups{};
+        for (size_t i = 0; i <= regex->groups; i++)
+            groups.push_back(matchGroup(subject, bounds, i));
+        result = make_shared<Array>(move(groups));
+    }
+    env->gc.push_back(result);
+    return result;
+}
+
+// findall(s, pattern) gives every match that does not overlap an earlier one; for a pattern with groups,
+// the first group of each, or an array of all its groups when there are several
+shared_ptr<Object> built_in_findall(vector<shared_ptr<Object>> args, shared_ptr<Environment> env) {
+    shared_ptr<Regex> regex{};
+    shared_ptr<Object> err = compiledPattern("findall", args, 2, regex);
+    if (err != nullptr) return err;
+    shared_ptr<String> subject = static_pointer_cast<String>(args[0]);
+    string_view text           = subject->value();
+    vector<size_t> bounds{};
+    vector<shared_ptr<Object>> found{};
+    while (regex->next(text, bounds)) {
+        if (regex->groups <= 1) {
+            found.push_back(matchGroup(subject, bounds, regex->groups));
+            continue;
+        }
+        vector<shared_ptr<Object>> groups{};
+        for (size_t i = 1; i <= regex->groups; i++)
+            groups.push_back(matchGroup(subject, bounds, i));
+        found.push_back(make_shared<Array>(move(groups)));
+    }
+    shared_ptr<Array> arr = make_shared<Array>(move(found));
     env->gc.push_back(arr);
     return arr;
 }
+
+// replace(s, pattern, replacement) replaces every match; in the replacement, $0 stands for the match,
+// $1 to $9 for its groups and $$ for a dollar sign
+shared_ptr<Object> built_in_replace(vector<shared_ptr<Object>> args, shared_ptr<Environment> env) {
+    shared_ptr<Regex> regex{};
+    shared_ptr<Object> err = compiledPattern("replace", args, 3, regex);
+    if (err != nullptr) return err;
+    string_view text        = static_pointer_cast<String>(args[0])->value();
+    string_view replacement = static_pointer_cast<String>(args[2])->value();
+    vector<size_t> bounds{};
+    string out{};
+    size_t copied = 0, replaced = 0;
+    while (regex->next(text, bounds)) {
+        out.append(text.substr(copied, bounds[0] - copied));
+        for (size_t i = 0; i < replacement.size(); i++) {
+            char next = i + 1 < replacement.size() ? replacement[i + 1] : '\0';
+            if (replacement[i] != '$' || (next != '$' && !isdigit((unsigned char)next))) out += replacement[i];
+            else if (next == '$') {
+                out += '$';
+                i++;
+            } else {
+                size_t group = next - '0';
+                if (group <= regex->groups && bounds[2 * group] != string_view::npos &&
+                    bounds[2 * group + 1] != string_view::npos)
+                    out.append(text.substr(bounds[2 * group], bounds[2 * group + 1] - bounds[2 * group]));
+                i++;
+            }
+        }
+        copied = bounds[1];
+        replaced++;
+    }
+    // strings never change, so a string with nothing to replace is returned as it is
+    if (replaced == 0) return args[0];
+    out.append(text.substr(copied));
+    shared_ptr<String> str(new String(move(out)));
+    env->gc.push_back(str);
+    return str;
+}
+
+// import_native(path) loads a native extension module and binds the builtins it registers
+shared_ptr<Object> built_in_import_native(vector<shared_ptr<Object>> args, shared_ptr<Environment> env) {
+    if (args.size() != 1)
+        return newError("Wrong number of arguments for import_native(). Expected 1, got " + to_string(args.size()));
+    if (args[0]->type != STRING_OBJ)
+        return newError("Argument 1 to import_native() must be STRING. Instead got " + args[0]->inspectType());
+    return importNative(string(static_pointer_cast<String>(args[0])->value()), env);
+}
@@ -15,6 +15,72 @@ std::shared_ptr<Object>
     built_in_pop(std::vector<std::shared_ptr<Object>>, std::shared_ptr<Environment>);
 std::shared_ptr<Object>
     built_in_push(std::vector<std::shared_ptr<Object>>, std::shared_ptr<Environment>);
+std::shared_ptr<Object>
+    built_in_substr(std::vector<std::shared_ptr<Object>>, std::shared_ptr<Environment>);
+std::shared_ptr<Object>
+    built_in_split(std::vector<std::shared_ptr<Object>>, std::shared_ptr<Environment>);
+std::shared_ptr<Object>
+    built_in_find(std::vector<std::shared_ptr<Object>>, std::shared_ptr<Environment>);
+std::shared_ptr<Object>
+    built_in_sum(std::vector<std::shared_ptr<Object>>, std::shared_ptr<Environment>);
+std::shared_ptr<Object>
+    built_in_dot(std::vector<std::shared_ptr<Object>>, std::shared_ptr<Environment>);
+std::shared_ptr<Object>
+    built_in_argmin(std::vector<std::shared_ptr<Object>>, std::shared_ptr<Environment>);
+std::shared_ptr<Object>
+    built_in_argmax(std::vector<std::shared_ptr<Object>>, std::shared_ptr<Environment>);
+std::shared_ptr<Object>
+    built_in_sort(std::vector<std::shared_ptr<Object>>, std::shared_ptr<Environment>);
+std::shared_ptr<Object>
+    built_in_sorted(std::vector<std::shared_ptr<Object>>, std::shared_ptr<Environment>);
+std::shared_ptr<Object>
+    built_in_pmap(std::vector<std::shared_ptr<Object>>, std::shared_ptr<Environment>);
+std::shared_ptr<Object>
+    built_in_pfilter(std::vector<std::shared_ptr<Object>>, std::shared_ptr<Environment>);
+std::shared_ptr<Object>
+    built_in_preduce(std::vector<std::shared_ptr<Object>>, std::shared_ptr<Environment>);
+std::shared_ptr<Object>
+    built_in_join(std::vector<std::shared_ptr<Object>>, std::shared_ptr<Environment>);
+std::shared_ptr<Object>
+    built_in_sleep(std::vector<std::shared_ptr<Object>>, std::shared_ptr<Environment>);
+std::shared_ptr<Object>
+    built_in_chan(std::vector<std::shared_ptr<Object>>, std::shared_ptr<Environment>);
+std::shared_ptr<Object>
+    built_in_send(std::vector<std::shared_ptr<Object>>, std::shared_ptr<Environment>);
+std::shared_ptr<Object>
+    built_in_recv(std::vector<std::shared_ptr<Object>>, std::shared_ptr<Environment>);
+std::shared_ptr<Object>
+    built_in_select(std::vector<std::shared_ptr<Object>>, std::shared_ptr<Environment>);
+std::shared_ptr<Object>
+    built_in_readfile(std::vector<std::shared_ptr<Object>>, std::shared_ptr<Environment>);
+std::shared_ptr<Object>
+    built_in_writefile(std::vector<std::shared_ptr<Object>>, std::shared_ptr<Environment>);
+std::shared_ptr<Object>
+    built_in_open(std::vector<std::shared_ptr<Object>>, std::shared_ptr<Environment>);
+std::shared_ptr<Object>
+    built_in_read(std::vector<std::shared_ptr<Object>>, std::shared_ptr<Environment>);
+std::shared_ptr<Object>
+    built_in_lines(std::vector<std::shared_ptr<Object>>, std::shared_ptr<Environment>);
+std::shared_ptr<Object>
+    built_in_json_parse(std::vector<std::shared_ptr<Object>>, std::shared_ptr<Environment>);
+std::shared_ptr<Object>
+    built_in_json_stringify(std::vector<std::shared_ptr<Object>>, std::shared_ptr<Environment>);
+std::shared_ptr<Object>
+    built_in_json_lines(std::vector<std::shared_ptr<Object>>, std::shared_ptr<Environment>);
+std::shared_ptr<Object>
+    built_in_csv_read(std::vector<std::shared_ptr<Object>>, std::shared_ptr<Environment>);
+std::shared_ptr<Object>
+    built_in_csv_rows(std::vector<std::shared_ptr<Object>>, std::shared_ptr<Environment>);
+std::shared_ptr<Object>
+    built_in_match(std::vector<std::shared_ptr<Object>>, std::shared_ptr<Environment>);
+std::shared_ptr<Object>
+    built_in_search(std::vector<std::shared_ptr<Object>>, std::shared_ptr<Environment>);
+std::shared_ptr<Object>
+    built_in_findall(std::vector<std::shared_ptr<Object>>, std::shared_ptr<Environment>);
+std::shared_ptr<Object>
+    built_in_replace(std::vector<std::shared_ptr<Object>>, std::shared_ptr<Environment>);
+std::shared_ptr<Object>
+    built_in_import_native(std::vector<std::shared_ptr<Object>>, std::shared_ptr<Environment>);
 std::shared_ptr<Object> newError(std::string);
 
 typedef struct Builtin : Object {
@@ -34,13 +100,84 @@ enum BuiltinFunctions {
     builtin_min,
     builtin_pop,
     builtin_push,
+    builtin_substr,
+    builtin_split,
+    builtin_find,
+    builtin_sum,
+    builtin_dot,
+    builtin_argmin,
+    builtin_argmax,
+    builtin_sort,
+    builtin_sorted,
+    builtin_pmap,
+    builtin_pfilter,
+    builtin_preduce,
+    builtin_join,
+    builtin_sleep,
+    builtin_chan,
+    builtin_send,
+    builtin_recv,
+    builtin_select,
+    builtin_readfile,
+    builtin_writefile,
+    builtin_open,
+    builtin_read,
+    builtin_lines,
+    builtin_json_parse,
+    builtin_json_stringify,
+    builtin_json_lines,
+    builtin_csv_read,
+    builtin_csv_rows,
+    builtin_match,
+    builtin_search,
+    builtin_findall,
+    builtin_replace,
+    builtin_import_native,
+    // builtins registered by native modules are numbered from here; see native.hpp
+    builtin_native,
 };
 
 const std::unordered_map<std::string, int> builtins{
-    {"len",   builtin_len  },
-    {"print", builtin_print},
-    {"max",   builtin_max  },
-    {"min",   builtin_min  },
-    {"pop",   builtin_pop  },
-    {"push",  builtin_push }
+    {"len",            builtin_len           },
+    {"print",          builtin_print         },
+    {"max",            builtin_max           },
+    {"min",            builtin_min           },
+    {"pop",            builtin_pop           },
+    {"push",           builtin_push          },
+    {"substr",         builtin_substr        },
+    {"split",          builtin_split         },
+    {"find",           builtin_find          },
+    {"sum",            builtin_sum           },
+    {"dot",            builtin_dot           },
+    {"argmin",         builtin_argmin        },
+    {"argmax",         builtin_argmax        },
+    {"sort",           builtin_sort          },
+    {"sorted",         builtin_sorted        },
+    {"pmap",           builtin_pmap          },
+    {"pfilter",        builtin_pfilter       },
+    {"preduce",        builtin_preduce       },
+    {"join",           builtin_join          },
+    {"sleep",          builtin_sleep         },
+    {"chan",           builtin_chan          },
+    {"send",           builtin_send          },
+    {"recv",           builtin_recv          },
+    {"select",         builtin_select        },
+    {"readfile",       builtin_readfile      },
+    {"writefile",      builtin_writefile     },
+    {"open",           builtin_open          },
+    {"read",           builtin_read          },
+    {"lines",          builtin_lines         },
+    {"json_parse",     builtin_json_parse    },
+    {"json_stringify", builtin_json_stringify},
+    {"json_lines",     builtin_json_lines    },
+    {"csv_read",       builtin_csv_read      },
+    {"csv_rows",       builtin_csv_rows      },
+    {"match",          builtin_match         },
+    {"search",         builtin_search        },
+    {"findall",        builtin_findall       },
+    {"replace",        builtin_replace       },
+    {"import_native",  builtin_import_native },
 };
+
+// the builtin an interned name refers to, or -1
+int builtinSymbol(Symbol);
@@ -0,0 +1,188 @@
+#pragma once
+#include <atomic>
+#include <memory>
+#include <utility>
+
+using namespace std;
+
+// The queues behind channels. Neither ever blocks or takes a lock: a push
+// that finds no room and a pop that finds nothing both just return false, and
+// waiting is left to the caller (see WaitQueue).
+
+// Dmitry Vyukov's bounded multi-producer multi-consumer queue. Every cell
+// carries a sequence number that says whether it is free for the push at its
+// position or holds the value for the pop at that position, so producers and
+// consumers each claim a position with one compare-and-swap and never touch
+// the same cell at the same time. With `once` set the buffer is used for a
+// single pass: it takes `capacity` pushes in all and then stays full.
+template <class T>
+class RingBuffer {
+  public:
+    RingBuffer(size_t capacity, bool once = false) : cells(new Cell[capacity]), capacity(capacity), once(once) {
+        for (size_t i = 0; i < capacity; i++)
+            this->cells[i].sequence.store(i, memory_order_relaxed);
+    }
+
+    // moves value in when there is room, leaving it alone otherwise
+    bool push(T& value) {
+        size_t position = this->tail.load(memory_order_relaxed);
+        while (true) {
+            if (this->once && position >= this->capacity) return false;
+            Cell& cell    = this->cells[position % this->capacity];
+            size_t ready  = cell.sequence.load(memory_order_acquire);
+            ptrdiff_t lag = (ptrdiff_t)ready - (ptrdiff_t)position;
+            if (lag == 0) {
+                if (!this->tail.compare_exchange_weak(position, position + 1, memory_order_relaxed)) continue;
+                cell.value = move(value);
+                cell.sequence.store(position + 1, memory_order_release);
+                return true;
+            }
+            // the cell still holds the value pushed one pass earlier
+            if (lag < 0) return false;
+            position = this->tail.load(memory_order_relaxed);
+        }
+    }
+
+    bool pop(T& value) {
+        size_t position = this->head.load(memory_order_relaxed);
+        while (true) {
+            if (this->once && position >= this->capacity) return false;
+            Cell& cell    = this->cells[position % this->capacity];
+            size_t ready  = cell.sequence.load(memory_order_acquire);
+            ptrdiff_t lag = (ptrdiff_t)ready - (ptrdiff_t)(position + 1);
+            if (lag == 0) {
+                if (!this->head.compare_exchange_weak(position, position + 1, memory_order_relaxed)) continue;
+                value = move(cell.value);
+                cell.sequence.store(position + this->capacity, memory_order_release);
+                return true;
+            }
+            // nothing has been pushed here yet, or the push is still being written
+            if (lag < 0) return false;
+            position = this->head.load(memory_order_relaxed);
+        }
+    }
+
+    // whether a single-pass buffer has handed out every value it will ever take
+    bool exhausted() const { return this->once && this->head.load(memory_order_acquire) >= this->capacity; }
+
+  private:
+    struct Cell {
+        atomic<size_t> sequence{0};
+        T value{};
+    };
+
+    unique_ptr<Cell[]> cells;
+    size_t capacity;
+    bool once;
+    // on lines of their own, so producers and consumers do not share one
+    alignas(64) atomic<size_t> tail{0};
+    alignas(64) atomic<size_t> head{0};
+};
+
+// An unbounded queue made of single-pass RingBuffers, each twice as large as
+// the last up to a limit. Producers push into the newest segment and link a
+// new one once it is full; consumers pop from the oldest and move on once it
+// is exhausted. A segment both ends have moved past is retired, and freed
+// by the next operation that finds no other operation in progress, since
+// only operations that started before it was retired can still be using it.
+template <class T>
+class SegmentedQueue {
+  public:
+    SegmentedQueue() {
+        Segment* first = new Segment(FIRST_SEGMENT);
+        this->head.store(first);
+        this->tail.store(first);
+    }
+
+    ~SegmentedQueue() {
+        this->release(this->retired.exchange(nullptr));
+        for (Segment* segment = this->head.load(); segment != nullptr;) {
+            Segment* next = segment->next.load();
+            delete segment;
+            segment = next;
+        }
+    }
+
+    void push(T& value) {
+        this->users++;
+        while (true) {
+            Segment* segment = this->tail.load();
+            if (segment->ring.push(value)) break;
+            Segment* next = segment->next.load();
+            if (next == nullptr) {
+                Segment* fresh = new Segment(min(segment->size * 2, LAST_SEGMENT));
+                if (segment->next.compare_exchange_strong(next, fresh)) next = fresh;
+                else delete fresh;
+            }
+            this->tail.compare_exchange_strong(segment, next);
+        }
+        this->leave();
+    }
+
+    bool pop(T& value) {
+        this->users++;
+        bool popped = false;
+        while (true) {
+            Segment* segment = this->head.load();
+            if (segment->ring.pop(value)) {
+                popped = true;
+                break;
+            }
+            Segment* next = segment->next.load();
+            if (!segment->ring.exhausted() || next == nullptr) break;
+            // a producer may not have moved the tail on yet; it must be past the segment before it is retired
+            Segment* stale = segment;
+            this->tail.compare_exchange_strong(stale, next);
+            if (this->head.compare_exchange_strong(segment, next)) this->retire(segment);
+        }
+        this->leave();
+        return popped;
+    }
+
+  private:
+    static constexpr size_t FIRST_SEGMENT = 32;
+    static constexpr size_t LAST_SEGMENT  = 8192;
+
+    struct Segment {
+        Segment(size_t size) : ring(size, true), size(size) {}
+
+        RingBuffer<T> ring;
+        size_t size;
+        atomic<Segment*> next{nullptr};
+        Segment* retiredNext{nullptr};
+    };
+
+    atomic<Segment*> head{nullptr};
+    atomic<Segment*> tail{nullptr};
+    // operations in progress, and the segments waiting for there to be none
+    atomic<size_t> users{0};
+    atomic<Segment*> retired{nullptr};
+
+    void retire(Segment* segment) {
+        segment->retiredNext = this->retired.load();
+        while (!this->retired.compare_exchange_weak(segment->retiredNext, segment));
+    }
+
+    void leave() {
+        if (this->retired.load() != nullptr) {
+            // anything retired before the exchange is unreachable to operations that start after it
+            Segment* list = this->retired.exchange(nullptr);
+            if (this->users.load() == 1) this->release(list);
+            else
+                while (list != nullptr) {
+                    Segment* next = list->retiredNext;
+                    this->retire(list);
+                    list = next;
+                }
+        }
+        this->users--;
+    }
+
+    void release(Segment* list) {
+        while (list != nullptr) {
+            Segment* next = list->retiredNext;
+            delete list;
+            list = next;
+        }
+    }
+};
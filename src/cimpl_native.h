@@ -0,0 +1,121 @@
+#ifndef CIMPL_NATIVE_H
+#define CIMPL_NATIVE_H
+
+/*
+ * The C interface between cimpl and native extension modules.
+ *
+ * import_native("libfoo.so") opens the shared object and calls the function
+ * it exports as cimpl_native_init, passing the table of functions below. That
+ * function registers builtins with register_builtin and returns 0, or
+ * something else to make the import fail.
+ *
+ * Values are opaque handles. Those passed to a builtin, and those it creates
+ * with the make_ and array_get/hash_get functions, live until the builtin
+ * returns; a builtin keeps nothing between calls. Strings are read in place and
+ * are not NUL-terminated.
+ *
+ * The table only ever grows at the end, and version goes up when it does, so
+ * a module built against an older header works with a newer interpreter. A
+ * module that needs newer functions checks api->version first.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CIMPL_NATIVE_VERSION 1
+
+typedef struct cimpl_value cimpl_value;
+/* the call a builtin is running in, which owns the values it creates */
+typedef struct cimpl_call cimpl_call;
+/* the library being imported, while its init function runs */
+typedef struct cimpl_module cimpl_module;
+
+typedef enum cimpl_type {
+    CIMPL_OTHER,
+    CIMPL_NULL,
+    CIMPL_BOOL,
+    CIMPL_INT,
+    CIMPL_FLOAT,
+    CIMPL_STRING,
+    CIMPL_ARRAY,
+    CIMPL_HASH,
+} cimpl_type;
+
+/* A pure builtin has no side effects and keeps no state, so parallel builtins
+ * and pfor may call it from several threads at once. Calls to any other
+ * builtin are made one at a time. */
+#define CIMPL_PURE 1u
+
+/* Returns the result, which may be one of args; NULL returns null. */
+typedef cimpl_value* (*cimpl_native_fn)(cimpl_call* call, cimpl_value* const* args, size_t count);
+
+typedef struct cimpl_api {
+    uint32_t version;
+    /* sizeof(cimpl_api) in the interpreter */
+    uint32_t size;
+
+    /* Registers name as a builtin taking arity arguments, or any number when
+     * arity is -1. signature has a letter per argument that is checked before
+     * the call: i integer, f float, n integer or float, b boolean, s string,
+     * a array, h hash, . anything; it may be NULL or shorter than the
+     * arguments, which are then not checked. flags is 0 or CIMPL_PURE.
+     * Returns 0, or -1 when the name is taken or the arguments are bad. */
+    int (*register_builtin)(
+        cimpl_module* module, const char* name, cimpl_native_fn fn, int arity, const char* signature, unsigned flags
+    );
+
+    cimpl_type (*type_of)(const cimpl_value* value);
+    /* a builtin's result, which the script sees as an error with this message */
+    cimpl_value* (*make_error)(cimpl_call* call, const char* message);
+
+    cimpl_value* (*make_null)(cimpl_call* call);
+    cimpl_value* (*make_bool)(cimpl_call* call, int value);
+    /* integers are 32 bits wide in the interpreter, and are truncated to fit */
+    cimpl_value* (*make_int)(cimpl_call* call, int64_t value);
+    cimpl_value* (*make_float)(cimpl_call* call, double value);
+    /* copies length bytes from data */
+    cimpl_value* (*make_string)(cimpl_call* call, const char* data, size_t length);
+
+    /* These read a value of their own type, and give 0 or NULL for others;
+     * get_float also reads integers. */
+    int (*get_bool)(const cimpl_value* value);
+    int64_t (*get_int)(const cimpl_value* value);
+    double (*get_float)(const cimpl_value* value);
+    const char* (*get_string)(const cimpl_value* value, size_t* length);
+
+    cimpl_value* (*make_array)(cimpl_call* call, cimpl_value* const* elements, size_t count);
+    /* packed arrays, copied from data */
+    cimpl_value* (*make_int_array)(cimpl_call* call, const int32_t* data, size_t count);
+    cimpl_value* (*make_float_array)(cimpl_call* call, const double* data, size_t count);
+    size_t (*array_length)(const cimpl_value* array);
+    /* NULL when index is out of range */
+    cimpl_value* (*array_get)(cimpl_call* call, const cimpl_value* array, size_t index);
+    /* All the elements of an array of integers (or, for array_floats, of
+     * numbers) in one run, read in place when the array is packed and copied
+     * otherwise; NULL when it holds anything else. */
+    const int32_t* (*array_ints)(cimpl_call* call, const cimpl_value* array);
+    const double* (*array_floats)(cimpl_call* call, const cimpl_value* array);
+
+    cimpl_value* (*make_hash)(cimpl_call* call);
+    /* Keys are integers, booleans or strings. Returns 0, or -1 for any other
+     * key or when hash is not a hash. Only hashes made in this call may be set. */
+    int (*hash_set)(cimpl_call* call, cimpl_value* hash, const cimpl_value* key, const cimpl_value* value);
+    /* NULL when the key is not in the hash */
+    cimpl_value* (*hash_get)(cimpl_call* call, const cimpl_value* hash, const cimpl_value* key);
+    size_t (*hash_size)(const cimpl_value* hash);
+    /* the keys of a hash as an array, in no particular order */
+    cimpl_value* (*hash_keys)(cimpl_call* call, const cimpl_value* hash);
+} cimpl_api;
+
+/* what a module exports as cimpl_native_init */
+typedef int (*cimpl_native_init_fn)(const cimpl_api* api, cimpl_module* module);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,373 @@
+#include "closure.hpp"
+
+#include "builtins.hpp"
+#include "evaluator.hpp"
+
+using namespace std;
+
+Closure compileBlockStatement(shared_ptr<BlockStatement> block) {
+    vector<Closure> statements{};
+    for (auto stmt : block->statements)
+        statements.push_back(compileNode(stmt));
+
+    return [statements](const shared_ptr<Environment>& env) -> shared_ptr<Object> {
+        for (auto& stmt : statements) {
+            shared_ptr<Object> result = stmt(env);
+            if (result != nullptr && result->type == RETURN_OBJ) return result;
+        }
+        return nullptr;
+    };
+}
+
+Closure compileExpression(shared_ptr<Expression> expr) {
+    if (expr->unboxed)
+        return [expr](const shared_ptr<Environment>& env) { return evalUnboxedExpression(expr, env); };
+    switch (expr->type) {
+        case arrayLiteral: {
+            shared_ptr<ArrayLiteral> a = static_pointer_cast<ArrayLiteral>(expr);
+            vector<Closure> elements   = compileExpressionList(a->elements);
+            return [elements](const shared_ptr<Environment>& env) -> shared_ptr<Object> {
+                vector<shared_ptr<Object>> values = evalClosureList(elements, env);
+                if (values.size() == 1 && isError(values[0])) return values[0];
+                shared_ptr<Array> newa(new Array(values));
+                env->gc.push_back(newa);
+                return newa;
+            };
+        }
+        case booleanExpression: {
+            shared_ptr<Object> b = nativeToBoolean(static_pointer_cast<BooleanLiteral>(expr)->value);
+            return [b](const shared_ptr<Environment>& env) { return b; };
+        }
+        case callExpression:
+        case builtinCallExpression:
+        case functionCallExpression: {
+            shared_ptr<CallExpression> ce = static_pointer_cast<CallExpression>(expr);
+            vector<Closure> arguments     = compileExpressionList(ce->arguments);
+            if (ce->_function->type == identifier) {
+                // builtins take precedence over every binding, so resolve them now
+                auto builtin_find =
+                    builtins.find(static_pointer_cast<IdentifierLiteral>(ce->_function)->value);
+                if (builtin_find != builtins.end()) {
+                    shared_ptr<Builtin> bi(new Builtin());
+                    bi->builtin_type = builtin_find->second;
+                    return [bi, arguments](const shared_ptr<Environment>& env) -> shared_ptr<Object> {
+                        vector<shared_ptr<Object>> args = evalClosureList(arguments, env);
+                        if (args.size() == 1 && isError(args[0])) return args[0];
+                        return evalBuiltinFunction(bi, args, env);
+                    };
+                }
+            }
+            Closure callee = compileExpression(ce->_function);
+            return [callee, arguments](const shared_ptr<Environment>& env) -> shared_ptr<Object> {
+                shared_ptr<Object> func = callee(env);
+                if (isError(func)) return func;
+                vector<shared_ptr<Object>> args = evalClosureList(arguments, env);
+                if (args.size() == 1 && isError(args[0])) return args[0];
+                return applyFunction(func, args, env);
+            };
+        }
+        case doExpression: {
+            shared_ptr<DoExpression> de  = static_pointer_cast<DoExpression>(expr);
+            shared_ptr<Closure> body     = make_shared<Closure>(compileBlockStatement(de->body));
+            shared_ptr<Closure> condition = make_shared<Closure>(compileNode(de->condition));
+            return [de, body, condition](const shared_ptr<Environment>& env) {
+                shared_ptr<Loop> loop(new Loop(doLoop, de->body, env));
+                env->gc.push_back(loop);
+                loop->condition         = de->condition;
+                loop->compiledBody      = body;
+                loop->compiledCondition = condition;
+                return evalLoop(loop);
+            };
+        }
+        case floatLiteral: {
+            shared_ptr<Object> f(new Float(static_pointer_cast<FloatLiteral>(expr)->value));
+            return [f](const shared_ptr<Environment>& env) { return f; };
+        }
+        case forExpression: {
+            shared_ptr<ForExpression> fe = static_pointer_cast<ForExpression>(expr);
+            shared_ptr<Closure> body     = make_shared<Closure>(compileBlockStatement(fe->body));
+            if (fe->iterable != nullptr) {
+                Closure iterable         = compileNode(fe->iterable);
+                vector<Symbol> variables = loopVariables(fe);
+                return [iterable, variables, body](const shared_ptr<Environment>& env) -> shared_ptr<Object> {
+                    return evalForEach(iterable(env), variables, [&]() { return (*body)(env); }, env);
+                };
+            }
+            return [fe, body](const shared_ptr<Environment>& env) -> shared_ptr<Object> {
+                shared_ptr<Loop> loop(new Loop(forLoop, fe->body, env));
+                env->gc.push_back(loop);
+                shared_ptr<Object> range = evalForRange(fe, loop);
+                if (isError(range)) return range;
+                loop->statements   = fe->statements;
+                loop->compiledBody = body;
+                if (fe->parallel) return evalParallelLoop(fe, loop);
+                return evalLoop(loop);
+            };
+        }
+        case functionLiteral: {
+            shared_ptr<FunctionLiteral> fl = static_pointer_cast<FunctionLiteral>(expr);
+            shared_ptr<Closure> body       = make_shared<Closure>(compileBlockStatement(fl->body));
+            return [fl, body](const shared_ptr<Environment>& env) -> shared_ptr<Object> {
+                shared_ptr<Function> newf(new Function(fl->parameters, fl->body, env));
+                newf->name         = fl->name->value;
+                newf->compiledBody = body;
+                if (fl->async) newf->function_type = asyncFunction;
+                env->gc.push_back(newf);
+                env->set(fl->name->symbol, newf);
+                return nullptr;
+            };
+        }
+        case identifier: {
+            Symbol name = static_pointer_cast<IdentifierLiteral>(expr)->symbol;
+            int builtin = builtinSymbol(name);
+            if (builtin != -1) {
+                shared_ptr<Builtin> bi(new Builtin());
+                bi->builtin_type = builtin;
+                return [bi](const shared_ptr<Environment>& env) { return bi; };
+            }
+            return [name](const shared_ptr<Environment>& env) -> shared_ptr<Object> {
+                shared_ptr<Object> val = env->get(name);
+                if (val != nullptr) return val;
+                return newError("identifier not found: " + *name);
+            };
+        }
+        case ifExpression: {
+            shared_ptr<IfExpression> ie = static_pointer_cast<IfExpression>(expr);
+            Closure condition           = compileNode(ie->condition);
+            Closure consequence         = compileBlockStatement(ie->consequence);
+            vector<Closure> conditions  = compileExpressionList(ie->conditions);
+            vector<Closure> alternatives{};
+            for (auto alt : ie->alternatives)
+                alternatives.push_back(compileBlockStatement(alt));
+            Closure alternative = nullptr;
+            if (ie->alternative != nullptr) alternative = compileBlockStatement(ie->alternative);
+
+            return [condition, consequence, conditions, alternatives,
+                    alternative](const shared_ptr<Environment>& env) -> shared_ptr<Object> {
+                shared_ptr<Object> initCondition = condition(env);
+                if (isError(initCondition)) return initCondition;
+                if (isTruthy(initCondition)) return consequence(env);
+                for (int i = 0; i < conditions.size(); i++) {
+                    shared_ptr<Object> cond = conditions[i](env);
+                    if (isError(cond)) return cond;
+                    if (isTruthy(cond)) return alternatives[i](env);
+                }
+                if (alternative != nullptr) return alternative(env);
+                return nullptr;
+            };
+        }
+        case indexExpression: {
+            shared_ptr<IndexExpression> ie = static_pointer_cast<IndexExpression>(expr);
+            Closure left                   = compileNode(ie->_left);
+            Closure index                  = compileNode(ie->index);
+            return [left, index](const shared_ptr<Environment>& env) -> shared_ptr<Object> {
+                shared_ptr<Object> l = left(env);
+                if (isError(l)) return l;
+                shared_ptr<Object> i = index(env);
+                if (isError(i)) return i;
+                return evalIndexExpression(l, i, env);
+            };
+        }
+        case sliceExpression: {
+            shared_ptr<SliceExpression> se = static_pointer_cast<SliceExpression>(expr);
+            Closure left                   = compileNode(se->_left);
+            // a bound that is left out stays nullptr
+            Closure start = se->start == nullptr ? nullptr : compileNode(se->start);
+            Closure end   = se->end == nullptr ? nullptr : compileNode(se->end);
+            Closure step  = se->step == nullptr ? nullptr : compileNode(se->step);
+            return [left, start, end, step](const shared_ptr<Environment>& env) -> shared_ptr<Object> {
+                shared_ptr<Object> l = left(env);
+                if (isError(l)) return l;
+                shared_ptr<Object> s = start == nullptr ? nullptr : start(env);
+                if (isError(s)) return s;
+                shared_ptr<Object> e = end == nullptr ? nullptr : end(env);
+                if (isError(e)) return e;
+                shared_ptr<Object> by = step == nullptr ? nullptr : step(env);
+                if (isError(by)) return by;
+                return evalSliceExpression(l, s, e, by, env);
+            };
+        }
+        case awaitExpression: {
+            Closure value = compileExpression(static_pointer_cast<AwaitExpression>(expr)->value);
+            return [value](const shared_ptr<Environment>& env) -> shared_ptr<Object> {
+                shared_ptr<Object> v = value(env);
+                if (isError(v)) return v;
+                return evalAwait(v, env);
+            };
+        }
+        case spawnExpression: {
+            shared_ptr<CallExpression> ce = static_pointer_cast<SpawnExpression>(expr)->call;
+            Closure callee                = compileExpression(ce->_function);
+            vector<Closure> arguments     = compileExpressionList(ce->arguments);
+            return [callee, arguments](const shared_ptr<Environment>& env) -> shared_ptr<Object> {
+                shared_ptr<Object> func = callee(env);
+                if (isError(func)) return func;
+                vector<shared_ptr<Object>> args = evalClosureList(arguments, env);
+                if (args.size() == 1 && isError(args[0])) return args[0];
+                shared_ptr<Object> task = spawnTask(func, args);
+                env->gc.push_back(task);
+                return task;
+            };
+        }
+        case infixExpression:
+        case intAddExpression:
+        case intSubExpression:
+        case intMulExpression:
+        case intDivExpression:
+        case intLessExpression:
+        case intGreaterExpression:
+        case intEqualExpression:
+        case intNotEqualExpression:
+        case floatAddExpression:
+        case floatSubExpression:
+        case floatMulExpression:
+        case floatDivExpression:
+        case floatLessExpression:
+        case floatGreaterExpression:
+        case floatEqualExpression:
+        case floatNotEqualExpression: {
+            shared_ptr<InfixExpression> ie = static_pointer_cast<InfixExpression>(expr);
+            Closure left                   = compileNode(ie->_left);
+            Closure right                  = compileNode(ie->_right);
+            string op                      = ie->_operator;
+            // the integer and float operations are selected once, here, instead of on every visit
+            auto node     = intInfixNodes.find(op);
+            int kind      = node == intInfixNodes.end() ? infixExpression : node->second;
+            auto fnode    = floatInfixNodes.find(op);
+            int floatKind = fnode == floatInfixNodes.end() ? infixExpression : fnode->second;
+            return [left, right, op, kind, floatKind](const shared_ptr<Environment>& env) -> shared_ptr<Object> {
+                shared_ptr<Object> l = left(env);
+                if (isError(l)) return l;
+                shared_ptr<Object> r = right(env);
+                if (isError(r)) return r;
+                if (kind != infixExpression && l->type == INTEGER_OBJ && r->type == INTEGER_OBJ)
+                    return evalIntInfixNode(kind, l, r, env);
+                if (floatKind != infixExpression && isNumeric(l) && isNumeric(r))
+                    return evalFloatInfixNode(floatKind, l, r, env);
+                return evalInfixExpression(op, l, r, env);
+            };
+        }
+        case integerLiteral: {
+            shared_ptr<Object> i(new Integer(static_pointer_cast<IntegerLiteral>(expr)->value));
+            return [i](const shared_ptr<Environment>& env) { return i; };
+        }
+        case postfixExpression: {
+            shared_ptr<PostfixExpression> p = static_pointer_cast<PostfixExpression>(expr);
+            if (p->_left->type != identifier) break;
+            Closure left = compileNode(p->_left);
+            Symbol name  = static_pointer_cast<IdentifierLiteral>(p->_left)->symbol;
+            string op    = p->_operator;
+            string lit   = p->_left->literal;
+            return [left, name, op, lit](const shared_ptr<Environment>& env) -> shared_ptr<Object> {
+                shared_ptr<Object> l = left(env);
+                if (isError(l)) return l;
+                if (l->type != INTEGER_OBJ) return newError(lit + " is not an integer.");
+                shared_ptr<Object> np = evalPostfixExpression(op, env->get(name), env);
+                env->set(name, np);
+                return np;
+            };
+        }
+        case prefixExpression: {
+            shared_ptr<PrefixExpression> p = static_pointer_cast<PrefixExpression>(expr);
+            Closure right                  = compileNode(p->_right);
+            string op                      = p->_operator;
+            return [right, op](const shared_ptr<Environment>& env) -> shared_ptr<Object> {
+                shared_ptr<Object> r = right(env);
+                if (isError(r)) return r;
+                return evalPrefixExpression(op, r, env);
+            };
+        }
+        case stringLiteral: {
+            shared_ptr<StringLiteral> sl = static_pointer_cast<StringLiteral>(expr);
+            shared_ptr<Object> s =
+                sl->symbol != nullptr ? stringConstant(sl->symbol) : shared_ptr<Object>(new String(sl->value));
+            return [s](const shared_ptr<Environment>& env) { return s; };
+        }
+        case whileExpression: {
+            shared_ptr<WhileExpression> we = static_pointer_cast<WhileExpression>(expr);
+            shared_ptr<Closure> body       = make_shared<Closure>(compileBlockStatement(we->body));
+            shared_ptr<Closure> condition  = make_shared<Closure>(compileNode(we->condition));
+            return [we, body, condition](const shared_ptr<Environment>& env) {
+                shared_ptr<Loop> loop(new Loop(whileLoop, we->body, env));
+                env->gc.push_back(loop);
+                loop->condition         = we->condition;
+                loop->compiledBody      = body;
+                loop->compiledCondition = condition;
+                return evalLoop(loop);
+            };
+        }
+        default: break;
+    }
+    // anything without a dedicated closure is handed to the tree-walker
+    return [expr](const shared_ptr<Environment>& env) { return evalNode(expr, env); };
+}
+
+vector<Closure> compileExpressionList(vector<shared_ptr<Expression>> exprs) {
+    vector<Closure> result{};
+    for (auto e : exprs)
+        result.push_back(compileNode(e));
+    return result;
+}
+
+Closure compileNode(shared_ptr<Node> node) {
+    if (node == nullptr) return [](const shared_ptr<Environment>& env) { return nullptr; };
+    if (node->nodetype == statement) return compileStatement(static_pointer_cast<Statement>(node));
+    return compileExpression(static_pointer_cast<Expression>(node));
+}
+
+Closure compileStatement(shared_ptr<Statement> stmt) {
+    switch (stmt->type) {
+        case blockStatement: return compileBlockStatement(static_pointer_cast<BlockStatement>(stmt));
+        case expressionStatement:
+            return compileNode(static_pointer_cast<ExpressionStatement>(stmt)->expression);
+        case functionStatement: {
+            shared_ptr<FunctionStatement> fs = static_pointer_cast<FunctionStatement>(stmt);
+            shared_ptr<Closure> body = make_shared<Closure>(compileBlockStatement(fs->body));
+            return [fs, body](const shared_ptr<Environment>& env) -> shared_ptr<Object> {
+                shared_ptr<Function> newf(new Function(fs->parameters, fs->body, env));
+                newf->name         = fs->name->value;
+                newf->compiledBody = body;
+                env->set(fs->name->symbol, newf);
+                return newf;
+            };
+        }
+        case letStatement: {
+            shared_ptr<LetStatement> ls = static_pointer_cast<LetStatement>(stmt);
+            Closure value               = compileNode(ls->value);
+            Symbol name                 = ls->name->symbol;
+            return [value, name](const shared_ptr<Environment>& env) -> shared_ptr<Object> {
+                shared_ptr<Object> val = value(env);
+                if (isError(val)) return val;
+                env->set(name, val);
+                return nullptr;
+            };
+        }
+        case returnStatement: {
+            Closure value = compileNode(static_pointer_cast<ReturnStatement>(stmt)->returnValue);
+            return [value](const shared_ptr<Environment>& env) -> shared_ptr<Object> {
+                shared_ptr<Object> val = value(env);
+                if (isError(val)) return val;
+                shared_ptr<ReturnValue> newr(new ReturnValue(val));
+                env->gc.push_back(newr);
+                return newr;
+            };
+        }
+        default: break;
+    }
+    return [stmt](const shared_ptr<Environment>& env) { return evalNode(stmt, env); };
+}
+
+vector<shared_ptr<Object>>
+evalClosureList(const vector<Closure>& closures, const shared_ptr<Environment>& env) {
+    vector<shared_ptr<Object>> result{};
+
+    for (auto& closure : closures) {
+        shared_ptr<Object> evaluated = closure(env);
+        if (isError(evaluated)) {
+            result.push_back(evaluated);
+            return result;
+        }
+        result.push_back(evaluated);
+    }
+    return result;
+}
@@ -0,0 +1,15 @@
+#pragma once
+#include "object.hpp"
+
+// Closure compilation backend: every AST node is compiled once into a
+// Closure that directly calls the closures of its children, so evaluation
+// no longer dispatches on node/expression types or casts nodes on each visit.
+// Objects, environments and the evaluator's helper functions are shared with
+// the tree-walking evaluator, so both backends produce the same results.
+
+Closure compileBlockStatement(shared_ptr<BlockStatement>);
+Closure compileExpression(shared_ptr<Expression>);
+vector<Closure> compileExpressionList(vector<shared_ptr<Expression>>);
+Closure compileNode(shared_ptr<Node>);
+Closure compileStatement(shared_ptr<Statement>);
+vector<shared_ptr<Object>> evalClosureList(const vector<Closure>&, const shared_ptr<Environment>&);
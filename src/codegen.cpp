@@ -0,0 +1,1118 @@
+#include "codegen.hpp"
+
+#include "builtins.hpp"
+#include "evaluator.hpp"
+#include "inference.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <unistd.h>
+
+// paths recorded by CMake when the runtime library is built
+#ifndef CIMPL_CXX_COMPILER
+#define CIMPL_CXX_COMPILER "c++"
+#endif
+#ifndef CIMPL_INCLUDE_DIR
+#define CIMPL_INCLUDE_DIR "src"
+#endif
+#ifndef CIMPL_RUNTIME_LIBRARY
+#define CIMPL_RUNTIME_LIBRARY "libcimplrt.a"
+#endif
+#ifndef CIMPL_LINK_LIBRARIES
+#define CIMPL_LINK_LIBRARIES "-lncurses"
+#endif
+
+using namespace std;
+
+static string quote(const string& s) {
+    string result = "\"";
+    for (unsigned char c : s) {
+        if (c == '"' || c == '\\') result += string{'\\', (char)c};
+        else if (c == '\n') result += "\\n";
+        else if (c == '\t') result += "\\t";
+        else if (c < 0x20 || c >= 0x7f) {
+            char escaped[5];
+            snprintf(escaped, sizeof escaped, "\\%03o", c);
+            result += escaped;
+        } else result += c;
+    }
+    return result + "\"";
+}
+
+static string join(const vector<string>& parts) {
+    string result{};
+    for (int i = 0; i < parts.size(); i++)
+        result += (i == 0 ? "" : ", ") + parts[i];
+    return result;
+}
+
+static string floatCode(double value) {
+    ostringstream ss;
+    ss << hexfloat << value;
+    return ss.str();
+}
+
+static string nativeName(string name) { return "v_" + name; }
+
+static string nativeDeclaration(int type) {
+    switch (type) {
+        case nativeInt:   return "int";
+        case nativeFloat: return "double";
+        case nativeBool:  return "bool";
+        default:          return "string";
+    }
+}
+
+static int nativeDatatype(int datatype) {
+    switch (datatype) {
+        case INT:     return nativeInt;
+        case FLOAT:   return nativeFloat;
+        case BOOLEAN: return nativeBool;
+        case STRING:  return nativeString;
+        default:      return nativeBoxed;
+    }
+}
+
+static string datatypeName(int datatype) {
+    switch (datatype) {
+        case INT:     return "INT";
+        case FLOAT:   return "FLOAT";
+        case BOOLEAN: return "BOOLEAN";
+        case STRING:  return "STRING";
+        default:      return "VOID";
+    }
+}
+
+static string unbox(string code, int type) {
+    switch (type) {
+        case nativeInt:   return "static_pointer_cast<Integer>(" + code + ")->value";
+        case nativeFloat: return "numericValue(" + code + ")";
+        case nativeBool:  return "(" + code + "->type == BOOLEAN_TRUE)";
+        default:          return "string(static_pointer_cast<String>(" + code + ")->value())";
+    }
+}
+
+CodeGenerator::CodeGenerator(vector<shared_ptr<Statement>> program) { this->program = program; }
+
+string CodeGenerator::generate() {
+    ostringstream mainCode{};
+    this->out = &mainCode;
+    this->collectNatives(this->program, {});
+
+    this->emit("int main() {");
+    this->indent++;
+    this->emit("shared_ptr<Environment> env(new Environment);");
+    this->emit("setErrorGarbageCollector(&env);");
+    this->emitLocals();
+    // like repl_file, a top-level statement's error is printed and the program goes on
+    for (auto stmt : this->program) {
+        this->emit("printResult([&]() -> shared_ptr<Object> {");
+        this->indent++;
+        this->genStatement(stmt);
+        this->indent--;
+        this->emit("}());");
+    }
+    this->emit("waitForTasks();");
+    this->emit("return 0;");
+    this->indent--;
+    this->emit("}");
+
+    ostringstream result{};
+    result << "// generated by `cimpl build`\n";
+    result << "#include \"builtins.hpp\"\n#include \"codegen.hpp\"\n";
+    result << "#include \"evaluator.hpp\"\n#include \"repl.hpp\"\n\n";
+    result << "using namespace std;\n\n";
+    result << this->declarations.str() << '\n' << this->functions.str() << mainCode.str();
+    return result.str();
+}
+
+string CodeGenerator::box(string code, int type) {
+    switch (type) {
+        case nativeInt:    return "shared_ptr<Object>(new Integer(" + code + "))";
+        case nativeFloat:  return "shared_ptr<Object>(new Float(" + code + "))";
+        case nativeBool:   return "static_pointer_cast<Object>(nativeToBoolean(" + code + "))";
+        case nativeString: return "shared_ptr<Object>(new String(" + code + "))";
+        default:           return code;
+    }
+}
+
+string CodeGenerator::builtinConstant(string name) {
+    auto found = this->builtinConstants.find(name);
+    if (found != this->builtinConstants.end()) return found->second;
+    string constant = "b_" + name;
+    this->declarations << "static const shared_ptr<Object> " << constant << " = newBuiltin("
+                       << builtins.at(name) << ");\n";
+    this->builtinConstants[name] = constant;
+    return constant;
+}
+
+void CodeGenerator::collectNatives(
+    const vector<shared_ptr<Statement>>& statements, const vector<shared_ptr<IdentifierLiteral>>& params
+) {
+    // Typed declarations and for-loop variables that are statements of the
+    // frame itself are candidates. Frame statement i sits at position 2i, the
+    // body and variables of a for-loop at 2i + 1; a candidate stays native only
+    // if every other use comes after its declaration and agrees with its type.
+    this->natives.clear();
+    for (int i = 0; i < statements.size(); i++) {
+        shared_ptr<Statement> stmt = statements[i];
+        if (stmt->type == identifierStatement) {
+            shared_ptr<IdentifierStatement> is = static_pointer_cast<IdentifierStatement>(stmt);
+            // a native local cannot be left unbound by a declaration that fails
+            bool certain = infallible(is->value) && assignable(is->datatype, is->value->datatype);
+            this->declareNative(is->name->value, certain ? nativeDatatype(is->datatype) : nativeBoxed, 2 * i);
+        } else if (stmt->type == expressionStatement) {
+            shared_ptr<Expression> expr = static_pointer_cast<ExpressionStatement>(stmt)->expression;
+            if (expr == nullptr || expr->type != forExpression) continue;
+            // pfor counters live in each chunk's environment
+            shared_ptr<ForExpression> fe = static_pointer_cast<ForExpression>(expr);
+            if (fe->parallel) continue;
+            // elements and lines are bound boxed
+            int type = fe->iterable == nullptr ? nativeInt : nativeBoxed;
+            for (auto var : fe->statements)
+                this->declareNative(static_pointer_cast<LetStatement>(var)->name->value, type, 2 * i);
+        }
+    }
+    for (auto param : params)
+        this->useNative(param->value, 0, false, nativeRebind);
+    // builtins shadow every binding of the same name
+    for (auto& native : this->natives)
+        if (builtins.find(native.first) != builtins.end()) native.second.eligible = false;
+
+    for (int i = 0; i < statements.size(); i++) {
+        if (statements[i]->type == identifierStatement) {
+            this->scanNode(static_pointer_cast<IdentifierStatement>(statements[i])->value, 2 * i, false);
+            continue;
+        }
+        this->scanNode(statements[i], 2 * i, false);
+    }
+}
+
+string CodeGenerator::constant(string initializer) {
+    string constant = "k" + to_string(this->constantCount++);
+    this->declarations << "static const shared_ptr<Object> " << constant << "(" << initializer << ");\n";
+    return constant;
+}
+
+void CodeGenerator::declareNative(string name, int type, int at) {
+    auto found = this->natives.find(name);
+    if (found == this->natives.end()) {
+        this->natives[name] = NativeLocal{type, at, type != nativeBoxed};
+        return;
+    }
+    if (found->second.type != type) found->second.eligible = false;
+}
+
+void CodeGenerator::emit(string line) { *this->out << string(this->indent * 4, ' ') << line << '\n'; }
+
+void CodeGenerator::emitLocals() {
+    vector<string> names{};
+    for (auto& native : this->natives)
+        if (native.second.eligible) names.push_back(native.first);
+    sort(names.begin(), names.end());
+    for (auto name : names)
+        this->emit(nativeDeclaration(this->natives[name].type) + " " + nativeName(name) + "{};");
+}
+
+void CodeGenerator::emitStatements(const vector<shared_ptr<Statement>>& statements) {
+    // each statement keeps its own error; only a return value leaves the block
+    for (auto stmt : statements) {
+        this->emit("if (shared_ptr<Object> r = [&]() -> shared_ptr<Object> {");
+        this->indent++;
+        this->genStatement(stmt);
+        this->indent--;
+        this->emit("}(); r != nullptr && r->type == RETURN_OBJ)");
+        this->emit("    return r;");
+    }
+}
+
+string CodeGenerator::genBoxed(shared_ptr<Expression> expr) {
+    if (expr != nullptr && expr->type == integerLiteral)
+        return this->constant("new Integer(" + to_string(static_pointer_cast<IntegerLiteral>(expr)->value) + ")");
+    if (expr != nullptr && expr->type == floatLiteral)
+        return this->constant("new Float(" + floatCode(static_pointer_cast<FloatLiteral>(expr)->value) + ")");
+    if (expr != nullptr && expr->type == stringLiteral)
+        return this->constant("new String(" + quote(static_pointer_cast<StringLiteral>(expr)->value) + ")");
+
+    int type;
+    string code = this->genExpression(expr, type);
+    if (type == nativeBoxed) return code;
+    string t = this->temporary();
+    this->emit("shared_ptr<Object> " + t + " = " + this->box(code, type) + ";");
+    return t;
+}
+
+string CodeGenerator::genCall(shared_ptr<CallExpression> ce) {
+    string callee{};
+    bool builtin = false;
+    if (ce->_function->type == identifier) {
+        string name = static_pointer_cast<IdentifierLiteral>(ce->_function)->value;
+        builtin     = builtins.find(name) != builtins.end();
+        if (builtin) callee = this->builtinConstant(name);
+    }
+    if (!builtin) callee = this->genBoxed(ce->_function);
+
+    vector<string> args{};
+    for (auto arg : ce->arguments)
+        args.push_back(this->genBoxed(arg));
+
+    string t = this->temporary();
+    if (builtin)
+        this->emit("shared_ptr<Object> " + t + " = evalBuiltinFunction(" + callee + ", {" + join(args) + "}, env);");
+    else this->emit("shared_ptr<Object> " + t + " = applyFunction(" + callee + ", {" + join(args) + "}, env);");
+    this->emit("if (isError(" + t + ")) return " + t + ";");
+    return t;
+}
+
+string CodeGenerator::genExpression(shared_ptr<Expression> expr, int& type) {
+    type = nativeBoxed;
+    if (expr == nullptr) return "shared_ptr<Object>(nullptr)";
+
+    switch (expr->type) {
+        case arrayLiteral: {
+            vector<string> elements{};
+            for (auto element : static_pointer_cast<ArrayLiteral>(expr)->elements)
+                elements.push_back(this->genBoxed(element));
+            string t = this->temporary();
+            this->emit(
+                "shared_ptr<Object> " + t + "(new Array(vector<shared_ptr<Object>>{" + join(elements) + "}));"
+            );
+            return t;
+        }
+        case awaitExpression: {
+            string value = this->genBoxed(static_pointer_cast<AwaitExpression>(expr)->value);
+            string t     = this->temporary();
+            this->emit("shared_ptr<Object> " + t + " = evalAwait(" + value + ", env);");
+            this->emit("if (isError(" + t + ")) return " + t + ";");
+            return t;
+        }
+        case booleanExpression:
+            type = nativeBool;
+            return static_pointer_cast<BooleanLiteral>(expr)->value ? "true" : "false";
+        case callExpression:
+        case builtinCallExpression:
+        case functionCallExpression: return this->genCall(static_pointer_cast<CallExpression>(expr));
+        case doExpression: {
+            shared_ptr<DoExpression> de = static_pointer_cast<DoExpression>(expr);
+            return this->genLoop(de->body, de->condition, true);
+        }
+        case floatLiteral:
+            type = nativeFloat;
+            return floatCode(static_pointer_cast<FloatLiteral>(expr)->value);
+        case forExpression: return this->genFor(static_pointer_cast<ForExpression>(expr));
+        case functionLiteral: {
+            shared_ptr<FunctionLiteral> fl = static_pointer_cast<FunctionLiteral>(expr);
+            string name                    = fl->name == nullptr ? "" : fl->name->value;
+            string body                    = this->genFunction(name, fl->parameters, fl->body);
+            vector<string> params{};
+            for (auto param : fl->parameters)
+                params.push_back(quote(param->value));
+            string t = this->temporary();
+            this->emit(
+                "shared_ptr<Object> " + t + " = newCompiledFunction(" + quote(name) + ", {" + join(params) +
+                "}, " + body + ", env);"
+            );
+            if (fl->async) this->emit("static_pointer_cast<Function>(" + t + ")->function_type = asyncFunction;");
+            this->emit("env->gc.push_back(" + t + ");");
+            this->emit("env->set(" + this->symbol(name) + ", " + t + ");");
+            return "shared_ptr<Object>(nullptr)";
+        }
+        case hashLiteral: {
+            string hash = this->temporary();
+            this->emit("shared_ptr<Hash> " + hash + "(new Hash);");
+            for (auto el : static_pointer_cast<HashLiteral>(expr)->pairs) {
+                string key = this->genBoxed(el.first);
+                string val = this->genBoxed(el.second);
+                this->emit(
+                    "if (shared_ptr<Object> e = setHashPair(" + hash + ", " + key + ", " + val + ", env)) return e;"
+                );
+            }
+            return "static_pointer_cast<Object>(" + hash + ")";
+        }
+        case identifier: {
+            string name = static_pointer_cast<IdentifierLiteral>(expr)->value;
+            if (builtins.find(name) != builtins.end()) return this->builtinConstant(name);
+            if (this->isNative(name)) {
+                type = this->natives[name].type;
+                return nativeName(name);
+            }
+            string t = this->temporary();
+            this->emit("shared_ptr<Object> " + t + " = env->get(" + this->symbol(name) + ");");
+            this->emit("if (" + t + " == nullptr) return newError(" + quote("identifier not found: " + name) + ");");
+            return t;
+        }
+        case ifExpression: return this->genIf(static_pointer_cast<IfExpression>(expr));
+        case indexExpression: {
+            shared_ptr<IndexExpression> ie = static_pointer_cast<IndexExpression>(expr);
+            string left                    = this->genBoxed(ie->_left);
+            string index                   = this->genBoxed(ie->index);
+            string t                       = this->temporary();
+            this->emit("shared_ptr<Object> " + t + " = evalIndexExpression(" + left + ", " + index + ", env);");
+            this->emit("if (isError(" + t + ")) return " + t + ";");
+            return t;
+        }
+        case sliceExpression: {
+            shared_ptr<SliceExpression> se = static_pointer_cast<SliceExpression>(expr);
+            string left                    = this->genBoxed(se->_left);
+            string start = se->start == nullptr ? "shared_ptr<Object>(nullptr)" : this->genBoxed(se->start);
+            string end   = se->end == nullptr ? "shared_ptr<Object>(nullptr)" : this->genBoxed(se->end);
+            string step  = se->step == nullptr ? "shared_ptr<Object>(nullptr)" : this->genBoxed(se->step);
+            string t     = this->temporary();
+            this->emit(
+                "shared_ptr<Object> " + t + " = evalSliceExpression(" + left + ", " + start + ", " + end + ", " +
+                step + ", env);"
+            );
+            this->emit("if (isError(" + t + ")) return " + t + ";");
+            return t;
+        }
+        case spawnExpression: {
+            shared_ptr<CallExpression> ce = static_pointer_cast<SpawnExpression>(expr)->call;
+            string callee                 = this->genBoxed(ce->_function);
+            vector<string> args{};
+            for (auto arg : ce->arguments)
+                args.push_back(this->genBoxed(arg));
+            string t = this->temporary();
+            this->emit("shared_ptr<Object> " + t + " = spawnTask(" + callee + ", {" + join(args) + "});");
+            this->emit("if (isError(" + t + ")) return " + t + ";");
+            this->emit("env->gc.push_back(" + t + ");");
+            return t;
+        }
+        case infixExpression:
+        case intAddExpression:
+        case intSubExpression:
+        case intMulExpression:
+        case intDivExpression:
+        case intLessExpression:
+        case intGreaterExpression:
+        case intEqualExpression:
+        case intNotEqualExpression:
+        case floatAddExpression:
+        case floatSubExpression:
+        case floatMulExpression:
+        case floatDivExpression:
+        case floatLessExpression:
+        case floatGreaterExpression:
+        case floatEqualExpression:
+        case floatNotEqualExpression: return this->genInfix(static_pointer_cast<InfixExpression>(expr), type);
+        case integerLiteral:
+            type = nativeInt;
+            return to_string(static_pointer_cast<IntegerLiteral>(expr)->value);
+        case postfixExpression: {
+            shared_ptr<PostfixExpression> p = static_pointer_cast<PostfixExpression>(expr);
+            if (p->_left->type != identifier) {
+                this->emit("return newError(\"not a valid postfix operation.\");");
+                return "shared_ptr<Object>(nullptr)";
+            }
+            string name = static_pointer_cast<IdentifierLiteral>(p->_left)->value;
+            string t    = this->temporary();
+            if (this->isNative(name) && (p->_operator == "++" || p->_operator == "--")) {
+                type = nativeInt;
+                this->emit("int " + t + " = " + p->_operator + nativeName(name) + ";");
+                return t;
+            }
+            string left = this->genBoxed(p->_left);
+            this->emit("if (" + left + "->type != INTEGER_OBJ)");
+            this->emit("    return newError(" + quote(p->_left->literal + " is not an integer.") + ");");
+            this->emit(
+                "shared_ptr<Object> " + t + " = evalPostfixExpression(" + quote(p->_operator) + ", " + left +
+                ", env);"
+            );
+            this->emit("env->set(" + this->symbol(name) + ", " + t + ");");
+            return t;
+        }
+        case prefixExpression: {
+            shared_ptr<PrefixExpression> p = static_pointer_cast<PrefixExpression>(expr);
+            int rightType;
+            string right = this->genExpression(p->_right, rightType);
+            if (p->_operator == "-" && (rightType == nativeInt || rightType == nativeFloat)) {
+                type = rightType;
+                return "(-" + right + ")";
+            }
+            if (p->_operator == "!" && rightType == nativeBool) {
+                type = nativeBool;
+                return "(!" + right + ")";
+            }
+            string t = this->temporary();
+            this->emit(
+                "shared_ptr<Object> " + t + " = evalPrefixExpression(" + quote(p->_operator) + ", " +
+                this->box(right, rightType) + ", env);"
+            );
+            this->emit("if (isError(" + t + ")) return " + t + ";");
+            return t;
+        }
+        case stringLiteral:
+            type = nativeString;
+            return "string(" + quote(static_pointer_cast<StringLiteral>(expr)->value) + ")";
+        case whileExpression: {
+            shared_ptr<WhileExpression> we = static_pointer_cast<WhileExpression>(expr);
+            return this->genLoop(we->body, we->condition, false);
+        }
+        default: break;
+    }
+    this->emit("return newError(\"expression cannot be compiled.\");");
+    return "shared_ptr<Object>(nullptr)";
+}
+
+string CodeGenerator::genFor(shared_ptr<ForExpression> fe) {
+    string result = this->temporary();
+    this->emit("shared_ptr<Object> " + result + " = [&]() -> shared_ptr<Object> {");
+    this->indent++;
+
+    if (fe->iterable != nullptr) {
+        // the body stays inline, in a function the runtime calls once per element
+        vector<string> variables{};
+        for (auto stmt : fe->statements)
+            variables.push_back(this->symbol(static_pointer_cast<LetStatement>(stmt)->name->value));
+        string iterable = this->genBoxed(fe->iterable);
+        this->emit("return evalForEach(" + iterable + ", {" + join(variables) + "}, [&]() -> shared_ptr<Object> {");
+        this->indent++;
+        this->emitStatements(fe->body->statements);
+        this->emit("return nullptr;");
+        this->indent--;
+        this->emit("}, env);");
+        this->indent--;
+        this->emit("}();");
+        this->emit("if (isError(" + result + ")) return " + result + ";");
+        return result;
+    }
+
+    shared_ptr<Expression> bounds[] = {fe->start, fe->end, fe->increment};
+    string values[3];
+    for (int i = 0; i < 3; i++) {
+        int type;
+        string code = this->genExpression(bounds[i], type);
+        values[i]   = this->temporary();
+        if (type == nativeInt) {
+            this->emit("long long " + values[i] + " = " + code + ";");
+            continue;
+        }
+        code = this->box(code, type);
+        this->emit("if (shared_ptr<Object> e = checkRangeBound(" + code + ")) return e;");
+        this->emit("long long " + values[i] + " = " + unbox(code, nativeInt) + ";");
+    }
+    this->emit("if (" + values[2] + " == 0) return newError(\"for-loop step cannot be 0.\");");
+
+    if (fe->parallel) {
+        // the body becomes a function of its own, called once per iteration by the runtime
+        vector<string> variables{}, operators{}, names{};
+        for (auto stmt : fe->statements)
+            variables.push_back(this->symbol(static_pointer_cast<LetStatement>(stmt)->name->value));
+        for (int i = 0; i < fe->reduceNames.size(); i++) {
+            operators.push_back(quote(fe->reduceOperators[i]));
+            names.push_back(this->symbol(fe->reduceNames[i]->value));
+        }
+        string body = this->genFunction("pfor", {}, fe->body);
+        this->emit(
+            "return evalParallelFor(" + values[0] + ", " + values[1] + ", " + values[2] + ", {" + join(variables) +
+            "}, {" + join(operators) + "}, {" + join(names) + "}, " + body + ", env);"
+        );
+        this->indent--;
+        this->emit("}();");
+        this->emit("if (isError(" + result + ")) return " + result + ";");
+        return result;
+    }
+
+    // native counters are plain locals, the rest are rebound in place like evalForLoop does
+    vector<string> bindings{};
+    for (auto stmt : fe->statements) {
+        string name = static_pointer_cast<LetStatement>(stmt)->name->value;
+        if (this->isNative(name)) {
+            bindings.push_back(nativeName(name) + " = loopValue(");
+            continue;
+        }
+        string slot = this->temporary(), var = this->temporary();
+        this->emit("shared_ptr<Object>* " + slot + " = env->slot(" + this->symbol(name) + ");");
+        this->emit("shared_ptr<Integer> " + var + "(new Integer(" + values[0] + "));");
+        this->emit("bindLoopVariable(env.get(), " + slot + ", " + var + ", " + values[0] + ");");
+        bindings.push_back("bindLoopVariable(env.get(), " + slot + ", " + var + ", ");
+    }
+
+    string counter = this->temporary();
+    auto bind      = [&]() {
+        for (auto binding : bindings)
+            this->emit(binding + counter + ");");
+    };
+    this->emit("long long " + counter + " = " + values[0] + ";");
+    this->emit(
+        "for (; " + values[2] + " > 0 ? " + counter + " < " + values[1] + " : " + counter + " > " + values[1] +
+        "; " + counter + " += " + values[2] + ") {"
+    );
+    this->indent++;
+    bind();
+    this->emitStatements(fe->body->statements);
+    this->indent--;
+    this->emit("}");
+    bind();
+    this->emit("return nullptr;");
+
+    this->indent--;
+    this->emit("}();");
+    this->emit("if (isError(" + result + ")) return " + result + ";");
+    return result;
+}
+
+string CodeGenerator::genFunction(
+    string name, vector<shared_ptr<IdentifierLiteral>> params, shared_ptr<BlockStatement> body
+) {
+    string function = "fn" + to_string(this->functionCount++) + "_" + name;
+    this->declarations << "static shared_ptr<Object> " << function << "(const shared_ptr<Environment>& env);\n";
+
+    // a function body is its own frame with its own native locals
+    ostringstream code{};
+    ostringstream* outer                     = this->out;
+    int outerIndent                          = this->indent;
+    unordered_map<string, NativeLocal> outerNatives = this->natives;
+    this->out                                = &code;
+    this->indent                             = 0;
+    this->collectNatives(body->statements, params);
+
+    this->emit("static shared_ptr<Object> " + function + "(const shared_ptr<Environment>& env) {");
+    this->indent++;
+    this->emitLocals();
+    this->emitStatements(body->statements);
+    this->emit("return nullptr;");
+    this->indent--;
+    this->emit("}");
+    this->emit("");
+
+    this->functions << code.str();
+    this->out     = outer;
+    this->indent  = outerIndent;
+    this->natives = outerNatives;
+    return function;
+}
+
+string CodeGenerator::genIf(shared_ptr<IfExpression> expr) {
+    string result = this->temporary();
+    this->emit("shared_ptr<Object> " + result + " = [&]() -> shared_ptr<Object> {");
+    this->indent++;
+
+    vector<shared_ptr<Expression>> conditions{expr->condition};
+    vector<shared_ptr<BlockStatement>> blocks{expr->consequence};
+    conditions.insert(conditions.end(), expr->conditions.begin(), expr->conditions.end());
+    blocks.insert(blocks.end(), expr->alternatives.begin(), expr->alternatives.end());
+    for (int i = 0; i < conditions.size(); i++) {
+        int type;
+        string cond = this->genExpression(conditions[i], type);
+        this->emit("if (" + this->truthy(cond, type) + ") {");
+        this->indent++;
+        this->emitStatements(blocks[i]->statements);
+        this->emit("return nullptr;");
+        this->indent--;
+        this->emit("}");
+    }
+    if (expr->alternative != nullptr) this->emitStatements(expr->alternative->statements);
+    this->emit("return nullptr;");
+
+    this->indent--;
+    this->emit("}();");
+    this->emit("if (isError(" + result + ")) return " + result + ";");
+    return result;
+}
+
+string CodeGenerator::genInfix(shared_ptr<InfixExpression> ie, int& type) {
+    string op = ie->_operator;
+    int leftType, rightType;
+    string left = this->genExpression(ie->_left, leftType);
+
+    // the right operand may have side effects, so a native left value is read first
+    ostringstream rightCode{};
+    ostringstream* outer = this->out;
+    this->out            = &rightCode;
+    string right         = this->genExpression(ie->_right, rightType);
+    this->out            = outer;
+    if (!rightCode.str().empty() && leftType != nativeBoxed) {
+        string t = this->temporary();
+        this->emit(nativeDeclaration(leftType) + " " + t + " = " + left + ";");
+        left = t;
+    }
+    *this->out << rightCode.str();
+
+    bool arithmetic = op == "+" || op == "-" || op == "*" || op == "/";
+    bool comparison = op == "<" || op == ">" || op == "==" || op == "!=";
+    if (leftType == nativeInt && rightType == nativeInt && (arithmetic || comparison)) {
+        type = arithmetic ? nativeInt : nativeBool;
+        return "(" + left + " " + op + " " + right + ")";
+    }
+    // a native int mixed with a double is promoted by C++ itself
+    bool numeric = (leftType == nativeInt || leftType == nativeFloat) &&
+                   (rightType == nativeInt || rightType == nativeFloat);
+    if (numeric && (arithmetic || comparison)) {
+        type = arithmetic ? nativeFloat : nativeBool;
+        return "(" + left + " " + op + " " + right + ")";
+    }
+    if (leftType == nativeBool && rightType == nativeBool && (op == "==" || op == "!=")) {
+        type = nativeBool;
+        return "(" + left + " " + op + " " + right + ")";
+    }
+    if (leftType == nativeString && rightType == nativeString && op == "+") {
+        type = nativeString;
+        return "(" + left + " + " + right + ")";
+    }
+
+    string l = left, r = right;
+    if (leftType != nativeBoxed) {
+        l = this->temporary();
+        this->emit("shared_ptr<Object> " + l + " = " + this->box(left, leftType) + ";");
+    }
+    if (rightType != nativeBoxed) {
+        r = this->temporary();
+        this->emit("shared_ptr<Object> " + r + " = " + this->box(right, rightType) + ";");
+    }
+    string t  = this->temporary();
+    auto node = intInfixNodes.find(op);
+    if (node != intInfixNodes.end()) {
+        this->emit(
+            "shared_ptr<Object> " + t + " = " + l + "->type == INTEGER_OBJ && " + r +
+            "->type == INTEGER_OBJ ? evalIntInfixNode(" + to_string(node->second) + ", " + l + ", " + r +
+            ", env) : evalInfixExpression(" + quote(op) + ", " + l + ", " + r + ", env);"
+        );
+    } else
+        this->emit("shared_ptr<Object> " + t + " = evalInfixExpression(" + quote(op) + ", " + l + ", " + r + ", env);");
+    this->emit("if (isError(" + t + ")) return " + t + ";");
+    return t;
+}
+
+string CodeGenerator::genLoop(shared_ptr<BlockStatement> body, shared_ptr<Expression> condition, bool isDo) {
+    string result = this->temporary(), last = this->temporary();
+    this->emit("shared_ptr<Object> " + result + " = [&]() -> shared_ptr<Object> {");
+    this->indent++;
+    this->emit("shared_ptr<Object> " + last + " = nullptr;");
+
+    // evalLoop checks a do-loop's condition once before its first pass too
+    int type;
+    if (isDo) this->genExpression(condition, type);
+    this->emit("while (true) {");
+    this->indent++;
+    if (!isDo) {
+        string cond = this->genExpression(condition, type);
+        this->emit("if (!" + this->truthy(cond, type) + ") break;");
+    }
+    this->emit(last + " = [&]() -> shared_ptr<Object> {");
+    this->indent++;
+    this->emitStatements(body->statements);
+    this->emit("return nullptr;");
+    this->indent--;
+    this->emit("}();");
+    if (isDo) {
+        string cond = this->genExpression(condition, type);
+        this->emit("if (!" + this->truthy(cond, type) + ") break;");
+    }
+    this->indent--;
+    this->emit("}");
+    this->emit("return " + last + ";");
+
+    this->indent--;
+    this->emit("}();");
+    this->emit("if (isError(" + result + ")) return " + result + ";");
+    return result;
+}
+
+void CodeGenerator::genStatement(shared_ptr<Statement> stmt) {
+    switch (stmt->type) {
+        case assignmentExpressionStatement: {
+            shared_ptr<AssignmentExpressionStatement> ae =
+                static_pointer_cast<AssignmentExpressionStatement>(stmt);
+            string name = ae->name->value;
+            if (this->isNative(name)) {
+                int nativeType = this->natives[name].type;
+                int type;
+                string val = this->genExpression(ae->value, type);
+                if (type != nativeType && !(nativeType == nativeFloat && type == nativeInt)) {
+                    string t        = this->temporary();
+                    string expected = nativeType == nativeInt     ? "INTEGER_OBJ"
+                                      : nativeType == nativeFloat ? "FLOAT_OBJ"
+                                                                  : "STRING_OBJ";
+                    this->emit("shared_ptr<Object> " + t + " = " + this->box(val, type) + ";");
+                    if (nativeType == nativeFloat) this->emit("if (" + t + " == nullptr || !isNumeric(" + t + "))");
+                    else this->emit("if (" + t + " == nullptr || " + t + "->type != " + expected + ")");
+                    this->emit(
+                        "    return newError(\"Cannot assign \" + ObjectType." + expected + " + \" and \" + (" + t +
+                        " == nullptr ? ObjectType.NULL_OBJ : " + t + "->inspectType()));"
+                    );
+                    val = unbox(t, nativeType);
+                }
+                this->emit(nativeName(name) + " " + ae->_operator + " " + val + ";");
+                this->emit("return nullptr;");
+                return;
+            }
+            string val = this->genBoxed(ae->value);
+            string old = this->temporary();
+            this->emit("shared_ptr<Object> " + old + " = env->get(" + this->symbol(name) + ");");
+            this->emit("if (" + old + " == nullptr) return newError(" + quote("identifier not found: " + name) + ");");
+            this->emit(
+                "if (" + val + "->type != " + old + "->type && !(" + old + "->type == FLOAT_OBJ && " + val +
+                "->type == INTEGER_OBJ))"
+            );
+            this->emit(
+                "    return newError(\"Cannot assign \" + " + old + "->inspectType() + \" and \" + " + val +
+                "->inspectType());"
+            );
+            this->emit(
+                "env->set(" + this->symbol(name) + ", evalAssignmentExpression(" + quote(ae->_operator) + ", " + old +
+                ", " + val + ", env));"
+            );
+            this->emit("return nullptr;");
+            return;
+        }
+        case blockStatement:
+            this->emitStatements(static_pointer_cast<BlockStatement>(stmt)->statements);
+            this->emit("return nullptr;");
+            return;
+        case expressionStatement: {
+            int type;
+            string val = this->genExpression(static_pointer_cast<ExpressionStatement>(stmt)->expression, type);
+            this->emit("return " + (type == nativeBoxed ? val : "nullptr") + ";");
+            return;
+        }
+        case functionStatement: {
+            shared_ptr<FunctionStatement> fs = static_pointer_cast<FunctionStatement>(stmt);
+            string body                      = this->genFunction(fs->name->value, fs->parameters, fs->body);
+            vector<string> params{};
+            for (auto param : fs->parameters)
+                params.push_back(quote(param->value));
+            string t = this->temporary();
+            this->emit(
+                "shared_ptr<Object> " + t + " = newCompiledFunction(" + quote(fs->name->value) + ", {" +
+                join(params) + "}, " + body + ", env);"
+            );
+            this->emit("env->set(" + this->symbol(fs->name->value) + ", " + t + ");");
+            this->emit("return " + t + ";");
+            return;
+        }
+        case identifierStatement: {
+            shared_ptr<IdentifierStatement> is = static_pointer_cast<IdentifierStatement>(stmt);
+            string name                        = is->name->value;
+            if (this->isNative(name)) {
+                int nativeType = this->natives[name].type;
+                int type;
+                string val = this->genExpression(is->value, type);
+                if (type != nativeType && !(nativeType == nativeFloat && type == nativeInt)) {
+                    string t = this->temporary();
+                    this->emit(
+                        "shared_ptr<Object> " + t + " = checkDataType(" + datatypeName(is->datatype) + ", " +
+                        this->box(val, type) + ", env);"
+                    );
+                    this->emit("if (isError(" + t + ")) return " + t + ";");
+                    val = unbox(t, nativeType);
+                }
+                this->emit(nativeName(name) + " = " + val + ";");
+                this->emit("return nullptr;");
+                return;
+            }
+            string val = this->genBoxed(is->value);
+            string t   = this->temporary();
+            this->emit(
+                "shared_ptr<Object> " + t + " = checkDataType(" + datatypeName(is->datatype) + ", " + val + ", env);"
+            );
+            this->emit("if (isError(" + t + ")) return " + t + ";");
+            this->emit("env->set(" + this->symbol(name) + ", " + t + ");");
+            this->emit("return nullptr;");
+            return;
+        }
+        case letStatement: {
+            shared_ptr<LetStatement> ls = static_pointer_cast<LetStatement>(stmt);
+            string val                  = this->genBoxed(ls->value);
+            this->emit("env->set(" + this->symbol(ls->name->value) + ", " + val + ");");
+            this->emit("return nullptr;");
+            return;
+        }
+        case returnStatement: {
+            string val = this->genBoxed(static_pointer_cast<ReturnStatement>(stmt)->returnValue);
+            this->emit("return shared_ptr<Object>(new ReturnValue(" + val + "));");
+            return;
+        }
+    }
+    this->emit("return nullptr;");
+}
+
+bool CodeGenerator::isNative(string name) {
+    auto found = this->natives.find(name);
+    return found != this->natives.end() && found->second.eligible;
+}
+
+void CodeGenerator::scanNode(shared_ptr<Node> node, int at, bool nested) {
+    if (node == nullptr) return;
+    if (node->nodetype == statement) {
+        shared_ptr<Statement> stmt = static_pointer_cast<Statement>(node);
+        switch (stmt->type) {
+            case assignmentExpressionStatement: {
+                shared_ptr<AssignmentExpressionStatement> ae =
+                    static_pointer_cast<AssignmentExpressionStatement>(stmt);
+                this->useNative(ae->name->value, at, nested, nativeAssign, ae->_operator);
+                this->scanNode(ae->value, at, nested);
+                return;
+            }
+            case blockStatement:
+                for (auto s : static_pointer_cast<BlockStatement>(stmt)->statements)
+                    this->scanNode(s, at, nested);
+                return;
+            case expressionStatement:
+                this->scanNode(static_pointer_cast<ExpressionStatement>(stmt)->expression, at, nested);
+                return;
+            case functionStatement: {
+                shared_ptr<FunctionStatement> fs = static_pointer_cast<FunctionStatement>(stmt);
+                this->useNative(fs->name->value, at, nested, nativeRebind);
+                for (auto param : fs->parameters)
+                    this->useNative(param->value, at, true, nativeRebind);
+                this->scanNode(fs->body, at, true);
+                return;
+            }
+            case identifierStatement: {
+                shared_ptr<IdentifierStatement> is = static_pointer_cast<IdentifierStatement>(stmt);
+                this->useNative(is->name->value, at, nested, nativeRebind);
+                this->scanNode(is->value, at, nested);
+                return;
+            }
+            case letStatement: {
+                shared_ptr<LetStatement> ls = static_pointer_cast<LetStatement>(stmt);
+                this->useNative(ls->name->value, at, nested, nativeRebind);
+                this->scanNode(ls->value, at, nested);
+                return;
+            }
+            case returnStatement:
+                this->scanNode(static_pointer_cast<ReturnStatement>(stmt)->returnValue, at, nested);
+                return;
+        }
+        return;
+    }
+
+    shared_ptr<Expression> expr = static_pointer_cast<Expression>(node);
+    switch (expr->type) {
+        case arrayLiteral:
+            for (auto element : static_pointer_cast<ArrayLiteral>(expr)->elements)
+                this->scanNode(element, at, nested);
+            return;
+        case callExpression:
+        case builtinCallExpression:
+        case functionCallExpression: {
+            shared_ptr<CallExpression> ce = static_pointer_cast<CallExpression>(expr);
+            this->scanNode(ce->_function, at, nested);
+            for (auto arg : ce->arguments)
+                this->scanNode(arg, at, nested);
+            return;
+        }
+        case doExpression: {
+            shared_ptr<DoExpression> de = static_pointer_cast<DoExpression>(expr);
+            this->scanNode(de->body, at, nested);
+            this->scanNode(de->condition, at, nested);
+            return;
+        }
+        case forExpression: {
+            shared_ptr<ForExpression> fe = static_pointer_cast<ForExpression>(expr);
+            this->scanNode(fe->start, at, nested);
+            this->scanNode(fe->end, at, nested);
+            this->scanNode(fe->increment, at, nested);
+            this->scanNode(fe->iterable, at, nested);
+            if (fe->parallel) {
+                // the body runs as a function of its own, and the reductions are set through env
+                for (auto var : fe->statements)
+                    this->useNative(static_pointer_cast<LetStatement>(var)->name->value, at | 1, true, nativeRebind);
+                for (auto name : fe->reduceNames)
+                    this->useNative(name->value, at | 1, true, nativeRebind);
+                this->scanNode(fe->body, at | 1, true);
+                return;
+            }
+            // elements and lines are set through env
+            int use = fe->iterable == nullptr ? nativeLoopBind : nativeRebind;
+            for (auto var : fe->statements)
+                this->useNative(static_pointer_cast<LetStatement>(var)->name->value, at | 1, nested, use);
+            this->scanNode(fe->body, at | 1, nested);
+            return;
+        }
+        case functionLiteral: {
+            shared_ptr<FunctionLiteral> fl = static_pointer_cast<FunctionLiteral>(expr);
+            if (fl->name != nullptr) this->useNative(fl->name->value, at, nested, nativeRebind);
+            for (auto param : fl->parameters)
+                this->useNative(param->value, at, true, nativeRebind);
+            this->scanNode(fl->body, at, true);
+            return;
+        }
+        case hashLiteral:
+            for (auto el : static_pointer_cast<HashLiteral>(expr)->pairs) {
+                this->scanNode(el.first, at, nested);
+                this->scanNode(el.second, at, nested);
+            }
+            return;
+        case identifier:
+            this->useNative(static_pointer_cast<IdentifierLiteral>(expr)->value, at, nested, nativeRead);
+            return;
+        case ifExpression: {
+            shared_ptr<IfExpression> ie = static_pointer_cast<IfExpression>(expr);
+            this->scanNode(ie->condition, at, nested);
+            this->scanNode(ie->consequence, at, nested);
+            for (auto cond : ie->conditions)
+                this->scanNode(cond, at, nested);
+            for (auto alt : ie->alternatives)
+                this->scanNode(alt, at, nested);
+            this->scanNode(ie->alternative, at, nested);
+            return;
+        }
+        case indexExpression: {
+            shared_ptr<IndexExpression> ie = static_pointer_cast<IndexExpression>(expr);
+            this->scanNode(ie->_left, at, nested);
+            this->scanNode(ie->index, at, nested);
+            return;
+        }
+        case sliceExpression: {
+            shared_ptr<SliceExpression> se = static_pointer_cast<SliceExpression>(expr);
+            this->scanNode(se->_left, at, nested);
+            this->scanNode(se->start, at, nested);
+            this->scanNode(se->end, at, nested);
+            this->scanNode(se->step, at, nested);
+            return;
+        }
+        case spawnExpression:
+            this->scanNode(static_pointer_cast<SpawnExpression>(expr)->call, at, nested);
+            return;
+        case awaitExpression:
+            this->scanNode(static_pointer_cast<AwaitExpression>(expr)->value, at, nested);
+            return;
+        case infixExpression:
+        case intAddExpression:
+        case intSubExpression:
+        case intMulExpression:
+        case intDivExpression:
+        case intLessExpression:
+        case intGreaterExpression:
+        case intEqualExpression:
+        case intNotEqualExpression:
+        case floatAddExpression:
+        case floatSubExpression:
+        case floatMulExpression:
+        case floatDivExpression:
+        case floatLessExpression:
+        case floatGreaterExpression:
+        case floatEqualExpression:
+        case floatNotEqualExpression: {
+            shared_ptr<InfixExpression> ie = static_pointer_cast<InfixExpression>(expr);
+            this->scanNode(ie->_left, at, nested);
+            this->scanNode(ie->_right, at, nested);
+            return;
+        }
+        case postfixExpression: {
+            shared_ptr<PostfixExpression> p = static_pointer_cast<PostfixExpression>(expr);
+            if (p->_left->type == identifier)
+                this->useNative(static_pointer_cast<IdentifierLiteral>(p->_left)->value, at, nested, nativeIncrement);
+            else this->scanNode(p->_left, at, nested);
+            return;
+        }
+        case prefixExpression: this->scanNode(static_pointer_cast<PrefixExpression>(expr)->_right, at, nested); return;
+        case whileExpression: {
+            shared_ptr<WhileExpression> we = static_pointer_cast<WhileExpression>(expr);
+            this->scanNode(we->condition, at, nested);
+            this->scanNode(we->body, at, nested);
+            return;
+        }
+        default: return;
+    }
+}
+
+string CodeGenerator::symbol(string name) {
+    // names are interned once, when the program starts
+    auto found = this->symbols.find(name);
+    if (found != this->symbols.end()) return found->second;
+    string symbol = "s" + to_string(this->symbols.size());
+    this->declarations << "static const Symbol " << symbol << " = intern(" << quote(name) << ");\n";
+    this->symbols[name] = symbol;
+    return symbol;
+}
+
+string CodeGenerator::temporary() { return "t" + to_string(this->temporaryCount++); }
+
+string CodeGenerator::truthy(string code, int type) {
+    switch (type) {
+        case nativeBoxed: return "isTruthy(" + code + ")";
+        case nativeBool:  return code;
+        default:          return "true";
+    }
+}
+
+void CodeGenerator::useNative(string name, int at, bool nested, int use, string op) {
+    auto found = this->natives.find(name);
+    if (found == this->natives.end() || !found->second.eligible) return;
+    NativeLocal& local = found->second;
+
+    bool allowed = !nested && at > local.declaredAt;
+    switch (use) {
+        case nativeRead:     break;
+        case nativeRebind:   allowed = false; break;
+        case nativeLoopBind: allowed = allowed && local.type == nativeInt; break;
+        case nativeAssign:
+            if (local.type == nativeInt || local.type == nativeFloat)
+                allowed = allowed && (op == "+=" || op == "-=" || op == "*=" || op == "/=");
+            else
+                allowed = allowed && local.type == nativeString && op == "+=";
+            break;
+        case nativeIncrement: allowed = allowed && local.type == nativeInt; break;
+    }
+    if (!allowed) local.eligible = false;
+}
+
+int buildProgram(string& input, string output) {
+    unique_ptr<AST> ast(new AST(input));
+    ast->parseProgram();
+    if (ast->parser->errors.size() != 0) {
+        cout << "parser error:\n";
+        for (auto err : ast->parser->errors)
+            cout << '\t' << err;
+        return 1;
+    }
+
+    CodeGenerator generator(ast->Statements);
+    string code = generator.generate();
+
+    // `-o name.cpp` keeps the generated source instead of compiling it
+    bool sourceOnly = output.size() > 4 && output.compare(output.size() - 4, 4, ".cpp") == 0;
+    char path[]     = "/tmp/cimpl-XXXXXX.cpp";
+    if (!sourceOnly) {
+        int fd = mkstemps(path, 4);
+        if (fd == -1) {
+            cout << "could not create a temporary file for the generated source\n";
+            return 1;
+        }
+        close(fd);
+    }
+    string sourcePath = sourceOnly ? output : string(path);
+    ofstream source(sourcePath);
+    source << code;
+    source.close();
+    if (sourceOnly) return 0;
+
+    const char* cxx = getenv("CXX");
+    ostringstream command;
+    command << (cxx != nullptr ? cxx : CIMPL_CXX_COMPILER) << " -std=c++17 -O2 -I\"" << CIMPL_INCLUDE_DIR << "\" -o \""
+            << output << "\" \"" << sourcePath << "\" \"" << CIMPL_RUNTIME_LIBRARY << "\" " << CIMPL_LINK_LIBRARIES;
+    int status = system(command.str().c_str());
+    unlink(sourcePath.c_str());
+    return status == 0 ? 0 : 1;
+}
+
+shared_ptr<Object> newBuiltin(int type) {
+    shared_ptr<Builtin> bi(new Builtin());
+    bi->builtin_type = type;
+    return bi;
+}
+
+shared_ptr<Object>
+newCompiledFunction(string name, vector<string> params, Closure body, shared_ptr<Environment> env) {
+    vector<shared_ptr<IdentifierLiteral>> parameters{};
+    for (auto param : params) {
+        shared_ptr<IdentifierLiteral> ident(new IdentifierLiteral);
+        ident->value  = param;
+        ident->symbol = intern(param);
+        parameters.push_back(ident);
+    }
+    shared_ptr<Function> newf(new Function(parameters, nullptr, env));
+    newf->name         = name;
+    newf->compiledBody = make_shared<Closure>(body);
+    return newf;
+}
+
+void printResult(shared_ptr<Object> result) {
+    if (result == nullptr || result->type != ERROR_OBJ) return;
+    cout << static_pointer_cast<Error>(result)->message << '\n';
+}
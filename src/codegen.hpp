@@ -0,0 +1,75 @@
+#pragma once
+#include "object.hpp"
+
+#include <sstream>
+
+// Ahead-of-time compiler behind `cimpl build`. A parsed program is translated
+// into C++ that calls into the interpreter's own runtime (objects, environments,
+// builtins and the evaluator's helpers), which the system compiler then links
+// against the cimpl runtime library, so the binary starts without parsing.
+// Variables declared with a datatype and for-loop counters are kept in native
+// C++ locals (int, double, bool or string) whenever every use of them in their function can be typed
+// statically, so their arithmetic is done without boxing.
+
+enum NativeType { nativeBoxed, nativeInt, nativeFloat, nativeBool, nativeString };
+
+enum NativeUse { nativeRead, nativeRebind, nativeLoopBind, nativeAssign, nativeIncrement };
+
+typedef struct NativeLocal {
+    int type;
+    // position of the declaring frame statement; see CodeGenerator::scanNode
+    int declaredAt;
+    bool eligible;
+} NativeLocal;
+
+class CodeGenerator {
+  public:
+    CodeGenerator(vector<shared_ptr<Statement>>);
+    ~CodeGenerator() = default;
+
+    string generate();
+
+  private:
+    vector<shared_ptr<Statement>> program;
+    ostringstream declarations{};
+    ostringstream functions{};
+    ostringstream* out{nullptr};
+    unordered_map<string, NativeLocal> natives{};
+    unordered_map<string, string> builtinConstants{};
+    unordered_map<string, string> symbols{};
+    int constantCount{0};
+    int functionCount{0};
+    int temporaryCount{0};
+    int indent{0};
+
+    string box(string, int);
+    string builtinConstant(string);
+    void collectNatives(const vector<shared_ptr<Statement>>&, const vector<shared_ptr<IdentifierLiteral>>&);
+    string constant(string);
+    void declareNative(string, int, int);
+    void emit(string);
+    void emitLocals();
+    void emitStatements(const vector<shared_ptr<Statement>>&);
+    string genBoxed(shared_ptr<Expression>);
+    string genCall(shared_ptr<CallExpression>);
+    string genExpression(shared_ptr<Expression>, int&);
+    string genFor(shared_ptr<ForExpression>);
+    string genFunction(string, vector<shared_ptr<IdentifierLiteral>>, shared_ptr<BlockStatement>);
+    string genIf(shared_ptr<IfExpression>);
+    string genInfix(shared_ptr<InfixExpression>, int&);
+    string genLoop(shared_ptr<BlockStatement>, shared_ptr<Expression>, bool);
+    void genStatement(shared_ptr<Statement>);
+    bool isNative(string);
+    void scanNode(shared_ptr<Node>, int, bool);
+    string symbol(string);
+    string temporary();
+    string truthy(string, int);
+    void useNative(string, int, bool, int, string = "");
+};
+
+int buildProgram(string&, string);
+
+// runtime support called by generated programs
+shared_ptr<Object> newBuiltin(int);
+shared_ptr<Object> newCompiledFunction(string, vector<string>, Closure, shared_ptr<Environment>);
+void printResult(shared_ptr<Object>);
@@ -0,0 +1,236 @@
+#include "csv.hpp"
+
+#include "evaluator.hpp"
+#include "simd.hpp"
+
+#include <charconv>
+#include <cmath>
+#include <cstring>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+#if defined(__x86_64__)
+// SSE2 is part of x86-64 itself, so this needs no runtime check
+static void classifyBlock(const char* block, char delimiter, uint64_t& quote, uint64_t& separator) {
+    quote = separator = 0;
+    for (int i = 0; i < 4; i++) {
+        __m128i bytes = _mm_loadu_si128((const __m128i*)(block + 16 * i));
+        __m128i ends  = _mm_or_si128(
+            _mm_cmpeq_epi8(bytes, _mm_set1_epi8(delimiter)), _mm_cmpeq_epi8(bytes, _mm_set1_epi8('\n'))
+        );
+        int shift = 16 * i;
+        quote |= (uint64_t)(unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, _mm_set1_epi8('"'))) << shift;
+        separator |= (uint64_t)(unsigned)_mm_movemask_epi8(ends) << shift;
+    }
+}
+#else
+static void classifyBlock(const char* block, char delimiter, uint64_t& quote, uint64_t& separator) {
+    quote = separator = 0;
+    for (int i = 0; i < 64; i++) {
+        if (block[i] == '"') quote |= 1ULL << i;
+        else if (block[i] == delimiter || block[i] == '\n') separator |= 1ULL << i;
+    }
+}
+#endif
+
+CsvScanner::CsvScanner(shared_ptr<const string_view> text, char delimiter) {
+    this->text      = text;
+    this->data      = text->data();
+    this->size      = text->size();
+    this->delimiter = delimiter;
+}
+
+void CsvScanner::scan() {
+    uint64_t quote, separator;
+    if (this->size - this->scanned >= 64) classifyBlock(this->data + this->scanned, this->delimiter, quote, separator);
+    else {
+        // the delimiter is never NUL, so padding with it marks nothing
+        char last[64];
+        memset(last, 0, sizeof(last));
+        memcpy(last, this->data + this->scanned, this->size - this->scanned);
+        classifyBlock(last, this->delimiter, quote, separator);
+    }
+    // a doubled quote inside a quoted field closes and reopens it, which leaves the mask as it was
+    uint64_t inside  = prefixXor(quote) ^ this->inQuotes;
+    this->inQuotes   = (uint64_t)((int64_t)inside >> 63);
+    this->separators = separator & ~inside;
+    this->base       = this->scanned;
+    this->scanned += 64;
+}
+
+bool CsvScanner::next(string_view& field, bool& last) {
+    while (this->separators == 0) {
+        if (this->scanned >= this->size) {
+            // the last record need not end with a newline
+            if (this->fieldStart >= this->size && !this->open) return false;
+            size_t end = this->size;
+            if (end > this->fieldStart && this->data[end - 1] == '\r') end--;
+            field            = string_view(this->data + this->fieldStart, end - this->fieldStart);
+            last             = true;
+            this->fieldStart = this->size;
+            this->open       = false;
+            return true;
+        }
+        this->scan();
+    }
+    size_t position = this->base + __builtin_ctzll(this->separators);
+    this->separators &= this->separators - 1;
+    last       = this->data[position] == '\n';
+    size_t end = position;
+    if (last && end > this->fieldStart && this->data[end - 1] == '\r') end--;
+    field            = string_view(this->data + this->fieldStart, end - this->fieldStart);
+    this->fieldStart = position + 1;
+    this->open       = !last;
+    return true;
+}
+
+// the field without the quotes around it, if it has them
+static string_view unquote(string_view field) {
+    if (field.size() >= 2 && field.front() == '"' && field.back() == '"') return field.substr(1, field.size() - 2);
+    return field;
+}
+
+shared_ptr<Object> csvString(const shared_ptr<const string_view>& text, string_view field) {
+    string_view inner = unquote(field);
+    if (inner.size() == field.size() || inner.find('"') == string_view::npos)
+        return make_shared<String>(text, inner.data() - text->data(), inner.size());
+    string decoded{};
+    decoded.reserve(inner.size());
+    for (size_t i = 0; i < inner.size(); i++) {
+        decoded += inner[i];
+        if (inner[i] == '"' && i + 1 < inner.size() && inner[i + 1] == '"') i++;
+    }
+    return make_shared<String>(move(decoded));
+}
+
+template <class T>
+static bool parseField(string_view field, T& value) {
+    field = unquote(field);
+    // from_chars would also take words like nan and inf
+    if (field.empty() || (!isdigit((unsigned char)field.back()) && field.back() != '.')) return false;
+    // from_chars takes no leading '+', which spreadsheets write
+    if (field[0] == '+') field.remove_prefix(1);
+    auto parsed = from_chars(field.data(), field.data() + field.size(), value);
+    return parsed.ec == errc() && parsed.ptr == field.data() + field.size();
+}
+
+shared_ptr<Object> csvValue(const shared_ptr<const string_view>& text, string_view field) {
+    int integer;
+    if (parseField(field, integer)) return make_shared<Integer>(integer);
+    double number;
+    if (parseField(field, number)) return make_shared<Float>(number);
+    string_view inner = unquote(field);
+    if (inner == "true" || inner == "false") return nativeToBoolean(inner == "true");
+    return csvString(text, field);
+}
+
+bool CsvScanner::record(vector<shared_ptr<Object>>& fields) {
+    fields.clear();
+    string_view field;
+    bool last;
+    while (this->next(field, last)) {
+        if (last && fields.empty() && field.empty()) continue;
+        fields.push_back(csvValue(this->text, field));
+        if (last) return true;
+    }
+    return false;
+}
+
+// the column as the narrowest packed array its fields allow, or else as Strings
+static shared_ptr<Object> buildColumn(const shared_ptr<const string_view>& text, const vector<string_view>& fields) {
+    size_t count = fields.size();
+    vector<int> ints(count);
+    size_t i = 0;
+    while (i < count && parseField(fields[i], ints[i]))
+        i++;
+    if (count > 0 && i == count) return make_shared<Array>(move(ints));
+    ints = vector<int>{};
+
+    vector<double> floats(count);
+    size_t numbers = 0;
+    for (i = 0; i < count; i++) {
+        if (unquote(fields[i]).empty()) floats[i] = NAN;
+        else if (parseField(fields[i], floats[i])) numbers++;
+        else break;
+    }
+    if (numbers > 0 && i == count) return make_shared<Array>(move(floats));
+    floats = vector<double>{};
+
+    vector<shared_ptr<Object>> values(count);
+    bool booleans = count > 0;
+    for (i = 0; i < count && booleans; i++) {
+        string_view field = unquote(fields[i]);
+        if (field == "true" || field == "false") values[i] = nativeToBoolean(field == "true");
+        else booleans = false;
+    }
+    if (!booleans)
+        for (i = 0; i < count; i++)
+            values[i] = csvString(text, fields[i]);
+    return make_shared<Array>(move(values));
+}
+
+shared_ptr<Object> readCsv(shared_ptr<const string_view> text, char delimiter, bool header) {
+    CsvScanner scanner(text, delimiter);
+    vector<string_view> names{};
+    vector<vector<string_view>> columns{};
+    size_t column = 0, records = 0;
+    const char* recordStart = nullptr;
+    string_view field;
+    bool last;
+    while (scanner.next(field, last)) {
+        if (last && column == 0 && field.empty()) continue;
+        if (column == 0) recordStart = field.data();
+        if (records == 0) {
+            columns.emplace_back();
+            if (header) names.push_back(field);
+            else columns.back().push_back(field);
+        } else {
+            if (column >= columns.size())
+                return newError(
+                    "Could not read CSV; record " + to_string(records + 1) + " has more than " +
+                    to_string(columns.size()) + " fields"
+                );
+            columns[column].push_back(field);
+        }
+        column++;
+        if (!last) continue;
+
+        if (records > 0 && column < columns.size())
+            return newError(
+                "Could not read CSV; record " + to_string(records + 1) + " has " + to_string(column) + " fields, not " +
+                to_string(columns.size())
+            );
+        // the first record's length gives a guess at how many follow, so the columns grow once or twice at most
+        if (records == 0) {
+            size_t guess = text->size() / max<size_t>(field.data() + field.size() + 1 - recordStart, 1) + 1;
+            for (auto& values : columns)
+                values.reserve(guess);
+        }
+        records++;
+        column = 0;
+    }
+
+    shared_ptr<Hash> table = make_shared<Hash>();
+    table->pairs.reserve(columns.size());
+    for (size_t i = 0; i < columns.size(); i++) {
+        shared_ptr<Object> values = buildColumn(text, columns[i]);
+        columns[i]                = vector<string_view>{};
+        size_t key;
+        shared_ptr<Object> name{};
+        if (header) {
+            shared_ptr<String> str = static_pointer_cast<String>(csvString(text, names[i]));
+            key                    = hashKey(str);
+            name                   = str;
+        } else {
+            shared_ptr<Integer> position = make_shared<Integer>(i);
+            key                          = hashKey(position);
+            name                         = position;
+        }
+        table->pairs[key] = make_shared<HashPair>(name, values);
+    }
+    return table;
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include "object.hpp"
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using namespace std;
+
+// Finds the fields of CSV text in order. The text is classified 64 bytes at a
+// time with vector compares that mark its quotes, delimiters and newlines;
+// the quotes are turned into a mask of the bytes inside quoted fields, whose
+// delimiters and newlines are not separators. Only the block being looked at
+// is kept, so scanning a file of any size takes the same memory.
+class CsvScanner {
+  public:
+    CsvScanner(shared_ptr<const string_view>, char);
+
+    // the next field as it stands in the text, quotes and all, and whether
+    // it ends a record; false once the text has ended
+    bool next(string_view&, bool&);
+    // the values of the next record that is not blank (see csvValue); false once the text has ended
+    bool record(vector<shared_ptr<Object>>&);
+
+  private:
+    shared_ptr<const string_view> text;
+    const char* data;
+    size_t size;
+    char delimiter;
+    // separators not yet handed out from the block that starts at base
+    uint64_t separators{0};
+    size_t base{0};
+    size_t scanned{0};
+    uint64_t inQuotes{0};
+    size_t fieldStart{0};
+    // a delimiter was the last separator, so a field follows even at the end of the text
+    bool open{false};
+
+    void scan();
+};
+
+// The value of a field: surrounding quotes are taken off, and the String is a
+// view of text unless the field had doubled quotes to undo.
+shared_ptr<Object> csvString(const shared_ptr<const string_view>&, string_view);
+// A field on its own: an Integer, Float or Boolean when it reads as one, and
+// otherwise its String. Columns are typed as a whole instead.
+shared_ptr<Object> csvValue(const shared_ptr<const string_view>&, string_view);
+
+// Reads all of text into a Hash from each column's name (its position when
+// there is no header) to an Array of its values. A column is packed as
+// integers, floats or booleans when all its fields are; empty fields in a
+// column of numbers become NaN floats. Returns an Error when a record has more
+// or fewer fields than the first.
+shared_ptr<Object> readCsv(shared_ptr<const string_view>, char, bool);
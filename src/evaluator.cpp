@@ -1,9 +1,17 @@
 #include "evaluator.hpp"
 
 #include "builtins.hpp"
+#include "csv.hpp"
+#include "jit.hpp"
+#include "json.hpp"
+#include "simd.hpp"
+#include "threads.hpp"
 
+#include <cstring>
 #include <iostream>
+#include <map>
 #include <memory>
+#include <mutex>
 
 using namespace std;
 
@@ -15,8 +23,33 @@ shared_ptr<Environment> err_gc = nullptr;
 
 void setErrorGarbageCollector(shared_ptr<Environment>* env) { err_gc = *env; };
 
+// node kinds an InfixExpression is rewritten to once it has seen two Integers
+extern const unordered_map<string, ExpressionType> intInfixNodes = {
+    {"+",  intAddExpression     },
+    {"-",  intSubExpression     },
+    {"*",  intMulExpression     },
+    {"/",  intDivExpression     },
+    {"<",  intLessExpression    },
+    {">",  intGreaterExpression },
+    {"==", intEqualExpression   },
+    {"!=", intNotEqualExpression},
+};
+
+// node kinds an InfixExpression is rewritten to once it has seen a Float and
+// another number; Integer operands are promoted to double
+extern const unordered_map<string, ExpressionType> floatInfixNodes = {
+    {"+",  floatAddExpression     },
+    {"-",  floatSubExpression     },
+    {"*",  floatMulExpression     },
+    {"/",  floatDivExpression     },
+    {"<",  floatLessExpression    },
+    {">",  floatGreaterExpression },
+    {"==", floatEqualExpression   },
+    {"!=", floatNotEqualExpression},
+};
+
 shared_ptr<Object>
-applyFunction(shared_ptr<Object> fn, vector<shared_ptr<Object>> args, shared_ptr<Environment> env) {
+applyFunction(shared_ptr<Object> fn, const vector<shared_ptr<Object>>& args, shared_ptr<Environment> env) {
     if (fn->type == FUNCTION_OBJ) {
         shared_ptr<Function> func;
         try {
@@ -26,21 +59,62 @@ applyFunction(shared_ptr<Object> fn, vector<shared_ptr<Object>> args, shared_ptr
             ss << " not a function: " << fn->inspectType();
             return newError(ss.str());
         }
-        shared_ptr<Environment> newEnv = extendFunction(func, args);
-        shared_ptr<Object> evaluated   = evalNode(func->body, newEnv);
-        if (evaluated == nullptr) return nullptr;
-        return unwrapReturnValue(evaluated);
+        return evalFunctionCall(func, args);
     } else if (fn->type == BUILTIN_OBJ) return evalBuiltinFunction(fn, args, env);
     return newError("not a function: " + fn->inspectType());
 }
 
+void despecializeCallExpression(shared_ptr<CallExpression> ce) {
+    ce->type           = callExpression;
+    ce->generic        = true;
+    ce->cachedFunction.reset();
+    ce->cachedBuiltin = nullptr;
+}
+
+void despecializeInfixExpression(shared_ptr<InfixExpression> ie) {
+    ie->type    = infixExpression;
+    ie->generic = true;
+}
+
+shared_ptr<Object> checkRangeBound(shared_ptr<Object> val) {
+    if (val != nullptr && val->type == INTEGER_OBJ) return nullptr;
+    string got = val == nullptr ? ObjectType.NULL_OBJ : val->inspectType();
+    return newError("for-loop range must be INTEGER, got " + got);
+}
+
+shared_ptr<Object> checkDataType(int datatype, shared_ptr<Object> val, shared_ptr<Environment> env) {
+    int objectType = val == nullptr ? NULL_OBJ : val->type;
+    switch (datatype) {
+        case INT:
+            if (objectType == INTEGER_OBJ) return val;
+            break;
+        case FLOAT:
+            if (objectType == FLOAT_OBJ) return val;
+            if (objectType == INTEGER_OBJ) {
+                shared_ptr<Float> newf(new Float(static_pointer_cast<Integer>(val)->value));
+                env->gc.push_back(newf);
+                return newf;
+            }
+            break;
+        case BOOLEAN:
+            if (objectType == BOOLEAN_TRUE || objectType == BOOLEAN_FALSE) return val;
+            break;
+        case STRING:
+            if (objectType == STRING_OBJ) return val;
+            break;
+        default: return val;
+    }
+    string got = val == nullptr ? ObjectType.NULL_OBJ : val->inspectType();
+    return newError("Mismatched DataType: " + got + " is not equal to: " + DatatypeMap.at(datatype));
+}
+
 shared_ptr<Object> evalArrayIndexExpression(
     shared_ptr<Object> arr, shared_ptr<Object> index, shared_ptr<Environment> env
 ) {
     shared_ptr<Array> arrayObject = static_pointer_cast<Array>(arr);
     shared_ptr<Integer> intObject = static_pointer_cast<Integer>(index);
     int idx                       = intObject->value;
-    int max                       = arrayObject->elements.size();
+    int max                       = arrayObject->size();
     // evaluate negative (reverse) index
     if (idx < 0) {
         if (idx + max < 0) {
@@ -48,19 +122,33 @@ shared_ptr<Object> evalArrayIndexExpression(
             ss << "index out of range.";
             return newError(ss.str());
         }
-        return arrayObject->elements[idx + max];
+        return arrayObject->at(idx + max);
     }
     if (idx > max - 1) {
         ostringstream ss;
         ss << "index out of range.";
         return newError(ss.str());
     }
-    return arrayObject->elements[idx];
+    return arrayObject->at(idx);
 }
 
 shared_ptr<Object> evalAssignmentExpression(
     string op, shared_ptr<Object> oldVal, shared_ptr<Object> val, shared_ptr<Environment> env
 ) {
+    if (oldVal->type == FLOAT_OBJ) {
+        double result = static_pointer_cast<Float>(oldVal)->value;
+        double v      = numericValue(val);
+        switch (op[0]) {
+            case '+': result += v; break;
+            case '-': result -= v; break;
+            case '*': result *= v; break;
+            case '/': result /= v; break;
+            default:  return nullptr;
+        }
+        shared_ptr<Float> newf(new Float(result));
+        env->gc.push_back(newf);
+        return newf;
+    }
     if (val->type == INTEGER_OBJ) {
         shared_ptr<Integer> oldv = static_pointer_cast<Integer>(oldVal);
         shared_ptr<Integer> v    = static_pointer_cast<Integer>(val);
@@ -85,7 +173,7 @@ shared_ptr<Object> evalAssignmentExpression(
         shared_ptr<String> olds = static_pointer_cast<String>(oldVal);
         shared_ptr<String> s    = static_pointer_cast<String>(val);
         if (op == "+=") {
-            shared_ptr<String> news(new String(olds->value + s->value));
+            shared_ptr<String> news(new String(string(olds->value()).append(s->value())));
             env->gc.push_back(news);
             return news;
         } else {
@@ -95,6 +183,30 @@ shared_ptr<Object> evalAssignmentExpression(
     return nullptr;
 }
 
+shared_ptr<Object> characterString(unsigned char c) {
+    // single-character strings are shared constants, so indexing never allocates
+    static const vector<shared_ptr<Object>> characters = []() {
+        vector<shared_ptr<Object>> result{};
+        for (int i = 0; i < 256; i++)
+            result.push_back(shared_ptr<Object>(new String(string(1, (char)i))));
+        return result;
+    }();
+    return characters[c];
+}
+
+void bindLoopVariable(Environment* env, shared_ptr<Object>* slot, shared_ptr<Integer>& var, long long counter) {
+    int value = loopValue(counter);
+    // spawned tasks may hold the previous Integer without a reference the
+    // count can be trusted for, so a shared environment always gets a new one
+    unique_lock<shared_mutex> guard{};
+    if (env->shared) guard = unique_lock<shared_mutex>(*env->lock);
+    if (*slot != var) *slot = var;
+    if (env->shared || var.use_count() > 2) {
+        var   = shared_ptr<Integer>(new Integer(value));
+        *slot = var;
+    } else var->value = value;
+}
+
 shared_ptr<Object> evalBangOperatorExpression(shared_ptr<Object> _right) {
     switch (_right->type) {
         case BOOLEAN_TRUE: return static_pointer_cast<Object>(FALSE_BOOL);
@@ -105,10 +217,11 @@ shared_ptr<Object> evalBangOperatorExpression(shared_ptr<Object> _right) {
 }
 
 vector<shared_ptr<Object>>
-evalCallExpressions(vector<shared_ptr<Expression>> expr, shared_ptr<Environment> env) {
+evalCallExpressions(const vector<shared_ptr<Expression>>& expr, const shared_ptr<Environment>& env) {
     vector<shared_ptr<Object>> result{};
+    result.reserve(expr.size());
 
-    for (auto e : expr) {
+    for (auto& e : expr) {
         shared_ptr<Object> evaluated = evalNode(e, env);
         if (isError(evaluated)) {
             result.push_back(evaluated);
@@ -121,6 +234,7 @@ evalCallExpressions(vector<shared_ptr<Expression>> expr, shared_ptr<Environment>
 
 shared_ptr<Object>
 evalExpressions(shared_ptr<Expression> expr, shared_ptr<Environment> env = nullptr) {
+    if (expr->unboxed) return evalUnboxedExpression(expr, env);
     switch (expr->type) {
         case arrayLiteral: {
             shared_ptr<ArrayLiteral> a          = static_pointer_cast<ArrayLiteral>(expr);
@@ -141,6 +255,30 @@ evalExpressions(shared_ptr<Expression> expr, shared_ptr<Environment> env = nullp
             if (isError(func)) return func;
             vector<shared_ptr<Object>> args = evalCallExpressions(ce->arguments, env);
             if (args.size() == 1 && isError(args[0])) return args[0];
+            if (!ce->generic && PARALLEL_DEPTH == 0) quickenCallExpression(ce, func);
+            return applyFunction(func, args, env);
+        }
+        case builtinCallExpression: {
+            // builtins take precedence over every binding, so no guard is needed
+            shared_ptr<CallExpression> ce   = static_pointer_cast<CallExpression>(expr);
+            vector<shared_ptr<Object>> args = evalCallExpressions(ce->arguments, env);
+            if (args.size() == 1 && isError(args[0])) return args[0];
+            return evalBuiltinFunction(ce->cachedBuiltin, args, env);
+        }
+        case functionCallExpression: {
+            shared_ptr<CallExpression> ce = static_pointer_cast<CallExpression>(expr);
+            // the callee's name was no builtin when it was quickened, and builtins never change, so it is
+            // looked up in the environment without going through evalIdentifier
+            Symbol name             = static_pointer_cast<IdentifierLiteral>(ce->_function)->symbol;
+            shared_ptr<Object> func = env->get(name);
+            if (func == nullptr) return newError("identifier not found: " + *name);
+            vector<shared_ptr<Object>> args = evalCallExpressions(ce->arguments, env);
+            if (args.size() == 1 && isError(args[0])) return args[0];
+            // guard: the callee must still be the Function this call site has always seen, in which case
+            // applyFunction's type checks and cast are already known to succeed
+            if (!ce->cachedFunction.owner_before(func) && !func.owner_before(ce->cachedFunction))
+                return evalFunctionCall(static_pointer_cast<Function>(func), args);
+            if (PARALLEL_DEPTH == 0) despecializeCallExpression(ce);
             return applyFunction(func, args, env);
         }
         case doExpression: {
@@ -158,24 +296,27 @@ evalExpressions(shared_ptr<Expression> expr, shared_ptr<Environment> env = nullp
             return newf;
         }
         case forExpression: {
-            shared_ptr<ForExpression> fe = dynamic_pointer_cast<ForExpression>(expr);
+            shared_ptr<ForExpression> fe = static_pointer_cast<ForExpression>(expr);
             shared_ptr<Loop> loop(new Loop(forLoop, fe->body, env));
             env->gc.push_back(loop);
-            loop->start     = static_pointer_cast<IntegerLiteral>(fe->start)->value;
-            loop->end       = static_pointer_cast<IntegerLiteral>(fe->end)->value;
-            loop->increment = static_pointer_cast<IntegerLiteral>(fe->increment)->value;
-            for (auto stmt : fe->statements) {
-                evalNode(stmt, loop->env);
-                loop->statements.push_back(stmt);
+            if (fe->iterable != nullptr) {
+                auto body = [loop]() { return unpackLoopBody(loop); };
+                return evalForEach(evalNode(fe->iterable, env), loopVariables(fe), body, env);
             }
+            shared_ptr<Object> range = evalForRange(fe, loop);
+            if (isError(range)) return range;
+            if (fe->parallel) return evalParallelLoop(fe, loop);
+            loop->statements = fe->statements;
             return evalLoop(loop);
             break;
         }
         case functionLiteral: {
             shared_ptr<FunctionLiteral> fl = static_pointer_cast<FunctionLiteral>(expr);
             shared_ptr<Function> newf(new Function(fl->parameters, fl->body, env));
+            newf->name = fl->name->value;
+            if (fl->async) newf->function_type = asyncFunction;
             env->gc.push_back(newf);
-            env->set(fl->name->value, newf);
+            env->set(fl->name->symbol, newf);
             break;
         }
         case hashLiteral: {
@@ -200,15 +341,83 @@ evalExpressions(shared_ptr<Expression> expr, shared_ptr<Environment> env = nullp
             if (isError(index)) return index;
             return evalIndexExpression(left, index, env);
         }
+        case sliceExpression: {
+            shared_ptr<SliceExpression> se = static_pointer_cast<SliceExpression>(expr);
+            shared_ptr<Object> left        = evalNode(se->_left, env);
+            if (isError(left)) return left;
+            // a bound that is left out stays nullptr
+            shared_ptr<Object> start = nullptr, end = nullptr, step = nullptr;
+            if (se->start != nullptr) start = evalNode(se->start, env);
+            if (isError(start)) return start;
+            if (se->end != nullptr) end = evalNode(se->end, env);
+            if (isError(end)) return end;
+            if (se->step != nullptr) step = evalNode(se->step, env);
+            if (isError(step)) return step;
+            return evalSliceExpression(left, start, end, step, env);
+        }
+        case awaitExpression: {
+            shared_ptr<Object> value = evalNode(static_pointer_cast<AwaitExpression>(expr)->value, env);
+            if (isError(value)) return value;
+            return evalAwait(value, env);
+        }
+        case spawnExpression: {
+            shared_ptr<CallExpression> ce = static_pointer_cast<SpawnExpression>(expr)->call;
+            shared_ptr<Object> func       = evalNode(ce->_function, env);
+            if (isError(func)) return func;
+            vector<shared_ptr<Object>> args = evalCallExpressions(ce->arguments, env);
+            if (args.size() == 1 && isError(args[0])) return args[0];
+            shared_ptr<Object> task = spawnTask(func, args);
+            env->gc.push_back(task);
+            return task;
+        }
         case infixExpression: {
             shared_ptr<InfixExpression> i = static_pointer_cast<InfixExpression>(expr);
             shared_ptr<Object> left       = evalNode(i->_left, env);
             if (isError(left)) return left;
             shared_ptr<Object> right = evalNode(i->_right, env);
             if (isError(right)) return right;
+            if (!i->generic && PARALLEL_DEPTH == 0) quickenInfixExpression(i, left, right);
             shared_ptr<Object> ni = evalInfixExpression(i->_operator, left, right, env);
             return ni;
         }
+        case intAddExpression:
+        case intSubExpression:
+        case intMulExpression:
+        case intDivExpression:
+        case intLessExpression:
+        case intGreaterExpression:
+        case intEqualExpression:
+        case intNotEqualExpression: {
+            shared_ptr<InfixExpression> i = static_pointer_cast<InfixExpression>(expr);
+            shared_ptr<Object> left       = evalNode(i->_left, env);
+            if (isError(left)) return left;
+            shared_ptr<Object> right = evalNode(i->_right, env);
+            if (isError(right)) return right;
+            // guard: both operands must still be Integers
+            if (left->type == INTEGER_OBJ && right->type == INTEGER_OBJ)
+                return evalIntInfixNode(i->type, left, right, env);
+            if (PARALLEL_DEPTH == 0) despecializeInfixExpression(i);
+            return evalInfixExpression(i->_operator, left, right, env);
+        }
+        case floatAddExpression:
+        case floatSubExpression:
+        case floatMulExpression:
+        case floatDivExpression:
+        case floatLessExpression:
+        case floatGreaterExpression:
+        case floatEqualExpression:
+        case floatNotEqualExpression: {
+            shared_ptr<InfixExpression> i = static_pointer_cast<InfixExpression>(expr);
+            shared_ptr<Object> left       = evalNode(i->_left, env);
+            if (isError(left)) return left;
+            shared_ptr<Object> right = evalNode(i->_right, env);
+            if (isError(right)) return right;
+            // guard: both operands must still be numbers, at least one a Float
+            if (isNumeric(left) && isNumeric(right) && (left->type == FLOAT_OBJ || right->type == FLOAT_OBJ))
+                return evalFloatInfixNode(i->type, left, right, env);
+            if (PARALLEL_DEPTH == 0) despecializeInfixExpression(i);
+            return evalInfixExpression(i->_operator, left, right, env);
+        }
         case integerLiteral: {
             shared_ptr<IntegerLiteral> i = static_pointer_cast<IntegerLiteral>(expr);
             shared_ptr<Integer> newi(new Integer(i->value));
@@ -222,7 +431,7 @@ evalExpressions(shared_ptr<Expression> expr, shared_ptr<Environment> env = nullp
             if (left->type != INTEGER_OBJ)
                 return newError(p->_left->literal + " is not an integer.");
             shared_ptr<IdentifierLiteral> id = static_pointer_cast<IdentifierLiteral>(p->_left);
-            string name                      = id->value;
+            Symbol name                      = id->symbol;
             shared_ptr<Object> val           = env->get(name);
             shared_ptr<Object> np            = evalPostfixExpression(p->_operator, val, env);
             env->set(name, np);
@@ -236,7 +445,9 @@ evalExpressions(shared_ptr<Expression> expr, shared_ptr<Environment> env = nullp
             return np;
         }
         case stringLiteral: {
-            shared_ptr<StringLiteral> s = static_pointer_cast<StringLiteral>(expr);
+            StringLiteral* s = static_cast<StringLiteral*>(expr.get());
+            if (s->constantReady.load(memory_order_acquire)) return s->constant;
+            if (s->symbol != nullptr) return literalConstant(s);
             shared_ptr<String> news(new String(s->value));
             env->gc.push_back(news);
             return news;
@@ -253,10 +464,181 @@ evalExpressions(shared_ptr<Expression> expr, shared_ptr<Environment> env = nullp
     return nullptr;
 }
 
+shared_ptr<Object> evalFloatInfixNode(
+    int kind, shared_ptr<Object> l, shared_ptr<Object> r, shared_ptr<Environment> env
+) {
+    double leftVal  = numericValue(l);
+    double rightVal = numericValue(r);
+    double result;
+
+    switch (kind) {
+        case floatAddExpression:      result = leftVal + rightVal; break;
+        case floatSubExpression:      result = leftVal - rightVal; break;
+        case floatMulExpression:      result = leftVal * rightVal; break;
+        case floatDivExpression:      result = leftVal / rightVal; break;
+        case floatLessExpression:     return nativeToBoolean(leftVal < rightVal);
+        case floatGreaterExpression:  return nativeToBoolean(leftVal > rightVal);
+        case floatEqualExpression:    return nativeToBoolean(leftVal == rightVal);
+        case floatNotEqualExpression: return nativeToBoolean(leftVal != rightVal);
+        default:                      return newError("Not a quickened infix node.");
+    }
+    shared_ptr<Float> newf(new Float(result));
+    env->gc.push_back(newf);
+    return newf;
+}
+
+shared_ptr<Object> evalForLoop(shared_ptr<Loop> loop) {
+    // The induction variable is kept in a native counter. Each loop variable's
+    // environment slot is resolved once up front and its Integer is updated in
+    // place, so iterations do no map lookups, casts or allocations. A fresh
+    // Integer is only bound when the body kept a reference to the previous one.
+    vector<shared_ptr<Object>*> slots{};
+    vector<shared_ptr<Integer>> vars{};
+    for (auto stmt : loop->statements) {
+        shared_ptr<LetStatement> ls = static_pointer_cast<LetStatement>(stmt);
+        shared_ptr<Object>* slot    = loop->env->slot(ls->name->symbol);
+        shared_ptr<Integer> var(new Integer(loop->start));
+        bindLoopVariable(loop->env.get(), slot, var, loop->start);
+        slots.push_back(slot);
+        vars.push_back(var);
+    }
+
+    auto bindLoopVariables = [&](long long value) {
+        for (int v = 0; v < vars.size(); v++)
+            bindLoopVariable(loop->env.get(), slots[v], vars[v], value);
+    };
+
+    shared_ptr<Object> result = nullptr;
+    long long i               = loop->start;
+    long long end             = loop->end;
+    long long step            = loop->increment;
+    for (; step > 0 ? i < end : i > end; i += step) {
+        bindLoopVariables(i);
+        result = unpackLoopBody(loop);
+        if (result != nullptr && result->type == RETURN_OBJ) return result;
+    }
+    // loop variables hold the first out-of-range value once the loop ends
+    bindLoopVariables(i);
+    return result;
+}
+
+shared_ptr<Object> evalForRange(shared_ptr<ForExpression> expr, shared_ptr<Loop> loop) {
+    shared_ptr<Expression> bounds[] = {expr->start, expr->end, expr->increment};
+    long long values[3];
+    for (int i = 0; i < 3; i++) {
+        shared_ptr<Object> val = evalNode(bounds[i], loop->env);
+        if (isError(val)) return val;
+        shared_ptr<Object> err = checkRangeBound(val);
+        if (err != nullptr) return err;
+        values[i] = static_pointer_cast<Integer>(val)->value;
+    }
+    if (values[2] == 0) return newError("for-loop step cannot be 0.");
+    loop->start     = values[0];
+    loop->end       = values[1];
+    loop->increment = values[2];
+    return nullptr;
+}
+
+shared_ptr<Object> evalForEach(
+    shared_ptr<Object> iterable, const vector<Symbol>& variables, const function<shared_ptr<Object>()>& body,
+    shared_ptr<Environment> env
+) {
+    if (isError(iterable)) return iterable;
+    if (iterable->type != ARRAY_OBJ && iterable->type != LINES_OBJ)
+        return newError("for-loop cannot iterate over " + iterable->inspectType() + "; expected ARRAY or LINES");
+
+    // slots are only made once there is something to bind, so an empty loop leaves its variables unset
+    vector<shared_ptr<Object>*> slots{};
+    auto bindLoopVariables = [&](const shared_ptr<Object>& value) {
+        if (slots.empty())
+            for (auto variable : variables)
+                slots.push_back(env->slot(variable));
+        unique_lock<shared_mutex> guard{};
+        if (env->shared) guard = unique_lock<shared_mutex>(*env->lock);
+        for (auto slot : slots)
+            *slot = value;
+    };
+
+    shared_ptr<Object> result = nullptr;
+    if (iterable->type == ARRAY_OBJ) {
+        // the body may push onto the array, so its length is read every time
+        shared_ptr<Array> arr = static_pointer_cast<Array>(iterable);
+        for (size_t i = 0; i < arr->size(); i++) {
+            bindLoopVariables(arr->at(i));
+            result = body();
+            if (result != nullptr && result->type == RETURN_OBJ) return result;
+        }
+        return result;
+    }
+
+    shared_ptr<Lines> lines            = static_pointer_cast<Lines>(iterable);
+    shared_ptr<const string_view> text = lines->text;
+    if (lines->format == csvLines) {
+        // a record's fields are bound as a new array, since the body may keep it
+        CsvScanner scanner(text, lines->delimiter);
+        vector<shared_ptr<Object>> fields{};
+        bool skip = lines->header;
+        while (scanner.record(fields)) {
+            if (skip) {
+                skip = false;
+                continue;
+            }
+            bindLoopVariables(make_shared<Array>(move(fields)));
+            result = body();
+            if (result != nullptr && result->type == RETURN_OBJ) return result;
+        }
+        return result;
+    }
+
+    // Lines are views of the text, found with memchr (vectorized in glibc).
+    // Each is a String of its own, since the body may keep it.
+    const char* data = text->data();
+    size_t size      = text->size();
+    for (size_t start = 0; start < size;) {
+        const char* newline = (const char*)memchr(data + start, '\n', size - start);
+        size_t end          = newline == nullptr ? size : newline - data;
+        if (lines->format == jsonLines) {
+            size_t first = start;
+            while (first < end && isspace((unsigned char)data[first]))
+                first++;
+            start = end + 1;
+            if (first == end) continue;
+            shared_ptr<Object> value = parseJson(text, first, end - first);
+            if (isError(value)) return value;
+            bindLoopVariables(value);
+            result = body();
+            if (result != nullptr && result->type == RETURN_OBJ) return result;
+            continue;
+        }
+        bindLoopVariables(shared_ptr<Object>(new String(text, start, end - start)));
+        result = body();
+        if (result != nullptr && result->type == RETURN_OBJ) return result;
+        start = end + 1;
+    }
+    return result;
+}
+
+shared_ptr<Object> evalFunctionCall(shared_ptr<Function> func, const vector<shared_ptr<Object>>& args) {
+    if (func->function_type == asyncFunction) return spawnTask(func, args);
+    return runFunction(func, args);
+}
+
+// the call itself, which for an async function happens on its task
+shared_ptr<Object> runFunction(shared_ptr<Function> func, const vector<shared_ptr<Object>>& args) {
+    if (JIT_ENABLED) {
+        shared_ptr<Object> jitted = evalJitFunction(func, args);
+        if (jitted != nullptr) return jitted;
+    }
+    shared_ptr<Environment> newEnv = extendFunction(func, args);
+    shared_ptr<Object> evaluated   = func->compiledBody != nullptr ? (*func->compiledBody)(newEnv)
+                                                                   : evalNode(func->body, newEnv);
+    if (evaluated == nullptr) return nullptr;
+    return unwrapReturnValue(evaluated);
+}
+
 shared_ptr<Object> evalHashIndexExpression(shared_ptr<Object> hash, shared_ptr<Object> index) {
     shared_ptr<Hash> hashObject = static_pointer_cast<Hash>(hash);
     size_t key;
-    shared_ptr<HashPair> pair;
     if (index->inspectType() == ObjectType.BOOLEAN_OBJ)
         key = hashKey(static_pointer_cast<Boolean>(index));
     else if (index->inspectType() == ObjectType.INTEGER_OBJ)
@@ -264,17 +646,14 @@ shared_ptr<Object> evalHashIndexExpression(shared_ptr<Object> hash, shared_ptr<O
     else if (index->inspectType() == ObjectType.STRING_OBJ)
         key = hashKey(static_pointer_cast<String>(index));
     else return newError("unusable as hash key: " + index->inspectType());
-    try {
-        pair = hashObject->pairs[key];
-    } catch (...) {
-        return newError("key not in hash");
-    }
-    return pair->value;
+    // a lookup must not insert, since parallel builtins read hashes from several threads
+    auto found = hashObject->pairs.find(key);
+    if (found == hashObject->pairs.end()) return newError("key not in hash");
+    return found->second->value;
 }
 
 shared_ptr<Object> evalHashLiteral(shared_ptr<HashLiteral> expr, shared_ptr<Environment> env) {
-    unordered_map<size_t, shared_ptr<HashPair>> pairs;
-    size_t hashed;
+    shared_ptr<Hash> hash(new Hash);
     for (pair<shared_ptr<Expression>, shared_ptr<Expression>> el : expr->pairs) {
         shared_ptr<Object> key = evalNode(el.first, env);
         if (isError(key)) return key;
@@ -282,34 +661,23 @@ shared_ptr<Object> evalHashLiteral(shared_ptr<HashLiteral> expr, shared_ptr<Envi
         shared_ptr<Object> val = evalNode(el.second, env);
         if (isError(val)) return val;
 
-        if (key->inspectType() == ObjectType.INTEGER_OBJ)
-            hashed = hashKey(static_pointer_cast<Integer>(key));
-        else if (key->inspectType() == ObjectType.STRING_OBJ)
-            hashed = hashKey(static_pointer_cast<String>(key));
-        else if (key->inspectType() == ObjectType.BOOLEAN_OBJ)
-            hashed = hashKey(static_pointer_cast<Boolean>(key));
-        else return newError("unusable as hash key: " + key->inspectType());
-
-        shared_ptr<HashPair> newh(new HashPair(key, val));
-        pairs[hashed] = newh;
-        env->gc.push_back(newh);
+        shared_ptr<Object> err = setHashPair(hash, key, val, env);
+        if (err != nullptr) return err;
     }
-    shared_ptr<Hash> hash(new Hash);
     env->gc.push_back(hash);
-    hash->pairs = pairs;
     return hash;
 }
 
 shared_ptr<Object> evalIdentifier(shared_ptr<IdentifierLiteral> node, shared_ptr<Environment> env) {
-    auto builtin_find = builtins.find(node->value);
-    if (builtin_find != builtins.end()) {
+    int builtin = builtinSymbol(node->symbol);
+    if (builtin != -1) {
         unique_ptr<Builtin> bi(new Builtin());
-        bi->builtin_type = builtin_find->second;
+        bi->builtin_type = builtin;
         // env->gc.push_back(bi);
         return bi;
     }
 
-    shared_ptr<Object> val = env->get(node->value);
+    shared_ptr<Object> val = env->get(node->symbol);
     if (val != nullptr) return val;
 
     return newError("identifier not found: " + node->value);
@@ -352,10 +720,13 @@ shared_ptr<Object> evalInfixExpression(
 ) {
     if (l->type == INTEGER_OBJ && r->type == INTEGER_OBJ)
         return evalIntegerInfixExpression(op, l, r, env);
+    else if (isNumeric(l) && isNumeric(r) && floatInfixNodes.find(op) != floatInfixNodes.end())
+        return evalFloatInfixNode(floatInfixNodes.at(op), l, r, env);
+    else if (op == "==") return nativeToBoolean(objectsEqual(l, r));
+    else if (op == "!=") return nativeToBoolean(!objectsEqual(l, r));
+    else if (l->type == ARRAY_OBJ || r->type == ARRAY_OBJ) return evalArrayInfixExpression(op, l, r, env);
     else if (l->type == STRING_OBJ && r->type == STRING_OBJ)
         return evalStringInfixExpression(op, l, r, env);
-    else if (op == "==") return nativeToBoolean(l->inspectObject() == r->inspectObject());
-    else if (op == "!=") return nativeToBoolean(l->inspectObject() != r->inspectObject());
     else if (l->type != r->type) {
         if (l->type == STRING_OBJ) {
             switch (r->type) {
@@ -412,6 +783,63 @@ shared_ptr<Object> evalInfixExpression(
     return newError(ss.str());
 }
 
+shared_ptr<Object> evalArrayInfixExpression(
+    string op, shared_ptr<Object> l, shared_ptr<Object> r, shared_ptr<Environment> env
+) {
+    // arithmetic is element-wise, between arrays of the same length or an array and a number
+    int kind;
+    if (op == "+") kind = simdAdd;
+    else if (op == "-") kind = simdSub;
+    else if (op == "*") kind = simdMul;
+    else if (op == "/") kind = simdDiv;
+    else return newError("Unknown operator: " + l->inspectType() + op + r->inspectType());
+    if ((l->type != ARRAY_OBJ && !isNumeric(l)) || (r->type != ARRAY_OBJ && !isNumeric(r)))
+        return newError("Type mismatch: " + l->inspectType() + op + r->inspectType());
+
+    Array* la     = l->type == ARRAY_OBJ ? static_cast<Array*>(l.get()) : nullptr;
+    Array* ra     = r->type == ARRAY_OBJ ? static_cast<Array*>(r.get()) : nullptr;
+    size_t length = la != nullptr ? la->length : ra->length;
+    if (la != nullptr && ra != nullptr && la->length != ra->length)
+        return newError(
+            "Array lengths differ: " + to_string(la->length) + " and " + to_string(ra->length)
+        );
+    shared_ptr<Array> newa;
+    if ((la == nullptr ? l->type == INTEGER_OBJ : la->kind == intArray) &&
+        (ra == nullptr ? r->type == INTEGER_OBJ : ra->kind == intArray)) {
+        vector<int> leftScratch, rightScratch, result(length);
+        int leftScalar = 0, rightScalar = 0;
+        if (la == nullptr) leftScalar = static_pointer_cast<Integer>(l)->value;
+        if (ra == nullptr) rightScalar = static_pointer_cast<Integer>(r)->value;
+        const int* left  = la != nullptr ? la->intData(leftScratch) : &leftScalar;
+        const int* right = ra != nullptr ? ra->intData(rightScratch) : &rightScalar;
+        if (kind == simdDiv) {
+            if (ra == nullptr && rightScalar == 0) return newError("Division by zero.");
+            // INT_MIN / -1 traps like a zero divisor does
+            for (size_t i = 0; i < length; i++) {
+                int divisor = ra != nullptr ? right[i] : rightScalar;
+                if (divisor == 0) return newError("Division by zero.");
+                if (divisor == -1 && (la != nullptr ? left[i] : leftScalar) == INT_MIN)
+                    return newError("Integer overflow: " + to_string(INT_MIN) + " / -1");
+            }
+        }
+        simdKernels().mapInt(kind, left, la != nullptr, right, ra != nullptr, result.data(), length);
+        newa = shared_ptr<Array>(new Array(move(result)));
+    } else {
+        vector<double> leftScratch, rightScratch, result(length);
+        double leftScalar = 0, rightScalar = 0;
+        if (la == nullptr) leftScalar = numericValue(l);
+        if (ra == nullptr) rightScalar = numericValue(r);
+        const double* left  = la != nullptr ? la->floatData(leftScratch) : &leftScalar;
+        const double* right = ra != nullptr ? ra->floatData(rightScratch) : &rightScalar;
+        if (length > 0 && (left == nullptr || right == nullptr))
+            return newError("Element-wise " + op + " needs arrays of INTEGER or FLOAT.");
+        simdKernels().mapFloat(kind, left, la != nullptr, right, ra != nullptr, result.data(), length);
+        newa = shared_ptr<Array>(new Array(move(result)));
+    }
+    env->gc.push_back(newa);
+    return newa;
+}
+
 shared_ptr<Object> evalIntegerInfixExpression(
     string op, shared_ptr<Object> l, shared_ptr<Object> r, shared_ptr<Environment> env
 ) {
@@ -468,10 +896,33 @@ shared_ptr<Object> evalIntegerInfixExpression(
     }
 }
 
+shared_ptr<Object> evalIntInfixNode(
+    int kind, shared_ptr<Object> l, shared_ptr<Object> r, shared_ptr<Environment> env
+) {
+    int leftVal  = static_pointer_cast<Integer>(l)->value;
+    int rightVal = static_pointer_cast<Integer>(r)->value;
+    int result;
+
+    switch (kind) {
+        case intAddExpression:      result = leftVal + rightVal; break;
+        case intSubExpression:      result = leftVal - rightVal; break;
+        case intMulExpression:      result = leftVal * rightVal; break;
+        case intDivExpression:      result = leftVal / rightVal; break;
+        case intLessExpression:     return nativeToBoolean(leftVal < rightVal);
+        case intGreaterExpression:  return nativeToBoolean(leftVal > rightVal);
+        case intEqualExpression:    return nativeToBoolean(leftVal == rightVal);
+        case intNotEqualExpression: return nativeToBoolean(leftVal != rightVal);
+        default:                    return newError("Not a quickened infix node.");
+    }
+    shared_ptr<Integer> newi(new Integer(result));
+    env->gc.push_back(newi);
+    return newi;
+}
+
 shared_ptr<Object> evalLoop(shared_ptr<Loop> loop) {
     // FIXME: loop body variable scope not limited; sets outer/global scope
     shared_ptr<Object> cond = nullptr;
-    if (!(loop->loop_type == forLoop)) cond = evalNode(loop->condition, loop->env);
+    if (!(loop->loop_type == forLoop)) cond = evalLoopCondition(loop);
     if (isError(cond)) return cond;
 
     shared_ptr<Boolean> b     = static_pointer_cast<Boolean>(cond);
@@ -480,24 +931,16 @@ shared_ptr<Object> evalLoop(shared_ptr<Loop> loop) {
         case doLoop: {
             do {
                 result = unpackLoopBody(loop);
-                cond   = evalNode(loop->condition, loop->env);
+                cond   = evalLoopCondition(loop);
                 b      = static_pointer_cast<Boolean>(cond);
             } while (b->value);
             return result;
         }
-        case forLoop: {
-            for (int i = loop->start; i < loop->end; i += loop->increment) {
-                result = unpackLoopBody(loop);
-                for (auto stmt : loop->statements)
-                    dynamic_pointer_cast<Integer>(loop->env->get(stmt->token.literal))->value +=
-                        loop->increment;
-            }
-            return result;
-        }
+        case forLoop: return evalForLoop(loop);
         case whileLoop: {
             while (b->value) {
                 result = unpackLoopBody(loop);
-                cond   = evalNode(loop->condition, loop->env);
+                cond   = evalLoopCondition(loop);
                 b      = static_pointer_cast<Boolean>(cond);
             }
             return result;
@@ -506,8 +949,18 @@ shared_ptr<Object> evalLoop(shared_ptr<Loop> loop) {
     return newError("Not a valid loop type.");
 }
 
+shared_ptr<Object> evalLoopCondition(shared_ptr<Loop> loop) {
+    if (loop->compiledCondition != nullptr) return (*loop->compiledCondition)(loop->env);
+    return evalNode(loop->condition, loop->env);
+}
+
 shared_ptr<Object>
 evalMinusOperatorExpression(shared_ptr<Object> right, shared_ptr<Environment> env) {
+    if (right->type == FLOAT_OBJ) {
+        shared_ptr<Float> newf(new Float(-static_pointer_cast<Float>(right)->value));
+        env->gc.push_back(newf);
+        return newf;
+    }
     if (right->type != INTEGER_OBJ) {
         ostringstream ss;
         ss << "Unknown operator: -" << right->inspectType();
@@ -531,6 +984,118 @@ shared_ptr<Object> evalNode(shared_ptr<Node> node, shared_ptr<Environment> env =
     }
 }
 
+// The starting value of a pfor reduction in each chunk. min and max start
+// from the variable itself, since folding it in twice changes nothing.
+shared_ptr<Object> reductionIdentity(string op, shared_ptr<Object> value) {
+    if (op == "min" || op == "max") return value;
+    if (value->type == INTEGER_OBJ) return shared_ptr<Object>(new Integer(op == "*" ? 1 : 0));
+    if (value->type == FLOAT_OBJ) return shared_ptr<Object>(new Float(op == "*" ? 1 : 0));
+    if (value->type == STRING_OBJ && op == "+") return shared_ptr<Object>(new String(""));
+    return newError("Cannot reduce " + value->inspectType() + " with " + op + " in pfor.");
+}
+
+shared_ptr<Object>
+reduceValues(string op, shared_ptr<Object> left, shared_ptr<Object> right, shared_ptr<Environment> env) {
+    if (op == "+" || op == "*") return evalInfixExpression(op, left, right, env);
+    shared_ptr<Object> less = evalInfixExpression("<", right, left, env);
+    if (isError(less)) return less;
+    return isTruthy(less) == (op == "min") ? right : left;
+}
+
+// Runs the iterations of a pfor loop in chunks on the shared thread pool (see
+// parallelChunks). Each chunk binds the loop variables in its own child of env,
+// so whatever the body sets stays private to the chunk, and starts every
+// reduction variable from its identity. The chunk results are then folded into
+// the variables in iteration order and set in env, once every chunk is done.
+shared_ptr<Object> evalParallelFor(
+    long long start, long long end, long long step, const vector<Symbol>& variables, const vector<string>& operators,
+    const vector<Symbol>& names, const Closure& body, shared_ptr<Environment> env
+) {
+    long long count = 0;
+    if (step > 0 && end > start) count = (end - start + step - 1) / step;
+    if (step < 0 && end < start) count = (start - end - step - 1) / -step;
+
+    vector<shared_ptr<Object>> initial{}, identities{};
+    for (size_t r = 0; r < names.size(); r++) {
+        shared_ptr<Object> value = env->get(names[r]);
+        if (value == nullptr) return newError("identifier not found: " + *names[r]);
+        shared_ptr<Object> identity = reductionIdentity(operators[r], value);
+        if (isError(identity)) return identity;
+        initial.push_back(value);
+        identities.push_back(identity);
+    }
+
+    // chunk results, keyed by their first iteration so they fold in order
+    map<size_t, vector<shared_ptr<Object>>> partials{};
+    mutex partialsLock;
+    shared_ptr<Object> err = parallelChunks(count, env, [&](size_t first, size_t last, shared_ptr<Environment> local) {
+        for (size_t r = 0; r < names.size(); r++)
+            local->set(names[r], identities[r]);
+        vector<shared_ptr<Object>*> slots{};
+        vector<shared_ptr<Integer>> vars{};
+        for (auto name : variables) {
+            slots.push_back(local->slot(name));
+            vars.push_back(shared_ptr<Integer>(new Integer(0)));
+        }
+        for (size_t i = first; i < last; i++) {
+            for (size_t v = 0; v < vars.size(); v++)
+                bindLoopVariable(local.get(), slots[v], vars[v], start + (long long)i * step);
+            shared_ptr<Object> result = body(local);
+            if (result == nullptr) continue;
+            if (result->type == RETURN_OBJ) return newError("Cannot return from inside a pfor loop.");
+            if (isError(result)) return result;
+        }
+        vector<shared_ptr<Object>> values{};
+        for (auto name : names)
+            values.push_back(local->get(name));
+        lock_guard<mutex> guard(partialsLock);
+        partials[first] = move(values);
+        return shared_ptr<Object>(nullptr);
+    });
+    if (err != nullptr) return err;
+
+    for (size_t r = 0; r < names.size(); r++) {
+        shared_ptr<Object> result = initial[r];
+        for (auto& partial : partials) {
+            result = reduceValues(operators[r], result, partial.second[r], env);
+            if (isError(result)) return result;
+        }
+        env->set(names[r], result);
+    }
+    return nullptr;
+}
+
+// runs a pfor whose range evalForRange has already put in loop
+vector<Symbol> loopVariables(shared_ptr<ForExpression> expr) {
+    vector<Symbol> variables{};
+    for (auto stmt : expr->statements)
+        variables.push_back(static_pointer_cast<LetStatement>(stmt)->name->symbol);
+    return variables;
+}
+
+shared_ptr<Object> evalParallelLoop(shared_ptr<ForExpression> expr, shared_ptr<Loop> loop) {
+    vector<Symbol> variables = loopVariables(expr), names{};
+    for (auto name : expr->reduceNames)
+        names.push_back(name->symbol);
+    if (loop->compiledBody != nullptr)
+        return evalParallelFor(
+            loop->start, loop->end, loop->increment, variables, expr->reduceOperators, names, *loop->compiledBody,
+            loop->env
+        );
+    shared_ptr<BlockStatement> body = expr->body;
+    return evalParallelFor(
+        loop->start, loop->end, loop->increment, variables, expr->reduceOperators, names,
+        [body](const shared_ptr<Environment>& env) -> shared_ptr<Object> {
+            for (auto stmt : body->statements) {
+                shared_ptr<Object> result = evalNode(stmt, env);
+                if (result != nullptr && result->type == RETURN_OBJ) return result;
+            }
+            return nullptr;
+        },
+        loop->env
+    );
+}
+
 shared_ptr<Object>
 evalPostfixExpression(string op, shared_ptr<Object> left, shared_ptr<Environment> env) {
     if (left->type != INTEGER_OBJ) return newError("Increment operation on non-integer object.");
@@ -560,33 +1125,52 @@ evalPrefixExpression(string op, shared_ptr<Object> r, shared_ptr<Environment> en
     }
 }
 
-shared_ptr<Object> evalStringIndexExpression(
-    shared_ptr<Object> str, shared_ptr<Object> index, shared_ptr<Environment> env
+shared_ptr<Object> evalSliceExpression(
+    shared_ptr<Object> left, shared_ptr<Object> start, shared_ptr<Object> end, shared_ptr<Object> step,
+    shared_ptr<Environment> env
 ) {
-    shared_ptr<String> stringObject = static_pointer_cast<String>(str);
-    shared_ptr<Integer> intObject   = static_pointer_cast<Integer>(index);
-    int idx                         = intObject->value;
-    int max                         = stringObject->value.length();
-    if (idx < 0) {
-        if (idx + max < 0) {
-            ostringstream ss;
-            ss << "index out of range.";
-            return newError(ss.str());
-        }
-        string s(1, stringObject->value[idx + max]);
-        shared_ptr<String> news(new String(s));
+    long from, stride;
+    size_t count;
+    if (left->type == ARRAY_OBJ) {
+        shared_ptr<Array> a    = static_pointer_cast<Array>(left);
+        shared_ptr<Object> err = sliceBounds(start, end, step, a->length, from, count, stride);
+        if (err != nullptr) return err;
+        // a view of a view indexes the same buffer; even a whole slice is a new
+        // array, since sort() changes the array it is given
+        shared_ptr<Array> view(new Array(*a, a->index(from), count, a->step * stride));
+        env->gc.push_back(view);
+        return view;
+    }
+    if (left->type == STRING_OBJ) {
+        shared_ptr<String> s   = static_pointer_cast<String>(left);
+        shared_ptr<Object> err = sliceBounds(start, end, step, s->length, from, count, stride);
+        if (err != nullptr) return err;
+        if (stride == 1) return stringView(s, from, count, env);
+        // characters that are not adjacent cannot share the buffer
+        string_view chars = s->value();
+        string result{};
+        for (size_t i = 0; i < count; i++)
+            result += chars[from + (long)i * stride];
+        shared_ptr<String> news(new String(result));
         env->gc.push_back(news);
         return news;
     }
-    if (idx > max - 1) {
+    return newError("slice operator not supported: " + left->inspectType());
+}
+
+shared_ptr<Object> evalStringIndexExpression(
+    shared_ptr<Object> str, shared_ptr<Object> index, shared_ptr<Environment> env
+) {
+    shared_ptr<String> stringObject = static_pointer_cast<String>(str);
+    int idx                         = static_pointer_cast<Integer>(index)->value;
+    int max                         = stringObject->length;
+    if (idx < 0) idx += max;
+    if (idx < 0 || idx > max - 1) {
         ostringstream ss;
         ss << "index out of range.";
         return newError(ss.str());
     }
-    string s(1, stringObject->value[idx]);
-    shared_ptr<String> news(new String(s));
-    env->gc.push_back(news);
-    return news;
+    return characterString(stringObject->value()[idx]);
 }
 
 shared_ptr<Object>
@@ -596,15 +1180,41 @@ evalStatements(shared_ptr<Statement> stmt, shared_ptr<Environment> env = nullptr
             // FIXME: string += int returns only int
             shared_ptr<AssignmentExpressionStatement> ae =
                 static_pointer_cast<AssignmentExpressionStatement>(stmt);
+            if (ae->datatype == INT) {
+                // type inference proved the variable and the value are of this datatype
+                int val    = evalUnboxedInt(ae->value, env);
+                int result = static_pointer_cast<Integer>(env->get(ae->name->symbol))->value;
+                switch (ae->_operator[0]) {
+                    case '+': result += val; break;
+                    case '-': result -= val; break;
+                    case '*': result *= val; break;
+                    case '/': result /= val; break;
+                }
+                env->set(ae->name->symbol, shared_ptr<Object>(new Integer(result)));
+                break;
+            }
+            if (ae->datatype == FLOAT) {
+                double val    = evalUnboxedFloat(ae->value, env);
+                double result = static_pointer_cast<Float>(env->get(ae->name->symbol))->value;
+                switch (ae->_operator[0]) {
+                    case '+': result += val; break;
+                    case '-': result -= val; break;
+                    case '*': result *= val; break;
+                    case '/': result /= val; break;
+                }
+                env->set(ae->name->symbol, shared_ptr<Object>(new Float(result)));
+                break;
+            }
             shared_ptr<Object> val = evalNode(ae->value, env);
             if (isError(val)) return val;
-            shared_ptr<Object> oldVal = env->get(ae->name->value);
-            if (val->type != oldVal->type)
+            shared_ptr<Object> oldVal = env->get(ae->name->symbol);
+            // an Integer is promoted when it is assigned to a Float
+            if (val->type != oldVal->type && !(oldVal->type == FLOAT_OBJ && val->type == INTEGER_OBJ))
                 return newError(
                     "Cannot assign " + oldVal->inspectType() + " and " + val->inspectType()
                 );
             shared_ptr<Object> newVal = evalAssignmentExpression(ae->_operator, oldVal, val, env);
-            env->set(ae->name->value, newVal);
+            env->set(ae->name->symbol, newVal);
             break;
         }
         case blockStatement: {
@@ -622,17 +1232,24 @@ evalStatements(shared_ptr<Statement> stmt, shared_ptr<Environment> env = nullptr
         case functionStatement: {
             shared_ptr<FunctionStatement> fs = static_pointer_cast<FunctionStatement>(stmt);
             shared_ptr<Function> newf(new Function(fs->parameters, fs->body, env));
-            env->set(fs->name->value, newf);
+            newf->name = fs->name->value;
+            env->set(fs->name->symbol, newf);
             return newf;
         }
         case identifierStatement: {
+            shared_ptr<IdentifierStatement> is = static_pointer_cast<IdentifierStatement>(stmt);
+            shared_ptr<Object> val              = evalNode(is->value, env);
+            if (isError(val)) return val;
+            val = checkDataType(is->datatype, val, env);
+            if (isError(val)) return val;
+            env->set(is->name->symbol, val);
             break;
         }
         case letStatement: {
             shared_ptr<LetStatement> ls = static_pointer_cast<LetStatement>(stmt);
             shared_ptr<Object> val      = evalNode(ls->value, env);
             if (isError(val)) return val;
-            env->set(ls->name->value, val);
+            env->set(ls->name->symbol, val);
             break;
         }
         case returnStatement: {
@@ -656,15 +1273,16 @@ shared_ptr<Object> evalStringInfixExpression(
         );
     shared_ptr<String> nl = static_pointer_cast<String>(l);
     shared_ptr<String> nr = static_pointer_cast<String>(r);
-    shared_ptr<String> news(new String(nl->value + nr->value));
+    shared_ptr<String> news(new String(string(nl->value()).append(nr->value())));
     env->gc.push_back(news);
     return news;
 }
 
-shared_ptr<Environment> extendFunction(shared_ptr<Function> fn, vector<shared_ptr<Object>> args) {
+shared_ptr<Environment> extendFunction(shared_ptr<Function> fn, const vector<shared_ptr<Object>>& args) {
     shared_ptr<Environment> env(new Environment(fn->env));
+    env->store.reserve(fn->parameters.size());
     for (int i = 0; i < fn->parameters.size(); i++) {
-        env->set(fn->parameters[i]->value, args[i]);
+        env->set(fn->parameters[i]->symbol, args[i]);
     }
     return env;
 }
@@ -673,7 +1291,7 @@ size_t hashKey(shared_ptr<Boolean> b) { return b->value ? 1 : 0; }
 
 size_t hashKey(shared_ptr<Integer> i) { return i->value; }
 
-size_t hashKey(shared_ptr<String> s) { return hash<string>{}(s->value); }
+size_t hashKey(shared_ptr<String> s) { return s->hashValue(); }
 
 bool isError(shared_ptr<Object> obj) {
     if (obj != nullptr) {
@@ -682,6 +1300,8 @@ bool isError(shared_ptr<Object> obj) {
     return false;
 }
 
+bool isNumeric(shared_ptr<Object> obj) { return obj->type == INTEGER_OBJ || obj->type == FLOAT_OBJ; }
+
 bool isTruthy(shared_ptr<Object> obj) {
     switch (obj->type) {
         case BOOLEAN_TRUE: return true;
@@ -691,18 +1311,398 @@ bool isTruthy(shared_ptr<Object> obj) {
     }
 }
 
+bool objectsEqual(const shared_ptr<Object>& l, const shared_ptr<Object>& r) {
+    // structural equality: values of different types are never equal, except
+    // Integers and Floats, which compare by number
+    if (l == r) return true;
+    if (l == nullptr || r == nullptr) return false;
+    if (isNumeric(l) && isNumeric(r)) return numericValue(l) == numericValue(r);
+    if (l->type != r->type) return false;
+
+    switch (l->type) {
+        case STRING_OBJ: {
+            String* ls = static_cast<String*>(l.get());
+            String* rs = static_cast<String*>(r.get());
+            if (ls->length != rs->length) return false;
+            if (ls->buffer == rs->buffer && ls->offset == rs->offset) return true;
+            if (ls->hashed.load(memory_order_acquire) && rs->hashed.load(memory_order_acquire) &&
+                ls->hashCode.load(memory_order_relaxed) != rs->hashCode.load(memory_order_relaxed))
+                return false;
+            return ls->value() == rs->value();
+        }
+        case ARRAY_OBJ: {
+            Array* la = static_cast<Array*>(l.get());
+            Array* ra = static_cast<Array*>(r.get());
+            if (la->length != ra->length) return false;
+            if (la->buffer() == ra->buffer() && la->offset == ra->offset && la->step == ra->step) return true;
+            if (la->kind == intArray && ra->kind == intArray) {
+                for (size_t i = 0; i < la->length; i++)
+                    if (la->intAt(i) != ra->intAt(i)) return false;
+                return true;
+            }
+            for (size_t i = 0; i < la->length; i++)
+                if (!objectsEqual(la->at(i), ra->at(i))) return false;
+            return true;
+        }
+        case HASH_OBJ: {
+            const unordered_map<size_t, shared_ptr<HashPair>>& lp = static_cast<Hash*>(l.get())->pairs;
+            const unordered_map<size_t, shared_ptr<HashPair>>& rp = static_cast<Hash*>(r.get())->pairs;
+            if (lp.size() != rp.size()) return false;
+            for (auto& pair : lp) {
+                auto found = rp.find(pair.first);
+                if (found == rp.end() || !objectsEqual(pair.second->key, found->second->key) ||
+                    !objectsEqual(pair.second->value, found->second->value))
+                    return false;
+            }
+            return true;
+        }
+        // the two Booleans and NULL carry no value beyond their type
+        case BOOLEAN_FALSE:
+        case BOOLEAN_TRUE:
+        case NULL_OBJ: return true;
+        // functions, builtins and other objects are only equal to themselves
+        default: return false;
+    }
+}
+
+// Splits count tasks into chunks and runs them on the shared thread pool. The
+// first task is done on the calling thread beforehand, so call sites and
+// operators are quickened for the types at hand before the AST is shared. Each
+// chunk allocates in an environment of its own, a child of env, which outer
+// scopes are only read through. Returns the first error in task order, if any
+// chunk met one.
+shared_ptr<Object> parallelChunks(
+    size_t count, shared_ptr<Environment> env,
+    const function<shared_ptr<Object>(size_t, size_t, shared_ptr<Environment>)>& chunk
+) {
+    if (count == 0) return nullptr;
+    shared_ptr<Object> err = chunk(0, 1, shared_ptr<Environment>(new Environment(env)));
+    if (err != nullptr) return err;
+
+    ThreadPool& pool = ThreadPool::shared();
+    size_t rest      = count - 1;
+    size_t chunks    = min(rest, pool.size() * 8);
+    vector<shared_ptr<Object>> errors(chunks);
+    atomic<bool> failed{false};
+    PARALLEL_DEPTH++;
+    pool.run(chunks, [&](size_t i) {
+        if (failed) return;
+        shared_ptr<Environment> local(new Environment(env));
+        errors[i] = chunk(1 + rest * i / chunks, 1 + rest * (i + 1) / chunks, local);
+        if (errors[i] != nullptr) failed = true;
+    });
+    PARALLEL_DEPTH--;
+    for (auto& error : errors)
+        if (error != nullptr) return error;
+    return nullptr;
+}
+
+void quickenCallExpression(shared_ptr<CallExpression> ce, shared_ptr<Object> func) {
+    if (ce->_function->type != identifier) {
+        ce->generic = true;
+        return;
+    }
+    switch (func->type) {
+        case BUILTIN_OBJ: {
+            // only a builtin's own name is guaranteed to resolve to it again
+            string name = static_pointer_cast<IdentifierLiteral>(ce->_function)->value;
+            if (builtins.find(name) == builtins.end()) {
+                ce->generic = true;
+                break;
+            }
+            ce->cachedBuiltin = func;
+            ce->type          = builtinCallExpression;
+            break;
+        }
+        case FUNCTION_OBJ:
+            ce->cachedFunction = func;
+            ce->type           = functionCallExpression;
+            break;
+        default: ce->generic = true;
+    }
+}
+
+void quickenInfixExpression(
+    shared_ptr<InfixExpression> ie, shared_ptr<Object> l, shared_ptr<Object> r
+) {
+    bool integers = l->type == INTEGER_OBJ && r->type == INTEGER_OBJ;
+    bool floats   = isNumeric(l) && isNumeric(r) && !integers;
+    const unordered_map<string, ExpressionType>& nodes = integers ? intInfixNodes : floatInfixNodes;
+    auto node                                          = nodes.find(ie->_operator);
+    if (!(integers || floats) || node == nodes.end()) {
+        ie->generic = true;
+        return;
+    }
+    ie->type = node->second;
+}
+
+shared_ptr<Object>
+setHashPair(shared_ptr<Hash> hash, shared_ptr<Object> key, shared_ptr<Object> val, shared_ptr<Environment> env) {
+    size_t hashed;
+    if (key->inspectType() == ObjectType.INTEGER_OBJ) hashed = hashKey(static_pointer_cast<Integer>(key));
+    else if (key->inspectType() == ObjectType.STRING_OBJ)
+        hashed = hashKey(static_pointer_cast<String>(key));
+    else if (key->inspectType() == ObjectType.BOOLEAN_OBJ)
+        hashed = hashKey(static_pointer_cast<Boolean>(key));
+    else return newError("unusable as hash key: " + key->inspectType());
+
+    shared_ptr<HashPair> newh(new HashPair(key, val));
+    hash->pairs[hashed] = newh;
+    env->gc.push_back(newh);
+    return nullptr;
+}
+
 shared_ptr<Boolean> nativeToBoolean(bool input) {
     if (input) return static_pointer_cast<Boolean>(TRUE_BOOL);
     return static_pointer_cast<Boolean>(FALSE_BOOL);
 }
 
+double numericValue(shared_ptr<Object> obj) {
+    if (obj->type == FLOAT_OBJ) return static_pointer_cast<Float>(obj)->value;
+    return static_pointer_cast<Integer>(obj)->value;
+}
+
 shared_ptr<Object> newError(string msg) {
+    // errors raised while tasks may be running are kept by the thread raising
+    // them instead of the shared environment; a fiber only switches threads
+    // when it parks, never inside this push
+    thread_local vector<shared_ptr<Object>> threadErrors{};
     shared_ptr<Object> err(new Error(msg));
-    err_gc->gc.push_back(err);
+    if (PARALLEL_DEPTH == 0) err_gc->gc.push_back(err);
+    else threadErrors.push_back(err);
     return err;
 }
 
+bool evalUnboxedBool(const shared_ptr<Expression>& expr, const shared_ptr<Environment>& env) {
+    switch (expr->type) {
+        case booleanExpression: return static_pointer_cast<BooleanLiteral>(expr)->value;
+        case identifier:
+            return env->get(static_pointer_cast<IdentifierLiteral>(expr)->symbol)->type == BOOLEAN_TRUE;
+        case infixExpression: {
+            // booleans compared with == or !=
+            shared_ptr<InfixExpression> ie = static_pointer_cast<InfixExpression>(expr);
+            bool equal = evalUnboxedBool(ie->_left, env) == evalUnboxedBool(ie->_right, env);
+            return ie->_operator[0] == '=' ? equal : !equal;
+        }
+        case intLessExpression:
+        case intGreaterExpression:
+        case intEqualExpression:
+        case intNotEqualExpression: {
+            shared_ptr<InfixExpression> ie = static_pointer_cast<InfixExpression>(expr);
+            int left                       = evalUnboxedInt(ie->_left, env);
+            int right                      = evalUnboxedInt(ie->_right, env);
+            switch (expr->type) {
+                case intLessExpression:    return left < right;
+                case intGreaterExpression: return left > right;
+                case intEqualExpression:   return left == right;
+                default:                   return left != right;
+            }
+        }
+        case floatLessExpression:
+        case floatGreaterExpression:
+        case floatEqualExpression:
+        case floatNotEqualExpression: {
+            shared_ptr<InfixExpression> ie = static_pointer_cast<InfixExpression>(expr);
+            double left                    = evalUnboxedFloat(ie->_left, env);
+            double right                   = evalUnboxedFloat(ie->_right, env);
+            switch (expr->type) {
+                case floatLessExpression:    return left < right;
+                case floatGreaterExpression: return left > right;
+                case floatEqualExpression:   return left == right;
+                default:                     return left != right;
+            }
+        }
+        case prefixExpression: return !evalUnboxedBool(static_pointer_cast<PrefixExpression>(expr)->_right, env);
+        default: return false;
+    }
+}
+
+shared_ptr<Object> evalUnboxedExpression(shared_ptr<Expression> expr, shared_ptr<Environment> env) {
+    // only the result is boxed; it is owned by whoever holds it, not env->gc
+    if (expr->datatype == INT) return shared_ptr<Object>(new Integer(evalUnboxedInt(expr, env)));
+    if (expr->datatype == FLOAT) return shared_ptr<Object>(new Float(evalUnboxedFloat(expr, env)));
+    return nativeToBoolean(evalUnboxedBool(expr, env));
+}
+
+double evalUnboxedFloat(const shared_ptr<Expression>& expr, const shared_ptr<Environment>& env) {
+    // integer operands of a float operation are promoted
+    if (expr->datatype == INT) return evalUnboxedInt(expr, env);
+    switch (expr->type) {
+        case floatLiteral: return static_pointer_cast<FloatLiteral>(expr)->value;
+        case identifier:
+            return static_pointer_cast<Float>(env->get(static_pointer_cast<IdentifierLiteral>(expr)->symbol))->value;
+        case floatAddExpression:
+        case floatSubExpression:
+        case floatMulExpression:
+        case floatDivExpression: {
+            shared_ptr<InfixExpression> ie = static_pointer_cast<InfixExpression>(expr);
+            double left                    = evalUnboxedFloat(ie->_left, env);
+            double right                   = evalUnboxedFloat(ie->_right, env);
+            switch (expr->type) {
+                case floatAddExpression: return left + right;
+                case floatSubExpression: return left - right;
+                case floatMulExpression: return left * right;
+                default:                 return left / right;
+            }
+        }
+        case prefixExpression: return -evalUnboxedFloat(static_pointer_cast<PrefixExpression>(expr)->_right, env);
+        default: return 0;
+    }
+}
+
+int evalUnboxedInt(const shared_ptr<Expression>& expr, const shared_ptr<Environment>& env) {
+    switch (expr->type) {
+        case identifier:
+            return static_pointer_cast<Integer>(env->get(static_pointer_cast<IdentifierLiteral>(expr)->symbol))->value;
+        case integerLiteral: return static_pointer_cast<IntegerLiteral>(expr)->value;
+        case intAddExpression:
+        case intSubExpression:
+        case intMulExpression:
+        case intDivExpression: {
+            shared_ptr<InfixExpression> ie = static_pointer_cast<InfixExpression>(expr);
+            int left                       = evalUnboxedInt(ie->_left, env);
+            int right                      = evalUnboxedInt(ie->_right, env);
+            switch (expr->type) {
+                case intAddExpression: return left + right;
+                case intSubExpression: return left - right;
+                case intMulExpression: return left * right;
+                default:               return left / right;
+            }
+        }
+        case prefixExpression: return -evalUnboxedInt(static_pointer_cast<PrefixExpression>(expr)->_right, env);
+        default: return 0;
+    }
+}
+
+shared_ptr<Object> sliceBounds(
+    shared_ptr<Object> start, shared_ptr<Object> end, shared_ptr<Object> step, size_t size, long& from,
+    size_t& count, long& stride
+) {
+    // as in python, bounds count from the end when negative and are clamped to
+    // the sequence, so a slice is never out of range; left-out bounds are nullptr
+    shared_ptr<Object> given[3] = {start, end, step};
+    for (auto bound : given)
+        if (bound != nullptr && bound->type != INTEGER_OBJ)
+            return newError("slice bounds must be INTEGER, got " + bound->inspectType());
+    stride = step == nullptr ? 1 : static_pointer_cast<Integer>(step)->value;
+    if (stride == 0) return newError("slice step cannot be 0.");
+
+    // a backwards slice runs from the last element down to just before the first
+    long n         = size;
+    long lower     = stride > 0 ? 0 : -1;
+    long upper     = stride > 0 ? n : n - 1;
+    long bounds[2] = {stride > 0 ? 0 : n - 1, stride > 0 ? n : -1};
+    for (int i = 0; i < 2; i++) {
+        if (given[i] == nullptr) continue;
+        long bound = static_pointer_cast<Integer>(given[i])->value;
+        if (bound < 0) bound += n;
+        bounds[i] = min(max(bound, lower), upper);
+    }
+    long span = stride > 0 ? bounds[1] - bounds[0] : bounds[0] - bounds[1];
+    long by   = stride > 0 ? stride : -stride;
+    count     = span <= 0 ? 0 : (span + by - 1) / by;
+    from      = count == 0 ? 0 : bounds[0];
+    return nullptr;
+}
+
+// Marks env and the environments around it as shared, so their bindings are
+// locked from now on (see Environment).
+void shareEnvironment(shared_ptr<Environment> env) {
+    static mutex sharing;
+    lock_guard<mutex> guard(sharing);
+    for (Environment* e = env.get(); e != nullptr && !e->shared; e = e->outer.get()) {
+        e->lock.reset(new shared_mutex());
+        e->shared = true;
+    }
+}
+
+// Starts func(args) as a green thread on the Scheduler and returns its Task.
+// The task reads the environments the function closes over while the spawner
+// carries on, so those are shared first, and the AST stays as it is until
+// the task has finished.
+shared_ptr<Object> spawnTask(shared_ptr<Object> func, vector<shared_ptr<Object>> args) {
+    if (func->type != FUNCTION_OBJ && func->type != BUILTIN_OBJ)
+        return newError("Cannot spawn " + func->inspectType() + "; spawn needs a function call.");
+    if (func->type == FUNCTION_OBJ) shareEnvironment(static_pointer_cast<Function>(func)->env);
+    for (auto& arg : args)
+        if (arg->type == FUNCTION_OBJ) shareEnvironment(static_pointer_cast<Function>(arg)->env);
+
+    shared_ptr<Task> task(new Task());
+    PARALLEL_DEPTH++;
+    Scheduler::shared().spawn([task, func, args]() {
+        // the task's own allocation area
+        shared_ptr<Environment> env(new Environment());
+        task->result = func->type == FUNCTION_OBJ ? runFunction(static_pointer_cast<Function>(func), args)
+                                                  : applyFunction(func, args, env);
+        PARALLEL_DEPTH--;
+        task->finished->set();
+    });
+    return task;
+}
+
+// the value a task's function returned, once it has; a function that returned
+// nothing gives NULL
+shared_ptr<Object> awaitTask(shared_ptr<Task> task, shared_ptr<Environment> env) {
+    task->finished->wait();
+    if (task->result != nullptr) return task->result;
+    shared_ptr<Object> null(new Null());
+    env->gc.push_back(null);
+    return null;
+}
+
+// `await` waits for a task, or for each task of an array of them, and leaves
+// any other value as it is
+shared_ptr<Object> evalAwait(shared_ptr<Object> value, shared_ptr<Environment> env) {
+    if (value->type == TASK_OBJ) return awaitTask(static_pointer_cast<Task>(value), env);
+    if (value->type != ARRAY_OBJ) return value;
+    vector<shared_ptr<Object>> elements = static_pointer_cast<Array>(value)->elements();
+    for (auto& el : elements)
+        if (el->type != TASK_OBJ) return value;
+    vector<shared_ptr<Object>> results{};
+    for (auto& el : elements)
+        results.push_back(awaitTask(static_pointer_cast<Task>(el), env));
+    shared_ptr<Array> arr(new Array(move(results)));
+    env->gc.push_back(arr);
+    return arr;
+}
+
+// a program is over once the tasks it spawned are
+void waitForTasks() { Scheduler::waitAll(); }
+
+shared_ptr<Object> stringConstant(Symbol value) {
+    // interned literals evaluate to one shared String each, which keeps its
+    // cached hash and compares equal to itself by identity
+    static unordered_map<Symbol, shared_ptr<Object>> constants{};
+    static mutex constantsMutex;
+    lock_guard<mutex> lock(constantsMutex);
+    shared_ptr<Object>& constant = constants[value];
+    if (constant == nullptr) constant = shared_ptr<Object>(new String(*value));
+    return constant;
+}
+
+shared_ptr<Object> literalConstant(StringLiteral* literal) {
+    // the interned String is looked up once per literal and then read off it
+    static mutex literalsMutex;
+    shared_ptr<Object> constant = stringConstant(literal->symbol);
+    lock_guard<mutex> lock(literalsMutex);
+    if (!literal->constantReady.load(memory_order_relaxed)) {
+        literal->constant = constant;
+        literal->constantReady.store(true, memory_order_release);
+    }
+    return constant;
+}
+
+shared_ptr<Object>
+stringView(shared_ptr<String> s, size_t offset, size_t length, shared_ptr<Environment> env) {
+    if (length == 1) return characterString(s->value()[offset]);
+    if (offset == 0 && length == s->length) return s;
+    shared_ptr<String> view(new String(s->buffer, s->offset + offset, length));
+    env->gc.push_back(view);
+    return view;
+}
+
 shared_ptr<Object> unpackLoopBody(shared_ptr<Loop> loop) {
+    if (loop->compiledBody != nullptr) return (*loop->compiledBody)(loop->env);
     for (auto stmt : loop->body->statements) {
         shared_ptr<Object> result = evalNode(stmt, loop->env);
         if (result != nullptr && result->type == RETURN_OBJ) return result;
@@ -1,18 +1,45 @@
 #pragma once
 #include "object.hpp"
 
+#include <climits>
+
 using namespace std;
 
+extern const unordered_map<string, ExpressionType> floatInfixNodes;
+extern const unordered_map<string, ExpressionType> intInfixNodes;
+
 shared_ptr<Object>
-    applyFunction(shared_ptr<Object>, vector<shared_ptr<Object>>, shared_ptr<Environment>);
+    applyFunction(shared_ptr<Object>, const vector<shared_ptr<Object>>&, shared_ptr<Environment>);
 shared_ptr<Object>
     evalArrayIndexExpression(shared_ptr<Object>, shared_ptr<Object>, shared_ptr<Environment>);
+shared_ptr<Object>
+    evalArrayInfixExpression(string, shared_ptr<Object>, shared_ptr<Object>, shared_ptr<Environment>);
 shared_ptr<Object>
     evalAssignmentExpression(string, shared_ptr<Object>, shared_ptr<Object>, shared_ptr<Environment>);
+shared_ptr<Object> checkRangeBound(shared_ptr<Object>);
+shared_ptr<Object> checkDataType(int, shared_ptr<Object>, shared_ptr<Environment>);
+void despecializeCallExpression(shared_ptr<CallExpression>);
+void despecializeInfixExpression(shared_ptr<InfixExpression>);
+shared_ptr<Object> characterString(unsigned char);
+void bindLoopVariable(Environment*, shared_ptr<Object>*, shared_ptr<Integer>&, long long);
+// The counter of a range loop as an Integer. Only the value a loop ends on can
+// fall outside the range of Integers; it is held at the end of that range,
+// where it still fails the loop's condition.
+inline int loopValue(long long value) { return value > INT_MAX ? INT_MAX : value < INT_MIN ? INT_MIN : (int)value; }
 shared_ptr<Object> evalBangOperatorExpression(shared_ptr<Object>);
 vector<shared_ptr<Object>>
-evalCallExpressions(vector<shared_ptr<Expression>> expr, shared_ptr<Environment>);
+evalCallExpressions(const vector<shared_ptr<Expression>>&, const shared_ptr<Environment>&);
 shared_ptr<Object> evalExpressions(shared_ptr<Expression>, shared_ptr<Environment>);
+shared_ptr<Object>
+    evalFloatInfixNode(int, shared_ptr<Object>, shared_ptr<Object>, shared_ptr<Environment>);
+shared_ptr<Object> evalForLoop(shared_ptr<Loop>);
+shared_ptr<Object> evalForRange(shared_ptr<ForExpression>, shared_ptr<Loop>);
+// runs the body once per element of an array or line of lines(), bound to every variable
+shared_ptr<Object> evalForEach(
+    shared_ptr<Object>, const vector<Symbol>&, const function<shared_ptr<Object>()>&, shared_ptr<Environment>
+);
+shared_ptr<Object> evalFunctionCall(shared_ptr<Function>, const vector<shared_ptr<Object>>&);
+shared_ptr<Object> runFunction(shared_ptr<Function>, const vector<shared_ptr<Object>>&);
 shared_ptr<Object> evalHashIndexExpression(shared_ptr<Object>, shared_ptr<Object>);
 shared_ptr<Object> evalHashLiteral(shared_ptr<HashLiteral>, shared_ptr<Environment>);
 shared_ptr<Object> evalIdentifier(shared_ptr<IdentifierLiteral>, shared_ptr<Environment>);
@@ -23,23 +50,59 @@ shared_ptr<Object>
     evalInfixExpression(string, shared_ptr<Object>, shared_ptr<Object>, shared_ptr<Environment>);
 shared_ptr<Object>
     evalIntegerInfixExpression(string, shared_ptr<Object>, shared_ptr<Object>, shared_ptr<Environment>);
+shared_ptr<Object>
+    evalIntInfixNode(int, shared_ptr<Object>, shared_ptr<Object>, shared_ptr<Environment>);
 shared_ptr<Object> evalLoop(shared_ptr<Loop>);
+shared_ptr<Object> evalLoopCondition(shared_ptr<Loop>);
 shared_ptr<Object> evalMinusOperatorExpression(shared_ptr<Object>, shared_ptr<Environment>);
 shared_ptr<Object> evalNode(shared_ptr<Node>, shared_ptr<Environment>);
+shared_ptr<Object> evalParallelFor(
+    long long, long long, long long, const vector<Symbol>&, const vector<string>&, const vector<Symbol>&,
+    const Closure&, shared_ptr<Environment>
+);
+vector<Symbol> loopVariables(shared_ptr<ForExpression>);
+shared_ptr<Object> evalParallelLoop(shared_ptr<ForExpression>, shared_ptr<Loop>);
 shared_ptr<Object> evalPostfixExpression(string, shared_ptr<Object>, shared_ptr<Environment>);
 shared_ptr<Object> evalPrefixExpression(string, shared_ptr<Object>, shared_ptr<Environment>);
 shared_ptr<Object> evalStatements(shared_ptr<Statement>, shared_ptr<Environment>);
+shared_ptr<Object> evalSliceExpression(
+    shared_ptr<Object>, shared_ptr<Object>, shared_ptr<Object>, shared_ptr<Object>, shared_ptr<Environment>
+);
 shared_ptr<Object>
     evalStringIndexExpression(shared_ptr<Object>, shared_ptr<Object>, shared_ptr<Environment>);
 shared_ptr<Object>
     evalStringInfixExpression(string, shared_ptr<Object>, shared_ptr<Object>, shared_ptr<Environment>);
-shared_ptr<Environment> extendFunction(shared_ptr<Function>, vector<shared_ptr<Object>>);
+bool evalUnboxedBool(const shared_ptr<Expression>&, const shared_ptr<Environment>&);
+shared_ptr<Object> evalUnboxedExpression(shared_ptr<Expression>, shared_ptr<Environment>);
+double evalUnboxedFloat(const shared_ptr<Expression>&, const shared_ptr<Environment>&);
+int evalUnboxedInt(const shared_ptr<Expression>&, const shared_ptr<Environment>&);
+shared_ptr<Environment> extendFunction(shared_ptr<Function>, const vector<shared_ptr<Object>>&);
 size_t hashKey(shared_ptr<Integer>);
 size_t hashKey(shared_ptr<Boolean>);
 size_t hashKey(shared_ptr<String>);
 bool isError(shared_ptr<Object>);
+bool isNumeric(shared_ptr<Object>);
 bool isTruthy(shared_ptr<Object>);
 shared_ptr<Boolean> nativeToBoolean(bool);
+bool objectsEqual(const shared_ptr<Object>&, const shared_ptr<Object>&);
+shared_ptr<Object> parallelChunks(
+    size_t, shared_ptr<Environment>, const function<shared_ptr<Object>(size_t, size_t, shared_ptr<Environment>)>&
+);
+void quickenCallExpression(shared_ptr<CallExpression>, shared_ptr<Object>);
+void quickenInfixExpression(shared_ptr<InfixExpression>, shared_ptr<Object>, shared_ptr<Object>);
+double numericValue(shared_ptr<Object>);
 shared_ptr<Object> newError(string);
+shared_ptr<Object>
+    setHashPair(shared_ptr<Hash>, shared_ptr<Object>, shared_ptr<Object>, shared_ptr<Environment>);
+shared_ptr<Object>
+    sliceBounds(shared_ptr<Object>, shared_ptr<Object>, shared_ptr<Object>, size_t, long&, size_t&, long&);
+void shareEnvironment(shared_ptr<Environment>);
+shared_ptr<Object> spawnTask(shared_ptr<Object>, vector<shared_ptr<Object>>);
+shared_ptr<Object> awaitTask(shared_ptr<Task>, shared_ptr<Environment>);
+shared_ptr<Object> evalAwait(shared_ptr<Object>, shared_ptr<Environment>);
+void waitForTasks();
+shared_ptr<Object> stringConstant(Symbol);
+shared_ptr<Object> literalConstant(StringLiteral*);
+shared_ptr<Object> stringView(shared_ptr<String>, size_t, size_t, shared_ptr<Environment>);
 shared_ptr<Object> unpackLoopBody(shared_ptr<Loop>);
 shared_ptr<Object> unwrapReturnValue(shared_ptr<Object>);
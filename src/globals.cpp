@@ -0,0 +1,11 @@
+#include "globals.hpp"
+
+stack<pair<string, int>> HISTORY;
+stack<pair<string, int>> MEMORY;
+WINDOW* PAD = nullptr;
+int PADPOS{0};
+int PADHEIGHT = 10000;
+unsigned int CURSOR_X{4}, CURSOR_Y{0};
+unsigned int MIN_X{4}, MAXLINE_X{1};
+int WIN_HEIGHT{}, WIN_WIDTH{};
+int INDENT_LEVEL{0}, INDENT_SPACES{4};
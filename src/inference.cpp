@@ -0,0 +1,465 @@
+#include "inference.hpp"
+
+#include "builtins.hpp"
+#include "evaluator.hpp"
+
+using namespace std;
+
+// binding of a name whose datatype is not known statically
+const int UNTYPED = -2;
+
+static bool isLiteral(shared_ptr<Expression> expr) {
+    switch (expr->type) {
+        case booleanExpression:
+        case floatLiteral:
+        case integerLiteral:
+        case stringLiteral:  return true;
+        default:             return false;
+    }
+}
+
+TypeInference::TypeInference(vector<string>* errors) { this->errors = errors; }
+
+void TypeInference::inferProgram(vector<shared_ptr<Statement>>& program) {
+    unordered_map<string, int> names{};
+    for (auto stmt : program)
+        this->collectBindings(stmt, names, true);
+    for (auto name : names)
+        if (name.second != UNTYPED && builtins.find(name.first) == builtins.end())
+            this->signatures[name.first] = name.second;
+
+    this->inferFrame(program, {}, -1);
+}
+
+void TypeInference::bind(unordered_map<string, int>& names, string name, int datatype) {
+    auto found = names.find(name);
+    if (found == names.end()) names[name] = datatype;
+    else if (found->second != datatype) found->second = UNTYPED;
+}
+
+void TypeInference::collectBindings(shared_ptr<Node> node, unordered_map<string, int>& names, bool program) {
+    // Records the datatype of every binding made in a frame. Nested functions
+    // bind their parameters and locals in their own frame, so only their name
+    // counts, unless the whole program is collected to find the signatures of
+    // typed functions: then any other binding of a name makes it untyped.
+    if (node == nullptr) return;
+    if (node->nodetype == statement) {
+        shared_ptr<Statement> stmt = static_pointer_cast<Statement>(node);
+        switch (stmt->type) {
+            case assignmentExpressionStatement:
+                this->collectBindings(static_pointer_cast<AssignmentExpressionStatement>(stmt)->value, names, program);
+                return;
+            case blockStatement:
+                for (auto s : static_pointer_cast<BlockStatement>(stmt)->statements)
+                    this->collectBindings(s, names, program);
+                return;
+            case expressionStatement:
+                this->collectBindings(static_pointer_cast<ExpressionStatement>(stmt)->expression, names, program);
+                return;
+            case functionStatement: {
+                shared_ptr<FunctionStatement> fs = static_pointer_cast<FunctionStatement>(stmt);
+                this->bind(names, fs->name->value, program && fs->datatype != -1 ? fs->datatype : UNTYPED);
+                if (!program) return;
+                for (auto param : fs->parameters)
+                    this->bind(names, param->value, UNTYPED);
+                this->collectBindings(fs->body, names, program);
+                return;
+            }
+            case identifierStatement: {
+                shared_ptr<IdentifierStatement> is = static_pointer_cast<IdentifierStatement>(stmt);
+                this->bind(names, is->name->value, program ? UNTYPED : is->datatype);
+                this->collectBindings(is->value, names, program);
+                return;
+            }
+            case letStatement: {
+                shared_ptr<LetStatement> ls = static_pointer_cast<LetStatement>(stmt);
+                this->bind(names, ls->name->value, UNTYPED);
+                this->collectBindings(ls->value, names, program);
+                return;
+            }
+            case returnStatement:
+                this->collectBindings(static_pointer_cast<ReturnStatement>(stmt)->returnValue, names, program);
+                return;
+        }
+        return;
+    }
+
+    shared_ptr<Expression> expr = static_pointer_cast<Expression>(node);
+    switch (expr->type) {
+        case arrayLiteral:
+            for (auto element : static_pointer_cast<ArrayLiteral>(expr)->elements)
+                this->collectBindings(element, names, program);
+            return;
+        case callExpression:
+        case builtinCallExpression:
+        case functionCallExpression: {
+            shared_ptr<CallExpression> ce = static_pointer_cast<CallExpression>(expr);
+            this->collectBindings(ce->_function, names, program);
+            for (auto arg : ce->arguments)
+                this->collectBindings(arg, names, program);
+            return;
+        }
+        case doExpression: {
+            shared_ptr<DoExpression> de = static_pointer_cast<DoExpression>(expr);
+            this->collectBindings(de->body, names, program);
+            this->collectBindings(de->condition, names, program);
+            return;
+        }
+        case forExpression: {
+            shared_ptr<ForExpression> fe = static_pointer_cast<ForExpression>(expr);
+            this->collectBindings(fe->start, names, program);
+            this->collectBindings(fe->end, names, program);
+            this->collectBindings(fe->increment, names, program);
+            this->collectBindings(fe->iterable, names, program);
+            // elements and lines can be of any type
+            bool counted = fe->iterable == nullptr && !program;
+            for (auto var : fe->statements)
+                this->bind(names, static_pointer_cast<LetStatement>(var)->name->value, counted ? INT : UNTYPED);
+            this->collectBindings(fe->body, names, program);
+            return;
+        }
+        case functionLiteral: {
+            shared_ptr<FunctionLiteral> fl = static_pointer_cast<FunctionLiteral>(expr);
+            if (fl->name != nullptr) this->bind(names, fl->name->value, UNTYPED);
+            if (!program) return;
+            for (auto param : fl->parameters)
+                this->bind(names, param->value, UNTYPED);
+            this->collectBindings(fl->body, names, program);
+            return;
+        }
+        case hashLiteral:
+            for (auto el : static_pointer_cast<HashLiteral>(expr)->pairs) {
+                this->collectBindings(el.first, names, program);
+                this->collectBindings(el.second, names, program);
+            }
+            return;
+        case ifExpression: {
+            shared_ptr<IfExpression> ie = static_pointer_cast<IfExpression>(expr);
+            this->collectBindings(ie->condition, names, program);
+            this->collectBindings(ie->consequence, names, program);
+            for (auto cond : ie->conditions)
+                this->collectBindings(cond, names, program);
+            for (auto alt : ie->alternatives)
+                this->collectBindings(alt, names, program);
+            this->collectBindings(ie->alternative, names, program);
+            return;
+        }
+        case indexExpression: {
+            shared_ptr<IndexExpression> ie = static_pointer_cast<IndexExpression>(expr);
+            this->collectBindings(ie->_left, names, program);
+            this->collectBindings(ie->index, names, program);
+            return;
+        }
+        case sliceExpression: {
+            shared_ptr<SliceExpression> se = static_pointer_cast<SliceExpression>(expr);
+            this->collectBindings(se->_left, names, program);
+            this->collectBindings(se->start, names, program);
+            this->collectBindings(se->end, names, program);
+            this->collectBindings(se->step, names, program);
+            return;
+        }
+        case spawnExpression:
+            this->collectBindings(static_pointer_cast<SpawnExpression>(expr)->call, names, program);
+            return;
+        case awaitExpression:
+            this->collectBindings(static_pointer_cast<AwaitExpression>(expr)->value, names, program);
+            return;
+        case infixExpression:
+        case intAddExpression:
+        case intSubExpression:
+        case intMulExpression:
+        case intDivExpression:
+        case intLessExpression:
+        case intGreaterExpression:
+        case intEqualExpression:
+        case intNotEqualExpression:
+        case floatAddExpression:
+        case floatSubExpression:
+        case floatMulExpression:
+        case floatDivExpression:
+        case floatLessExpression:
+        case floatGreaterExpression:
+        case floatEqualExpression:
+        case floatNotEqualExpression: {
+            shared_ptr<InfixExpression> ie = static_pointer_cast<InfixExpression>(expr);
+            this->collectBindings(ie->_left, names, program);
+            this->collectBindings(ie->_right, names, program);
+            return;
+        }
+        case postfixExpression:
+            this->collectBindings(static_pointer_cast<PostfixExpression>(expr)->_left, names, program);
+            return;
+        case prefixExpression:
+            this->collectBindings(static_pointer_cast<PrefixExpression>(expr)->_right, names, program);
+            return;
+        case whileExpression: {
+            shared_ptr<WhileExpression> we = static_pointer_cast<WhileExpression>(expr);
+            this->collectBindings(we->condition, names, program);
+            this->collectBindings(we->body, names, program);
+            return;
+        }
+        default: return;
+    }
+}
+
+int TypeInference::inferExpression(shared_ptr<Expression> expr) {
+    if (expr == nullptr) return -1;
+    switch (expr->type) {
+        case arrayLiteral:
+            for (auto element : static_pointer_cast<ArrayLiteral>(expr)->elements)
+                this->inferExpression(element);
+            return -1;
+        case booleanExpression:
+        case floatLiteral:
+        case integerLiteral:
+        case stringLiteral: return expr->datatype;
+        case callExpression:
+        case builtinCallExpression:
+        case functionCallExpression: {
+            shared_ptr<CallExpression> ce = static_pointer_cast<CallExpression>(expr);
+            this->inferExpression(ce->_function);
+            for (auto arg : ce->arguments)
+                this->inferExpression(arg);
+            if (ce->_function->type != identifier) return -1;
+            // a local binding of the same name would shadow the function
+            string name = static_pointer_cast<IdentifierLiteral>(ce->_function)->value;
+            auto found  = this->signatures.find(name);
+            if (found == this->signatures.end() || this->bindings.find(name) != this->bindings.end()) return -1;
+            ce->datatype = found->second;
+            return ce->datatype;
+        }
+        case doExpression: {
+            shared_ptr<DoExpression> de = static_pointer_cast<DoExpression>(expr);
+            this->inferStatement(de->body);
+            this->inferExpression(de->condition);
+            return -1;
+        }
+        case forExpression: {
+            shared_ptr<ForExpression> fe = static_pointer_cast<ForExpression>(expr);
+            this->inferExpression(fe->start);
+            this->inferExpression(fe->end);
+            this->inferExpression(fe->increment);
+            this->inferExpression(fe->iterable);
+            // the counters are bound to Integers before the body first runs
+            unordered_map<string, int> outer = this->scope;
+            for (auto var : fe->statements) {
+                string name = static_pointer_cast<LetStatement>(var)->name->value;
+                if (this->bindings[name] == INT) this->scope[name] = INT;
+            }
+            this->inferStatement(fe->body);
+            this->scope = outer;
+            return -1;
+        }
+        case functionLiteral: {
+            shared_ptr<FunctionLiteral> fl = static_pointer_cast<FunctionLiteral>(expr);
+            this->inferFrame(fl->body->statements, fl->parameters, -1);
+            return -1;
+        }
+        case hashLiteral:
+            for (auto el : static_pointer_cast<HashLiteral>(expr)->pairs) {
+                this->inferExpression(el.first);
+                this->inferExpression(el.second);
+            }
+            return -1;
+        case identifier: {
+            auto found = this->scope.find(static_pointer_cast<IdentifierLiteral>(expr)->value);
+            if (found == this->scope.end()) return -1;
+            expr->datatype = found->second;
+            return expr->datatype;
+        }
+        case ifExpression: {
+            shared_ptr<IfExpression> ie = static_pointer_cast<IfExpression>(expr);
+            this->inferExpression(ie->condition);
+            this->inferStatement(ie->consequence);
+            for (auto cond : ie->conditions)
+                this->inferExpression(cond);
+            for (auto alt : ie->alternatives)
+                this->inferStatement(alt);
+            if (ie->alternative != nullptr) this->inferStatement(ie->alternative);
+            return -1;
+        }
+        case indexExpression: {
+            shared_ptr<IndexExpression> ie = static_pointer_cast<IndexExpression>(expr);
+            this->inferExpression(ie->_left);
+            this->inferExpression(ie->index);
+            return -1;
+        }
+        case sliceExpression: {
+            shared_ptr<SliceExpression> se = static_pointer_cast<SliceExpression>(expr);
+            this->inferExpression(se->_left);
+            this->inferExpression(se->start);
+            this->inferExpression(se->end);
+            this->inferExpression(se->step);
+            return -1;
+        }
+        case spawnExpression:
+            this->inferExpression(static_pointer_cast<SpawnExpression>(expr)->call);
+            return -1;
+        case awaitExpression:
+            this->inferExpression(static_pointer_cast<AwaitExpression>(expr)->value);
+            return -1;
+        case infixExpression:
+        case intAddExpression:
+        case intSubExpression:
+        case intMulExpression:
+        case intDivExpression:
+        case intLessExpression:
+        case intGreaterExpression:
+        case intEqualExpression:
+        case intNotEqualExpression:
+        case floatAddExpression:
+        case floatSubExpression:
+        case floatMulExpression:
+        case floatDivExpression:
+        case floatLessExpression:
+        case floatGreaterExpression:
+        case floatEqualExpression:
+        case floatNotEqualExpression: return this->inferInfix(static_pointer_cast<InfixExpression>(expr));
+        case postfixExpression: {
+            shared_ptr<PostfixExpression> p = static_pointer_cast<PostfixExpression>(expr);
+            if (this->inferExpression(p->_left) == INT) p->datatype = INT;
+            return p->datatype;
+        }
+        case prefixExpression: {
+            shared_ptr<PrefixExpression> p = static_pointer_cast<PrefixExpression>(expr);
+            int right                      = this->inferExpression(p->_right);
+            if (p->_operator == "-" && (right == INT || right == FLOAT)) p->datatype = right;
+            // any operand is either truthy or not
+            else if (p->_operator == "!") p->datatype = BOOLEAN;
+            else return -1;
+            p->unboxed = (p->_operator == "-" || right == BOOLEAN) && infallible(p->_right);
+            return p->datatype;
+        }
+        case whileExpression: {
+            shared_ptr<WhileExpression> we = static_pointer_cast<WhileExpression>(expr);
+            this->inferExpression(we->condition);
+            this->inferStatement(we->body);
+            return -1;
+        }
+        default: return -1;
+    }
+}
+
+void TypeInference::inferFrame(
+    const vector<shared_ptr<Statement>>& statements, const vector<shared_ptr<IdentifierLiteral>>& params,
+    int returnType
+) {
+    unordered_map<string, int> outerBindings = this->bindings, outerScope = this->scope;
+    int outerReturnType                      = this->returnType;
+    this->bindings.clear();
+    this->scope.clear();
+    this->returnType = returnType;
+
+    for (auto stmt : statements)
+        this->collectBindings(stmt, this->bindings, false);
+    for (auto param : params)
+        this->bind(this->bindings, param->value, UNTYPED);
+    // builtins shadow every binding of the same name
+    for (auto& binding : this->bindings)
+        if (builtins.find(binding.first) != builtins.end()) binding.second = UNTYPED;
+
+    for (auto stmt : statements) {
+        this->inferStatement(stmt);
+        if (stmt->type != identifierStatement) continue;
+        // once a frame-level declaration that cannot fail has run, the name
+        // holds a value of its datatype for the rest of the frame
+        shared_ptr<IdentifierStatement> is = static_pointer_cast<IdentifierStatement>(stmt);
+        string name                        = is->name->value;
+        if (this->bindings[name] == is->datatype && infallible(is->value) &&
+            assignable(is->datatype, is->value->datatype))
+            this->scope[name] = is->datatype;
+    }
+
+    this->bindings   = outerBindings;
+    this->scope      = outerScope;
+    this->returnType = outerReturnType;
+}
+
+int TypeInference::inferInfix(shared_ptr<InfixExpression> ie) {
+    int left  = this->inferExpression(ie->_left);
+    int right = this->inferExpression(ie->_right);
+    string op = ie->_operator;
+
+    bool numeric = (left == INT || left == FLOAT) && (right == INT || right == FLOAT);
+    if (numeric) {
+        // an Integer mixed with a Float is promoted to double
+        int datatype                                       = left == INT && right == INT ? INT : FLOAT;
+        const unordered_map<string, ExpressionType>& nodes = datatype == INT ? intInfixNodes : floatInfixNodes;
+        auto node                                          = nodes.find(op);
+        if (node == nodes.end()) return -1;
+        ie->type     = node->second;
+        ie->datatype = op == "+" || op == "-" || op == "*" || op == "/" ? datatype : BOOLEAN;
+    } else if (left == BOOLEAN && right == BOOLEAN && (op == "==" || op == "!=")) ie->datatype = BOOLEAN;
+    else if (left == STRING && right == STRING && op == "+") {
+        ie->datatype = STRING;
+        return ie->datatype;
+    } else return -1;
+
+    ie->unboxed = infallible(ie->_left) && infallible(ie->_right);
+    return ie->datatype;
+}
+
+void TypeInference::inferStatement(shared_ptr<Statement> stmt) {
+    switch (stmt->type) {
+        case assignmentExpressionStatement: {
+            shared_ptr<AssignmentExpressionStatement> ae = static_pointer_cast<AssignmentExpressionStatement>(stmt);
+            int value                                    = this->inferExpression(ae->value);
+            auto found                                   = this->scope.find(ae->name->value);
+            // a numeric target updated by a value that cannot fail is done unboxed
+            if (found != this->scope.end() && (found->second == INT || found->second == FLOAT) &&
+                assignable(found->second, value) && infallible(ae->value))
+                ae->datatype = found->second;
+            return;
+        }
+        case blockStatement:
+            for (auto s : static_pointer_cast<BlockStatement>(stmt)->statements)
+                this->inferStatement(s);
+            return;
+        case expressionStatement:
+            this->inferExpression(static_pointer_cast<ExpressionStatement>(stmt)->expression);
+            return;
+        case functionStatement: {
+            shared_ptr<FunctionStatement> fs = static_pointer_cast<FunctionStatement>(stmt);
+            this->inferFrame(fs->body->statements, fs->parameters, fs->datatype);
+            return;
+        }
+        case identifierStatement: {
+            shared_ptr<IdentifierStatement> is = static_pointer_cast<IdentifierStatement>(stmt);
+            int value                          = this->inferExpression(is->value);
+            // literal values were already checked by the parser
+            if (value == -1 || isLiteral(is->value) || is->datatype == VOID || assignable(is->datatype, value))
+                return;
+            ostringstream ss;
+            ss << "Mismatched DataType: " << DatatypeMap.at(value)
+               << " is not equal to: " << DatatypeMap.at(is->datatype) << '\n';
+            this->errors->push_back(ss.str());
+            return;
+        }
+        case letStatement: this->inferExpression(static_pointer_cast<LetStatement>(stmt)->value); return;
+        case returnStatement: {
+            shared_ptr<ReturnStatement> rs = static_pointer_cast<ReturnStatement>(stmt);
+            int value                      = this->inferExpression(rs->returnValue);
+            if (this->returnType == -1 || value == -1 || isLiteral(rs->returnValue) || value == this->returnType)
+                return;
+            this->errors->push_back("Function return value DataType mismatch.\n");
+            return;
+        }
+    }
+}
+
+bool assignable(int declared, int inferred) {
+    // an Integer is promoted when it is stored in a Float
+    return inferred == declared || (declared == FLOAT && inferred == INT);
+}
+
+bool infallible(shared_ptr<Expression> expr) {
+    // evaluating these can neither fail nor yield another type than inferred
+    if (expr == nullptr) return false;
+    if (isLiteral(expr) || expr->unboxed) return true;
+    return expr->type == identifier && expr->datatype != -1;
+}
+
+void inferTypes(vector<shared_ptr<Statement>>& program, vector<string>& errors) {
+    TypeInference inference(&errors);
+    inference.inferProgram(program);
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include "ast.hpp"
+
+#include <unordered_map>
+
+using namespace std;
+
+// Static type inference, run once over a parsed program. Declared datatypes
+// (typed declarations, for-loop counters and function return types) and
+// literal types are propagated through expressions: identifiers, infix,
+// prefix, postfix and call nodes whose type is known get their datatype set,
+// and numeric/boolean subtrees made only of such nodes are marked unboxed so
+// the evaluator runs them on native values without per-operation type checks.
+// Mismatches found on the way are reported like parser errors.
+//
+// A variable is only typed within one function body (its frame), and only if
+// every binding of it in that frame agrees on the datatype. Typed reads must
+// follow a frame-level declaration that cannot fail, or sit inside the for-loop
+// that binds them, so the value they read is always there and of that type.
+
+class TypeInference {
+  public:
+    TypeInference(vector<string>*);
+    ~TypeInference() = default;
+
+    void inferProgram(vector<shared_ptr<Statement>>&);
+
+  private:
+    vector<string>* errors;
+    // typed function statements whose name is bound nowhere else in the program
+    unordered_map<string, int> signatures{};
+    // datatype every binding of a name in the current frame agrees on, or -2
+    unordered_map<string, int> bindings{};
+    // typed names readable at the current point of the frame
+    unordered_map<string, int> scope{};
+    int returnType{-1};
+
+    void bind(unordered_map<string, int>&, string, int);
+    void collectBindings(shared_ptr<Node>, unordered_map<string, int>&, bool);
+    int inferExpression(shared_ptr<Expression>);
+    void inferFrame(const vector<shared_ptr<Statement>>&, const vector<shared_ptr<IdentifierLiteral>>&, int);
+    int inferInfix(shared_ptr<InfixExpression>);
+    void inferStatement(shared_ptr<Statement>);
+};
+
+bool assignable(int, int);
+bool infallible(shared_ptr<Expression>);
+void inferTypes(vector<shared_ptr<Statement>>&, vector<string>&);
@@ -0,0 +1,322 @@
+#include "io.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+using namespace std;
+
+// submission slots; completions get twice as many, so the kernel never drops one
+const unsigned RING_ENTRIES = 256;
+const size_t IO_THREADS     = 4;
+// how much of a file whose size stat() does not know is read at a time
+const size_t READ_CHUNK = 64 << 10;
+// the smallest block a LineReader reads into
+const size_t LINE_BLOCK = 1 << 20;
+
+IoLoop::IoLoop() {
+    if (this->setupRing()) this->reaper = thread([this]() { this->reap(); });
+    else this->failOver();
+}
+
+IoLoop& IoLoop::shared() {
+    static IoLoop* loop = new IoLoop();
+    return *loop;
+}
+
+// the raw system calls, so there is no dependency on liburing
+bool IoLoop::setupRing() {
+    io_uring_params params{};
+    int fd = syscall(__NR_io_uring_setup, RING_ENTRIES, &params);
+    if (fd < 0) return false;
+
+    size_t sqSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    size_t cqSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    bool single   = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (single) sqSize = cqSize = max(sqSize, cqSize);
+    void* sq = mmap(nullptr, sqSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    void* cq = sq;
+    if (!single) cq = mmap(nullptr, cqSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+    void* sqes = mmap(
+        nullptr, params.sq_entries * sizeof(io_uring_sqe), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd,
+        IORING_OFF_SQES
+    );
+    if (sq == MAP_FAILED || cq == MAP_FAILED || sqes == MAP_FAILED) {
+        close(fd);
+        return false;
+    }
+
+    char* sqBase   = (char*)sq;
+    char* cqBase   = (char*)cq;
+    this->ring     = fd;
+    this->entries  = params.sq_entries;
+    this->sqTail   = (unsigned*)(sqBase + params.sq_off.tail);
+    this->sqMask   = (unsigned*)(sqBase + params.sq_off.ring_mask);
+    this->sqArray  = (unsigned*)(sqBase + params.sq_off.array);
+    this->sqes     = (io_uring_sqe*)sqes;
+    this->cqHead   = (unsigned*)(cqBase + params.cq_off.head);
+    this->cqTail   = (unsigned*)(cqBase + params.cq_off.tail);
+    this->cqMask   = (unsigned*)(cqBase + params.cq_off.ring_mask);
+    this->cqes     = (io_uring_cqe*)(cqBase + params.cq_off.cqes);
+    return true;
+}
+
+ssize_t IoLoop::run(IoRequest& request) {
+    if (this->ringFailed || !this->submit(request)) {
+        {
+            lock_guard<mutex> guard(this->lock);
+            this->queue.push_back(&request);
+        }
+        this->pending.notify_one();
+    }
+    request.done.wait();
+    return request.result;
+}
+
+bool IoLoop::submit(IoRequest& request) {
+    bool taken = false;
+    this->slots.until([this, &taken]() {
+        if (this->ringFailed) return true;
+        unsigned used = this->inFlight.load();
+        while (used < this->entries)
+            if (this->inFlight.compare_exchange_weak(used, used + 1)) return taken = true;
+        return false;
+    });
+    if (!taken) return false;
+
+    lock_guard<mutex> guard(this->submitting);
+    if (this->ringFailed) {
+        this->inFlight--;
+        return false;
+    }
+    unsigned tail     = *this->sqTail;
+    unsigned index    = tail & *this->sqMask;
+    io_uring_sqe& sqe = this->sqes[index];
+    memset(&sqe, 0, sizeof(sqe));
+    sqe.opcode            = request.write ? IORING_OP_WRITEV : IORING_OP_READV;
+    sqe.fd                = request.fd;
+    sqe.addr              = (uintptr_t)&request.buffer;
+    sqe.len               = 1;
+    sqe.off               = request.offset;
+    sqe.user_data         = (uintptr_t)&request;
+    this->sqArray[index]  = index;
+    __atomic_store_n(this->sqTail, tail + 1, __ATOMIC_RELEASE);
+    long entered;
+    do entered = syscall(__NR_io_uring_enter, this->ring, 1, 0, 0, nullptr, 0);
+    while (entered < 0 && (errno == EINTR || errno == EAGAIN));
+    if (entered >= 0) return true;
+    // The kernel fails the call before it takes the entry, and the ring is
+    // never entered to submit again, so the entry is left unread; the request
+    // goes to the blocking threads with every one after it.
+    this->inFlight--;
+    this->failOver();
+    return false;
+}
+
+void IoLoop::failOver() {
+    this->ringFailed = true;
+    call_once(this->fallback, [this]() {
+        for (size_t i = 0; i < IO_THREADS; i++)
+            this->workers.emplace_back([this]() { this->work(); });
+    });
+    // callers waiting for a slot see the ring has failed and go there too
+    this->slots.notifyAll();
+}
+
+void IoLoop::reap() {
+    bool entering = true;
+    while (true) {
+        if (entering) {
+            long waited = syscall(__NR_io_uring_enter, this->ring, 0, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+            // completions still arrive without the call, so those in flight
+            // are polled for while new requests go to the blocking threads
+            if (waited < 0 && errno != EINTR) {
+                entering = false;
+                this->failOver();
+            }
+        } else {
+            if (this->inFlight == 0) return;
+            this_thread::sleep_for(chrono::milliseconds(1));
+        }
+        unsigned head = *this->cqHead;
+        while (head != __atomic_load_n(this->cqTail, __ATOMIC_ACQUIRE)) {
+            io_uring_cqe& cqe   = this->cqes[head & *this->cqMask];
+            IoRequest* request  = (IoRequest*)(uintptr_t)cqe.user_data;
+            request->result     = cqe.res;
+            __atomic_store_n(this->cqHead, ++head, __ATOMIC_RELEASE);
+            this->inFlight--;
+            // the request may be gone as soon as it is done
+            request->done.set();
+            this->slots.notifyOne();
+        }
+    }
+}
+
+void IoLoop::work() {
+    while (true) {
+        IoRequest* request;
+        {
+            unique_lock<mutex> guard(this->lock);
+            this->pending.wait(guard, [this]() { return !this->queue.empty(); });
+            request = this->queue.front();
+            this->queue.pop_front();
+        }
+        ssize_t done =
+            request->write ? pwritev(request->fd, &request->buffer, 1, request->offset)
+                           : preadv(request->fd, &request->buffer, 1, request->offset);
+        request->result = done < 0 ? -errno : done;
+        request->done.set();
+    }
+}
+
+int readFile(const string& path, string& contents) {
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return errno;
+    struct stat info;
+    // one byte over the size, so the read that finds the end needs no more room
+    size_t capacity = fstat(fd, &info) == 0 && info.st_size > 0 ? info.st_size + 1 : READ_CHUNK;
+
+    // a file can grow while it is read, so this goes on until a read comes back empty
+    contents.resize(capacity);
+    size_t length = 0;
+    int error     = 0;
+    while (true) {
+        if (length == contents.size()) contents.resize(contents.size() * 2);
+        IoRequest request{};
+        request.fd         = fd;
+        request.buffer     = {&contents[length], contents.size() - length};
+        request.offset     = length;
+        ssize_t read       = IoLoop::shared().run(request);
+        if (read < 0) {
+            error = -read;
+            break;
+        }
+        if (read == 0) break;
+        length += read;
+    }
+    close(fd);
+    contents.resize(length);
+    return error;
+}
+
+int writeFile(const string& path, const string& contents) {
+    int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) return errno;
+    size_t written = 0;
+    int error      = 0;
+    while (written < contents.size()) {
+        IoRequest request{};
+        request.write      = true;
+        request.fd         = fd;
+        request.buffer     = {(void*)(contents.data() + written), contents.size() - written};
+        request.offset     = written;
+        ssize_t wrote      = IoLoop::shared().run(request);
+        if (wrote < 0) {
+            error = -wrote;
+            break;
+        }
+        written += wrote;
+    }
+    if (close(fd) != 0 && error == 0) error = errno;
+    return error;
+}
+
+int mapFile(const string& path, shared_ptr<const string_view>& contents) {
+    // unmapped once the last view of it is gone
+    struct Mapping {
+        ~Mapping() {
+            if (this->data != nullptr) munmap(this->data, this->view.size());
+        }
+        void* data{nullptr};
+        string_view view{};
+    };
+
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return errno;
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        int error = errno;
+        close(fd);
+        return error;
+    }
+    shared_ptr<Mapping> mapping = make_shared<Mapping>();
+    // mmap refuses an empty mapping, and an empty file needs none
+    if (info.st_size > 0) {
+        void* data = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED) {
+            int error = errno;
+            close(fd);
+            return error;
+        }
+        // files are mostly read front to back, so the kernel can read well ahead
+        madvise(data, info.st_size, MADV_SEQUENTIAL);
+        mapping->data = data;
+        mapping->view = string_view((const char*)data, info.st_size);
+    }
+    close(fd);
+    contents = shared_ptr<const string_view>(mapping, &mapping->view);
+    return 0;
+}
+
+LineReader::LineReader(int fd) { this->fd = fd; }
+
+bool LineReader::next(shared_ptr<const string_view>& block, size_t& offset, size_t& length) {
+    while (true) {
+        if (this->block != nullptr && this->searched < this->filled) {
+            const char* data    = this->block->data();
+            const char* newline = (const char*)memchr(data + this->searched, '\n', this->filled - this->searched);
+            if (newline != nullptr) {
+                block           = this->block;
+                offset          = this->lineStart;
+                length          = newline - data - this->lineStart;
+                this->lineStart = this->searched = offset + length + 1;
+                return true;
+            }
+            this->searched = this->filled;
+        }
+        if (this->ended) {
+            // the last line need not end with a newline
+            if (this->lineStart == this->filled) return false;
+            block           = this->block;
+            offset          = this->lineStart;
+            length          = this->filled - this->lineStart;
+            this->lineStart = this->filled;
+            return true;
+        }
+        this->fill();
+    }
+}
+
+void LineReader::fill() {
+    // a block's characters are never freed or moved while views of it are around
+    struct Block {
+        unique_ptr<char[]> data;
+        string_view view;
+    };
+
+    if (this->block == nullptr || this->filled == this->block->size()) {
+        size_t pending         = this->filled - this->lineStart;
+        size_t capacity        = max(LINE_BLOCK, pending * 2);
+        shared_ptr<Block> next = make_shared<Block>();
+        next->data.reset(new char[capacity]);
+        next->view = string_view(next->data.get(), capacity);
+        if (pending > 0) memcpy(next->data.get(), this->block->data() + this->lineStart, pending);
+        this->block = shared_ptr<const string_view>(next, &next->view);
+        this->searched -= this->lineStart;
+        this->filled    = pending;
+        this->lineStart = 0;
+    }
+
+    // views only reach up to filled, so the rest of the block is free to read into
+    ssize_t got;
+    do got = read(this->fd, (char*)this->block->data() + this->filled, this->block->size() - this->filled);
+    while (got < 0 && errno == EINTR);
+    if (got < 0) this->error = errno;
+    if (got <= 0) this->ended = true;
+    else this->filled += got;
+}
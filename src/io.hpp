@@ -0,0 +1,104 @@
+#pragma once
+#include "threads.hpp"
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include <sys/uio.h>
+
+using namespace std;
+
+// File I/O that parks the calling task instead of blocking its thread, so one
+// worker can keep hundreds of reads in flight. Requests go to the kernel
+// through an io_uring, and a thread of its own reaps their completions and
+// wakes the tasks waiting on them. Where io_uring is unavailable (an old
+// kernel, or a seccomp policy that forbids it) they are run by a few blocking
+// I/O threads instead, as are all requests after the ring fails. Opening and
+// closing files stays synchronous.
+
+// reads the whole file at path; returns 0 or an errno value
+int readFile(const string&, string&);
+// replaces the file at path with contents; returns 0 or an errno value
+int writeFile(const string&, const string&);
+// maps the file at path into memory, read-only; the mapping goes with the last
+// copy of contents. Returns 0 or an errno value
+int mapFile(const string&, shared_ptr<const string_view>&);
+
+// Reads a stream (a pipe, say) in large blocks and hands out its lines, each
+// as a view of the block it sits in. A block is only replaced once it is
+// full, by a new one that starts with the line left unfinished at its end,
+// so views handed out earlier stay valid.
+class LineReader {
+  public:
+    LineReader(int);
+
+    // the next line, without its newline; false once the stream has ended
+    bool next(shared_ptr<const string_view>&, size_t&, size_t&);
+    // 0, or the errno value of a read that failed
+    int error{0};
+
+  private:
+    int fd;
+    shared_ptr<const string_view> block{};
+    size_t filled{0};
+    // where the next line starts, and how far the search for its end has got
+    size_t lineStart{0};
+    size_t searched{0};
+    bool ended{false};
+
+    void fill();
+};
+
+// One read or write at an offset. result is the byte count or -errno.
+typedef struct IoRequest {
+    bool write{false};
+    int fd{-1};
+    iovec buffer{};
+    off_t offset{0};
+    ssize_t result{0};
+    Event done{};
+} IoRequest;
+
+class IoLoop {
+  public:
+    // set up on first use and kept until the program exits
+    static IoLoop& shared();
+
+    // runs request and waits for it to finish
+    ssize_t run(IoRequest&);
+
+  private:
+    IoLoop();
+
+    // the io_uring, when the kernel gave us one
+    int ring{-1};
+    unsigned entries{0};
+    unsigned* sqTail{nullptr};
+    unsigned* sqMask{nullptr};
+    unsigned* sqArray{nullptr};
+    struct io_uring_sqe* sqes{nullptr};
+    unsigned* cqHead{nullptr};
+    unsigned* cqTail{nullptr};
+    unsigned* cqMask{nullptr};
+    struct io_uring_cqe* cqes{nullptr};
+    mutex submitting{};
+    // requests submitted but not reaped, kept below the ring's size
+    atomic<unsigned> inFlight{0};
+    WaitQueue slots{};
+    thread reaper{};
+
+    // the blocking fallback, started when there is no ring or it fails
+    atomic<bool> ringFailed{false};
+    once_flag fallback{};
+    vector<thread> workers{};
+    mutex lock{};
+    condition_variable pending{};
+    deque<IoRequest*> queue{};
+
+    bool setupRing();
+    // false when the ring has failed and the request was not submitted
+    bool submit(IoRequest&);
+    void failOver();
+    void reap();
+    void work();
+};
@@ -0,0 +1,479 @@
+#include "jit.hpp"
+
+#include "builtins.hpp"
+#include "evaluator.hpp"
+#include "threads.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <sys/mman.h>
+#include <unistd.h>
+
+using namespace std;
+
+bool JIT_ENABLED = true;
+
+// x86-64 condition codes, as the second byte of a `0F 8x` near jump
+const uint8_t JMP = 0xE9;
+const uint8_t JE  = 0x84;
+const uint8_t JNE = 0x85;
+const uint8_t JL  = 0x8C;
+const uint8_t JGE = 0x8D;
+const uint8_t JLE = 0x8E;
+
+JitCompiler::JitCompiler(shared_ptr<Function> fn) { this->function = fn; }
+
+shared_ptr<JitCode> JitCompiler::compile() {
+#if defined(__x86_64__) && defined(__linux__)
+    if (this->function->parameters.size() > JIT_MAX_PARAMETERS) return nullptr;
+
+    // push rbp; mov rbp, rsp; sub rsp, <frame>; jmp <init>
+    this->emit({0x55, 0x48, 0x89, 0xE5, 0x48, 0x81, 0xEC});
+    size_t frame = this->code.size();
+    this->emit32(0);
+    size_t init  = this->emitJump(JMP);
+    size_t entry = this->code.size();
+
+    for (auto param : this->function->parameters)
+        if (this->locals.find(param->value) == this->locals.end())
+            this->locals[param->value] = {this->allocateSlot(), this->allocateSlot(), jitInt};
+
+    this->compileBlock(this->function->body);
+    // running off the end returns nothing, which only the interpreter can express
+    this->emitDeoptJump(JMP);
+    if (!this->supported || this->returnType == -1) return nullptr;
+
+    // locals are unassigned on entry; parameters are copied from the args array
+    this->patchJump(init, this->code.size());
+    for (auto local : this->locals) {
+        this->emit({0xC7, 0x85});
+        this->emit32(local.second.flagOffset);
+        this->emit32(0);
+    }
+    for (int i = 0; i < this->function->parameters.size(); i++) {
+        JitLocal param = this->locals[this->function->parameters[i]->value];
+        this->emit({0x8B, 0x87});
+        this->emit32(i * sizeof(int));
+        this->emit({0x89, 0x85});
+        this->emit32(param.offset);
+        this->emit({0xC7, 0x85});
+        this->emit32(param.flagOffset);
+        this->emit32(1);
+    }
+    this->patchJump(this->emitJump(JMP), entry);
+
+    // deoptimization stub: *status = 1; return 0
+    size_t deopt = this->code.size();
+    this->emit({0xC7, 0x06});
+    this->emit32(1);
+    this->emit({0x31, 0xC0, 0xC9, 0xC3});
+    for (size_t jump : this->deoptJumps)
+        this->patchJump(jump, deopt);
+
+    int aligned = (this->frameSize + 15) & ~15;
+    memcpy(&this->code[frame], &aligned, sizeof(aligned));
+
+    return this->install();
+#else
+    return nullptr;
+#endif
+}
+
+int JitCompiler::allocateSlot() {
+    this->frameSize += 8;
+    return -this->frameSize;
+}
+
+void JitCompiler::compileBlock(shared_ptr<BlockStatement> block) {
+    for (auto stmt : block->statements) {
+        if (!this->supported) return;
+        this->compileStatement(stmt);
+    }
+}
+
+int JitCompiler::compileExpression(shared_ptr<Expression> expr) {
+    if (expr == nullptr) {
+        this->supported = false;
+        return -1;
+    }
+    switch (expr->type) {
+        case booleanExpression:
+            this->emit({0xB8});
+            this->emit32(static_pointer_cast<BooleanLiteral>(expr)->value ? 1 : 0);
+            return jitBool;
+        case identifier: return this->loadLocal(static_pointer_cast<IdentifierLiteral>(expr)->value);
+        case infixExpression:
+        case intAddExpression:
+        case intSubExpression:
+        case intMulExpression:
+        case intDivExpression:
+        case intLessExpression:
+        case intGreaterExpression:
+        case intEqualExpression:
+        case intNotEqualExpression: return this->compileInfix(static_pointer_cast<InfixExpression>(expr));
+        case integerLiteral:
+            this->emit({0xB8});
+            this->emit32(static_pointer_cast<IntegerLiteral>(expr)->value);
+            return jitInt;
+        case postfixExpression: {
+            shared_ptr<PostfixExpression> p = static_pointer_cast<PostfixExpression>(expr);
+            if (p->_left->type != identifier) break;
+            string name = static_pointer_cast<IdentifierLiteral>(p->_left)->value;
+            if (this->loadLocal(name) != jitInt) break;
+            if (p->_operator == "++") this->emit({0x83, 0xC0, 0x01});
+            else if (p->_operator == "--") this->emit({0x83, 0xE8, 0x01});
+            else break;
+            this->storeLocal(name, jitInt);
+            return jitInt;
+        }
+        case prefixExpression: {
+            shared_ptr<PrefixExpression> p = static_pointer_cast<PrefixExpression>(expr);
+            int type                       = this->compileExpression(p->_right);
+            if (p->_operator == "-" && type == jitInt) {
+                this->emit({0xF7, 0xD8});
+                return jitInt;
+            }
+            if (p->_operator == "!" && type == jitBool) {
+                this->emit({0x83, 0xF0, 0x01});
+                return jitBool;
+            }
+            break;
+        }
+        default: break;
+    }
+    this->supported = false;
+    return -1;
+}
+
+void JitCompiler::compileFor(shared_ptr<ForExpression> expr) {
+    // pfor iterations are spread over threads, which compiled code does not do
+    if (expr->parallel || expr->iterable != nullptr) {
+        this->supported = false;
+        return;
+    }
+    int counter = this->allocateSlot();
+    int end     = this->allocateSlot();
+    int step    = this->allocateSlot();
+
+    // range bounds are evaluated once and widened so the counter cannot overflow
+    shared_ptr<Expression> bounds[] = {expr->start, expr->end, expr->increment};
+    int slots[]                     = {counter, end, step};
+    for (int i = 0; i < 3; i++) {
+        if (this->compileExpression(bounds[i]) != jitInt) {
+            this->supported = false;
+            return;
+        }
+        if (i == 2) {
+            this->emit({0x85, 0xC0});
+            this->emitDeoptJump(JE);
+        }
+        this->emit({0x48, 0x63, 0xC0, 0x48, 0x89, 0x85});
+        this->emit32(slots[i]);
+    }
+
+    auto bindLoopVariables = [&]() {
+        for (auto stmt : expr->statements) {
+            this->emit({0x8B, 0x85});
+            this->emit32(counter);
+            this->storeLocal(static_pointer_cast<LetStatement>(stmt)->name->value, jitInt);
+        }
+    };
+
+    size_t top = this->code.size();
+    this->emit({0x48, 0x83, 0xBD});
+    this->emit32(step);
+    this->emit({0x00});
+    size_t countDown = this->emitJump(JL);
+    this->emit({0x48, 0x8B, 0x85});
+    this->emit32(counter);
+    this->emit({0x48, 0x3B, 0x85});
+    this->emit32(end);
+    size_t exitUp = this->emitJump(JGE);
+    size_t body   = this->emitJump(JMP);
+    this->patchJump(countDown, this->code.size());
+    this->emit({0x48, 0x8B, 0x85});
+    this->emit32(counter);
+    this->emit({0x48, 0x3B, 0x85});
+    this->emit32(end);
+    size_t exitDown = this->emitJump(JLE);
+
+    this->patchJump(body, this->code.size());
+    bindLoopVariables();
+    this->compileBlock(expr->body);
+    this->emit({0x48, 0x8B, 0x85});
+    this->emit32(counter);
+    this->emit({0x48, 0x03, 0x85});
+    this->emit32(step);
+    this->emit({0x48, 0x89, 0x85});
+    this->emit32(counter);
+    this->patchJump(this->emitJump(JMP), top);
+
+    this->patchJump(exitUp, this->code.size());
+    this->patchJump(exitDown, this->code.size());
+    // the value the loop ends on may not fit an Integer, which the interpreter clamps (see loopValue)
+    // mov rax, [counter]; movsxd rcx, eax; cmp rax, rcx
+    this->emit({0x48, 0x8B, 0x85});
+    this->emit32(counter);
+    this->emit({0x48, 0x63, 0xC8, 0x48, 0x39, 0xC8});
+    this->emitDeoptJump(JNE);
+    bindLoopVariables();
+}
+
+void JitCompiler::compileIf(shared_ptr<IfExpression> expr) {
+    vector<shared_ptr<Expression>> conditions{expr->condition};
+    vector<shared_ptr<BlockStatement>> blocks{expr->consequence};
+    conditions.insert(conditions.end(), expr->conditions.begin(), expr->conditions.end());
+    blocks.insert(blocks.end(), expr->alternatives.begin(), expr->alternatives.end());
+
+    vector<size_t> ends{};
+    for (int i = 0; i < conditions.size(); i++) {
+        if (this->compileExpression(conditions[i]) != jitBool) {
+            this->supported = false;
+            return;
+        }
+        this->emit({0x85, 0xC0});
+        size_t next = this->emitJump(JE);
+        this->compileBlock(blocks[i]);
+        ends.push_back(this->emitJump(JMP));
+        this->patchJump(next, this->code.size());
+    }
+    if (expr->alternative != nullptr) this->compileBlock(expr->alternative);
+    for (size_t end : ends)
+        this->patchJump(end, this->code.size());
+}
+
+int JitCompiler::compileInfix(shared_ptr<InfixExpression> expr) {
+    int left = this->compileExpression(expr->_left);
+    this->emit({0x50});
+    int right = this->compileExpression(expr->_right);
+    // left operand in eax, right operand in ecx
+    this->emit({0x89, 0xC1, 0x58});
+    if (left == -1 || right == -1) return -1;
+
+    string op = expr->_operator;
+    if (left == jitInt && right == jitInt) {
+        if (op == "+") {
+            this->emit({0x01, 0xC8});
+            return jitInt;
+        }
+        if (op == "-") {
+            this->emit({0x29, 0xC8});
+            return jitInt;
+        }
+        if (op == "*") {
+            this->emit({0x0F, 0xAF, 0xC1});
+            return jitInt;
+        }
+        if (op == "/") {
+            // division by zero and INT_MIN / -1 trap; leave those to the interpreter
+            this->emit({0x85, 0xC9});
+            this->emitDeoptJump(JE);
+            this->emit({0x83, 0xF9, 0xFF});
+            size_t safe = this->emitJump(JNE);
+            this->emit({0x3D});
+            this->emit32(INT32_MIN);
+            this->emitDeoptJump(JE);
+            this->patchJump(safe, this->code.size());
+            this->emit({0x99, 0xF7, 0xF9});
+            return jitInt;
+        }
+    }
+    uint8_t setcc = 0;
+    if (left == jitInt && right == jitInt && op == "<") setcc = 0x9C;
+    else if (left == jitInt && right == jitInt && op == ">") setcc = 0x9F;
+    else if (left == right && op == "==") setcc = 0x94;
+    else if (left == right && op == "!=") setcc = 0x95;
+    if (setcc == 0) {
+        this->supported = false;
+        return -1;
+    }
+    // cmp eax, ecx; setcc al; movzx eax, al
+    this->emit({0x39, 0xC8, 0x0F, setcc, 0xC0, 0x0F, 0xB6, 0xC0});
+    return jitBool;
+}
+
+void JitCompiler::compileStatement(shared_ptr<Statement> stmt) {
+    switch (stmt->type) {
+        case blockStatement: this->compileBlock(static_pointer_cast<BlockStatement>(stmt)); return;
+        case expressionStatement: {
+            shared_ptr<Expression> expr = static_pointer_cast<ExpressionStatement>(stmt)->expression;
+            if (expr == nullptr) return;
+            switch (expr->type) {
+                case forExpression:   this->compileFor(static_pointer_cast<ForExpression>(expr)); return;
+                case ifExpression:    this->compileIf(static_pointer_cast<IfExpression>(expr)); return;
+                case whileExpression: this->compileWhile(static_pointer_cast<WhileExpression>(expr)); return;
+                default:              this->compileExpression(expr); return;
+            }
+        }
+        case identifierStatement: {
+            shared_ptr<IdentifierStatement> is = static_pointer_cast<IdentifierStatement>(stmt);
+            int type                           = this->compileExpression(is->value);
+            // a declaration that would fail its datatype check stays interpreted
+            int declared = is->datatype == INT ? jitInt : is->datatype == BOOLEAN ? jitBool : -1;
+            if (type == -1 || type != declared) break;
+            this->storeLocal(is->name->value, type);
+            return;
+        }
+        case letStatement: {
+            shared_ptr<LetStatement> ls = static_pointer_cast<LetStatement>(stmt);
+            int type                    = this->compileExpression(ls->value);
+            if (type != -1) this->storeLocal(ls->name->value, type);
+            return;
+        }
+        case returnStatement: {
+            // the interpreter keeps looping after a return inside a while body
+            if (this->whileDepth > 0) break;
+            int type = this->compileExpression(static_pointer_cast<ReturnStatement>(stmt)->returnValue);
+            if (type == -1 || (this->returnType != -1 && this->returnType != type)) break;
+            this->returnType = type;
+            // *status = 0; return eax
+            this->emit({0xC7, 0x06});
+            this->emit32(0);
+            this->emit({0xC9, 0xC3});
+            return;
+        }
+        default: break;
+    }
+    this->supported = false;
+}
+
+void JitCompiler::compileWhile(shared_ptr<WhileExpression> expr) {
+    this->whileDepth++;
+    size_t top = this->code.size();
+    if (this->compileExpression(expr->condition) != jitBool) {
+        this->supported = false;
+        return;
+    }
+    this->emit({0x85, 0xC0});
+    size_t exit = this->emitJump(JE);
+    this->compileBlock(expr->body);
+    this->patchJump(this->emitJump(JMP), top);
+    this->patchJump(exit, this->code.size());
+    this->whileDepth--;
+}
+
+int JitCompiler::loadLocal(string name) {
+    auto local = this->locals.find(name);
+    // builtins shadow every binding, and anything else lives outside the function
+    if (local == this->locals.end() || builtins.find(name) != builtins.end()) {
+        this->supported = false;
+        return -1;
+    }
+    // a local read before its `let` ran may still resolve to an outer binding
+    this->emit({0x83, 0xBD});
+    this->emit32(local->second.flagOffset);
+    this->emit({0x00});
+    this->emitDeoptJump(JE);
+    this->emit({0x8B, 0x85});
+    this->emit32(local->second.offset);
+    return local->second.type;
+}
+
+void JitCompiler::storeLocal(string name, int type) {
+    auto local = this->locals.find(name);
+    if (local == this->locals.end()) {
+        this->locals[name] = {this->allocateSlot(), this->allocateSlot(), type};
+        local              = this->locals.find(name);
+    } else if (local->second.type != type) {
+        this->supported = false;
+        return;
+    }
+    this->emit({0x89, 0x85});
+    this->emit32(local->second.offset);
+    this->emit({0xC7, 0x85});
+    this->emit32(local->second.flagOffset);
+    this->emit32(1);
+}
+
+shared_ptr<JitCode> JitCompiler::install() {
+    size_t page = sysconf(_SC_PAGESIZE);
+    size_t size = (this->code.size() + page - 1) / page * page;
+    void* mem   = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mem == MAP_FAILED) return nullptr;
+    memcpy(mem, this->code.data(), this->code.size());
+    if (mprotect(mem, size, PROT_READ | PROT_EXEC) != 0) {
+        munmap(mem, size);
+        return nullptr;
+    }
+
+    shared_ptr<JitCode> jit(new JitCode);
+    jit->entry      = reinterpret_cast<JitEntry>(mem);
+    jit->size       = this->code.size();
+    jit->returnType = this->returnType;
+    writePerfMap(*jit, this->function->name);
+    return jit;
+}
+
+void JitCompiler::emit(initializer_list<uint8_t> bytes) {
+    this->code.insert(this->code.end(), bytes);
+}
+
+void JitCompiler::emit32(int32_t value) {
+    uint8_t bytes[4];
+    memcpy(bytes, &value, sizeof(bytes));
+    this->code.insert(this->code.end(), bytes, bytes + 4);
+}
+
+size_t JitCompiler::emitJump(uint8_t op) {
+    if (op == JMP) this->emit({JMP});
+    else this->emit({0x0F, op});
+    size_t at = this->code.size();
+    this->emit32(0);
+    return at;
+}
+
+void JitCompiler::emitDeoptJump(uint8_t op) { this->deoptJumps.push_back(this->emitJump(op)); }
+
+void JitCompiler::patchJump(size_t at, size_t target) {
+    int32_t rel = target - (at + 4);
+    memcpy(&this->code[at], &rel, sizeof(rel));
+}
+
+shared_ptr<Object> evalJitFunction(shared_ptr<Function> func, const vector<shared_ptr<Object>>& args) {
+    // functions built by `cimpl build` are already native code
+    if (func->jitState == jitUnsupported || func->body == nullptr) return nullptr;
+    if (func->jitState == jitCounting) {
+        // parallel builtins and pfor call the same function from several threads
+        static mutex compiling;
+        unique_lock<mutex> guard(compiling, defer_lock);
+        if (PARALLEL_DEPTH != 0) guard.lock();
+        if (func->jitState == jitCounting) {
+            if (func->callCount.fetch_add(1, memory_order_relaxed) + 1 < JIT_CALL_THRESHOLD) return nullptr;
+            JitCompiler compiler(func);
+            func->jitCode = compiler.compile();
+            // published last, so a thread that sees jitCompiled also sees the code
+            func->jitState = func->jitCode == nullptr ? jitUnsupported : jitCompiled;
+        }
+        if (func->jitState == jitUnsupported) return nullptr;
+    }
+
+    // guards: every parameter must be bound to an Integer
+    int params = func->parameters.size();
+    if (args.size() < params) return nullptr;
+    int argv[JIT_MAX_PARAMETERS];
+    for (int i = 0; i < params; i++) {
+        if (args[i] == nullptr || args[i]->type != INTEGER_OBJ) return nullptr;
+        argv[i] = static_pointer_cast<Integer>(args[i])->value;
+    }
+
+    int status = 0;
+    int result = func->jitCode->entry(argv, &status);
+    if (status != 0) return nullptr;
+    if (func->jitCode->returnType == jitBool) return nativeToBoolean(result);
+    return shared_ptr<Integer>(new Integer(result));
+}
+
+void writePerfMap(const JitCode& jit, string name) {
+    static FILE* map = nullptr;
+    if (map == nullptr) {
+        char path[64];
+        snprintf(path, sizeof(path), "/tmp/perf-%d.map", getpid());
+        map = fopen(path, "a");
+        if (map == nullptr) return;
+    }
+    fprintf(
+        map, "%lx %zx cimpl::%s\n", reinterpret_cast<unsigned long>(jit.entry), jit.size,
+        name.empty() ? "<anonymous>" : name.c_str()
+    );
+    fflush(map);
+}
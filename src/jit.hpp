@@ -0,0 +1,72 @@
+#pragma once
+#include "object.hpp"
+
+#include <cstdint>
+
+// Baseline JIT: once a Function has been called JIT_CALL_THRESHOLD times its
+// body is compiled to x86-64 machine code, provided it only does Integer and
+// Boolean arithmetic on its parameters and locals. Compiled code has no side
+// effects, so deoptimizing is simply re-running the call in the interpreter.
+
+const int JIT_CALL_THRESHOLD = 1000;
+const int JIT_MAX_PARAMETERS = 16;
+
+extern bool JIT_ENABLED;
+
+enum JitState { jitCounting, jitCompiled, jitUnsupported };
+
+enum JitType { jitInt, jitBool };
+
+// args are the unboxed Integer arguments; status is set non-zero to deoptimize
+typedef int (*JitEntry)(const int* args, int* status);
+
+typedef struct JitCode {
+    JitEntry entry;
+    size_t size;
+    int returnType;
+} JitCode;
+
+typedef struct JitLocal {
+    int offset;
+    int flagOffset;
+    int type;
+} JitLocal;
+
+class JitCompiler {
+  public:
+    JitCompiler(shared_ptr<Function>);
+    ~JitCompiler() = default;
+
+    shared_ptr<JitCode> compile();
+
+  private:
+    shared_ptr<Function> function;
+    vector<uint8_t> code{};
+    unordered_map<string, JitLocal> locals{};
+    vector<size_t> deoptJumps{};
+    int frameSize{0};
+    int whileDepth{0};
+    int returnType{-1};
+    bool supported{true};
+
+    int allocateSlot();
+    int compileExpression(shared_ptr<Expression>);
+    int compileInfix(shared_ptr<InfixExpression>);
+    void compileBlock(shared_ptr<BlockStatement>);
+    void compileFor(shared_ptr<ForExpression>);
+    void compileIf(shared_ptr<IfExpression>);
+    void compileStatement(shared_ptr<Statement>);
+    void compileWhile(shared_ptr<WhileExpression>);
+    int loadLocal(string);
+    void storeLocal(string, int);
+    shared_ptr<JitCode> install();
+
+    void emit(std::initializer_list<uint8_t>);
+    void emit32(int32_t);
+    size_t emitJump(uint8_t);
+    void emitDeoptJump(uint8_t);
+    void patchJump(size_t, size_t);
+};
+
+shared_ptr<Object> evalJitFunction(shared_ptr<Function>, const vector<shared_ptr<Object>>&);
+void writePerfMap(const JitCode&, string);
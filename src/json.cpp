@@ -0,0 +1,545 @@
+#include "json.hpp"
+
+#include "builtins.hpp"
+#include "evaluator.hpp"
+#include "simd.hpp"
+
+#include <charconv>
+#include <cmath>
+#include <cstring>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+// deeper documents are refused rather than risk the stack of a task
+const int JSON_MAX_DEPTH = 1024;
+// how many distinct object keys a parse shares between the objects that repeat them
+const size_t JSON_KEY_CACHE = 4096;
+
+// one bit per byte of a 64-byte block
+typedef struct BlockMasks {
+    uint64_t quote;
+    uint64_t backslash;
+    uint64_t structural;
+} BlockMasks;
+
+#if defined(__x86_64__)
+// SSE2 is part of x86-64 itself, so this needs no runtime check
+static void classifyBlock(const char* block, BlockMasks& masks) {
+    masks = {0, 0, 0};
+    for (int i = 0; i < 4; i++) {
+        __m128i bytes = _mm_loadu_si128((const __m128i*)(block + 16 * i));
+        // {, }, [ and ] differ from each other in two bits; setting one of them leaves two values to compare
+        __m128i folded    = _mm_or_si128(bytes, _mm_set1_epi8(0x20));
+        __m128i brackets  = _mm_or_si128(
+            _mm_cmpeq_epi8(folded, _mm_set1_epi8('{')), _mm_cmpeq_epi8(folded, _mm_set1_epi8('}'))
+        );
+        __m128i separator = _mm_or_si128(
+            _mm_cmpeq_epi8(bytes, _mm_set1_epi8(':')), _mm_cmpeq_epi8(bytes, _mm_set1_epi8(','))
+        );
+        int shift = 16 * i;
+        masks.quote |= (uint64_t)(unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, _mm_set1_epi8('"'))) << shift;
+        masks.backslash |= (uint64_t)(unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, _mm_set1_epi8('\\')))
+                           << shift;
+        masks.structural |= (uint64_t)(unsigned)_mm_movemask_epi8(_mm_or_si128(brackets, separator)) << shift;
+    }
+}
+#else
+static void classifyBlock(const char* block, BlockMasks& masks) {
+    masks = {0, 0, 0};
+    for (int i = 0; i < 64; i++) {
+        uint64_t bit = 1ULL << i;
+        switch (block[i]) {
+            case '"': masks.quote |= bit; break;
+            case '\\': masks.backslash |= bit; break;
+            case '{':
+            case '}':
+            case '[':
+            case ']':
+            case ':':
+            case ',': masks.structural |= bit; break;
+        }
+    }
+}
+#endif
+
+// Finds the structural characters outside strings and the unescaped quotes.
+// Returns false when a string is left open at the end.
+static bool findStructurals(const char* text, size_t length, vector<uint32_t>& indices) {
+    const uint64_t even  = 0x5555555555555555ULL;
+    uint64_t prevEscaped = 0, prevInString = 0;
+    indices.reserve(length / 8);
+    for (size_t base = 0; base < length; base += 64) {
+        BlockMasks masks;
+        if (length - base >= 64) classifyBlock(text + base, masks);
+        else {
+            char last[64];
+            memset(last, ' ', sizeof(last));
+            memcpy(last, text + base, length - base);
+            classifyBlock(last, masks);
+        }
+
+        // a backslash escapes the next byte unless it is escaped itself; runs of
+        // backslashes are told apart by whether they start on an odd or even bit
+        uint64_t backslash     = masks.backslash & ~prevEscaped;
+        uint64_t followsEscape = backslash << 1 | prevEscaped;
+        uint64_t oddStarts     = backslash & ~even & ~followsEscape;
+        uint64_t evenStarts    = oddStarts + backslash;
+        prevEscaped            = evenStarts < oddStarts;
+        uint64_t escaped       = (even ^ (evenStarts << 1)) & followsEscape;
+
+        uint64_t quote    = masks.quote & ~escaped;
+        uint64_t inString = prefixXor(quote) ^ prevInString;
+        prevInString      = (uint64_t)((int64_t)inString >> 63);
+        uint64_t bits     = (masks.structural & ~inString) | quote;
+        while (bits != 0) {
+            indices.push_back(base + __builtin_ctzll(bits));
+            bits &= bits - 1;
+        }
+    }
+    return prevInString == 0;
+}
+
+static void appendUtf8(string& out, uint32_t code) {
+    if (code < 0x80) out += (char)code;
+    else if (code < 0x800) {
+        out += (char)(0xC0 | code >> 6);
+        out += (char)(0x80 | (code & 0x3F));
+    } else if (code < 0x10000) {
+        out += (char)(0xE0 | code >> 12);
+        out += (char)(0x80 | (code >> 6 & 0x3F));
+        out += (char)(0x80 | (code & 0x3F));
+    } else {
+        out += (char)(0xF0 | code >> 18);
+        out += (char)(0x80 | (code >> 12 & 0x3F));
+        out += (char)(0x80 | (code >> 6 & 0x3F));
+        out += (char)(0x80 | (code & 0x3F));
+    }
+}
+
+class JsonParser {
+  public:
+    JsonParser(shared_ptr<const string_view> buffer, size_t offset, size_t length) {
+        this->buffer = buffer;
+        this->offset = offset;
+        this->text   = buffer->data() + offset;
+        this->length = length;
+    }
+
+    shared_ptr<Object> parse() {
+        if (this->length > UINT32_MAX) return newError("json_parse() takes documents of up to 4GB");
+        if (!findStructurals(this->text, this->length, this->indices))
+            return newError("Could not parse JSON; a string is never closed");
+        shared_ptr<Object> value = this->parseValue(0);
+        if (value == nullptr) return newError("Could not parse JSON; " + this->error);
+        size_t rest = this->skipSpace(this->cursor);
+        if (rest < this->length || this->at < this->indices.size())
+            return newError("Could not parse JSON; unexpected " + this->describe(rest) + " after the value");
+        return value;
+    }
+
+  private:
+    shared_ptr<const string_view> buffer;
+    size_t offset;
+    const char* text;
+    size_t length;
+    vector<uint32_t> indices{};
+    // the next structural to be consumed, and where the text after the last token starts
+    size_t at{0};
+    size_t cursor{0};
+    string error{};
+    // elements collected at each depth, reused by every array or object at it
+    vector<vector<shared_ptr<Object>>> elements{};
+    vector<vector<int>> integers{};
+    shared_ptr<Object> null{};
+    // keys seen so far; an array of records repeats the same few, and strings never change
+    unordered_map<string_view, shared_ptr<Object>> keys{};
+
+    size_t skipSpace(size_t position) {
+        while (position < this->length) {
+            char c = this->text[position];
+            if (c != ' ' && c != '\n' && c != '\r' && c != '\t') break;
+            position++;
+        }
+        return position;
+    }
+
+    size_t nextStructural() { return this->at < this->indices.size() ? this->indices[this->at] : this->length; }
+
+    string describe(size_t position) {
+        if (position >= this->length) return "end of input";
+        if ((unsigned char)this->text[position] < 0x20)
+            return "character " + to_string((int)this->text[position]) + " at position " + to_string(position);
+        return "'" + string(1, this->text[position]) + "' at position " + to_string(position);
+    }
+
+    shared_ptr<Object> fail(string message, size_t position) {
+        this->error = message + ", found " + this->describe(position);
+        return nullptr;
+    }
+
+    // consumes the structural character c if it is the next token
+    bool consume(char c) {
+        size_t position = this->skipSpace(this->cursor);
+        if (position != this->nextStructural() || position >= this->length || this->text[position] != c) return false;
+        this->at++;
+        this->cursor = position + 1;
+        return true;
+    }
+
+    shared_ptr<Object> parseValue(int depth) {
+        size_t start = this->skipSpace(this->cursor);
+        size_t next  = this->nextStructural();
+        if (start < this->length && start == next) {
+            switch (this->text[start]) {
+                case '"': return this->parseString();
+                case '[': return this->parseArray(depth + 1);
+                case '{': return this->parseObject(depth + 1);
+                default: return this->fail("expected a value", start);
+            }
+        }
+        // numbers, true, false and null run up to the next structural character
+        size_t end = next;
+        while (end > start && isspace((unsigned char)this->text[end - 1]))
+            end--;
+        this->cursor = end;
+        string_view token(this->text + start, end - start);
+        if (token == "true") return nativeToBoolean(true);
+        if (token == "false") return nativeToBoolean(false);
+        if (token == "null") {
+            if (this->null == nullptr) this->null = make_shared<Null>();
+            return this->null;
+        }
+        if (!isNumber(token)) return this->fail("expected a value", start);
+        int integer;
+        if (this->parseInteger(token, integer)) return make_shared<Integer>(integer);
+        double number;
+        if (this->parseNumber(token, number)) return make_shared<Float>(number);
+        return this->fail("expected a value", start);
+    }
+
+    // the number grammar of RFC 8259, which from_chars is looser than: no
+    // leading zeros or plus sign, digits on both sides of a point, and no
+    // infinities or NaN
+    static bool isNumber(string_view token) {
+        size_t i    = 0;
+        auto digits = [&]() {
+            size_t first = i;
+            while (i < token.size() && isdigit((unsigned char)token[i]))
+                i++;
+            return i > first;
+        };
+        if (i < token.size() && token[i] == '-') i++;
+        if (i < token.size() && token[i] == '0') i++;
+        else if (!digits()) return false;
+        if (i < token.size() && token[i] == '.') {
+            i++;
+            if (!digits()) return false;
+        }
+        if (i < token.size() && (token[i] == 'e' || token[i] == 'E')) {
+            i++;
+            if (i < token.size() && (token[i] == '+' || token[i] == '-')) i++;
+            if (!digits()) return false;
+        }
+        return i == token.size();
+    }
+
+    bool parseInteger(string_view token, int& value) {
+        auto parsed = from_chars(token.data(), token.data() + token.size(), value);
+        return parsed.ec == errc() && parsed.ptr == token.data() + token.size();
+    }
+
+    // anything that is not an integer, or does not fit in one
+    bool parseNumber(string_view token, double& value) {
+        auto parsed = from_chars(token.data(), token.data() + token.size(), value);
+        return parsed.ec == errc() && parsed.ptr == token.data() + token.size();
+    }
+
+    shared_ptr<Object> parseString() {
+        // quotes pair up, so the closing one is the next index
+        size_t open  = this->indices[this->at];
+        size_t close = this->indices[this->at + 1];
+        this->at += 2;
+        this->cursor     = close + 1;
+        const char* body = this->text + open + 1;
+        size_t size      = close - open - 1;
+        // control characters must be escaped, even in strings that need no decoding
+        bool control = false;
+        for (size_t i = 0; i < size; i++)
+            control |= (unsigned char)body[i] < 0x20;
+        if (control) {
+            size_t i = 0;
+            while ((unsigned char)body[i] >= 0x20)
+                i++;
+            return this->fail("expected an escape for a control character", open + 1 + i);
+        }
+        if (memchr(body, '\\', size) == nullptr)
+            return make_shared<String>(this->buffer, this->offset + open + 1, size);
+
+        string decoded{};
+        decoded.reserve(size);
+        for (size_t i = 0; i < size; i++) {
+            if (body[i] != '\\') {
+                decoded += body[i];
+                continue;
+            }
+            char escape = body[++i];
+            switch (escape) {
+                case '"':
+                case '\\':
+                case '/': decoded += escape; break;
+                case 'b': decoded += '\b'; break;
+                case 'f': decoded += '\f'; break;
+                case 'n': decoded += '\n'; break;
+                case 'r': decoded += '\r'; break;
+                case 't': decoded += '\t'; break;
+                case 'u': {
+                    uint32_t code;
+                    if (!this->parseHex(body + i + 1, size - i - 1, code))
+                        return this->fail("expected four hex digits after \\u", open + 1 + i);
+                    i += 4;
+                    // characters beyond the first plane come as a pair of surrogates
+                    uint32_t low;
+                    if (code >= 0xD800 && code < 0xDC00 && i + 6 < size && body[i + 1] == '\\' &&
+                        body[i + 2] == 'u' && this->parseHex(body + i + 3, size - i - 3, low) && low >= 0xDC00 &&
+                        low < 0xE000) {
+                        code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                        i += 6;
+                    } else if (code >= 0xD800 && code < 0xE000)
+                        return this->fail("expected a surrogate pair after \\u", open + i - 4);
+                    appendUtf8(decoded, code);
+                    break;
+                }
+                default: return this->fail("expected a valid escape after \\", open + 1 + i);
+            }
+        }
+        return make_shared<String>(move(decoded));
+    }
+
+    shared_ptr<Object> parseKey() {
+        size_t open = this->indices[this->at];
+        string_view raw(this->text + open + 1, this->indices[this->at + 1] - open - 1);
+        auto found = this->keys.find(raw);
+        if (found != this->keys.end()) {
+            this->at += 2;
+            this->cursor = open + raw.size() + 2;
+            return found->second;
+        }
+        shared_ptr<Object> key = this->parseString();
+        if (key != nullptr && this->keys.size() < JSON_KEY_CACHE) this->keys.emplace(raw, key);
+        return key;
+    }
+
+    bool parseHex(const char* digits, size_t available, uint32_t& code) {
+        if (available < 4) return false;
+        auto parsed = from_chars(digits, digits + 4, code, 16);
+        return parsed.ec == errc() && parsed.ptr == digits + 4;
+    }
+
+    // Integers are kept unboxed while every element so far has been one, and
+    // the array is made packed from them directly.
+    shared_ptr<Object> parseArray(int depth) {
+        if (depth > JSON_MAX_DEPTH) return this->fail("arrays and objects nested too deeply", this->cursor);
+        this->at++;
+        this->cursor = this->indices[this->at - 1] + 1;
+        if (this->elements.size() <= depth) {
+            this->elements.resize(depth + 1);
+            this->integers.resize(depth + 1);
+        }
+        if (this->consume(']')) return make_shared<Array>(vector<shared_ptr<Object>>{});
+
+        bool packed = true;
+        while (true) {
+            size_t start = this->skipSpace(this->cursor);
+            int integer;
+            if (packed && start != this->nextStructural()) {
+                size_t end = this->nextStructural();
+                while (end > start && isspace((unsigned char)this->text[end - 1]))
+                    end--;
+                if (this->parseInteger(string_view(this->text + start, end - start), integer)) {
+                    this->integers[depth].push_back(integer);
+                    this->cursor = end;
+                    if (!this->arraySeparator()) break;
+                    continue;
+                }
+            }
+            if (packed) {
+                packed = false;
+                for (int value : this->integers[depth])
+                    this->elements[depth].push_back(make_shared<Integer>(value));
+                this->integers[depth].clear();
+            }
+            shared_ptr<Object> element = this->parseValue(depth);
+            if (element == nullptr) return this->abandon(depth);
+            this->elements[depth].push_back(element);
+            if (!this->arraySeparator()) break;
+        }
+        if (!this->error.empty()) return this->abandon(depth);
+
+        shared_ptr<Object> arr{};
+        if (packed) arr = make_shared<Array>(vector<int>(this->integers[depth]));
+        else arr = make_shared<Array>(vector<shared_ptr<Object>>(this->elements[depth]));
+        this->integers[depth].clear();
+        this->elements[depth].clear();
+        return arr;
+    }
+
+    // true after a comma, false after the closing bracket or when neither follows
+    bool arraySeparator() {
+        if (this->consume(',')) return true;
+        if (!this->consume(']')) this->fail("expected ',' or ']'", this->skipSpace(this->cursor));
+        return false;
+    }
+
+    shared_ptr<Object> parseObject(int depth) {
+        if (depth > JSON_MAX_DEPTH) return this->fail("arrays and objects nested too deeply", this->cursor);
+        this->at++;
+        this->cursor = this->indices[this->at - 1] + 1;
+        if (this->elements.size() <= depth) {
+            this->elements.resize(depth + 1);
+            this->integers.resize(depth + 1);
+        }
+        // nested values may grow elements, so it is indexed afresh each time
+        if (!this->consume('}')) {
+            while (true) {
+                size_t start = this->skipSpace(this->cursor);
+                if (start != this->nextStructural() || start >= this->length || this->text[start] != '"') {
+                    this->fail("expected a string key", start);
+                    return this->abandon(depth);
+                }
+                shared_ptr<Object> key = this->parseKey();
+                if (key == nullptr) return this->abandon(depth);
+                if (!this->consume(':')) {
+                    this->fail("expected ':'", this->skipSpace(this->cursor));
+                    return this->abandon(depth);
+                }
+                shared_ptr<Object> value = this->parseValue(depth);
+                if (value == nullptr) return this->abandon(depth);
+                this->elements[depth].push_back(key);
+                this->elements[depth].push_back(value);
+                if (this->consume(',')) continue;
+                if (this->consume('}')) break;
+                this->fail("expected ',' or '}'", this->skipSpace(this->cursor));
+                return this->abandon(depth);
+            }
+        }
+
+        vector<shared_ptr<Object>>& pairs = this->elements[depth];
+        shared_ptr<Hash> hash             = make_shared<Hash>();
+        hash->pairs.reserve(pairs.size() / 2);
+        for (size_t i = 0; i < pairs.size(); i += 2) {
+            size_t key       = static_pointer_cast<String>(pairs[i])->hashValue();
+            hash->pairs[key] = make_shared<HashPair>(pairs[i], pairs[i + 1]);
+        }
+        pairs.clear();
+        return hash;
+    }
+
+    shared_ptr<Object> abandon(int depth) {
+        this->elements[depth].clear();
+        this->integers[depth].clear();
+        return nullptr;
+    }
+};
+
+shared_ptr<Object> parseJson(shared_ptr<const string_view> buffer, size_t offset, size_t length) {
+    JsonParser parser(buffer, offset, length);
+    return parser.parse();
+}
+
+static void writeString(string_view text, string& out) {
+    static const char* hex = "0123456789abcdef";
+    out += '"';
+    // runs of characters that need no escape are copied in one go
+    size_t run = 0;
+    for (size_t i = 0; i < text.size(); i++) {
+        unsigned char c = text[i];
+        if (c >= 0x20 && c != '"' && c != '\\') continue;
+        out.append(text.data() + run, i - run);
+        run = i + 1;
+        switch (c) {
+            case '"': out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            default:
+                out += "\\u00";
+                out += hex[c >> 4];
+                out += hex[c & 0xF];
+        }
+    }
+    out.append(text.data() + run, text.size() - run);
+    out += '"';
+}
+
+static void writeInteger(int value, string& out) {
+    char digits[16];
+    auto written = to_chars(digits, digits + sizeof(digits), value);
+    out.append(digits, written.ptr - digits);
+}
+
+// the shortest text that reads back as the same double, with a point so it reads back as a float
+static void writeFloat(double value, string& out) {
+    if (!isfinite(value)) {
+        out += "null";
+        return;
+    }
+    char digits[32];
+    auto written = to_chars(digits, digits + sizeof(digits), value);
+    string_view text(digits, written.ptr - digits);
+    out += text;
+    if (text.find_first_of(".e") == string_view::npos) out += ".0";
+}
+
+static string writeValue(Object* value, string& out, int depth) {
+    if (depth > JSON_MAX_DEPTH) return "arrays and hashes nested too deeply";
+    switch (value->type) {
+        case INTEGER_OBJ: writeInteger(static_cast<Integer*>(value)->value, out); return "";
+        case FLOAT_OBJ: writeFloat(static_cast<Float*>(value)->value, out); return "";
+        case STRING_OBJ: writeString(static_cast<String*>(value)->value(), out); return "";
+        case BOOLEAN_TRUE: out += "true"; return "";
+        case BOOLEAN_FALSE: out += "false"; return "";
+        case NULL_OBJ: out += "null"; return "";
+        case ARRAY_OBJ: {
+            Array* arr = static_cast<Array*>(value);
+            out += '[';
+            for (size_t i = 0; i < arr->size(); i++) {
+                if (i > 0) out += ',';
+                switch (arr->kind) {
+                    case intArray: writeInteger(arr->intAt(i), out); break;
+                    case floatArray: writeFloat(arr->floatAt(i), out); break;
+                    default: {
+                        string error = writeValue(arr->at(i).get(), out, depth + 1);
+                        if (!error.empty()) return error;
+                    }
+                }
+            }
+            out += ']';
+            return "";
+        }
+        case HASH_OBJ: {
+            out += '{';
+            bool first = true;
+            for (auto& pair : static_cast<Hash*>(value)->pairs) {
+                if (!first) out += ',';
+                first = false;
+                // JSON keys are always strings
+                Object* key = pair.second->key.get();
+                if (key->type == STRING_OBJ) writeString(static_cast<String*>(key)->value(), out);
+                else writeString(key->inspectObject(), out);
+                out += ':';
+                string error = writeValue(pair.second->value.get(), out, depth + 1);
+                if (!error.empty()) return error;
+            }
+            out += '}';
+            return "";
+        }
+        default: return value->inspectType() + " cannot be written as JSON";
+    }
+}
+
+string writeJson(const shared_ptr<Object>& value, string& out) { return writeValue(value.get(), out, 0); }
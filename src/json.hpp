@@ -0,0 +1,23 @@
+#pragma once
+#include "object.hpp"
+
+#include <memory>
+#include <string>
+#include <string_view>
+
+using namespace std;
+
+// JSON to and from cimpl values. Parsing runs in two passes, after simdjson:
+// the first classifies the text 64 bytes at a time with vector compares and
+// records where every structural character ({}[]:,) and every unescaped quote
+// outside a string is, and the second walks that list to build the values. It
+// only goes back to the text between them to read a token, trim the
+// whitespace around it, and check a string for escapes.
+
+// Parses the length characters at offset in buffer. Objects become Hashes and
+// arrays Arrays (packed when they hold only integers); strings without escapes
+// are views of buffer. Returns an Error when the text is not JSON.
+shared_ptr<Object> parseJson(shared_ptr<const string_view>, size_t, size_t);
+
+// appends the JSON text of a value to out; returns an error message, or "" when it succeeded
+string writeJson(const shared_ptr<Object>&, string&);
@@ -23,7 +23,10 @@ Token Lexer::nextToken() {
         string ds{input[curr], input[peek]};
         if (ds == "//") return Token(::COMMENT, readComment());
         if (ds == "/*") return Token(::BLOCK_COMMENT, readBlockComment());
-        if (DOUBLE_TOKEN_MAP.find(ds) != DOUBLE_TOKEN_MAP.end()) {
+        // keywords like "in" or "if" must not match the start of "int" or "iff"
+        bool keywordPrefix = isalpha(ch) && peek + 1 < input.length() &&
+                             (isalpha(input[peek + 1]) || input[peek + 1] == '_');
+        if (!keywordPrefix && DOUBLE_TOKEN_MAP.find(ds) != DOUBLE_TOKEN_MAP.end()) {
             advance();
             advance();
             return Token(DOUBLE_TOKEN_MAP.at(ds), ds);
@@ -1,4 +1,6 @@
+#include "codegen.hpp"
 #include "globals.hpp"
+#include "jit.hpp"
 #include "repl.hpp"
 
 #include <cstring>
@@ -7,16 +9,6 @@
 
 using namespace std;
 
-stack<pair<string, int>> HISTORY;
-stack<pair<string, int>> MEMORY;
-WINDOW* PAD = nullptr;
-int PADPOS{0};
-int PADHEIGHT = 10000;
-unsigned int CURSOR_X{4}, CURSOR_Y{0};
-unsigned int MIN_X{4}, MAXLINE_X{1};
-int WIN_HEIGHT{}, WIN_WIDTH{};
-int INDENT_LEVEL{0}, INDENT_SPACES{4};
-
 int main(int argc, char* argv[]) {
     if (argc == 1) {
         initscr();
@@ -29,12 +21,47 @@ int main(int argc, char* argv[]) {
         endwin();
     } else {
         if (strcmp(argv[1], "-h") == 0 || strcmp(argv[1], "--help") == 0) {
-            cout << "cimpl [OPTIONS] [FILE]\n\n";
+            cout << "cimpl [OPTIONS] [FILE]\n";
+            cout << "cimpl build FILE [-o OUTPUT]\n\n";
             cout << "If no args given, will run an interactive interpreter prompt.\n";
-            cout << "Options:\n\t-h --help: Shows this help menu.\n" << endl;
+            cout << "Options:\n\t-h --help: Shows this help menu.\n";
+            cout << "\t--closures: Compiles the program into closures before running it.\n";
+            cout << "\t--no-jit: Never compiles hot functions to machine code.\n";
+            cout << "\t-n: Runs FILE, then calls its process(line) for each line of stdin\n";
+            cout << "\t\tand its finish() at the end, when there is one.\n";
+            cout << "build: Compiles FILE ahead of time into the executable OUTPUT,\n";
+            cout << "\tor into C++ source when OUTPUT ends in .cpp.\n" << endl;
+        } else if (strcmp(argv[1], "build") == 0) {
+            string script{}, output{};
+            for (int i = 2; i < argc; i++) {
+                if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) output = argv[++i];
+                else script = argv[i];
+            }
+            if (script.empty()) return 1;
+            if (output.empty()) {
+                size_t dot = script.rfind('.'), slash = script.rfind('/');
+                bool hasExtension = dot != string::npos && (slash == string::npos || dot > slash);
+                output            = hasExtension ? script.substr(0, dot) : script + ".out";
+            }
+
+            ifstream file(script);
+            string content;
+            if (!file.is_open()) return 1;
+            getline(file, content, '\0');
+            file.close();
+            return buildProgram(content, output);
         } else {
+            bool closures = false, perLine = false;
+            int fileArg   = 1;
+            for (; fileArg < argc && argv[fileArg][0] == '-'; fileArg++) {
+                if (strcmp(argv[fileArg], "--closures") == 0) closures = true;
+                else if (strcmp(argv[fileArg], "--no-jit") == 0) JIT_ENABLED = false;
+                else if (strcmp(argv[fileArg], "-n") == 0) perLine = true;
+            }
+            if (fileArg >= argc) return 1;
+
             shared_ptr<Environment> env(new Environment);
-            ifstream file(argv[1]);
+            ifstream file(argv[fileArg]);
             string content;
 
             if (file.is_open()) {
@@ -43,7 +70,8 @@ int main(int argc, char* argv[]) {
             } else {
                 return 1;
             }
-            repl_file(content, env);
+            if (perLine) return repl_lines(content, env, closures);
+            repl_file(content, env, closures);
         }
     }
     return 0;
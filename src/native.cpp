@@ -0,0 +1,373 @@
+#include "native.hpp"
+
+#include "builtins.hpp"
+#include "cimpl_native.h"
+#include "evaluator.hpp"
+
+#include <algorithm>
+#include <deque>
+#include <dlfcn.h>
+#include <mutex>
+#include <unordered_map>
+
+using namespace std;
+
+static_assert(sizeof(int) == sizeof(int32_t), "packed integer arrays are handed out as int32_t");
+
+typedef struct NativeBuiltin {
+    string name;
+    cimpl_native_fn fn;
+    int arity;
+    string signature;
+    bool pure;
+} NativeBuiltin;
+
+// A value handle is the address of a shared_ptr that outlives the call: an
+// argument, or one of the values the call has made.
+struct cimpl_call {
+    // a deque, so the addresses given out stay put as it grows
+    deque<shared_ptr<Object>> values{};
+    deque<vector<int>> ints{};
+    deque<vector<double>> floats{};
+    // the hashes made in this call, which alone may be filled in
+    vector<const Object*> hashes{};
+};
+
+struct cimpl_module {
+    vector<NativeBuiltin> registered{};
+    // why the first register_builtin that failed did
+    string error{};
+};
+
+// Entries are only ever added, under importLock, and are written before the
+// Builtin that refers to them is bound, so calls read them without a lock.
+static unique_ptr<NativeBuiltin> natives[NATIVE_MAX_BUILTINS];
+static size_t nativeCount = 0;
+static unordered_map<string, int> nativeIds{};
+// the builtins each opened shared object registered, by its dlopen handle
+static unordered_map<void*, vector<int>> imported{};
+static mutex importLock;
+// builtins that are not pure are called one at a time
+static mutex impureLock;
+
+static cimpl_value* handle(shared_ptr<Object>* slot) { return reinterpret_cast<cimpl_value*>(slot); }
+
+static const shared_ptr<Object>& object(const cimpl_value* value) {
+    return *reinterpret_cast<const shared_ptr<Object>*>(value);
+}
+
+static cimpl_value* keep(cimpl_call* call, shared_ptr<Object> value) {
+    call->values.push_back(move(value));
+    return handle(&call->values.back());
+}
+
+static bool validName(const char* name) {
+    if (name == nullptr || !(isalpha((unsigned char)name[0]) || name[0] == '_')) return false;
+    for (const char* c = name; *c != '\0'; c++)
+        if (!isalnum((unsigned char)*c) && *c != '_') return false;
+    return true;
+}
+
+static int registerBuiltin(
+    cimpl_module* module, const char* name, cimpl_native_fn fn, int arity, const char* signature, unsigned flags
+) {
+    string letters = signature == nullptr ? "" : signature;
+    string reason{};
+    if (!validName(name)) reason = "a builtin needs a name made of letters, digits and underscores";
+    else if (builtins.find(name) != builtins.end() || nativeIds.find(name) != nativeIds.end())
+        reason = string(name) + " is already a builtin";
+    else if (fn == nullptr || arity < -1 || (flags & ~CIMPL_PURE) != 0)
+        reason = "bad arguments registering " + string(name);
+    else if (letters.find_first_not_of("ifnbsah.") != string::npos || (arity >= 0 && (int)letters.size() > arity))
+        reason = "bad signature for " + string(name) + ": " + letters;
+    for (auto& builtin : module->registered)
+        if (reason.empty() && builtin.name == name) reason = string(name) + " is already a builtin";
+    if (reason.empty() && nativeCount + module->registered.size() >= NATIVE_MAX_BUILTINS)
+        reason = "more than " + to_string(NATIVE_MAX_BUILTINS) + " native builtins";
+
+    if (!reason.empty()) {
+        if (module->error.empty()) module->error = reason;
+        return -1;
+    }
+    module->registered.push_back({name, fn, arity, letters, (flags & CIMPL_PURE) != 0});
+    return 0;
+}
+
+static cimpl_type typeOf(const cimpl_value* value) {
+    switch (object(value)->type) {
+        case NULL_OBJ: return CIMPL_NULL;
+        case BOOLEAN_OBJ:
+        case BOOLEAN_TRUE:
+        case BOOLEAN_FALSE: return CIMPL_BOOL;
+        case INTEGER_OBJ: return CIMPL_INT;
+        case FLOAT_OBJ: return CIMPL_FLOAT;
+        case STRING_OBJ: return CIMPL_STRING;
+        case ARRAY_OBJ: return CIMPL_ARRAY;
+        case HASH_OBJ: return CIMPL_HASH;
+        default: return CIMPL_OTHER;
+    }
+}
+
+static cimpl_value* makeError(cimpl_call* call, const char* message) { return keep(call, newError(message)); }
+
+static cimpl_value* makeNull(cimpl_call* call) { return keep(call, shared_ptr<Object>(new Null())); }
+
+static cimpl_value* makeBool(cimpl_call* call, int value) { return keep(call, nativeToBoolean(value != 0)); }
+
+static cimpl_value* makeInt(cimpl_call* call, int64_t value) { return keep(call, make_shared<Integer>((int)value)); }
+
+static cimpl_value* makeFloat(cimpl_call* call, double value) { return keep(call, make_shared<Float>(value)); }
+
+static cimpl_value* makeString(cimpl_call* call, const char* data, size_t length) {
+    return keep(call, make_shared<String>(string(data, length)));
+}
+
+static int getBool(const cimpl_value* value) { return typeOf(value) == CIMPL_BOOL && isTruthy(object(value)); }
+
+static int64_t getInt(const cimpl_value* value) {
+    const shared_ptr<Object>& obj = object(value);
+    return obj->type == INTEGER_OBJ ? static_pointer_cast<Integer>(obj)->value : 0;
+}
+
+static double getFloat(const cimpl_value* value) {
+    const shared_ptr<Object>& obj = object(value);
+    if (obj->type == FLOAT_OBJ) return static_pointer_cast<Float>(obj)->value;
+    return obj->type == INTEGER_OBJ ? static_pointer_cast<Integer>(obj)->value : 0;
+}
+
+static const char* getString(const cimpl_value* value, size_t* length) {
+    const shared_ptr<Object>& obj = object(value);
+    if (obj->type != STRING_OBJ) {
+        if (length != nullptr) *length = 0;
+        return nullptr;
+    }
+    string_view text = static_pointer_cast<String>(obj)->value();
+    if (length != nullptr) *length = text.size();
+    return text.data();
+}
+
+static cimpl_value* makeArray(cimpl_call* call, cimpl_value* const* elements, size_t count) {
+    vector<shared_ptr<Object>> values(count);
+    for (size_t i = 0; i < count; i++)
+        values[i] = elements[i] == nullptr ? shared_ptr<Object>(new Null()) : object(elements[i]);
+    return keep(call, make_shared<Array>(move(values)));
+}
+
+static cimpl_value* makeIntArray(cimpl_call* call, const int32_t* data, size_t count) {
+    return keep(call, make_shared<Array>(vector<int>(data, data + count)));
+}
+
+static cimpl_value* makeFloatArray(cimpl_call* call, const double* data, size_t count) {
+    return keep(call, make_shared<Array>(vector<double>(data, data + count)));
+}
+
+static const Array* arrayOf(const cimpl_value* value) {
+    const shared_ptr<Object>& obj = object(value);
+    return obj->type == ARRAY_OBJ ? static_cast<const Array*>(obj.get()) : nullptr;
+}
+
+static size_t arrayLength(const cimpl_value* value) {
+    const Array* arr = arrayOf(value);
+    return arr == nullptr ? 0 : arr->size();
+}
+
+static cimpl_value* arrayGet(cimpl_call* call, const cimpl_value* value, size_t index) {
+    const Array* arr = arrayOf(value);
+    if (arr == nullptr || index >= arr->size()) return nullptr;
+    return keep(call, arr->at(index));
+}
+
+static const int32_t* arrayInts(cimpl_call* call, const cimpl_value* value) {
+    const Array* arr = arrayOf(value);
+    return arr == nullptr ? nullptr : arr->intData(call->ints.emplace_back());
+}
+
+static const double* arrayFloats(cimpl_call* call, const cimpl_value* value) {
+    const Array* arr = arrayOf(value);
+    return arr == nullptr ? nullptr : arr->floatData(call->floats.emplace_back());
+}
+
+static cimpl_value* makeHash(cimpl_call* call) {
+    shared_ptr<Hash> hash = make_shared<Hash>();
+    call->hashes.push_back(hash.get());
+    return keep(call, hash);
+}
+
+static bool keyOf(const shared_ptr<Object>& key, size_t& hashed) {
+    switch (key->type) {
+        case INTEGER_OBJ: hashed = hashKey(static_pointer_cast<Integer>(key)); return true;
+        case STRING_OBJ: hashed = hashKey(static_pointer_cast<String>(key)); return true;
+        case BOOLEAN_TRUE:
+        case BOOLEAN_FALSE: hashed = hashKey(static_pointer_cast<Boolean>(key)); return true;
+        default: return false;
+    }
+}
+
+static int hashSet(cimpl_call* call, cimpl_value* hash, const cimpl_value* key, const cimpl_value* value) {
+    const shared_ptr<Object>& obj = object(hash);
+    size_t hashed;
+    if (find(call->hashes.begin(), call->hashes.end(), obj.get()) == call->hashes.end() || !keyOf(object(key), hashed))
+        return -1;
+    shared_ptr<Object> val = value == nullptr ? shared_ptr<Object>(new Null()) : object(value);
+    static_pointer_cast<Hash>(obj)->pairs[hashed] = make_shared<HashPair>(object(key), val);
+    return 0;
+}
+
+static cimpl_value* hashGet(cimpl_call* call, const cimpl_value* hash, const cimpl_value* key) {
+    const shared_ptr<Object>& obj = object(hash);
+    size_t hashed;
+    if (obj->type != HASH_OBJ || !keyOf(object(key), hashed)) return nullptr;
+    shared_ptr<Hash> hashObject = static_pointer_cast<Hash>(obj);
+    auto found                  = hashObject->pairs.find(hashed);
+    return found == hashObject->pairs.end() ? nullptr : keep(call, found->second->value);
+}
+
+static size_t hashSize(const cimpl_value* hash) {
+    const shared_ptr<Object>& obj = object(hash);
+    return obj->type == HASH_OBJ ? static_pointer_cast<Hash>(obj)->pairs.size() : 0;
+}
+
+static cimpl_value* hashKeys(cimpl_call* call, const cimpl_value* hash) {
+    const shared_ptr<Object>& obj = object(hash);
+    vector<shared_ptr<Object>> keys{};
+    if (obj->type == HASH_OBJ)
+        for (auto& pair : static_pointer_cast<Hash>(obj)->pairs)
+            keys.push_back(pair.second->key);
+    return keep(call, make_shared<Array>(move(keys)));
+}
+
+static const cimpl_api API = {
+    CIMPL_NATIVE_VERSION,
+    sizeof(cimpl_api),
+    registerBuiltin,
+    typeOf,
+    makeError,
+    makeNull,
+    makeBool,
+    makeInt,
+    makeFloat,
+    makeString,
+    getBool,
+    getInt,
+    getFloat,
+    getString,
+    makeArray,
+    makeIntArray,
+    makeFloatArray,
+    arrayLength,
+    arrayGet,
+    arrayInts,
+    arrayFloats,
+    makeHash,
+    hashSet,
+    hashGet,
+    hashSize,
+    hashKeys,
+};
+
+// binds the builtins in the outermost environment, where every function can see them
+static shared_ptr<Object> bindNatives(const vector<int>& ids, shared_ptr<Environment> env) {
+    while (env->outer != nullptr)
+        env = env->outer;
+    vector<shared_ptr<Object>> names{};
+    for (int id : ids) {
+        shared_ptr<Builtin> bi(new Builtin());
+        bi->builtin_type = builtin_native + id;
+        env->set(natives[id]->name, bi);
+        names.push_back(make_shared<String>(natives[id]->name));
+    }
+    shared_ptr<Array> arr = make_shared<Array>(move(names));
+    env->gc.push_back(arr);
+    return arr;
+}
+
+shared_ptr<Object> importNative(const string& path, shared_ptr<Environment> env) {
+    lock_guard<mutex> guard(importLock);
+    void* library = dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL);
+    // dlerror() starts with the path
+    if (library == nullptr) return newError(string("Could not import ") + dlerror());
+    auto found = imported.find(library);
+    if (found != imported.end()) {
+        // dlopen counts how often a library was opened, and this one stays open anyway
+        dlclose(library);
+        return bindNatives(found->second, env);
+    }
+
+    cimpl_native_init_fn init = (cimpl_native_init_fn)dlsym(library, "cimpl_native_init");
+    if (init == nullptr) {
+        dlclose(library);
+        return newError("Could not import " + path + ": it has no cimpl_native_init");
+    }
+    cimpl_module module{};
+    if (init(&API, &module) != 0) {
+        dlclose(library);
+        string reason = module.error.empty() ? "" : ": " + module.error;
+        return newError("Could not import " + path + "; its cimpl_native_init failed" + reason);
+    }
+
+    // the builtins may be running long after the import, so the library is never closed
+    vector<int> ids{};
+    for (auto& builtin : module.registered) {
+        int id                = nativeCount++;
+        natives[id]           = make_unique<NativeBuiltin>(move(builtin));
+        nativeIds[natives[id]->name] = id;
+        ids.push_back(id);
+    }
+    imported[library] = ids;
+    return bindNatives(ids, env);
+}
+
+static bool accepts(char letter, const shared_ptr<Object>& arg) {
+    switch (letter) {
+        case 'i': return arg->type == INTEGER_OBJ;
+        case 'f': return arg->type == FLOAT_OBJ;
+        case 'n': return arg->type == INTEGER_OBJ || arg->type == FLOAT_OBJ;
+        case 'b': return arg->type == BOOLEAN_TRUE || arg->type == BOOLEAN_FALSE;
+        case 's': return arg->type == STRING_OBJ;
+        case 'a': return arg->type == ARRAY_OBJ;
+        case 'h': return arg->type == HASH_OBJ;
+        default: return true;
+    }
+}
+
+static string typeName(char letter) {
+    switch (letter) {
+        case 'i': return ObjectType.INTEGER_OBJ;
+        case 'f': return ObjectType.FLOAT_OBJ;
+        case 'n': return ObjectType.INTEGER_OBJ + " or " + ObjectType.FLOAT_OBJ;
+        case 'b': return ObjectType.BOOLEAN_OBJ;
+        case 's': return ObjectType.STRING_OBJ;
+        case 'a': return ObjectType.ARRAY_OBJ;
+        default: return ObjectType.HASH_OBJ;
+    }
+}
+
+shared_ptr<Object> callNative(int id, vector<shared_ptr<Object>>& args, shared_ptr<Environment> env) {
+    const NativeBuiltin& native = *natives[id];
+    if (native.arity >= 0 && args.size() != (size_t)native.arity)
+        return newError(
+            "Wrong number of arguments for " + native.name + "(). Expected " + to_string(native.arity) + ", got " +
+            to_string(args.size())
+        );
+    for (size_t i = 0; i < native.signature.size() && i < args.size(); i++)
+        if (!accepts(native.signature[i], args[i]))
+            return newError(
+                "Argument " + to_string(i + 1) + " to " + native.name + "() must be " + typeName(native.signature[i]) +
+                ". Instead got " + args[i]->inspectType()
+            );
+
+    cimpl_call call{};
+    vector<cimpl_value*> handles(args.size());
+    for (size_t i = 0; i < args.size(); i++)
+        handles[i] = handle(&args[i]);
+    cimpl_value* result;
+    if (native.pure) result = native.fn(&call, handles.data(), handles.size());
+    else {
+        lock_guard<mutex> guard(impureLock);
+        result = native.fn(&call, handles.data(), handles.size());
+    }
+    if (result == nullptr) return shared_ptr<Object>(new Null());
+    shared_ptr<Object> value = object(result);
+    if (value->type == ARRAY_OBJ || value->type == HASH_OBJ || value->type == STRING_OBJ) env->gc.push_back(value);
+    return value;
+}
@@ -0,0 +1,24 @@
+#pragma once
+#include "object.hpp"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Native extension modules; see cimpl_native.h for the interface they are
+// written against. A module's builtins are numbered from builtin_native in the
+// order they are registered, and are bound as Builtins in the global
+// environment by the import, since the code that runs after it was parsed and
+// compiled before it ran. They therefore rank below script bindings of the
+// same name, unlike the builtins that are part of the interpreter.
+
+const size_t NATIVE_MAX_BUILTINS = 4096;
+
+// Opens the shared object at path and runs its cimpl_native_init, returning an
+// Array of the names it registered, or an Error. Importing the same object
+// again binds the same builtins without running it twice.
+shared_ptr<Object> importNative(const string&, shared_ptr<Environment>);
+// checks the arguments against what the builtin registered and calls it
+shared_ptr<Object> callNative(int, vector<shared_ptr<Object>>&, shared_ptr<Environment>);
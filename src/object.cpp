@@ -1,12 +1,84 @@
 #include "object.hpp"
 
+#include "channel.hpp"
+#include "evaluator.hpp"
+#include "threads.hpp"
+
 using namespace std;
 
 Object::Object() { this->type = OBJECT_OBJ; };
 
 Array::Array(vector<shared_ptr<Object>> el) {
-    this->elements = el;
-    this->type     = ARRAY_OBJ;
+    this->kind = boxedArray;
+    if (!el.empty()) {
+        int elementType = el[0]->type == BOOLEAN_FALSE ? BOOLEAN_TRUE : el[0]->type;
+        for (auto& element : el) {
+            int type = element->type == BOOLEAN_FALSE ? BOOLEAN_TRUE : element->type;
+            if (type != elementType) elementType = -1;
+        }
+        switch (elementType) {
+            case INTEGER_OBJ: {
+                vector<int> values(el.size());
+                for (size_t i = 0; i < el.size(); i++)
+                    values[i] = static_cast<Integer*>(el[i].get())->value;
+                this->kind = intArray;
+                this->ints = make_shared<const vector<int>>(move(values));
+                break;
+            }
+            case FLOAT_OBJ: {
+                vector<double> values(el.size());
+                for (size_t i = 0; i < el.size(); i++)
+                    values[i] = static_cast<Float*>(el[i].get())->value;
+                this->kind   = floatArray;
+                this->floats = make_shared<const vector<double>>(move(values));
+                break;
+            }
+            case BOOLEAN_TRUE: {
+                vector<bool> values(el.size());
+                for (size_t i = 0; i < el.size(); i++)
+                    values[i] = el[i]->type == BOOLEAN_TRUE;
+                this->kind  = boolArray;
+                this->bools = make_shared<const vector<bool>>(move(values));
+                break;
+            }
+            default: break;
+        }
+    }
+    this->length = el.size();
+    if (this->kind == boxedArray) this->storage = make_shared<const vector<shared_ptr<Object>>>(move(el));
+    this->offset = 0;
+    this->step   = 1;
+    this->type   = ARRAY_OBJ;
+}
+
+Array::Array(vector<int> values) {
+    this->kind   = intArray;
+    this->length = values.size();
+    this->ints   = make_shared<const vector<int>>(move(values));
+    this->offset = 0;
+    this->step   = 1;
+    this->type   = ARRAY_OBJ;
+}
+
+Array::Array(vector<double> values) {
+    this->kind   = floatArray;
+    this->length = values.size();
+    this->floats = make_shared<const vector<double>>(move(values));
+    this->offset = 0;
+    this->step   = 1;
+    this->type   = ARRAY_OBJ;
+}
+
+Array::Array(const Array& source, size_t offset, size_t length, long step) {
+    this->kind    = source.kind;
+    this->storage = source.storage;
+    this->ints    = source.ints;
+    this->floats  = source.floats;
+    this->bools   = source.bools;
+    this->offset  = offset;
+    this->length  = length;
+    this->step    = step;
+    this->type    = ARRAY_OBJ;
 }
 
 Boolean::Boolean(bool b) {
@@ -15,6 +87,91 @@ Boolean::Boolean(bool b) {
     else this->type = BOOLEAN_FALSE;
 }
 
+Channel::Channel(size_t capacity) {
+    this->capacity = capacity;
+    if (capacity == 0) this->unbounded.reset(new SegmentedQueue<shared_ptr<Object>>());
+    else this->bounded.reset(new RingBuffer<shared_ptr<Object>>(capacity));
+    this->senders.reset(new WaitQueue());
+    this->receivers.reset(new WaitQueue());
+    this->type = CHANNEL_OBJ;
+}
+
+Channel::~Channel() {}
+
+// Arrays are the only values a program changes in place: sort() hands the
+// array a new buffer. A value is sent as a snapshot, with every array in it
+// replaced by a view of the buffer it has now, so the sender can go on
+// sorting while the receiver reads.
+static shared_ptr<Object> snapshot(const shared_ptr<Object>& value) {
+    if (value->type == ARRAY_OBJ) {
+        const Array& a = *static_pointer_cast<Array>(value);
+        bool nested    = false;
+        if (a.kind == boxedArray)
+            for (size_t i = 0; i < a.size() && !nested; i++)
+                nested = a.at(i)->type == ARRAY_OBJ || a.at(i)->type == HASH_OBJ;
+        if (!nested) return make_shared<Array>(a, a.offset, a.length, a.step);
+        vector<shared_ptr<Object>> elements(a.size());
+        for (size_t i = 0; i < a.size(); i++)
+            elements[i] = snapshot(a.at(i));
+        return make_shared<Array>(move(elements));
+    }
+    if (value->type == HASH_OBJ) {
+        // hashes are not changed once built, only the arrays they hold
+        const Hash& h = *static_pointer_cast<Hash>(value);
+        bool nested   = false;
+        for (auto& pair : h.pairs)
+            nested = nested || pair.second->value->type == ARRAY_OBJ || pair.second->value->type == HASH_OBJ;
+        if (!nested) return value;
+        shared_ptr<Hash> copy = make_shared<Hash>();
+        for (auto& pair : h.pairs)
+            copy->pairs[pair.first] = make_shared<HashPair>(pair.second->key, snapshot(pair.second->value));
+        return copy;
+    }
+    return value;
+}
+
+void Channel::send(shared_ptr<Object> value) {
+    value = snapshot(value);
+    this->senders->until([this, &value]() { return this->trySend(value); });
+    this->receivers->notifyOne();
+}
+
+shared_ptr<Object> Channel::receive() {
+    shared_ptr<Object> value;
+    this->receivers->until([this, &value]() { return this->tryReceive(value); });
+    if (this->bounded) this->senders->notifyOne();
+    return value;
+}
+
+size_t Channel::select(const vector<shared_ptr<Channel>>& channels, shared_ptr<Object>& value) {
+    // each try starts one channel further on, so a busy channel cannot starve the ones after it
+    static atomic<size_t> rotation{0};
+    vector<WaitQueue*> queues{};
+    for (auto& channel : channels)
+        queues.push_back(channel->receivers.get());
+    size_t chosen = 0;
+    WaitQueue::untilAny(queues, [&]() {
+        size_t first = rotation++;
+        for (size_t i = 0; i < channels.size(); i++) {
+            chosen = (first + i) % channels.size();
+            if (channels[chosen]->tryReceive(value)) return true;
+        }
+        return false;
+    });
+    if (channels[chosen]->bounded) channels[chosen]->senders->notifyOne();
+    return chosen;
+}
+
+bool Channel::trySend(shared_ptr<Object>& value) {
+    if (this->bounded) return this->bounded->push(value);
+    this->unbounded->push(value);
+    return true;
+}
+
+bool Channel::tryReceive(shared_ptr<Object>& value) {
+    return this->bounded ? this->bounded->pop(value) : this->unbounded->pop(value);
+}
+
 Environment::Environment(shared_ptr<Environment> env) {
     if (env == nullptr) this->outer = nullptr;
     else this->outer = env;
@@ -30,7 +187,13 @@ Error::Error(string msg) {
     this->type    = ERROR_OBJ;
 }
 
-Float::Float(float fl) {
+File::File(string path, shared_ptr<const string_view> contents) {
+    this->path     = path;
+    this->contents = contents;
+    this->type     = FILE_OBJ;
+}
+
+Float::Float(double fl) {
     this->value = fl;
     this->type  = FLOAT_OBJ;
 }
@@ -42,10 +205,16 @@ Function::Function(
     this->type          = FUNCTION_OBJ;
     this->parameters    = params;
     this->body          = body;
+    this->compiledBody  = nullptr;
     this->env           = env;
     this->function_type = standardFunction;
+    this->callCount     = 0;
+    this->jitState      = 0;
+    this->jitCode       = nullptr;
 }
 
+Hash::Hash() { this->type = HASH_OBJ; }
+
 HashPair::HashPair(shared_ptr<Object> key, shared_ptr<Object> val) {
     this->key   = key;
     this->value = val;
@@ -56,10 +225,17 @@ Integer::Integer(int val) {
     this->type  = INTEGER_OBJ;
 }
 
+Lines::Lines(shared_ptr<const string_view> text) {
+    this->text = text;
+    this->type = LINES_OBJ;
+}
+
 Loop::Loop(int loop, shared_ptr<BlockStatement> body, shared_ptr<Environment> env) {
-    this->loop_type = loop;
-    this->body      = body;
-    this->env       = env;
+    this->loop_type         = loop;
+    this->body              = body;
+    this->compiledBody      = nullptr;
+    this->compiledCondition = nullptr;
+    this->env               = env;
 }
 
 Null::Null() { this->type = NULL_OBJ; }
@@ -73,9 +249,32 @@ ReturnValue::ReturnValue(shared_ptr<Object> obj) {
     this->type  = RETURN_OBJ;
 }
 
+Task::Task() {
+    this->finished = make_shared<Event>();
+    this->result   = nullptr;
+    this->type     = TASK_OBJ;
+}
+
 String::String(string str) {
-    this->value = str;
-    this->type  = STRING_OBJ;
+    // the view sits next to the characters it shows, in one allocation
+    struct Owned {
+        string text;
+        string_view view;
+    };
+    shared_ptr<Owned> owned = make_shared<Owned>();
+    owned->text             = move(str);
+    owned->view             = owned->text;
+    this->buffer            = shared_ptr<const string_view>(owned, &owned->view);
+    this->offset            = 0;
+    this->length            = this->buffer->size();
+    this->type   = STRING_OBJ;
+}
+
+String::String(shared_ptr<const string_view> buffer, size_t offset, size_t length) {
+    this->buffer = buffer;
+    this->offset = offset;
+    this->length = length;
+    this->type   = STRING_OBJ;
 }
 
 /**********
@@ -86,13 +285,73 @@ string Object::inspectType() { return ObjectType.OBJECT_OBJ; }
 
 string Object::inspectObject() { return "Object"; }
 
+shared_ptr<Object> Array::box(size_t index) const {
+    switch (this->kind) {
+        case intArray: return make_shared<Integer>((*this->ints)[index]);
+        case floatArray: return make_shared<Float>((*this->floats)[index]);
+        case boolArray: return nativeToBoolean((*this->bools)[index]);
+        default: return (*this->storage)[index];
+    }
+}
+
+const void* Array::buffer() const {
+    switch (this->kind) {
+        case intArray: return this->ints.get();
+        case floatArray: return this->floats.get();
+        case boolArray: return this->bools.get();
+        default: return this->storage.get();
+    }
+}
+
+vector<shared_ptr<Object>> Array::elements() const {
+    if (this->kind == boxedArray && this->step == 1)
+        return vector<shared_ptr<Object>>(
+            this->storage->begin() + this->offset, this->storage->begin() + this->offset + this->length
+        );
+    vector<shared_ptr<Object>> result{};
+    result.reserve(this->length);
+    for (size_t i = 0; i < this->length; i++)
+        result.push_back(this->at(i));
+    return result;
+}
+
+const int* Array::intData(vector<int>& scratch) const {
+    if (this->kind != intArray) return nullptr;
+    if (this->step == 1) return this->ints->data() + this->offset;
+    scratch.resize(this->length);
+    for (size_t i = 0; i < this->length; i++)
+        scratch[i] = this->intAt(i);
+    return scratch.data();
+}
+
+const double* Array::floatData(vector<double>& scratch) const {
+    if (this->kind == floatArray && this->step == 1) return this->floats->data() + this->offset;
+    scratch.resize(this->length);
+    for (size_t i = 0; i < this->length; i++) {
+        switch (this->kind) {
+            case intArray: scratch[i] = this->intAt(i); break;
+            case floatArray: scratch[i] = this->floatAt(i); break;
+            case boxedArray: {
+                // arrays mixing integers and floats are not packed, but are still numbers
+                Object* element = this->at(i).get();
+                if (element->type == INTEGER_OBJ) scratch[i] = static_cast<Integer*>(element)->value;
+                else if (element->type == FLOAT_OBJ) scratch[i] = static_cast<Float*>(element)->value;
+                else return nullptr;
+                break;
+            }
+            default: return nullptr;
+        }
+    }
+    return scratch.data();
+}
+
 string Array::inspectType() { return ObjectType.ARRAY_OBJ; }
 
 string Array::inspectObject() {
     ostringstream ss;
     vector<string> elements;
-    for (auto el : this->elements)
-        elements.push_back(el->inspectObject());
+    for (size_t i = 0; i < this->length; i++)
+        elements.push_back(this->at(i)->inspectObject());
     ss << "[";
     for (auto el : elements)
         ss << el << ", ";
@@ -104,31 +363,50 @@ string Boolean::inspectType() { return ObjectType.BOOLEAN_OBJ; }
 
 string Boolean::inspectObject() { return this->value ? "true" : "false"; }
 
-shared_ptr<Object> Environment::get(string name) {
-    try {
-        shared_ptr<Object> res = this->store[name];
-        return res;
-    } catch (...) {
-        if (this->outer != nullptr) {
-            try {
-                this->outer->get(name);
-            } catch (...) {
-                return nullptr;
-            }
-        }
-        return nullptr;
+shared_ptr<Object> Environment::get(Symbol name) {
+    for (Environment* env = this; env != nullptr; env = env->outer.get()) {
+        shared_lock<shared_mutex> guard{};
+        if (env->shared) guard = shared_lock<shared_mutex>(*env->lock);
+        auto found = env->store.find(name);
+        if (found != env->store.end()) return found->second;
     }
+    return nullptr;
 }
 
-shared_ptr<Object> Environment::set(string name, shared_ptr<Object> val) {
+shared_ptr<Object> Environment::get(const string& name) { return this->get(intern(name)); }
+
+shared_ptr<Object> Environment::set(Symbol name, shared_ptr<Object> val) {
+    unique_lock<shared_mutex> guard{};
+    if (this->shared) guard = unique_lock<shared_mutex>(*this->lock);
     this->store[name] = val;
     return val;
 }
 
+shared_ptr<Object> Environment::set(const string& name, shared_ptr<Object> val) {
+    return this->set(intern(name), val);
+}
+
+shared_ptr<Object>* Environment::slot(Symbol name) {
+    unique_lock<shared_mutex> guard{};
+    if (this->shared) guard = unique_lock<shared_mutex>(*this->lock);
+    return &this->store[name];
+}
+
+string Channel::inspectType() { return ObjectType.CHANNEL_OBJ; }
+
+string Channel::inspectObject() {
+    if (this->capacity == 0) return "<channel>";
+    return "<channel: capacity " + to_string(this->capacity) + ">";
+}
+
 string Error::inspectType() { return ObjectType.ERROR_OBJ; }
 
 string Error::inspectObject() { return "ERROR: " + this->message; }
 
+string File::inspectType() { return ObjectType.FILE_OBJ; }
+
+string File::inspectObject() { return "<file " + this->path + ": " + to_string(this->contents->size()) + " bytes>"; }
+
 string Float::inspectType() { return ObjectType.FLOAT_OBJ; }
 
 string Float::inspectObject() { return to_string(this->value); }
@@ -166,6 +444,10 @@ string Integer::inspectType() { return ObjectType.INTEGER_OBJ; }
 
 string Integer::inspectObject() { return to_string(this->value); }
 
+string Lines::inspectType() { return ObjectType.LINES_OBJ; }
+
+string Lines::inspectObject() { return "<lines>"; }
+
 string Null::inspectType() { return ObjectType.NULL_OBJ; }
 
 string Null::inspectObject() { return "null"; }
@@ -174,6 +456,18 @@ string ReturnValue::inspectType() { return ObjectType.RETURN_OBJ; }
 
 string ReturnValue::inspectObject() { return this->value->inspectObject(); }
 
+size_t String::hashValue() {
+    if (!this->hashed.load(memory_order_acquire)) {
+        this->hashCode.store(hash<string_view>{}(this->value()), memory_order_relaxed);
+        this->hashed.store(true, memory_order_release);
+    }
+    return this->hashCode.load(memory_order_relaxed);
+}
+
 string String::inspectType() { return ObjectType.STRING_OBJ; }
 
-string String::inspectObject() { return this->value; }
+string String::inspectObject() { return string(this->value()); }
+
+string Task::inspectType() { return ObjectType.TASK_OBJ; }
+
+string Task::inspectObject() { return this->finished->isSet() ? "<task: finished>" : "<task: running>"; }
@@ -1,27 +1,46 @@
 #pragma once
 #include "ast.hpp"
 
+#include <atomic>
 #include <functional>
+#include <shared_mutex>
 #include <ncurses.h>
 #include <sstream>
+#include <string_view>
 
 using namespace std;
 
 class Array;
 class Boolean;
+class Channel;
 class Environment;
 class Error;
+class File;
 class Float;
 class Function;
 class Hash;
 class HashKey;
 class HashPair;
 class Integer;
+class Lines;
 class Null;
 class Print;
 class Quit;
 class ReturnValue;
 class String;
+class Task;
+
+class Event;
+class WaitQueue;
+template <class T>
+class RingBuffer;
+template <class T>
+class SegmentedQueue;
+
+struct JitCode;
+
+// a pre-compiled AST node; see closure.hpp
+typedef function<shared_ptr<Object>(const shared_ptr<Environment>&)> Closure;
 
 enum ObjectEnum {
     ARRAY_OBJ,
@@ -29,12 +48,15 @@ enum ObjectEnum {
     BOOLEAN_TRUE,
     BOOLEAN_OBJ,
     BUILTIN_OBJ,
+    CHANNEL_OBJ,
     ERROR_OBJ,
+    FILE_OBJ,
     FLOAT_OBJ,
     FUNCTION_OBJ,
     HASH_OBJ,
     IDENT_OBJ,
     INTEGER_OBJ,
+    LINES_OBJ,
     LOOP_OBJ,
     NULL_OBJ,
     OBJECT_OBJ,
@@ -42,25 +64,33 @@ enum ObjectEnum {
     QUIT_OBJ,
     RETURN_OBJ,
     STRING_OBJ,
+    TASK_OBJ,
 };
 
 enum FunctionEnum {
     standardFunction,
     builtinFunction,
+    // calling one starts a task that runs the body; see spawnTask
+    asyncFunction,
 };
 
 enum LoopEnum { doLoop, whileLoop, forLoop };
 
+enum ArrayKind { boxedArray, intArray, floatArray, boolArray };
+
 const struct Objecttype {
     string ARRAY_OBJ    = {"ARRAY"};
     string BOOLEAN_OBJ  = {"BOOLEAN"};
     string BUILTIN_OBJ  = {"BUILTIN"};
+    string CHANNEL_OBJ  = {"CHANNEL"};
     string ERROR_OBJ    = {"ERROR"};
+    string FILE_OBJ     = {"FILE"};
     string FLOAT_OBJ    = {"FLOAT"};
     string FUNCTION_OBJ = {"FUNCTION"};
     string HASH_OBJ     = {"HASH"};
     string IDENT_OBJ    = {"IDENT"};
     string INTEGER_OBJ  = {"INTEGER"};
+    string LINES_OBJ    = {"LINES"};
     string LOOP_OBJ     = {"LOOP"};
     string NULL_OBJ     = {"NULL"};
     string OBJECT_OBJ   = {"OBJECT"};
@@ -68,6 +98,7 @@ const struct Objecttype {
     string QUIT_OBJ     = {"QUIT"};
     string RETURN_OBJ   = {"RETURN"};
     string STRING_OBJ   = {"STRING"};
+    string TASK_OBJ     = {"TASK"};
 } ObjectType;
 
 class Object {
@@ -83,11 +114,43 @@ class Object {
 class Array : public Object {
   public:
     Array(vector<shared_ptr<Object>>);
-
-    vector<shared_ptr<Object>> elements;
-
+    Array(vector<int>);
+    Array(vector<double>);
+    Array(const Array&, size_t, size_t, long);
+
+    // Arrays made only of integers, only of floats or only of booleans are
+    // packed: their values sit in one native buffer (a bitset for booleans)
+    // and are boxed again when read. Any other array holds its objects.
+    int kind;
+    shared_ptr<const vector<shared_ptr<Object>>> storage;
+    shared_ptr<const vector<int>> ints;
+    shared_ptr<const vector<double>> floats;
+    shared_ptr<const vector<bool>> bools;
+    // Slices are views: they share the buffer of the array they were cut
+    // from and record where they start, how many elements they have and how
+    // far apart those are. Buffers are never written to; sort() changes an
+    // array by giving it a new buffer, so views cut before keep the old one.
+    size_t offset;
+    size_t length;
+    long step;
+
+    shared_ptr<Object> box(size_t) const;
+    const void* buffer() const;
+    vector<shared_ptr<Object>> elements() const;
+    // the elements as one contiguous run, pointing into the buffer when the
+    // view allows it and copied into the scratch vector otherwise; floatData
+    // also converts integers, and both return nullptr for other elements
+    const int* intData(vector<int>&) const;
+    const double* floatData(vector<double>&) const;
     string inspectType();
     string inspectObject();
+    inline size_t index(size_t i) const { return this->offset + (long)i * this->step; }
+    inline shared_ptr<Object> at(size_t i) const {
+        return this->kind == boxedArray ? (*this->storage)[this->index(i)] : this->box(this->index(i));
+    }
+    inline int intAt(size_t i) const { return (*this->ints)[this->index(i)]; }
+    inline double floatAt(size_t i) const { return (*this->floats)[this->index(i)]; }
+    inline size_t size() const { return this->length; }
 };
 
 class Boolean : public Object {
@@ -105,12 +168,21 @@ class Environment : public Object {
     Environment(shared_ptr<Environment> = nullptr);
     ~Environment();
 
-    unordered_map<string, shared_ptr<Object>> store{};
+    unordered_map<Symbol, shared_ptr<Object>> store{};
     vector<shared_ptr<Object>> gc{};
     shared_ptr<Environment> outer;
-
-    shared_ptr<Object> get(string);
-    shared_ptr<Object> set(string, shared_ptr<Object>);
+    // Set once a spawned task can see this environment. From then on get and
+    // set go through lock, and code holding a slot of the store rebinds it
+    // under the lock too.
+    atomic<bool> shared{false};
+    unique_ptr<shared_mutex> lock{};
+
+    shared_ptr<Object> get(Symbol);
+    shared_ptr<Object> get(const string&);
+    shared_ptr<Object> set(Symbol, shared_ptr<Object>);
+    shared_ptr<Object> set(const string&, shared_ptr<Object>);
+    // the binding of a name in this environment itself, made if it is missing
+    shared_ptr<Object>* slot(Symbol);
 };
 
 class Error : public Object {
@@ -125,9 +197,9 @@ class Error : public Object {
 
 class Float : public Object {
   public:
-    Float(float);
+    Float(double);
 
-    float value;
+    double value;
 
     string inspectType();
     string inspectObject();
@@ -137,17 +209,26 @@ class Function : public Object {
   public:
     Function(vector<shared_ptr<IdentifierLiteral>>, shared_ptr<BlockStatement>, shared_ptr<Environment>);
 
+    string name;
     vector<shared_ptr<IdentifierLiteral>> parameters;
     shared_ptr<BlockStatement> body;
+    shared_ptr<Closure> compiledBody;
     shared_ptr<Environment> env;
     int function_type;
 
+    // baseline JIT bookkeeping; see jit.hpp
+    atomic<int> callCount;
+    atomic<int> jitState;
+    shared_ptr<JitCode> jitCode;
+
     string inspectType();
     string inspectObject();
 };
 
 class Hash : public Object {
   public:
+    Hash();
+
     unordered_map<size_t, shared_ptr<HashPair>> pairs{};
 
     inline string inspectType() { return ObjectType.HASH_OBJ; };
@@ -180,11 +261,13 @@ class Loop : public Object {
     vector<shared_ptr<Expression>> expressions;
     vector<shared_ptr<Statement>> statements;
     shared_ptr<BlockStatement> body;
+    shared_ptr<Closure> compiledBody;
+    shared_ptr<Closure> compiledCondition;
     shared_ptr<Environment> env;
     int loop_type;
-    int start;
-    int end;
-    int increment;
+    long long start;
+    long long end;
+    long long increment;
 };
 
 class Null : public Object {
@@ -219,8 +302,95 @@ class ReturnValue : public Object {
 class String : public Object {
   public:
     String(string);
+    String(shared_ptr<const string_view>, size_t, size_t);
+
+    // Slices, substrings and split parts are views: they share the buffer of
+    // the string they were cut from and only record where they start and end.
+    // The buffer is a view itself, of characters owned by whatever it shares
+    // ownership with: a string, or a file mapped by read() or lines().
+    shared_ptr<const string_view> buffer;
+    size_t offset;
+    size_t length;
+    // Strings are never changed in place, so the hash is computed at most once.
+    // Tasks may hash the same string at once; hashed is published after hashCode.
+    atomic<size_t> hashCode{0};
+    atomic<bool> hashed{false};
+
+    size_t hashValue();
+    string inspectType();
+    string inspectObject();
+    inline string_view value() const { return string_view(*this->buffer).substr(this->offset, this->length); }
+};
 
-    string value;
+// A queue of values passed between tasks, backed by the lock-free queues in
+// channel.hpp. A capacity of 0 means the channel never fills up.
+class Channel : public Object {
+  public:
+    Channel(size_t);
+    ~Channel();
+
+    size_t capacity;
+
+    // these wait until there is room or a value, parking a task meanwhile
+    void send(shared_ptr<Object>);
+    shared_ptr<Object> receive();
+    // receives from whichever of the channels has a value first and returns its position
+    static size_t select(const vector<shared_ptr<Channel>>&, shared_ptr<Object>&);
+
+    string inspectType();
+    string inspectObject();
+
+  private:
+    unique_ptr<RingBuffer<shared_ptr<Object>>> bounded;
+    unique_ptr<SegmentedQueue<shared_ptr<Object>>> unbounded;
+    unique_ptr<WaitQueue> senders;
+    unique_ptr<WaitQueue> receivers;
+
+    bool trySend(shared_ptr<Object>&);
+    bool tryReceive(shared_ptr<Object>&);
+};
+
+// A file opened with open(), mapped into memory rather than read in. read()
+// and lines() hand out views of the mapping, which stays until the last of
+// them is gone.
+class File : public Object {
+  public:
+    File(string, shared_ptr<const string_view>);
+
+    string path;
+    shared_ptr<const string_view> contents;
+
+    string inspectType();
+    string inspectObject();
+};
+
+enum LinesFormat { plainLines, jsonLines, csvLines };
+
+// What lines() returns: a for loop over it binds each line of text in turn,
+// without its newline, as a view of text. For json_lines() the loop binds
+// the value each line that is not blank holds as JSON instead, and for
+// csv_rows() an array of the fields of each record.
+class Lines : public Object {
+  public:
+    Lines(shared_ptr<const string_view>);
+
+    shared_ptr<const string_view> text;
+    int format{plainLines};
+    // csvLines only: what separates fields, and whether the first record is a header to skip
+    char delimiter{','};
+    bool header{true};
+
+    string inspectType();
+    string inspectObject();
+};
+
+// the handle spawn returns; join waits for finished and hands out result
+class Task : public Object {
+  public:
+    Task();
+
+    shared_ptr<Event> finished;
+    shared_ptr<Object> result;
 
     string inspectType();
     string inspectObject();
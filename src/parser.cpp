@@ -17,64 +17,37 @@ void Parser::checkFunctionReturn(shared_ptr<FunctionStatement> stmt) {
         if (st->type == returnStatement) {
             shared_ptr<ReturnStatement> returnStmt = dynamic_pointer_cast<ReturnStatement>(st);
             found++;
-            if (stmt->datatype != returnStmt->datatype) {
+            // only literal return values have a datatype known while parsing
+            if (returnStmt->datatype != -1 && stmt->datatype != returnStmt->datatype) {
                 ostringstream ss;
                 ss << "Function return value DataType mismatch.\n";
                 this->errors.push_back(ss.str());
             }
         }
     }
-    if (!found) {
+    if (!found && stmt->datatype != VOID) {
         ostringstream ss;
-        ss << "No return statement for fn: " << stmt->token.literal << '\n';
+        ss << "No return statement for fn: " << stmt->name->value << '\n';
         this->errors.push_back(ss.str());
     }
 }
 
 void Parser::checkIdentifierDataType(shared_ptr<IdentifierStatement> stmt) {
-    switch (stmt->datatype) {
-        case INT:
-            if (DatatypeMap.at(stmt->value->type) != "int") {
-                ostringstream ss;
-                ss << "Mismatched DataType: " << DatatypeMap.at(stmt->value->type)
-                   << " is not equal to: "
-                   << "Integer Literal\n";
-                this->errors.push_back(ss.str());
-            }
-            break;
-        case FLOAT:
-            if (DatatypeMap.at(stmt->value->type) != "float") {
-                ostringstream ss;
-                ss << "Mismatched DataType: " << DatatypeMap.at(stmt->value->type)
-                   << " is not equal to: "
-                   << "Float \n";
-                this->errors.push_back(ss.str());
-            }
-            break;
-        case BOOLEAN:
-            if (DatatypeMap.at(stmt->value->type) != "boolean") {
-                ostringstream ss;
-                ss << "Mismatched DataType: " << DatatypeMap.at(stmt->value->type)
-                   << " is not equal to: "
-                   << "Boolean\n";
-                this->errors.push_back(ss.str());
-            }
-            break;
-        case STRING:
-            if (DatatypeMap.at(stmt->value->type) != "string") {
-                ostringstream ss;
-                ss << "Mismatched DataType: " << DatatypeMap.at(stmt->value->type)
-                   << " is not equal to: "
-                   << "String \n";
-                this->errors.push_back(ss.str());
-            }
-            break;
-        case VOID:
-            ostringstream ss;
-            ss << "Cannot use void datatype with identifier initializations.\n";
-            this->errors.push_back(ss.str());
-            break;
+    if (stmt->datatype == VOID) {
+        ostringstream ss;
+        ss << "Cannot use void datatype with identifier initializations.\n";
+        this->errors.push_back(ss.str());
+        return;
     }
+    // only literals have a datatype known while parsing; integers widen to float
+    if (stmt->value == nullptr || stmt->value->datatype == -1) return;
+    if (stmt->value->datatype == stmt->datatype) return;
+    if (stmt->datatype == FLOAT && stmt->value->datatype == INT) return;
+
+    ostringstream ss;
+    ss << "Mismatched DataType: " << DatatypeMap.at(stmt->value->datatype)
+       << " is not equal to: " << DatatypeMap.at(stmt->datatype) << '\n';
+    this->errors.push_back(ss.str());
 }
 
 int Parser::currentPrecedence() {
@@ -122,9 +95,8 @@ shared_ptr<AssignmentExpressionStatement> Parser::parseAssignmentExpression() {
     expr->name = this->parseIdentifier();
     this->nextToken();
     expr->_operator = this->currentToken.literal;
-    int precedence  = this->currentPrecedence();
     this->nextToken();
-    expr->value = this->parseExpression(precedence);
+    expr->value = this->parseExpression(::LOWEST);
 
     // Read to end of line/file
     while (1) {
@@ -282,9 +254,9 @@ shared_ptr<FloatLiteral> Parser::parseFloatLiteral() {
     shared_ptr<FloatLiteral> expr(new FloatLiteral);
     expr->setExpressionNode(this->currentToken);
 
-    float value;
+    double value;
     try {
-        value = stof(this->currentToken.literal);
+        value = stod(this->currentToken.literal);
     } catch (...) {
         ostringstream ss;
         ss << "Could not parse " << this->currentToken.literal << " as float\n";
@@ -299,6 +271,7 @@ shared_ptr<FloatLiteral> Parser::parseFloatLiteral() {
 shared_ptr<ForExpression> Parser::parseForExpression() {
     shared_ptr<ForExpression> loop(new ForExpression);
     loop->setExpressionNode(this->currentToken);
+    loop->parallel = this->currentToken.type == ::PFOR;
 
     if (!expectPeek(::LPAREN)) return nullptr;
 
@@ -306,27 +279,55 @@ shared_ptr<ForExpression> Parser::parseForExpression() {
 
     vector<shared_ptr<LetStatement>> statements{};
     while (this->currentToken.type != ::IN) {
+        if (this->currentToken.type == ::_EOF) {
+            ostringstream ss;
+            ss << "Could not parse for-loop; no `in` range given\n";
+            this->errors.push_back(ss.str());
+            return nullptr;
+        }
+        if (this->currentToken.type == ::COMMA) {
+            this->nextToken();
+            continue;
+        }
         shared_ptr<LetStatement> stmt(new LetStatement);
         stmt->setStatementNode(this->currentToken);
         stmt->name = this->parseIdentifier();
         statements.push_back(stmt);
         this->nextToken();
     }
+    this->nextToken();
 
-    if (!(expectPeek(::INT))) return nullptr;
-
-    shared_ptr<Expression> start = this->parseIntegerLiteral();
-    loop->start                  = start;
+    // range bounds and step may be any expression; they are evaluated once per loop
+    shared_ptr<Expression> start = this->parseExpression(::LOWEST);
+    if (start == nullptr) return nullptr;
+    // a lone expression is iterated over
+    if (this->peekToken.type == ::RPAREN) {
+        if (loop->parallel) {
+            ostringstream ss;
+            ss << "Could not parse pfor; it needs a range\n";
+            this->errors.push_back(ss.str());
+            return nullptr;
+        }
+        this->nextToken();
+        loop->iterable = start;
+        for (auto stmt : statements)
+            loop->statements.push_back(stmt);
+        if (!(expectPeek(::LBRACE))) return nullptr;
+        loop->body = this->parseBlockStatement();
+        return loop;
+    }
+    loop->start = start;
     for (auto stmt : statements) {
         stmt->value = start;
         loop->statements.push_back(stmt);
     }
     if (!(expectPeek(::COLON))) return nullptr;
-    if (!(expectPeek(::INT))) return nullptr;
+    this->nextToken();
 
-    shared_ptr<Expression> end       = this->parseIntegerLiteral();
+    shared_ptr<Expression> end       = this->parseExpression(::LOWEST);
     shared_ptr<Expression> increment = nullptr;
-    loop->end                        = end;
+    if (end == nullptr) return nullptr;
+    loop->end = end;
     this->nextToken();
 
     if (this->currentToken.type == ::RPAREN) {
@@ -337,10 +338,9 @@ shared_ptr<ForExpression> Parser::parseForExpression() {
         increment          = inc;
     } else if (this->currentToken.type == ::COLON) {
         this->nextToken();
-        if (this->currentToken.type != ::INT) return nullptr;
-        increment = this->parseIntegerLiteral();
-        if (this->peekToken.type != ::RPAREN) return nullptr;
-        this->nextToken();
+        increment = this->parseExpression(::LOWEST);
+        if (increment == nullptr) return nullptr;
+        if (!(expectPeek(::RPAREN))) return nullptr;
     } else {
         ostringstream ss;
         ss << "Could not parse for-loop\n";
@@ -348,6 +348,7 @@ shared_ptr<ForExpression> Parser::parseForExpression() {
         return nullptr;
     }
     loop->increment = increment;
+    if (loop->parallel && !this->parseForReductions(loop)) return nullptr;
 
     if (!(expectPeek(::LBRACE))) return nullptr;
 
@@ -356,6 +357,36 @@ shared_ptr<ForExpression> Parser::parseForExpression() {
     return loop;
 }
 
+// any number of `reduce(op : name, ...)` clauses between a pfor's range and its body
+bool Parser::parseForReductions(shared_ptr<ForExpression> loop) {
+    while (this->peekToken.type == ::IDENT && this->peekToken.literal == "reduce") {
+        this->nextToken();
+        if (!expectPeek(::LPAREN)) return false;
+        this->nextToken();
+        string op = this->currentToken.literal;
+        if (op != "+" && op != "*" && op != "min" && op != "max") {
+            ostringstream ss;
+            ss << "Could not parse pfor reduction; expected +, *, min or max but got " << op << '\n';
+            this->errors.push_back(ss.str());
+            return false;
+        }
+        if (!expectPeek(::COLON)) return false;
+        do {
+            if (!expectPeek(::IDENT)) return false;
+            loop->reduceOperators.push_back(op);
+            loop->reduceNames.push_back(this->parseIdentifier());
+            this->nextToken();
+        } while (this->currentToken.type == ::COMMA);
+        if (this->currentToken.type != ::RPAREN) {
+            ostringstream ss;
+            ss << "Parenthesis/Bracket never closed\n";
+            this->errors.push_back(ss.str());
+            return false;
+        }
+    }
+    return true;
+}
+
 shared_ptr<FunctionLiteral> Parser::parseFunctionLiteral() {
     shared_ptr<FunctionLiteral> expr(new FunctionLiteral);
     expr->setExpressionNode(this->currentToken);
@@ -381,7 +412,6 @@ shared_ptr<FunctionStatement> Parser::parseFunctionStatement() {
 
     if (!expectPeek(::IDENT)) return nullptr;
     stmt->name = parseIdentifier();
-    this->nextToken();
 
     if (!expectPeek(::LPAREN)) return nullptr;
     stmt->parameters = this->parseFunctionParameters();
@@ -552,12 +582,17 @@ shared_ptr<IfExpression> Parser::parseIfExpression() {
 }
 
 shared_ptr<Expression> Parser::parseIndexExpression(shared_ptr<Expression> _left) {
+    Token token = this->currentToken;
+    this->nextToken();
+    shared_ptr<Expression> index = nullptr;
+    if (this->currentToken.type != ::COLON) index = this->parseExpression(::LOWEST);
+    if (this->currentToken.type == ::COLON || this->peekToken.type == ::COLON)
+        return this->parseSliceExpression(token, _left, index);
+
     shared_ptr<IndexExpression> expr(new IndexExpression);
-    expr->setExpressionNode(this->currentToken);
+    expr->setExpressionNode(token);
     expr->_left = _left;
-
-    this->nextToken();
-    expr->index = this->parseExpression(::LOWEST);
+    expr->index = index;
 
     if (!expectPeek(::RBRACKET)) {
         ostringstream ss;
@@ -614,6 +649,9 @@ shared_ptr<Expression> Parser::parseLeftPrefix(int prefix) {
         case PREFIX_FOR:          return parseForExpression();
         case PREFIX_ARRAY:        return parseArrayLiteral();
         case PREFIX_HASH:         return parseHashLiteral();
+        case PREFIX_SPAWN:        return parseSpawnExpression();
+        case PREFIX_ASYNC:        return parseAsyncFunction();
+        case PREFIX_AWAIT:        return parseAwaitExpression();
         default:                  return parsePrefixExpression();
     }
 }
@@ -702,6 +740,36 @@ shared_ptr<ReturnStatement> Parser::parseReturnStatement() {
     return stmt;
 }
 
+shared_ptr<SliceExpression>
+Parser::parseSliceExpression(Token token, shared_ptr<Expression> _left, shared_ptr<Expression> start) {
+    shared_ptr<SliceExpression> expr(new SliceExpression);
+    expr->setExpressionNode(token);
+    expr->_left = _left;
+    expr->start = start;
+
+    // step onto the colon unless the start bound was left out
+    if (this->currentToken.type != ::COLON) this->nextToken();
+    if (this->peekToken.type != ::RBRACKET && this->peekToken.type != ::COLON) {
+        this->nextToken();
+        expr->end = this->parseExpression(::LOWEST);
+    }
+    if (this->peekToken.type == ::COLON) {
+        this->nextToken();
+        if (this->peekToken.type != ::RBRACKET) {
+            this->nextToken();
+            expr->step = this->parseExpression(::LOWEST);
+        }
+    }
+
+    if (!expectPeek(::RBRACKET)) {
+        ostringstream ss;
+        ss << "Slice Bracket never closed\n";
+        this->errors.push_back(ss.str());
+    }
+
+    return expr;
+}
+
 shared_ptr<Statement> Parser::parseStatement() {
     TokenType curr = this->currentToken.type;
     TokenType peek = this->peekToken.type;
@@ -711,11 +779,47 @@ shared_ptr<Statement> Parser::parseStatement() {
         if (peek == ::FUNCTION) return parseFunctionStatement();
     } else if (curr == ::LET) return parseLetStatement();
     else if (curr == ::RETURN) return parseReturnStatement();
-    else if (curr == ::IDENT && peek == ::ASSIGN_EQ) return parseAssignmentExpression();
+    else if (curr == ::IDENT && (peek == ::PLUS_EQ || peek == ::MINUS_EQ || peek == ::MULT_EQ || peek == ::DIV_EQ))
+        return parseAssignmentExpression();
     else return parseExpressionStatement();
     return nullptr;
 }
 
+shared_ptr<SpawnExpression> Parser::parseSpawnExpression() {
+    shared_ptr<SpawnExpression> expr(new SpawnExpression);
+    expr->setExpressionNode(this->currentToken);
+    this->nextToken();
+
+    shared_ptr<Expression> call = this->parseExpression(::LOWEST);
+    if (call == nullptr) return nullptr;
+    if (call->type != callExpression) {
+        ostringstream ss;
+        ss << "Could not parse spawn; expected a function call but got " << call->printString() << '\n';
+        this->errors.push_back(ss.str());
+        return nullptr;
+    }
+    expr->call = static_pointer_cast<CallExpression>(call);
+    return expr;
+}
+
+shared_ptr<FunctionLiteral> Parser::parseAsyncFunction() {
+    if (!expectPeek(::FUNCTION)) return nullptr;
+    shared_ptr<FunctionLiteral> expr = this->parseFunctionLiteral();
+    if (expr != nullptr) expr->async = true;
+    return expr;
+}
+
+shared_ptr<AwaitExpression> Parser::parseAwaitExpression() {
+    shared_ptr<AwaitExpression> expr(new AwaitExpression);
+    expr->setExpressionNode(this->currentToken);
+    this->nextToken();
+
+    // binds like a prefix operator, so `await a + await b` adds two results
+    expr->value = this->parseExpression(::PREFIX);
+    if (expr->value == nullptr) return nullptr;
+    return expr;
+}
+
 shared_ptr<StringLiteral> Parser::parseStringLiteral() {
     shared_ptr<StringLiteral> expr(new StringLiteral);
     expr->setExpressionNode(this->currentToken);
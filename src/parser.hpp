@@ -5,6 +5,7 @@
 
 // Forward Declarations
 struct ArrayLiteral;
+struct AwaitExpression;
 struct BooleanLiteral;
 struct CallExpression;
 struct DoExpression;
@@ -20,6 +21,8 @@ struct InfixExpression;
 struct IntegerLiteral;
 struct PostfixExpression;
 struct PrefixExpression;
+struct SliceExpression;
+struct SpawnExpression;
 struct StringLiteral;
 struct WhileExpression;
 
@@ -66,6 +69,7 @@ class Parser {
     std::shared_ptr<FloatLiteral> parseFloatLiteral();
     std::shared_ptr<ForExpression> parseForExpression();
     std::shared_ptr<LetStatement> parseForLetStatement();
+    bool parseForReductions(std::shared_ptr<ForExpression>);
     std::shared_ptr<FunctionLiteral> parseFunctionLiteral();
     std::vector<std::shared_ptr<IdentifierLiteral>> parseFunctionParameters();
     std::shared_ptr<Expression> parseGroupedExpression();
@@ -78,6 +82,11 @@ class Parser {
     std::shared_ptr<Expression> parseLeftPrefix(int);
     std::shared_ptr<PostfixExpression> parsePostfixExpression(std::shared_ptr<Expression>);
     std::shared_ptr<PrefixExpression> parsePrefixExpression();
+    std::shared_ptr<SliceExpression>
+        parseSliceExpression(Token, std::shared_ptr<Expression>, std::shared_ptr<Expression>);
+    std::shared_ptr<SpawnExpression> parseSpawnExpression();
+    std::shared_ptr<FunctionLiteral> parseAsyncFunction();
+    std::shared_ptr<AwaitExpression> parseAwaitExpression();
     std::shared_ptr<StringLiteral> parseStringLiteral();
     std::shared_ptr<WhileExpression> parseWhileExpression();
 
@@ -108,6 +117,9 @@ enum prefix {
     PREFIX_ASSIGN,
     PREFIX_ARRAY,
     PREFIX_HASH,
+    PREFIX_SPAWN,
+    PREFIX_ASYNC,
+    PREFIX_AWAIT,
 };
 
 const std::unordered_map<TokenType, int> prefixFunctions = {
@@ -125,12 +137,16 @@ const std::unordered_map<TokenType, int> prefixFunctions = {
     {::DO,       PREFIX_DO          },
     {::WHILE,    PREFIX_WHILE       },
     {::FOR,      PREFIX_FOR         },
+    {::PFOR,     PREFIX_FOR         },
     {::PLUS_EQ,  PREFIX_ASSIGN      },
     {::MINUS_EQ, PREFIX_ASSIGN      },
     {::MULT_EQ,  PREFIX_ASSIGN      },
     {::DIV_EQ,   PREFIX_ASSIGN      },
     {::LBRACKET, PREFIX_ARRAY       },
     {::LBRACE,   PREFIX_HASH        },
+    {::SPAWN,    PREFIX_SPAWN       },
+    {::ASYNC,    PREFIX_ASYNC       },
+    {::AWAIT,    PREFIX_AWAIT       },
 };
 
 // Infix Functions
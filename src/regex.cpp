@@ -0,0 +1,816 @@
+#include "regex.hpp"
+
+#include <list>
+
+using namespace std;
+
+// deeper nesting of groups is refused rather than risk the stack of a task
+const int REGEX_MAX_DEPTH = 1000;
+// the largest count {n,m} may give
+const int REGEX_MAX_REPEAT = 1000;
+// counted repetition copies the repeated part, so a pattern can grow a long way past its length
+const size_t REGEX_MAX_PROGRAM = 100000;
+// a DFA that needs more states than this is dropped, and its pattern backtracked from then on
+const size_t REGEX_MAX_STATES = 10000;
+// compiled patterns each thread keeps
+const size_t REGEX_CACHE_SIZE = 64;
+// a backtracker stops marking the (instruction, position) pairs it has tried past this many
+const size_t BACKTRACK_MARK_BITS = 1 << 26;
+const size_t DFA_GAVE_UP         = string_view::npos - 1;
+
+enum RegexNodeKind { nodeBytes, nodeConcat, nodeAlternate, nodeRepeat, nodeGroup, nodeBegin, nodeEnd, nodeBoundary,
+                     nodeNotBoundary, nodeBackref };
+
+typedef struct RegexNode {
+    RegexNodeKind kind;
+    bitset<256> bytes{};
+    vector<unique_ptr<RegexNode>> children{};
+    // nodeRepeat: max is -1 when there is no upper bound
+    int min{0};
+    int max{0};
+    bool greedy{true};
+    // the group a nodeGroup captures or a nodeBackref refers to
+    int group{0};
+} RegexNode;
+
+static unique_ptr<RegexNode> regexNode(RegexNodeKind kind) {
+    unique_ptr<RegexNode> node(new RegexNode());
+    node->kind = kind;
+    return node;
+}
+
+static bool isWordByte(unsigned char c) { return isalnum(c) || c == '_'; }
+
+// \d, \w, \s and their negations
+static bool classEscape(char escape, bitset<256>& set) {
+    bitset<256> members{};
+    for (int c = 0; c < 256; c++) {
+        switch (tolower(escape)) {
+            case 'd': members[c] = isdigit(c) != 0; break;
+            case 'w': members[c] = isWordByte(c); break;
+            case 's': members[c] = c == ' ' || (c >= '\t' && c <= '\r'); break;
+            default: return false;
+        }
+    }
+    set |= isupper(escape) ? ~members : members;
+    return true;
+}
+
+// Parses a pattern into a tree of RegexNodes and compiles that into the
+// program of a Regex. Tree first, since counted repetition copies subtrees
+// and the literal prefix is read off the tree.
+class RegexCompiler {
+  public:
+    RegexCompiler(string_view pattern) { this->pattern = pattern; }
+
+    shared_ptr<Regex> compile(string& error) {
+        shared_ptr<Regex> regex(new Regex());
+        if (this->pattern.substr(0, 4) == "(?i)") {
+            regex->ignoreCase = true;
+            this->at          = 4;
+        }
+        this->regex                = regex.get();
+        unique_ptr<RegexNode> root = this->parseAlternation(0);
+        // parseAlternation only stops early at a ) that closes nothing
+        if (root != nullptr && this->at < this->pattern.size()) this->fail("unbalanced parenthesis");
+        if (!this->error.empty()) {
+            error = this->error;
+            return nullptr;
+        }
+
+        regex->groups = this->groups;
+        this->slots   = 2 * (this->groups + 1);
+        this->push(Regex::opSave, 0);
+        this->emit(*root);
+        this->push(Regex::opSave, 1);
+        this->push(Regex::opMatch);
+        if (regex->program.size() > REGEX_MAX_PROGRAM) {
+            error = "pattern is too large once its repetitions are expanded";
+            return nullptr;
+        }
+        regex->slots = this->slots;
+        bool open    = true;
+        this->literalPrefix(*root, regex->prefix, open);
+        regex->prepare();
+        return regex;
+    }
+
+  private:
+    string_view pattern;
+    size_t at{0};
+    size_t groups{0};
+    size_t slots{0};
+    string error{};
+    Regex* regex{nullptr};
+
+    void fail(string message) {
+        if (this->error.empty()) this->error = message + " at position " + to_string(this->at);
+    }
+
+    bool more() { return this->at < this->pattern.size(); }
+
+    bitset<256> folded(bitset<256> set) {
+        if (this->regex->ignoreCase)
+            for (int c = 'a'; c <= 'z'; c++)
+                if (set[c] || set[toupper(c)]) set[c] = set[toupper(c)] = true;
+        return set;
+    }
+
+    unique_ptr<RegexNode> bytesNode(bitset<256> set) {
+        unique_ptr<RegexNode> node = regexNode(nodeBytes);
+        node->bytes                = this->folded(set);
+        return node;
+    }
+
+    unique_ptr<RegexNode> parseAlternation(int depth) {
+        if (depth > REGEX_MAX_DEPTH) {
+            this->fail("groups nested too deeply");
+            return nullptr;
+        }
+        unique_ptr<RegexNode> first = this->parseConcat(depth);
+        if (first == nullptr || !this->more() || this->pattern[this->at] != '|') return first;
+        unique_ptr<RegexNode> alternate = regexNode(nodeAlternate);
+        alternate->children.push_back(move(first));
+        while (this->more() && this->pattern[this->at] == '|') {
+            this->at++;
+            unique_ptr<RegexNode> next = this->parseConcat(depth);
+            if (next == nullptr) return nullptr;
+            alternate->children.push_back(move(next));
+        }
+        return alternate;
+    }
+
+    unique_ptr<RegexNode> parseConcat(int depth) {
+        unique_ptr<RegexNode> concat = regexNode(nodeConcat);
+        while (this->more() && this->pattern[this->at] != '|' && this->pattern[this->at] != ')') {
+            unique_ptr<RegexNode> item = this->parseRepeat(depth);
+            if (item == nullptr) return nullptr;
+            concat->children.push_back(move(item));
+        }
+        if (concat->children.size() == 1) return move(concat->children[0]);
+        return concat;
+    }
+
+    unique_ptr<RegexNode> parseRepeat(int depth) {
+        unique_ptr<RegexNode> atom = this->parseAtom(depth);
+        bool repeated              = false;
+        while (atom != nullptr && this->more()) {
+            size_t start = this->at;
+            char c       = this->pattern[this->at];
+            int min = c == '+' ? 1 : 0, max = c == '?' ? 1 : -1;
+            if (c == '*' || c == '+' || c == '?') this->at++;
+            else if (c != '{' || !this->parseBounds(min, max)) return this->error.empty() ? move(atom) : nullptr;
+            // a bare assertion cannot be repeated, though one in a group can
+            bool assertion = atom->kind == nodeBegin || atom->kind == nodeEnd || atom->kind == nodeBoundary ||
+                             atom->kind == nodeNotBoundary;
+            if (repeated || (assertion && this->pattern[start - 1] != ')')) {
+                this->at = start;
+                this->fail(repeated ? "multiple repeat" : "nothing to repeat");
+                return nullptr;
+            }
+            repeated                     = true;
+            unique_ptr<RegexNode> repeat = regexNode(nodeRepeat);
+            repeat->min                  = min;
+            repeat->max                  = max;
+            if (this->more() && this->pattern[this->at] == '?') {
+                repeat->greedy = false;
+                this->at++;
+            }
+            repeat->children.push_back(move(atom));
+            atom = move(repeat);
+        }
+        return atom;
+    }
+
+    // {n}, {n,} or {n,m}; anything else leaves the { to be read as itself
+    bool parseBounds(int& min, int& max) {
+        size_t position = this->at + 1;
+        auto number     = [&](int& value) {
+            size_t start = position;
+            long parsed  = 0;
+            while (position < this->pattern.size() && isdigit((unsigned char)this->pattern[position]) &&
+                   parsed <= REGEX_MAX_REPEAT)
+                parsed = parsed * 10 + (this->pattern[position++] - '0');
+            value = (int)parsed;
+            return position > start;
+        };
+        if (!number(min)) return false;
+        max = min;
+        if (position < this->pattern.size() && this->pattern[position] == ',') {
+            position++;
+            if (!number(max)) max = -1;
+        }
+        if (position >= this->pattern.size() || this->pattern[position] != '}') return false;
+        if (min > REGEX_MAX_REPEAT || max > REGEX_MAX_REPEAT) {
+            this->fail("repeat count over " + to_string(REGEX_MAX_REPEAT));
+            return false;
+        }
+        if (max != -1 && min > max) {
+            this->fail("repeat minimum greater than its maximum");
+            return false;
+        }
+        this->at = position + 1;
+        return true;
+    }
+
+    unique_ptr<RegexNode> parseAtom(int depth) {
+        char c = this->pattern[this->at];
+        switch (c) {
+            case '(': {
+                this->at++;
+                int group = 0;
+                if (this->pattern.substr(this->at, 2) == "?:") this->at += 2;
+                else if (this->more() && this->pattern[this->at] == '?') {
+                    this->fail("unknown group syntax");
+                    return nullptr;
+                } else group = ++this->groups;
+                unique_ptr<RegexNode> inner = this->parseAlternation(depth + 1);
+                if (inner == nullptr) return nullptr;
+                if (!this->more() || this->pattern[this->at] != ')') {
+                    this->fail("missing )");
+                    return nullptr;
+                }
+                this->at++;
+                if (group == 0) return inner;
+                unique_ptr<RegexNode> node = regexNode(nodeGroup);
+                node->group                = group;
+                node->children.push_back(move(inner));
+                return node;
+            }
+            case '*':
+            case '+':
+            case '?': this->fail("nothing to repeat"); return nullptr;
+            case '.': {
+                this->at++;
+                bitset<256> any{};
+                any.set();
+                any['\n'] = false;
+                return this->bytesNode(any);
+            }
+            case '[': return this->parseClass();
+            case '^': this->at++; return regexNode(nodeBegin);
+            case '$': this->at++; return regexNode(nodeEnd);
+            case '\\': return this->parseEscape();
+            default: {
+                this->at++;
+                bitset<256> literal{};
+                literal[(unsigned char)c] = true;
+                return this->bytesNode(literal);
+            }
+        }
+    }
+
+    unique_ptr<RegexNode> parseEscape() {
+        this->at++;
+        if (!this->more()) {
+            this->fail("pattern ends with a backslash");
+            return nullptr;
+        }
+        char escape = this->pattern[this->at];
+        if (escape == 'b' || escape == 'B') {
+            this->at++;
+            this->regex->boundaries = true;
+            return regexNode(escape == 'b' ? nodeBoundary : nodeNotBoundary);
+        }
+        if (escape >= '1' && escape <= '9') {
+            size_t group = escape - '0';
+            if (group > this->groups) {
+                this->fail("invalid group reference \\" + string(1, escape));
+                return nullptr;
+            }
+            this->at++;
+            this->regex->backrefs      = true;
+            unique_ptr<RegexNode> node = regexNode(nodeBackref);
+            node->group                = group;
+            return node;
+        }
+        bitset<256> set{};
+        if (classEscape(escape, set)) {
+            this->at++;
+            return this->bytesNode(set);
+        }
+        unsigned char byte;
+        if (!this->escapedByte(byte)) return nullptr;
+        set[byte] = true;
+        return this->bytesNode(set);
+    }
+
+    // the byte an escape inside or outside a class stands for; at is just past the backslash
+    bool escapedByte(unsigned char& byte) {
+        char escape = this->pattern[this->at++];
+        switch (escape) {
+            case 't': byte = '\t'; return true;
+            case 'n': byte = '\n'; return true;
+            case 'r': byte = '\r'; return true;
+            case 'f': byte = '\f'; return true;
+            case 'v': byte = '\v'; return true;
+            case 'b': byte = '\b'; return true;
+            case 'x': {
+                if (this->at + 2 > this->pattern.size() || !isxdigit((unsigned char)this->pattern[this->at]) ||
+                    !isxdigit((unsigned char)this->pattern[this->at + 1])) {
+                    this->fail("\\x needs two hex digits");
+                    return false;
+                }
+                byte = (unsigned char)stoi(string(this->pattern.substr(this->at, 2)), nullptr, 16);
+                this->at += 2;
+                return true;
+            }
+        }
+        if (isalnum((unsigned char)escape)) {
+            this->at--;
+            this->fail("bad escape \\" + string(1, escape));
+            return false;
+        }
+        byte = escape;
+        return true;
+    }
+
+    unique_ptr<RegexNode> parseClass() {
+        this->at++;
+        bool negated = this->more() && this->pattern[this->at] == '^';
+        if (negated) this->at++;
+        bitset<256> set{};
+        bool first = true;
+        while (true) {
+            if (!this->more()) {
+                this->fail("unterminated character set");
+                return nullptr;
+            }
+            if (this->pattern[this->at] == ']' && !first) {
+                this->at++;
+                break;
+            }
+            first = false;
+            unsigned char low;
+            if (this->pattern[this->at] == '\\') {
+                this->at++;
+                if (!this->more()) continue;
+                if (classEscape(this->pattern[this->at], set)) {
+                    this->at++;
+                    continue;
+                }
+                if (!this->escapedByte(low)) return nullptr;
+            } else low = this->pattern[this->at++];
+
+            unsigned char high = low;
+            if (this->at + 1 < this->pattern.size() && this->pattern[this->at] == '-' &&
+                this->pattern[this->at + 1] != ']') {
+                this->at++;
+                if (this->pattern[this->at] == '\\') {
+                    this->at++;
+                    if (!this->more() || !this->escapedByte(high)) {
+                        this->fail("bad character range");
+                        return nullptr;
+                    }
+                } else high = this->pattern[this->at++];
+                if (high < low) {
+                    this->fail("bad character range");
+                    return nullptr;
+                }
+            }
+            for (int c = low; c <= high; c++)
+                set[c] = true;
+        }
+        set = this->folded(set);
+        if (negated) set.flip();
+        unique_ptr<RegexNode> node = regexNode(nodeBytes);
+        node->bytes                = set;
+        return node;
+    }
+
+    int push(Regex::Op op, int x = 0, int y = 0) {
+        this->regex->program.push_back({op, x, y});
+        return this->regex->program.size() - 1;
+    }
+
+    int here() { return this->regex->program.size(); }
+
+    int setIndex(const bitset<256>& set) {
+        vector<bitset<256>>& sets = this->regex->sets;
+        for (size_t i = 0; i < sets.size(); i++)
+            if (sets[i] == set) return i;
+        sets.push_back(set);
+        return sets.size() - 1;
+    }
+
+    bool nullable(const RegexNode& node) {
+        switch (node.kind) {
+            case nodeBytes: return false;
+            case nodeConcat:
+                for (auto& child : node.children)
+                    if (!this->nullable(*child)) return false;
+                return true;
+            case nodeAlternate:
+                for (auto& child : node.children)
+                    if (this->nullable(*child)) return true;
+                return false;
+            case nodeRepeat: return node.min == 0 || this->nullable(*node.children[0]);
+            case nodeGroup: return this->nullable(*node.children[0]);
+            default: return true;
+        }
+    }
+
+    void emit(const RegexNode& node) {
+        if (this->regex->program.size() > REGEX_MAX_PROGRAM) return;
+        vector<Regex::Inst>& program = this->regex->program;
+        switch (node.kind) {
+            case nodeBytes: this->push(Regex::opBytes, this->setIndex(node.bytes)); break;
+            case nodeConcat:
+                for (auto& child : node.children)
+                    this->emit(*child);
+                break;
+            case nodeAlternate: {
+                vector<int> exits{};
+                for (size_t i = 0; i < node.children.size(); i++) {
+                    int split = i + 1 < node.children.size() ? this->push(Regex::opSplit) : -1;
+                    if (split >= 0) program[split].x = this->here();
+                    this->emit(*node.children[i]);
+                    if (split < 0) break;
+                    exits.push_back(this->push(Regex::opJump));
+                    program[split].y = this->here();
+                }
+                for (int exit : exits)
+                    program[exit].x = this->here();
+                break;
+            }
+            case nodeGroup:
+                this->push(Regex::opSave, 2 * node.group);
+                this->emit(*node.children[0]);
+                this->push(Regex::opSave, 2 * node.group + 1);
+                break;
+            case nodeRepeat: this->emitRepeat(node); break;
+            case nodeBegin: this->push(Regex::opBegin); break;
+            case nodeEnd: this->push(Regex::opEnd); break;
+            case nodeBoundary: this->push(Regex::opBoundary); break;
+            case nodeNotBoundary: this->push(Regex::opNotBoundary); break;
+            case nodeBackref: this->push(Regex::opBackref, node.group); break;
+        }
+    }
+
+    // a split's x is taken first, so a greedy one points x at the repeated part and a lazy one past it
+    void branch(int split, int body, int skip, bool greedy) {
+        this->regex->program[split].x = greedy ? body : skip;
+        this->regex->program[split].y = greedy ? skip : body;
+    }
+
+    void emitRepeat(const RegexNode& node) {
+        const RegexNode& body = *node.children[0];
+        for (int i = 0; i < node.min && this->here() <= (int)REGEX_MAX_PROGRAM; i++)
+            this->emit(body);
+        if (node.max == -1) {
+            // A part that can match nothing must not go round again without
+            // moving, so where each time round starts is kept and checked;
+            // the DFA gets the same from never revisiting a state.
+            int loop     = this->push(Regex::opSplit);
+            int progress = this->nullable(body) ? this->slots++ : -1;
+            if (progress >= 0) this->push(Regex::opSave, progress);
+            this->emit(body);
+            if (progress >= 0) this->push(Regex::opProgress, progress);
+            this->push(Regex::opJump, loop);
+            this->branch(loop, loop + 1, this->here(), node.greedy);
+            return;
+        }
+        vector<int> splits{};
+        for (int i = node.min; i < node.max && this->here() <= (int)REGEX_MAX_PROGRAM; i++) {
+            splits.push_back(this->push(Regex::opSplit));
+            this->emit(body);
+        }
+        for (int split : splits)
+            this->branch(split, split + 1, this->here(), node.greedy);
+    }
+
+    // the bytes every match starts with; open is cleared at the first node that is not a single byte
+    void literalPrefix(const RegexNode& node, string& prefix, bool& open) {
+        switch (node.kind) {
+            case nodeBytes:
+                if (node.bytes.count() != 1) open = false;
+                else
+                    for (int c = 0; c < 256; c++)
+                        if (node.bytes[c]) prefix += (char)c;
+                break;
+            case nodeConcat:
+                for (size_t i = 0; i < node.children.size() && open; i++)
+                    this->literalPrefix(*node.children[i], prefix, open);
+                break;
+            case nodeGroup: this->literalPrefix(*node.children[0], prefix, open); break;
+            case nodeBegin: break;
+            default: open = false;
+        }
+    }
+};
+
+shared_ptr<Regex> Regex::compile(string_view pattern, string& error) {
+    RegexCompiler compiler(pattern);
+    return compiler.compile(error);
+}
+
+shared_ptr<Regex> Regex::cached(string_view pattern, string& error) {
+    // per thread, so the DFA states a pattern builds up as it is used need no lock
+    typedef list<pair<string, shared_ptr<Regex>>> Recent;
+    thread_local Recent recent{};
+    thread_local unordered_map<string_view, Recent::iterator> index{};
+
+    auto found = index.find(pattern);
+    if (found != index.end()) {
+        recent.splice(recent.begin(), recent, found->second);
+        return found->second->second;
+    }
+    shared_ptr<Regex> regex = Regex::compile(pattern, error);
+    if (regex == nullptr) return nullptr;
+    recent.emplace_front(string(pattern), regex);
+    index[recent.front().first] = recent.begin();
+    if (recent.size() > REGEX_CACHE_SIZE) {
+        index.erase(recent.back().first);
+        recent.pop_back();
+    }
+    return regex;
+}
+
+void Regex::prepare() {
+    int classes = 0;
+    for (int c = 0; c < 256; c++) {
+        bool differs = c == 0;
+        for (size_t i = 0; i < this->sets.size() && !differs; i++)
+            differs = this->sets[i][c] != this->sets[i][c - 1];
+        if (differs) {
+            this->classByte.push_back(c);
+            classes++;
+        }
+        this->classOf[c] = classes - 1;
+    }
+}
+
+bool Regex::dfaUsable() { return !this->backrefs && !this->boundaries && !this->dfaGaveUp; }
+
+// Adds the threads pc leads to without reading a byte, best first. Reaching
+// the match cuts off every thread after it unless cut is false.
+void Regex::closure(
+    vector<int>& threads, int pc, bool atBegin, bool atEnd, bool cut, vector<bool>& seen, bool& matched
+) {
+    vector<int> pending{pc};
+    while (!pending.empty()) {
+        int next = pending.back();
+        pending.pop_back();
+        if (seen[next]) continue;
+        seen[next]        = true;
+        const Inst& inst = this->program[next];
+        switch (inst.op) {
+            case opBytes: threads.push_back(next); break;
+            case opSplit:
+                pending.push_back(inst.y);
+                pending.push_back(inst.x);
+                break;
+            case opJump: pending.push_back(inst.x); break;
+            case opSave:
+            case opProgress: pending.push_back(next + 1); break;
+            case opMatch:
+                matched = true;
+                if (cut) return;
+                break;
+            case opBegin:
+                if (atBegin) pending.push_back(next + 1);
+                break;
+            // kept until the end of the text shows whether it holds
+            case opEnd:
+                if (atEnd) pending.push_back(next + 1);
+                else threads.push_back(next);
+                break;
+            // patterns with these never get a DFA
+            default: break;
+        }
+    }
+}
+
+int Regex::state(vector<int> threads, bool matched, bool searching, bool whole) {
+    string key((const char*)threads.data(), threads.size() * sizeof(int));
+    key += (char)(matched | searching << 1 | whole << 2);
+    auto found = this->stateIds.find(key);
+    if (found != this->stateIds.end()) return found->second;
+    if (this->states.size() >= REGEX_MAX_STATES) {
+        this->dfaGaveUp = true;
+        this->states.clear();
+        this->stateIds.clear();
+        return -1;
+    }
+    this->states.push_back({move(threads), matched, searching, whole, -1, vector<int>(this->classByte.size(), -1)});
+    this->stateIds.emplace(move(key), this->states.size() - 1);
+    return this->states.size() - 1;
+}
+
+int Regex::startState(bool atBegin, bool whole) {
+    vector<int> threads{};
+    vector<bool> seen(this->program.size());
+    bool matched = false;
+    this->closure(threads, 0, atBegin, false, !whole, seen, matched);
+    return this->state(move(threads), matched, !whole && !matched, whole);
+}
+
+int Regex::step(int from, unsigned char byte) {
+    int cls    = this->classOf[byte];
+    int cached = this->states[from].next[cls];
+    if (cached >= 0) return cached;
+
+    // state() may move the states, so nothing here holds on to one
+    vector<int> current = this->states[from].threads;
+    bool searching      = this->states[from].searching;
+    bool whole          = this->states[from].whole;
+    vector<int> threads{};
+    vector<bool> seen(this->program.size());
+    bool matched = false;
+    for (int pc : current) {
+        const Inst& inst = this->program[pc];
+        if (inst.op == opBytes && this->sets[inst.x][byte])
+            this->closure(threads, pc + 1, false, false, !whole, seen, matched);
+        if (matched && !whole) break;
+    }
+    // a match that starts here ranks below every thread that started earlier
+    if (searching && !matched) this->closure(threads, 0, false, false, true, seen, matched);
+    int next = this->state(move(threads), matched, searching && !matched, whole);
+    if (next >= 0) this->states[from].next[cls] = next;
+    return next;
+}
+
+bool Regex::endMatch(int id, bool atBegin) {
+    if (!atBegin && this->states[id].matchesAtEnd >= 0) return this->states[id].matchesAtEnd;
+    vector<int> threads{};
+    vector<bool> seen(this->program.size());
+    bool matched = false;
+    for (int pc : this->states[id].threads)
+        if (!matched && this->program[pc].op == opEnd)
+            this->closure(threads, pc + 1, atBegin, true, true, seen, matched);
+    // an empty text is the only one whose end is also its start, and is not worth remembering
+    if (!atBegin) this->states[id].matchesAtEnd = matched;
+    return matched;
+}
+
+int Regex::dfaWhole(string_view text) {
+    if (this->wholeStart < 0) this->wholeStart = this->startState(true, true);
+    int id = this->wholeStart;
+    for (size_t pos = 0; pos < text.size() && id >= 0; pos++) {
+        if (this->states[id].threads.empty()) return 0;
+        id = this->step(id, text[pos]);
+    }
+    if (id < 0) return -1;
+    return this->states[id].matched || this->endMatch(id, text.empty());
+}
+
+size_t Regex::dfaEnd(string_view text, size_t from) {
+    if (this->searchRestart < 0) this->searchRestart = this->startState(false, false);
+    if (from == 0 && this->searchStart < 0) this->searchStart = this->startState(true, false);
+    int id = from == 0 ? this->searchStart : this->searchRestart;
+    if (id < 0 || this->dfaGaveUp) return DFA_GAVE_UP;
+    size_t end = this->states[id].matched ? from : string_view::npos;
+    for (size_t pos = from; pos < text.size(); pos++) {
+        // with only a fresh thread running, nothing can match before the next place the prefix occurs
+        if (id == this->searchRestart && !this->prefix.empty()) {
+            pos = text.find(this->prefix, pos);
+            if (pos == string_view::npos) return end;
+        }
+        id = this->step(id, text[pos]);
+        if (id < 0) return DFA_GAVE_UP;
+        if (this->states[id].matched) end = pos + 1;
+        if (this->states[id].threads.empty() && !this->states[id].searching) return end;
+    }
+    if (this->endMatch(id, text.empty())) end = text.size();
+    return end;
+}
+
+bool Regex::backtrack(string_view text, size_t from, size_t limit, Placement placement, vector<size_t>& bounds) {
+    // Once a pair has failed it fails whichever way it is reached again, and
+    // from whichever start; a backreference makes that depend on the groups.
+    // The marks grow with the furthest position reached, not with the text.
+    bool marking = !this->backrefs;
+    vector<bool> tried{};
+    vector<size_t> slots(this->slots);
+    // a job either goes on from pc at pos, or puts a slot back to what it was
+    typedef struct Job {
+        int pc;
+        size_t pos;
+        int slot;
+    } Job;
+    vector<Job> jobs{};
+
+    for (size_t start = from; start <= limit; start++) {
+        if (placement == placeAnywhere && !this->prefix.empty()) {
+            start = text.find(this->prefix, start);
+            if (start == string_view::npos || start + this->prefix.size() > limit) return false;
+        }
+        fill(slots.begin(), slots.end(), string_view::npos);
+        jobs.push_back({0, start, -1});
+        while (!jobs.empty()) {
+            Job job = jobs.back();
+            jobs.pop_back();
+            if (job.slot >= 0) {
+                slots[job.slot] = job.pos;
+                continue;
+            }
+            int pc     = job.pc;
+            size_t pos = job.pos;
+            while (true) {
+                if (marking) {
+                    size_t mark = (pos - from) * this->program.size() + pc;
+                    if (mark >= tried.size()) {
+                        if (mark >= BACKTRACK_MARK_BITS) marking = false;
+                        else tried.resize(min(max(2 * tried.size(), mark + this->program.size()), BACKTRACK_MARK_BITS));
+                    }
+                    if (marking && tried[mark]) break;
+                    if (marking) tried[mark] = true;
+                }
+                const Inst& inst = this->program[pc];
+                switch (inst.op) {
+                    case opBytes:
+                        if (pos < limit && this->sets[inst.x][(unsigned char)text[pos]]) {
+                            pc++;
+                            pos++;
+                            continue;
+                        }
+                        break;
+                    case opSplit:
+                        jobs.push_back({inst.y, pos, -1});
+                        pc = inst.x;
+                        continue;
+                    case opJump: pc = inst.x; continue;
+                    case opSave:
+                        jobs.push_back({0, slots[inst.x], inst.x});
+                        slots[inst.x] = pos;
+                        pc++;
+                        continue;
+                    case opProgress:
+                        if (slots[inst.x] == pos) break;
+                        pc++;
+                        continue;
+                    case opMatch:
+                        if (placement == placeWhole && pos != limit) break;
+                        if (placement == placeNotEmpty && pos == start) break;
+                        bounds.assign(slots.begin(), slots.begin() + 2 * (this->groups + 1));
+                        return true;
+                    case opBegin:
+                        if (pos != 0) break;
+                        pc++;
+                        continue;
+                    case opEnd:
+                        if (pos != text.size()) break;
+                        pc++;
+                        continue;
+                    case opBoundary:
+                    case opNotBoundary: {
+                        bool before = pos > 0 && isWordByte(text[pos - 1]);
+                        bool after  = pos < text.size() && isWordByte(text[pos]);
+                        if ((before != after) != (inst.op == opBoundary)) break;
+                        pc++;
+                        continue;
+                    }
+                    case opBackref: {
+                        size_t groupStart = slots[2 * inst.x], groupEnd = slots[2 * inst.x + 1];
+                        if (groupStart == string_view::npos || groupEnd == string_view::npos) break;
+                        size_t length = groupEnd - groupStart;
+                        if (pos + length > limit) break;
+                        bool same = true;
+                        for (size_t i = 0; i < length && same; i++) {
+                            unsigned char a = text[groupStart + i], b = text[pos + i];
+                            same            = a == b || (this->ignoreCase && tolower(a) == tolower(b));
+                        }
+                        if (!same) break;
+                        pos += length;
+                        pc++;
+                        continue;
+                    }
+                }
+                // the thread failed
+                break;
+            }
+        }
+        if (placement != placeAnywhere) break;
+    }
+    return false;
+}
+
+bool Regex::matches(string_view text) {
+    if (this->dfaUsable()) {
+        int whole = this->dfaWhole(text);
+        if (whole >= 0) return whole;
+    }
+    vector<size_t> bounds{};
+    return this->backtrack(text, 0, text.size(), placeWhole, bounds);
+}
+
+bool Regex::search(string_view text, size_t from, vector<size_t>& bounds) {
+    if (from > text.size()) return false;
+    size_t limit = text.size();
+    if (this->dfaUsable()) {
+        size_t end = this->dfaEnd(text, from);
+        if (end == string_view::npos) return false;
+        // the backtracker then only has to find where that match starts, and its groups
+        if (end != DFA_GAVE_UP) limit = end;
+    }
+    return this->backtrack(text, from, limit, placeAnywhere, bounds);
+}
+
+bool Regex::next(string_view text, vector<size_t>& bounds) {
+    if (bounds.empty()) return this->search(text, 0, bounds);
+    size_t from = bounds[1];
+    if (bounds[0] != from) return this->search(text, from, bounds);
+    // the same empty match must not be found again, but a longer one may start there
+    if (this->backtrack(text, from, text.size(), placeNotEmpty, bounds)) return true;
+    return this->search(text, from + 1, bounds);
+}
@@ -0,0 +1,135 @@
+#pragma once
+#include <bitset>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+// Regular expressions for match(), search(), replace() and findall().
+//
+// A pattern is parsed and compiled to a small program of byte-set, split,
+// jump, save and assertion instructions, which two engines run. A lazy DFA,
+// built a state at a time as the text asks for it, finds whether and where a
+// match ends with one table lookup per byte. A backtracker that marks each
+// (instruction, position) pair it has tried, so no pair is tried twice,
+// then finds where that match starts and what its groups hold by going over
+// just the span the DFA found. Patterns the DFA cannot run, those with word
+// boundaries or backreferences, are backtracked over the whole text; with
+// backreferences the marks no longer hold, so those can take exponential time.
+//
+// Syntax: literals, ., [classes] with ranges and negation, \d \w \s \D \W \S,
+// \t \n \r and escaped punctuation, ^ and $ (start and end of text), \b \B,
+// (groups), (?:non-capturing groups), |, the quantifiers * + ? {n} {n,}
+// {n,m} and their lazy forms ending in ?, backreferences \1 to \9, and a
+// leading (?i) for case-insensitive matching. Matches are leftmost-first, as
+// in Perl: the first alternative and the greediest repetition that can match
+// win. Going through the matches also works as in Perl: each search starts
+// where the last match ended, and after an empty match a match that starts
+// there must not be empty, so findall("aaab", "a??") gives "", "a", "", "a",
+// "", "a", "" and "" rather than only the empty matches.
+
+class Regex {
+  public:
+    // compiles pattern; on failure returns null and says why in error
+    static shared_ptr<Regex> compile(string_view, string&);
+    // like compile, but looks in a per-thread cache of the patterns used most recently first
+    static shared_ptr<Regex> cached(string_view, string&);
+
+    // capture groups, not counting the whole match
+    size_t groups{0};
+
+    // whether the whole of text matches
+    bool matches(string_view);
+    // Finds the leftmost match that starts at or after from. bounds gets the
+    // start and end of the match and then of each group, with npos for a group
+    // that took no part in it.
+    bool search(string_view, size_t, vector<size_t>&);
+    // Finds the match after the one in bounds, or the first one when bounds
+    // is empty, and puts it in bounds.
+    bool next(string_view, vector<size_t>&);
+
+  private:
+    enum Op {
+        opBytes,
+        opSplit,
+        opJump,
+        opSave,
+        opProgress,
+        opMatch,
+        opBegin,
+        opEnd,
+        opBoundary,
+        opNotBoundary,
+        opBackref
+    };
+
+    // opBytes: x indexes sets. opSplit: x is tried before y. opJump: to x.
+    // opSave: x is the slot to set. opProgress fails unless the position has
+    // moved on from the one in slot x. opBackref: x is a group.
+    typedef struct Inst {
+        Op op;
+        int x;
+        int y;
+    } Inst;
+
+    // A DFA state is the list of program positions the NFA threads are at,
+    // best first, cut off after the first that matched.
+    typedef struct DfaState {
+        vector<int> threads;
+        // a match ends where this state is entered
+        bool matched;
+        // no match has been seen yet, so a new thread starts at every position
+        bool searching;
+        // for matches(): any path to the end of the text will do, so no thread is cut off
+        bool whole;
+        // whether $ lets the state match at the end of the text: -1 until known
+        int matchesAtEnd;
+        // per byte class, the state it leads to, or -1 until first needed
+        vector<int> next;
+    } DfaState;
+
+    vector<Inst> program{};
+    vector<bitset<256>> sets{};
+    size_t slots{0};
+    bool ignoreCase{false};
+    bool backrefs{false};
+    bool boundaries{false};
+    // set once the DFA has needed more states than it may keep
+    bool dfaGaveUp{false};
+    // what every match starts with, so the search can skip ahead to it
+    string prefix{};
+
+    // bytes no set tells apart share a class and so share DFA transitions
+    unsigned char classOf[256]{};
+    vector<unsigned char> classByte{};
+    vector<DfaState> states{};
+    unordered_map<string, int> stateIds{};
+    // the states a DFA run starts in: for matches(), and for a search from the start of the text or later
+    int wholeStart{-1};
+    int searchStart{-1};
+    int searchRestart{-1};
+
+    Regex() = default;
+    friend class RegexCompiler;
+
+    void prepare();
+    bool dfaUsable();
+    void closure(vector<int>&, int, bool, bool, bool, vector<bool>&, bool&);
+    int state(vector<int>, bool, bool, bool);
+    int startState(bool, bool);
+    int step(int, unsigned char);
+    // whether a $ thread matches at the end of the text, which is also its start when it is empty
+    bool endMatch(int, bool);
+    // 1 when the whole text matches, 0 when it does not, -1 when the DFA gave up
+    int dfaWhole(string_view);
+    // the end of the leftmost match from from; npos when there is none, and DFA_GAVE_UP
+    size_t dfaEnd(string_view, size_t);
+    // where backtrack() may put a match: anywhere from on, over all of the
+    // text, or starting at from without being empty
+    enum Placement { placeAnywhere, placeWhole, placeNotEmpty };
+    // the leftmost match placed as asked that starts at or after from and ends by limit
+    bool backtrack(string_view, size_t, size_t, Placement, vector<size_t>&);
+};
@@ -1,5 +1,11 @@
 #include "repl.hpp"
 
+#include "evaluator.hpp"
+#include "io.hpp"
+
+#include <cstring>
+#include <unistd.h>
+
 int repl(string& input, shared_ptr<Environment> env) {
     unique_ptr<AST> ast(new AST(input));
     ast->parseProgram();
@@ -28,27 +34,30 @@ int repl(string& input, shared_ptr<Environment> env) {
     return 0;
 }
 
-int repl_file(string& input, shared_ptr<Environment> env) {
+int repl_file(string& input, shared_ptr<Environment> env, bool compileClosures) {
     unique_ptr<AST> ast(new AST(input));
     ast->parseProgram();
 
     if (ast->parser->errors.size() != 0) {
-        printParserErrors(ast->parser->errors);
-        return 0;
+        // there is no curses pad when running a file
+        cout << "parser error:\n";
+        for (auto err : ast->parser->errors) cout << '\t' << err;
+        return 1;
     }
 
     setErrorGarbageCollector(&env);
 
-    for (auto stmt : ast->Statements) {
-        shared_ptr<Object> evaluated = evalNode(stmt, env);
+    vector<Closure> program{};
+    if (compileClosures)
+        for (auto stmt : ast->Statements)
+            program.push_back(compileNode(stmt));
+
+    for (int i = 0; i < ast->Statements.size(); i++) {
+        shared_ptr<Object> evaluated =
+            compileClosures ? program[i](env) : evalNode(ast->Statements[i], env);
         if (evaluated == nullptr) continue;
         switch (evaluated->type) {
             // case QUIT_OBJ: return 1; break;
-            case PRINT_OBJ: {
-                shared_ptr<Print> print = dynamic_pointer_cast<Print>(evaluated);
-                cout << print->value << '\n';
-                break;
-            }
             case ERROR_OBJ: {
                 shared_ptr<Error> result = dynamic_pointer_cast<Error>(evaluated);
                 cout << result->message.c_str() << '\n';
@@ -56,6 +65,57 @@ int repl_file(string& input, shared_ptr<Environment> env) {
             }
         }
     }
+    waitForTasks();
+    return 0;
+}
+
+// Runs the script once, then calls its process(line) for every line of stdin
+// and finally its finish(), when it has one. Functions cannot change the
+// script's variables, so a process(line, state) is also passed what it
+// returned for the line before (0 at first), and a finish(state) what it
+// returned for the last. Lines are views of the blocks LineReader reads, so
+// their text is never copied; each line still gets a String object of its
+// own, since process may keep it and Strings never change.
+int repl_lines(string& input, shared_ptr<Environment> env, bool compileClosures) {
+    // printed lines are written out a block at a time, even to a terminal
+    setvbuf(stdout, nullptr, _IOFBF, 1 << 16);
+    if (repl_file(input, env, compileClosures) != 0) return 1;
+    shared_ptr<Object> process = env->get("process");
+    if (process == nullptr || process->type != FUNCTION_OBJ) {
+        cout << "-n needs the script to define fn process(line)\n";
+        return 1;
+    }
+
+    vector<shared_ptr<Object>> args{nullptr};
+    shared_ptr<Object> state(new Integer(0));
+    bool stateful = static_pointer_cast<Function>(process)->parameters.size() > 1;
+    if (stateful) args.push_back(state);
+
+    LineReader reader(STDIN_FILENO);
+    shared_ptr<const string_view> block{};
+    size_t offset, length;
+    while (reader.next(block, offset, length)) {
+        // a view of the block, and a String of its own since process may keep it
+        args[0]                   = shared_ptr<Object>(new String(block, offset, length));
+        shared_ptr<Object> result = applyFunction(process, args, env);
+        if (isError(result)) {
+            cout << static_pointer_cast<Error>(result)->message << '\n';
+            waitForTasks();
+            return 1;
+        }
+        // a line that returns nothing leaves the state as it was
+        if (stateful && result != nullptr) args[1] = state = result;
+    }
+    if (reader.error != 0) cout << "Could not read stdin: " << strerror(reader.error) << '\n';
+
+    shared_ptr<Object> finish = env->get("finish");
+    if (finish != nullptr && finish->type == FUNCTION_OBJ) {
+        vector<shared_ptr<Object>> last{};
+        if (static_pointer_cast<Function>(finish)->parameters.size() > 0) last.push_back(state);
+        shared_ptr<Object> result = applyFunction(finish, last, env);
+        if (isError(result)) cout << static_pointer_cast<Error>(result)->message << '\n';
+    }
+    waitForTasks();
     return 0;
 }
 
@@ -1,4 +1,5 @@
 #pragma once
+#include "closure.hpp"
 #include "globals.hpp"
 #include "object.hpp"
 #include "util.hpp"
@@ -13,6 +14,8 @@ string parseBlockIndent(string&, shared_ptr<Environment>);
 void setErrorGarbageCollector(shared_ptr<Environment>*);
 shared_ptr<Object> evalNode(shared_ptr<Node>, shared_ptr<Environment>);
 int repl(string&, shared_ptr<Environment>);
-int repl_file(string&, shared_ptr<Environment>);
+int repl_file(string&, shared_ptr<Environment>, bool = false);
+int repl_lines(string&, shared_ptr<Environment>, bool = false);
+void waitForTasks();
 void printParserErrors(vector<string>);
 ostringstream printIndentPrompt(int);
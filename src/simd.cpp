@@ -0,0 +1,210 @@
+#include "simd.hpp"
+
+#include <cstring>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+// one lane per "vector", for targets without a kernel set of their own
+namespace portable {
+const char* const isa = "portable";
+
+template <class S>
+struct Lanes {
+    typedef S Scalar;
+    typedef S V;
+    static const size_t width = 1;
+    static const bool divides = true;
+    static V load(const S* p) { return *p; }
+    static void store(S* p, V v) { *p = v; }
+    static V set1(S x) { return x; }
+    static V add(V a, V b) { return a + b; }
+    static V sub(V a, V b) { return a - b; }
+    static V mul(V a, V b) { return a * b; }
+    static V div(V a, V b) { return a / b; }
+    static V min(V a, V b) { return b < a ? b : a; }
+    static V max(V a, V b) { return b > a ? b : a; }
+    static unsigned equal(V a, V b) { return a == b; }
+};
+struct IntLanes : Lanes<int> {
+    typedef long long Wide;
+    static Wide widenLow(V v) { return v; }
+    static Wide widenHigh(V) { return 0; }
+    static Wide addWide(Wide a, Wide b) { return a + b; }
+};
+typedef Lanes<double> FloatLanes;
+
+#include "simd_kernels.hpp"
+} // namespace portable
+
+#if defined(__x86_64__)
+
+// SSE2 is part of x86-64 itself, so this set needs no runtime check
+namespace sse2 {
+const char* const isa = "sse2";
+
+struct IntLanes {
+    typedef int Scalar;
+    typedef __m128i V;
+    static const size_t width = 4;
+    static const bool divides = false;
+    static V load(const int* p) { return _mm_loadu_si128((const __m128i*)p); }
+    static void store(int* p, V v) { _mm_storeu_si128((__m128i*)p, v); }
+    static V set1(int x) { return _mm_set1_epi32(x); }
+    static V add(V a, V b) { return _mm_add_epi32(a, b); }
+    static V sub(V a, V b) { return _mm_sub_epi32(a, b); }
+    // SSE2 only multiplies the even lanes, so the odd ones are shifted down and multiplied separately
+    static V mul(V a, V b) {
+        V even = _mm_mul_epu32(a, b);
+        V odd  = _mm_mul_epu32(_mm_srli_si128(a, 4), _mm_srli_si128(b, 4));
+        return _mm_unpacklo_epi32(
+            _mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)), _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0))
+        );
+    }
+    static V div(V a, V) { return a; }
+    static V min(V a, V b) {
+        V greater = _mm_cmpgt_epi32(a, b);
+        return _mm_or_si128(_mm_and_si128(greater, b), _mm_andnot_si128(greater, a));
+    }
+    static V max(V a, V b) {
+        V greater = _mm_cmpgt_epi32(a, b);
+        return _mm_or_si128(_mm_and_si128(greater, a), _mm_andnot_si128(greater, b));
+    }
+    static unsigned equal(V a, V b) { return _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(a, b))); }
+    // SSE2 has no sign extension, so each lane is interleaved with its sign
+    typedef __m128i Wide;
+    static Wide widenLow(V v) { return _mm_unpacklo_epi32(v, _mm_cmpgt_epi32(_mm_setzero_si128(), v)); }
+    static Wide widenHigh(V v) { return _mm_unpackhi_epi32(v, _mm_cmpgt_epi32(_mm_setzero_si128(), v)); }
+    static Wide addWide(Wide a, Wide b) { return _mm_add_epi64(a, b); }
+};
+
+struct FloatLanes {
+    typedef double Scalar;
+    typedef __m128d V;
+    static const size_t width = 2;
+    static const bool divides = true;
+    static V load(const double* p) { return _mm_loadu_pd(p); }
+    static void store(double* p, V v) { _mm_storeu_pd(p, v); }
+    static V set1(double x) { return _mm_set1_pd(x); }
+    static V add(V a, V b) { return _mm_add_pd(a, b); }
+    static V sub(V a, V b) { return _mm_sub_pd(a, b); }
+    static V mul(V a, V b) { return _mm_mul_pd(a, b); }
+    static V div(V a, V b) { return _mm_div_pd(a, b); }
+    static V min(V a, V b) { return _mm_min_pd(a, b); }
+    static V max(V a, V b) { return _mm_max_pd(a, b); }
+    static unsigned equal(V a, V b) { return _mm_movemask_pd(_mm_cmpeq_pd(a, b)); }
+};
+
+#include "simd_kernels.hpp"
+} // namespace sse2
+
+#pragma GCC push_options
+#pragma GCC target("avx2")
+namespace avx2 {
+const char* const isa = "avx2";
+
+struct IntLanes {
+    typedef int Scalar;
+    typedef __m256i V;
+    static const size_t width = 8;
+    static const bool divides = false;
+    static V load(const int* p) { return _mm256_loadu_si256((const __m256i*)p); }
+    static void store(int* p, V v) { _mm256_storeu_si256((__m256i*)p, v); }
+    static V set1(int x) { return _mm256_set1_epi32(x); }
+    static V add(V a, V b) { return _mm256_add_epi32(a, b); }
+    static V sub(V a, V b) { return _mm256_sub_epi32(a, b); }
+    static V mul(V a, V b) { return _mm256_mullo_epi32(a, b); }
+    static V div(V a, V) { return a; }
+    static V min(V a, V b) { return _mm256_min_epi32(a, b); }
+    static V max(V a, V b) { return _mm256_max_epi32(a, b); }
+    static unsigned equal(V a, V b) { return _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(a, b))); }
+    typedef __m256i Wide;
+    static Wide widenLow(V v) { return _mm256_cvtepi32_epi64(_mm256_castsi256_si128(v)); }
+    static Wide widenHigh(V v) { return _mm256_cvtepi32_epi64(_mm256_extracti128_si256(v, 1)); }
+    static Wide addWide(Wide a, Wide b) { return _mm256_add_epi64(a, b); }
+};
+
+struct FloatLanes {
+    typedef double Scalar;
+    typedef __m256d V;
+    static const size_t width = 4;
+    static const bool divides = true;
+    static V load(const double* p) { return _mm256_loadu_pd(p); }
+    static void store(double* p, V v) { _mm256_storeu_pd(p, v); }
+    static V set1(double x) { return _mm256_set1_pd(x); }
+    static V add(V a, V b) { return _mm256_add_pd(a, b); }
+    static V sub(V a, V b) { return _mm256_sub_pd(a, b); }
+    static V mul(V a, V b) { return _mm256_mul_pd(a, b); }
+    static V div(V a, V b) { return _mm256_div_pd(a, b); }
+    static V min(V a, V b) { return _mm256_min_pd(a, b); }
+    static V max(V a, V b) { return _mm256_max_pd(a, b); }
+    static unsigned equal(V a, V b) { return _mm256_movemask_pd(_mm256_cmp_pd(a, b, _CMP_EQ_OQ)); }
+};
+
+#include "simd_kernels.hpp"
+} // namespace avx2
+#pragma GCC pop_options
+
+#pragma GCC push_options
+#pragma GCC target("avx512f")
+namespace avx512 {
+const char* const isa = "avx512";
+
+struct IntLanes {
+    typedef int Scalar;
+    typedef __m512i V;
+    static const size_t width = 16;
+    static const bool divides = false;
+    static V load(const int* p) { return _mm512_loadu_si512(p); }
+    static void store(int* p, V v) { _mm512_storeu_si512(p, v); }
+    static V set1(int x) { return _mm512_set1_epi32(x); }
+    static V add(V a, V b) { return _mm512_add_epi32(a, b); }
+    static V sub(V a, V b) { return _mm512_sub_epi32(a, b); }
+    static V mul(V a, V b) { return _mm512_mullo_epi32(a, b); }
+    static V div(V a, V) { return a; }
+    static V min(V a, V b) { return _mm512_min_epi32(a, b); }
+    static V max(V a, V b) { return _mm512_max_epi32(a, b); }
+    static unsigned equal(V a, V b) { return _mm512_cmpeq_epi32_mask(a, b); }
+    typedef __m512i Wide;
+    static Wide widenLow(V v) { return _mm512_cvtepi32_epi64(_mm512_castsi512_si256(v)); }
+    static Wide widenHigh(V v) { return _mm512_cvtepi32_epi64(_mm512_extracti64x4_epi64(v, 1)); }
+    static Wide addWide(Wide a, Wide b) { return _mm512_add_epi64(a, b); }
+};
+
+struct FloatLanes {
+    typedef double Scalar;
+    typedef __m512d V;
+    static const size_t width = 8;
+    static const bool divides = true;
+    static V load(const double* p) { return _mm512_loadu_pd(p); }
+    static void store(double* p, V v) { _mm512_storeu_pd(p, v); }
+    static V set1(double x) { return _mm512_set1_pd(x); }
+    static V add(V a, V b) { return _mm512_add_pd(a, b); }
+    static V sub(V a, V b) { return _mm512_sub_pd(a, b); }
+    static V mul(V a, V b) { return _mm512_mul_pd(a, b); }
+    static V div(V a, V b) { return _mm512_div_pd(a, b); }
+    static V min(V a, V b) { return _mm512_min_pd(a, b); }
+    static V max(V a, V b) { return _mm512_max_pd(a, b); }
+    static unsigned equal(V a, V b) { return _mm512_cmpeq_pd_mask(a, b); }
+};
+
+#include "simd_kernels.hpp"
+} // namespace avx512
+#pragma GCC pop_options
+
+#endif
+
+const SimdKernels& simdKernels() {
+    static const SimdKernels& selected = []() -> const SimdKernels& {
+#if defined(__x86_64__)
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx512f")) return avx512::kernels;
+        if (__builtin_cpu_supports("avx2")) return avx2::kernels;
+        return sse2::kernels;
+#else
+        return portable::kernels;
+#endif
+    }();
+    return selected;
+}
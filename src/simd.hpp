@@ -0,0 +1,44 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// Vectorized kernels over the native buffers of packed arrays. The kernels are
+// compiled once per instruction set (SSE2, AVX2 and AVX-512 on x86-64, plain
+// loops elsewhere) and the widest set the CPU supports is picked on first use.
+// Reductions over floats add up lanes in a different order than a loop would,
+// so their last bits can differ from a sequential sum.
+
+enum SimdOperator { simdAdd, simdSub, simdMul, simdDiv };
+
+typedef struct SimdKernels {
+    const char* name;
+    // added up in 64 bits, so the caller can tell when the sum does not fit an int
+    long long (*sumInt)(const int*, size_t);
+    double (*sumFloat)(const double*, size_t);
+    // min and max need at least one element
+    int (*minInt)(const int*, size_t);
+    double (*minFloat)(const double*, size_t);
+    int (*maxInt)(const int*, size_t);
+    double (*maxFloat)(const double*, size_t);
+    // position of the first element equal to the value, or the length
+    size_t (*findInt)(const int*, size_t, int);
+    size_t (*findFloat)(const double*, size_t, double);
+    int (*dotInt)(const int*, const int*, size_t);
+    double (*dotFloat)(const double*, const double*, size_t);
+    // out[i] = left[i * leftStep] <op> right[i * rightStep]; a step of 0
+    // repeats a scalar. Integer division must not see a zero divisor, nor
+    // INT_MIN divided by -1.
+    void (*mapInt)(int, const int*, size_t, const int*, size_t, int*, size_t);
+    void (*mapFloat)(int, const double*, size_t, const double*, size_t, double*, size_t);
+} SimdKernels;
+
+const SimdKernels& simdKernels();
+
+// Bit i of the result is the xor of bits 0 to i. Given the quotes of a block
+// of text, it marks the bytes from each opening quote up to its closing one;
+// the JSON and CSV scanners use it to ignore separators inside strings.
+static inline uint64_t prefixXor(uint64_t bits) {
+    for (int shift = 1; shift < 64; shift <<= 1)
+        bits ^= bits << shift;
+    return bits;
+}
@@ -0,0 +1,143 @@
+// Kernel bodies shared by every instruction set. There is deliberately no
+// include guard: simd.cpp includes this file once per instruction set, inside a
+// namespace that first defines IntLanes and FloatLanes (the vector type, its
+// width and its operations, with equal() giving one bit per matching lane)
+// and the name of the set. IntLanes also widens its lanes to 64 bits, half of
+// them at a time, so integer sums cannot wrap.
+
+template <class L>
+typename L::Scalar sum(const typename L::Scalar* a, size_t n) {
+    typedef typename L::Scalar S;
+    typename L::V acc = L::set1(0);
+    size_t i          = 0;
+    for (; i + L::width <= n; i += L::width)
+        acc = L::add(acc, L::load(a + i));
+    S lanes[L::width];
+    L::store(lanes, acc);
+    S result = 0;
+    for (S lane : lanes)
+        result += lane;
+    for (; i < n; i++)
+        result += a[i];
+    return result;
+}
+
+template <class L>
+long long sumWide(const int* a, size_t n) {
+    typedef typename L::Wide W;
+    W acc    = L::widenLow(L::set1(0));
+    size_t i = 0;
+    for (; i + L::width <= n; i += L::width) {
+        typename L::V v = L::load(a + i);
+        acc             = L::addWide(acc, L::addWide(L::widenLow(v), L::widenHigh(v)));
+    }
+    long long lanes[sizeof(W) / sizeof(long long)];
+    memcpy(lanes, &acc, sizeof(W));
+    long long result = 0;
+    for (long long lane : lanes)
+        result += lane;
+    for (; i < n; i++)
+        result += a[i];
+    return result;
+}
+
+template <class L, bool smallest>
+typename L::Scalar extreme(const typename L::Scalar* a, size_t n) {
+    typedef typename L::Scalar S;
+    S result = a[0];
+    size_t i = 0;
+    if (n >= L::width) {
+        typename L::V acc = L::load(a);
+        for (i = L::width; i + L::width <= n; i += L::width)
+            acc = smallest ? L::min(acc, L::load(a + i)) : L::max(acc, L::load(a + i));
+        S lanes[L::width];
+        L::store(lanes, acc);
+        for (S lane : lanes)
+            if (smallest ? lane < result : lane > result) result = lane;
+    }
+    for (; i < n; i++)
+        if (smallest ? a[i] < result : a[i] > result) result = a[i];
+    return result;
+}
+
+template <class L>
+size_t find(const typename L::Scalar* a, size_t n, typename L::Scalar value) {
+    typename L::V wanted = L::set1(value);
+    size_t i             = 0;
+    for (; i + L::width <= n; i += L::width) {
+        unsigned mask = L::equal(L::load(a + i), wanted);
+        if (mask != 0) return i + __builtin_ctz(mask);
+    }
+    for (; i < n; i++)
+        if (a[i] == value) return i;
+    return n;
+}
+
+template <class L>
+typename L::Scalar dot(const typename L::Scalar* a, const typename L::Scalar* b, size_t n) {
+    typedef typename L::Scalar S;
+    typename L::V acc = L::set1(0);
+    size_t i          = 0;
+    for (; i + L::width <= n; i += L::width)
+        acc = L::add(acc, L::mul(L::load(a + i), L::load(b + i)));
+    S lanes[L::width];
+    L::store(lanes, acc);
+    S result = 0;
+    for (S lane : lanes)
+        result += lane;
+    for (; i < n; i++)
+        result += a[i] * b[i];
+    return result;
+}
+
+template <class L>
+void map(
+    int op, const typename L::Scalar* left, size_t leftStep, const typename L::Scalar* right, size_t rightStep,
+    typename L::Scalar* out, size_t n
+) {
+    typedef typename L::V V;
+    if (n == 0) return;
+    size_t i = 0;
+    // integer lanes have no division, so those quotients are all left to the tail loop
+    if (op != simdDiv || L::divides) {
+        V leftScalar  = L::set1(left[0]);
+        V rightScalar = L::set1(right[0]);
+        for (; i + L::width <= n; i += L::width) {
+            V l = leftStep ? L::load(left + i) : leftScalar;
+            V r = rightStep ? L::load(right + i) : rightScalar;
+            switch (op) {
+                case simdAdd: L::store(out + i, L::add(l, r)); break;
+                case simdSub: L::store(out + i, L::sub(l, r)); break;
+                case simdMul: L::store(out + i, L::mul(l, r)); break;
+                default:
+                    if constexpr (L::divides) L::store(out + i, L::div(l, r));
+                    break;
+            }
+        }
+    }
+    for (; i < n; i++) {
+        typename L::Scalar l = left[i * leftStep], r = right[i * rightStep];
+        switch (op) {
+            case simdAdd: out[i] = l + r; break;
+            case simdSub: out[i] = l - r; break;
+            case simdMul: out[i] = l * r; break;
+            default:      out[i] = l / r; break;
+        }
+    }
+}
+
+const SimdKernels kernels = {
+    isa,
+    sumWide<IntLanes>,
+    sum<FloatLanes>,
+    extreme<IntLanes, true>,
+    extreme<FloatLanes, true>,
+    extreme<IntLanes, false>,
+    extreme<FloatLanes, false>,
+    find<IntLanes>,
+    find<FloatLanes>,
+    dot<IntLanes>,
+    dot<FloatLanes>,
+    map<IntLanes>,
+    map<FloatLanes>,
+};
@@ -0,0 +1,251 @@
+#pragma once
+#include "threads.hpp"
+
+#include <algorithm>
+#include <utility>
+
+// Pattern-defeating quicksort (Orson Peters' pdqsort): quicksort with a
+// median-of-3 or ninther pivot that finishes small ranges with insertion sort,
+// notices ranges that are already sorted, shuffles around pivots that split
+// badly and falls back to heapsort once too many of them did, so it stays
+// O(n log n) on every input. parallelSort splits large inputs into one run
+// per thread of the shared pool and merges the sorted runs pairwise.
+
+namespace pdq {
+
+const ptrdiff_t insertionSortThreshold    = 24;
+const ptrdiff_t nintherThreshold          = 128;
+const ptrdiff_t partialInsertionSortLimit = 8;
+
+template <class Iter, class Compare>
+void insertionSort(Iter begin, Iter end, Compare less) {
+    if (begin == end) return;
+    for (Iter cur = begin + 1; cur != end; ++cur) {
+        Iter sift = cur, before = cur - 1;
+        if (less(*sift, *before)) {
+            auto held = move(*sift);
+            do {
+                *sift-- = move(*before);
+            } while (sift != begin && less(held, *--before));
+            *sift = move(held);
+        }
+    }
+}
+
+// the element before begin is known to be no larger than any in the range
+template <class Iter, class Compare>
+void unguardedInsertionSort(Iter begin, Iter end, Compare less) {
+    if (begin == end) return;
+    for (Iter cur = begin + 1; cur != end; ++cur) {
+        Iter sift = cur, before = cur - 1;
+        if (less(*sift, *before)) {
+            auto held = move(*sift);
+            do {
+                *sift-- = move(*before);
+            } while (less(held, *--before));
+            *sift = move(held);
+        }
+    }
+}
+
+// gives up, returning false, once it has had to move too many elements
+template <class Iter, class Compare>
+bool partialInsertionSort(Iter begin, Iter end, Compare less) {
+    if (begin == end) return true;
+    ptrdiff_t moved = 0;
+    for (Iter cur = begin + 1; cur != end; ++cur) {
+        Iter sift = cur, before = cur - 1;
+        if (less(*sift, *before)) {
+            auto held = move(*sift);
+            do {
+                *sift-- = move(*before);
+            } while (sift != begin && less(held, *--before));
+            *sift = move(held);
+            moved += cur - sift;
+            if (moved > partialInsertionSortLimit) return false;
+        }
+    }
+    return true;
+}
+
+template <class Iter, class Compare>
+inline void sort2(Iter a, Iter b, Compare less) {
+    if (less(*b, *a)) iter_swap(a, b);
+}
+
+template <class Iter, class Compare>
+inline void sort3(Iter a, Iter b, Iter c, Compare less) {
+    sort2(a, b, less);
+    sort2(b, c, less);
+    sort2(a, b, less);
+}
+
+// Partitions around the pivot at begin, putting elements equal to it on the
+// right. Returns where the pivot ended up and whether nothing had to move.
+template <class Iter, class Compare>
+pair<Iter, bool> partitionRight(Iter begin, Iter end, Compare less) {
+    auto pivot = move(*begin);
+    Iter first = begin, last = end;
+    // the median-of-3 guarantees an element no smaller than the pivot exists
+    while (less(*++first, pivot));
+    if (first - 1 == begin)
+        while (first < last && !less(*--last, pivot));
+    else
+        while (!less(*--last, pivot));
+    bool alreadyPartitioned = first >= last;
+    while (first < last) {
+        iter_swap(first, last);
+        while (less(*++first, pivot));
+        while (!less(*--last, pivot));
+    }
+    Iter pivotPosition = first - 1;
+    *begin             = move(*pivotPosition);
+    *pivotPosition     = move(pivot);
+    return {pivotPosition, alreadyPartitioned};
+}
+
+// Like partitionRight but puts equal elements on the left; used when the
+// pivot equals the element before the range, so a run of equal keys is
+// skipped in one pass.
+template <class Iter, class Compare>
+Iter partitionLeft(Iter begin, Iter end, Compare less) {
+    auto pivot = move(*begin);
+    Iter first = begin, last = end;
+    while (less(pivot, *--last));
+    if (last + 1 == end)
+        while (first < last && !less(pivot, *++first));
+    else
+        while (!less(pivot, *++first));
+    while (first < last) {
+        iter_swap(first, last);
+        while (less(pivot, *--last));
+        while (!less(pivot, *++first));
+    }
+    Iter pivotPosition = last;
+    *begin             = move(*pivotPosition);
+    *pivotPosition     = move(pivot);
+    return pivotPosition;
+}
+
+template <class Iter, class Compare>
+void sortLoop(Iter begin, Iter end, Compare less, int badAllowed, bool leftmost) {
+    while (true) {
+        ptrdiff_t size = end - begin;
+        if (size < insertionSortThreshold) {
+            if (leftmost) insertionSort(begin, end, less);
+            else unguardedInsertionSort(begin, end, less);
+            return;
+        }
+
+        ptrdiff_t half = size / 2;
+        if (size > nintherThreshold) {
+            sort3(begin, begin + half, end - 1, less);
+            sort3(begin + 1, begin + (half - 1), end - 2, less);
+            sort3(begin + 2, begin + (half + 1), end - 3, less);
+            sort3(begin + (half - 1), begin + half, begin + (half + 1), less);
+            iter_swap(begin, begin + half);
+        } else sort3(begin + half, begin, end - 1, less);
+
+        if (!leftmost && !less(*(begin - 1), *begin)) {
+            begin = partitionLeft(begin, end, less) + 1;
+            continue;
+        }
+
+        pair<Iter, bool> partition = partitionRight(begin, end, less);
+        Iter pivotPosition         = partition.first;
+        ptrdiff_t leftSize         = pivotPosition - begin;
+        ptrdiff_t rightSize        = end - (pivotPosition + 1);
+        if (leftSize < size / 8 || rightSize < size / 8) {
+            if (--badAllowed == 0) {
+                make_heap(begin, end, less);
+                sort_heap(begin, end, less);
+                return;
+            }
+            // break up whatever pattern produced the bad pivot
+            if (leftSize >= insertionSortThreshold) {
+                iter_swap(begin, begin + leftSize / 4);
+                iter_swap(pivotPosition - 1, pivotPosition - leftSize / 4);
+                if (leftSize > nintherThreshold) {
+                    iter_swap(begin + 1, begin + (leftSize / 4 + 1));
+                    iter_swap(begin + 2, begin + (leftSize / 4 + 2));
+                    iter_swap(pivotPosition - 2, pivotPosition - (leftSize / 4 + 1));
+                    iter_swap(pivotPosition - 3, pivotPosition - (leftSize / 4 + 2));
+                }
+            }
+            if (rightSize >= insertionSortThreshold) {
+                iter_swap(pivotPosition + 1, pivotPosition + (1 + rightSize / 4));
+                iter_swap(end - 1, end - rightSize / 4);
+                if (rightSize > nintherThreshold) {
+                    iter_swap(pivotPosition + 2, pivotPosition + (2 + rightSize / 4));
+                    iter_swap(pivotPosition + 3, pivotPosition + (3 + rightSize / 4));
+                    iter_swap(end - 2, end - (1 + rightSize / 4));
+                    iter_swap(end - 3, end - (2 + rightSize / 4));
+                }
+            }
+        } else if (partition.second && partialInsertionSort(begin, pivotPosition, less) &&
+                   partialInsertionSort(pivotPosition + 1, end, less))
+            return;
+
+        sortLoop(begin, pivotPosition, less, badAllowed, leftmost);
+        begin    = pivotPosition + 1;
+        leftmost = false;
+    }
+}
+
+} // namespace pdq
+
+template <class Iter, class Compare>
+void pdqsort(Iter begin, Iter end, Compare less) {
+    if (end - begin < 2) return;
+    int log2 = 0;
+    for (ptrdiff_t size = end - begin; size > 1; size >>= 1)
+        log2++;
+    pdq::sortLoop(begin, end, less, log2, true);
+}
+
+// below this many elements a single thread sorts faster than handing out runs
+const size_t PARALLEL_SORT_THRESHOLD = 1 << 16;
+
+template <class T, class Compare>
+void parallelSort(vector<T>& values, Compare less) {
+    ThreadPool& pool = ThreadPool::shared();
+    size_t runs      = min(pool.size(), values.size() / (PARALLEL_SORT_THRESHOLD / 2));
+    if (values.size() < PARALLEL_SORT_THRESHOLD || runs < 2) {
+        pdqsort(values.begin(), values.end(), less);
+        return;
+    }
+
+    vector<size_t> bounds{};
+    for (size_t i = 0; i <= runs; i++)
+        bounds.push_back(values.size() * i / runs);
+    pool.run(runs, [&](size_t i) { pdqsort(values.begin() + bounds[i], values.begin() + bounds[i + 1], less); });
+
+    // merge neighbouring runs into the other buffer until one run is left
+    vector<T> merged(values.size());
+    vector<T>* from = &values;
+    vector<T>* to   = &merged;
+    while (bounds.size() > 2) {
+        size_t pairs = (bounds.size() - 1) / 2;
+        pool.run((bounds.size()) / 2, [&](size_t i) {
+            size_t start = bounds[2 * i];
+            if (i == pairs) {
+                // an odd run out is carried over as it is
+                move(from->begin() + start, from->end(), to->begin() + start);
+                return;
+            }
+            size_t middle = bounds[2 * i + 1], end = bounds[2 * i + 2];
+            merge(
+                make_move_iterator(from->begin() + start), make_move_iterator(from->begin() + middle),
+                make_move_iterator(from->begin() + middle), make_move_iterator(from->begin() + end),
+                to->begin() + start, less
+            );
+        });
+        vector<size_t> next{};
+        for (size_t i = 0; i < bounds.size(); i += 2)
+            next.push_back(bounds[i]);
+        if (next.back() != values.size()) next.push_back(values.size());
+        bounds = next;
+        swap(from, to);
+    }
+    if (from != &values) values = move(*from);
+}
@@ -0,0 +1,408 @@
+#include "threads.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <sys/mman.h>
+#include <unistd.h>
+
+using namespace std;
+
+atomic<int> PARALLEL_DEPTH{0};
+
+// set while a thread is running tasks, so nested runs do not wait on themselves
+thread_local bool insidePool = false;
+
+ThreadPool::ThreadPool(size_t threads) {
+    for (size_t i = 0; i < max(threads, (size_t)1); i++)
+        this->ranges.emplace_back(new TaskRange());
+    for (size_t i = 1; i < threads; i++)
+        this->workers.emplace_back([this, i]() {
+            insidePool = true;
+            unique_lock<mutex> guard(this->lock);
+            size_t seen = this->generation;
+            while (true) {
+                this->wake.wait(guard, [this, seen]() { return this->stopping || this->generation != seen; });
+                if (this->stopping) return;
+                seen = this->generation;
+                guard.unlock();
+                this->work(i);
+                guard.lock();
+            }
+        });
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        lock_guard<mutex> guard(this->lock);
+        this->stopping = true;
+    }
+    this->wake.notify_all();
+    for (auto& worker : this->workers)
+        worker.join();
+}
+
+// the machine's core count, or CIMPL_THREADS when that is set
+size_t defaultThreads() {
+    const char* threads = getenv("CIMPL_THREADS");
+    if (threads != nullptr && atoi(threads) > 0) return atoi(threads);
+    return max(thread::hardware_concurrency(), 1u);
+}
+
+ThreadPool& ThreadPool::shared() {
+    static ThreadPool pool(defaultThreads());
+    return pool;
+}
+
+size_t ThreadPool::size() const { return this->ranges.size(); }
+
+void ThreadPool::run(size_t count, const function<void(size_t)>& task) {
+    if (insidePool || this->workers.empty() || count < 2) {
+        for (size_t i = 0; i < count; i++)
+            task(i);
+        return;
+    }
+    // one run at a time; the workers only know about a single task list
+    lock_guard<mutex> serial(this->running);
+    this->task    = &task;
+    this->pending = count;
+    for (size_t i = 0; i < this->ranges.size(); i++) {
+        lock_guard<mutex> guard(this->ranges[i]->lock);
+        this->ranges[i]->next = count * i / this->ranges.size();
+        this->ranges[i]->end  = count * (i + 1) / this->ranges.size();
+    }
+    {
+        lock_guard<mutex> guard(this->lock);
+        this->generation++;
+    }
+    this->wake.notify_all();
+    insidePool = true;
+    this->work(0);
+    insidePool = false;
+    unique_lock<mutex> guard(this->lock);
+    this->done.wait(guard, [this]() { return this->pending == 0; });
+    this->task = nullptr;
+}
+
+bool ThreadPool::inside() { return insidePool; }
+
+bool ThreadPool::steal(size_t self, size_t& index) {
+    for (size_t offset = 1; offset < this->ranges.size(); offset++) {
+        TaskRange& victim = *this->ranges[(self + offset) % this->ranges.size()];
+        size_t start, end;
+        {
+            lock_guard<mutex> guard(victim.lock);
+            if (victim.next >= victim.end) continue;
+            start      = victim.next + (victim.end - victim.next) / 2;
+            end        = victim.end;
+            victim.end = start;
+        }
+        TaskRange& own = *this->ranges[self];
+        lock_guard<mutex> guard(own.lock);
+        own.next = start + 1;
+        own.end  = end;
+        index    = start;
+        return true;
+    }
+    return false;
+}
+
+bool ThreadPool::take(size_t self, size_t& index) {
+    TaskRange& own = *this->ranges[self];
+    lock_guard<mutex> guard(own.lock);
+    if (own.next >= own.end) return false;
+    index = own.next++;
+    return true;
+}
+
+void ThreadPool::work(size_t self) {
+    size_t index;
+    while (this->take(self, index) || this->steal(self, index)) {
+        (*this->task)(index);
+        if (--this->pending == 0) {
+            lock_guard<mutex> guard(this->lock);
+            this->done.notify_all();
+        }
+    }
+}
+
+// Fibers move between workers, and the compiler may keep the address of a
+// thread_local across a call, so after a fiber switch these are only ever
+// read through the functions below, which are never inlined.
+const size_t NO_WORKER = SIZE_MAX;
+
+thread_local Fiber* runningFiber     = nullptr;
+thread_local ucontext_t* workerHome = nullptr;
+thread_local size_t workerIndex     = NO_WORKER;
+
+__attribute__((noinline)) Fiber* currentFiber() { return runningFiber; }
+__attribute__((noinline)) ucontext_t* currentHome() { return workerHome; }
+__attribute__((noinline)) size_t currentWorker() { return workerIndex; }
+
+// fiber stacks are reserved up front but only take memory as they are used
+const size_t FIBER_STACK_SIZE = 8 << 20;
+const size_t SPARE_STACKS     = 64;
+
+void fiberMain(unsigned high, unsigned low) {
+    Fiber* fiber = reinterpret_cast<Fiber*>(((uintptr_t)high << 32) | low);
+    fiber->body();
+    fiber->body     = nullptr;
+    fiber->finished = true;
+    swapcontext(&fiber->context, currentHome());
+}
+
+Scheduler::Scheduler(size_t threads) {
+    for (size_t i = 0; i < threads; i++) {
+        this->queueLocks.emplace_back(new mutex());
+        this->queues.emplace_back();
+    }
+    for (size_t i = 0; i < threads; i++)
+        this->workers.emplace_back([this, i]() { this->work(i); });
+}
+
+// set once the scheduler has been started, so waitAll need not start it
+atomic<Scheduler*> startedScheduler{nullptr};
+
+Scheduler& Scheduler::shared() {
+    static Scheduler* scheduler = new Scheduler(defaultThreads());
+    startedScheduler            = scheduler;
+    return *scheduler;
+}
+
+void Scheduler::spawn(function<void()> body) {
+    void* stack = nullptr;
+    {
+        lock_guard<mutex> guard(this->lock);
+        this->live++;
+        if (!this->spareStacks.empty()) {
+            stack = this->spareStacks.back();
+            this->spareStacks.pop_back();
+        }
+    }
+    if (stack == nullptr) {
+        stack = mmap(
+            nullptr, FIBER_STACK_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_STACK,
+            -1, 0
+        );
+        // the lowest page is left unmapped, so an overflow faults instead of corrupting memory
+        mprotect(stack, getpagesize(), PROT_NONE);
+    }
+
+    Fiber* fiber = new Fiber();
+    fiber->stack = stack;
+    fiber->body  = move(body);
+    getcontext(&fiber->context);
+    fiber->context.uc_stack.ss_sp   = stack;
+    fiber->context.uc_stack.ss_size = FIBER_STACK_SIZE;
+    fiber->context.uc_link          = nullptr;
+    uintptr_t address               = reinterpret_cast<uintptr_t>(fiber);
+    makecontext(&fiber->context, (void (*)())fiberMain, 2, (unsigned)(address >> 32), (unsigned)address);
+    this->push(fiber);
+}
+
+void Scheduler::waitAll() {
+    Scheduler* scheduler = startedScheduler;
+    if (scheduler == nullptr) return;
+    unique_lock<mutex> guard(scheduler->lock);
+    scheduler->finished.wait(guard, [scheduler]() { return scheduler->live == 0; });
+}
+
+void Scheduler::sleep(chrono::milliseconds duration) {
+    if (!canPark()) {
+        this_thread::sleep_for(duration);
+        return;
+    }
+    unique_lock<mutex> guard(this->lock);
+    this->timers.push({chrono::steady_clock::now() + duration, currentFiber()});
+    // a worker waiting for work may have to wake up sooner now
+    this->wakeup.notify_one();
+    park(guard);
+}
+
+bool Scheduler::canPark() { return currentFiber() != nullptr && !ThreadPool::inside(); }
+
+void Scheduler::park(unique_lock<mutex>& held) {
+    Fiber* fiber   = currentFiber();
+    fiber->release = held.release();
+    swapcontext(&fiber->context, currentHome());
+}
+
+void Scheduler::wake(Fiber* fiber) { this->push(fiber); }
+
+void Scheduler::push(Fiber* fiber) {
+    // a fiber stays with the worker that spawned or woke it, otherwise they take turns
+    size_t queue = currentWorker();
+    if (queue == NO_WORKER) queue = this->nextQueue++ % this->queues.size();
+    {
+        lock_guard<mutex> guard(*this->queueLocks[queue]);
+        this->queues[queue].push_back(fiber);
+    }
+    {
+        lock_guard<mutex> guard(this->lock);
+        this->ready++;
+    }
+    this->wakeup.notify_one();
+}
+
+Fiber* Scheduler::next(size_t self) {
+    {
+        lock_guard<mutex> guard(*this->queueLocks[self]);
+        if (!this->queues[self].empty()) {
+            Fiber* fiber = this->queues[self].back();
+            this->queues[self].pop_back();
+            this->ready--;
+            return fiber;
+        }
+    }
+    for (size_t offset = 1; offset < this->queues.size(); offset++) {
+        size_t victim = (self + offset) % this->queues.size();
+        lock_guard<mutex> guard(*this->queueLocks[victim]);
+        if (this->queues[victim].empty()) continue;
+        Fiber* fiber = this->queues[victim].front();
+        this->queues[victim].pop_front();
+        this->ready--;
+        return fiber;
+    }
+    return nullptr;
+}
+
+void Scheduler::resume(Fiber* fiber) {
+    runningFiber = fiber;
+    swapcontext(workerHome, &fiber->context);
+    runningFiber = nullptr;
+    if (fiber->release != nullptr) {
+        fiber->release->unlock();
+        fiber->release = nullptr;
+    }
+    if (!fiber->finished) return;
+
+    lock_guard<mutex> guard(this->lock);
+    if (this->spareStacks.size() < SPARE_STACKS) this->spareStacks.push_back(fiber->stack);
+    else munmap(fiber->stack, FIBER_STACK_SIZE);
+    delete fiber;
+    if (--this->live == 0) this->finished.notify_all();
+}
+
+void Scheduler::work(size_t self) {
+    ucontext_t home;
+    workerHome  = &home;
+    workerIndex = self;
+    while (true) {
+        Fiber* fiber = this->next(self);
+        if (fiber != nullptr) {
+            this->resume(fiber);
+            continue;
+        }
+        unique_lock<mutex> guard(this->lock);
+        auto now = chrono::steady_clock::now();
+        while (!this->timers.empty() && this->timers.top().first <= now) {
+            Fiber* woken = this->timers.top().second;
+            this->timers.pop();
+            lock_guard<mutex> queueGuard(*this->queueLocks[self]);
+            this->queues[self].push_back(woken);
+            this->ready++;
+        }
+        if (this->ready > 0) continue;
+        if (this->timers.empty()) this->wakeup.wait(guard);
+        else this->wakeup.wait_until(guard, this->timers.top().first);
+    }
+}
+
+void Event::set() {
+    vector<Fiber*> woken{};
+    {
+        lock_guard<mutex> guard(this->lock);
+        this->done = true;
+        swap(woken, this->waiters);
+        // under the lock, since a waiter that sees done may go on to destroy the Event
+        this->signal.notify_all();
+    }
+    for (Fiber* fiber : woken)
+        Scheduler::shared().wake(fiber);
+}
+
+void Event::wait() {
+    unique_lock<mutex> guard(this->lock);
+    if (this->done) return;
+    if (!Scheduler::canPark()) {
+        this->signal.wait(guard, [this]() { return this->done; });
+        return;
+    }
+    this->waiters.push_back(currentFiber());
+    Scheduler::park(guard);
+}
+
+bool Event::isSet() {
+    lock_guard<mutex> guard(this->lock);
+    return this->done;
+}
+
+void WaitQueue::until(const function<bool()>& attempt) { untilAny({this}, attempt); }
+
+void WaitQueue::untilAny(const vector<WaitQueue*>& queues, const function<bool()>& attempt) {
+    bool slept = false;
+    while (!attempt()) {
+        shared_ptr<Waiter> waiter = make_shared<Waiter>();
+        waiter->fiber             = Scheduler::canPark() ? currentFiber() : nullptr;
+        for (WaitQueue* queue : queues) {
+            lock_guard<mutex> guard(queue->lock);
+            queue->waiters.push_back(waiter);
+            queue->waiting++;
+        }
+        // whoever changes things after this sees the waiter, or the attempt sees their change
+        atomic_thread_fence(memory_order_seq_cst);
+        bool done = attempt();
+
+        {
+            unique_lock<mutex> guard(waiter->lock);
+            if (!done && !waiter->woken) {
+                waiter->sleeping = true;
+                slept            = true;
+                if (waiter->fiber != nullptr) Scheduler::park(guard);
+                else waiter->signal.wait(guard, [&waiter]() { return waiter->woken; });
+            } else waiter->woken = true;
+        }
+        // take the waiter off the queues that have not woken it
+        for (WaitQueue* queue : queues) {
+            lock_guard<mutex> guard(queue->lock);
+            auto found = find(queue->waiters.begin(), queue->waiters.end(), waiter);
+            if (found == queue->waiters.end()) continue;
+            queue->waiters.erase(found);
+            queue->waiting--;
+        }
+        if (done) break;
+    }
+    // the notify that woke this caller may have been meant for what another queue's waiters wait on
+    if (slept && queues.size() > 1)
+        for (WaitQueue* queue : queues)
+            queue->notifyOne();
+}
+
+void WaitQueue::notifyOne() {
+    atomic_thread_fence(memory_order_seq_cst);
+    while (this->waiting.load() > 0 && !this->wakeNext());
+}
+
+void WaitQueue::notifyAll() {
+    atomic_thread_fence(memory_order_seq_cst);
+    while (this->waiting.load() > 0)
+        this->wakeNext();
+}
+
+bool WaitQueue::wakeNext() {
+    shared_ptr<Waiter> waiter;
+    {
+        lock_guard<mutex> guard(this->lock);
+        if (this->waiters.empty()) return true;
+        waiter = this->waiters.front();
+        this->waiters.pop_front();
+        this->waiting--;
+    }
+    lock_guard<mutex> guard(waiter->lock);
+    if (waiter->woken) return false;
+    waiter->woken = true;
+    if (!waiter->sleeping) return true;
+    if (waiter->fiber != nullptr) Scheduler::shared().wake(waiter->fiber);
+    else waiter->signal.notify_one();
+    return true;
+}
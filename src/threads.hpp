@@ -0,0 +1,169 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <ucontext.h>
+#include <vector>
+
+using namespace std;
+
+// A fixed set of worker threads for builtins that split work into independent
+// tasks. Each run hands every thread, the calling one included, an even share
+// of the task indices; a thread that runs out steals the back half of another
+// thread's share, so uneven tasks still keep every thread busy. A run started
+// from inside a task just runs inline.
+
+// How many parallel builtins or pfor loops are running script code. While it
+// is not zero the evaluator leaves the shared AST alone: call sites and
+// operators are neither quickened nor despecialized, and the JIT counts calls
+// and compiles under a lock.
+extern atomic<int> PARALLEL_DEPTH;
+
+typedef struct TaskRange {
+    mutex lock{};
+    size_t next{0};
+    size_t end{0};
+} TaskRange;
+
+class ThreadPool {
+  public:
+    ThreadPool(size_t);
+    ~ThreadPool();
+
+    // the pool sized to the machine, or to CIMPL_THREADS when that is set,
+    // started on first use
+    static ThreadPool& shared();
+
+    // how many threads a run can use, the caller included
+    size_t size() const;
+    // calls task(0) ... task(count - 1) and returns once all of them are done
+    void run(size_t, const function<void(size_t)>&);
+    // whether the calling thread is running tasks of a run
+    static bool inside();
+
+  private:
+    vector<thread> workers{};
+    // one share of task indices per thread; the caller's is the first
+    vector<unique_ptr<TaskRange>> ranges{};
+    mutex lock{};
+    mutex running{};
+    condition_variable wake{};
+    condition_variable done{};
+    const function<void(size_t)>* task{nullptr};
+    atomic<size_t> pending{0};
+    size_t generation{0};
+    bool stopping{false};
+
+    bool steal(size_t, size_t&);
+    bool take(size_t, size_t&);
+    void work(size_t);
+};
+
+// A task started by the Scheduler: a stack of its own and the context to
+// resume it from. The worker that switches away from a fiber unlocks
+// `release`, so whoever wakes the fiber cannot resume it before it has parked.
+typedef struct Fiber {
+    ucontext_t context{};
+    void* stack{nullptr};
+    function<void()> body{};
+    mutex* release{nullptr};
+    bool finished{false};
+} Fiber;
+
+// Green threads: fibers multiplexed onto a fixed set of worker threads, as
+// many as the ThreadPool has. Each worker keeps a deque of runnable fibers; it
+// runs its own newest fiber first and, once it has none, steals the oldest
+// fiber of another worker. Fibers are never preempted. They only give up their
+// worker when they park, waiting on an Event or sleeping.
+class Scheduler {
+  public:
+    // started on first use and kept until the program exits, so fibers still
+    // running then are simply abandoned
+    static Scheduler& shared();
+
+    // runs body on a fiber of its own
+    void spawn(function<void()>);
+    // returns once every fiber spawned so far has finished
+    static void waitAll();
+    // parks the calling fiber for a while, or sleeps the thread when it is not one
+    void sleep(chrono::milliseconds);
+
+    // whether the caller is a fiber that may park; code run by the ThreadPool may not
+    static bool canPark();
+    // switches the calling fiber out, unlocking held once it is off its stack
+    static void park(unique_lock<mutex>&);
+    // makes a parked fiber runnable again
+    void wake(Fiber*);
+
+  private:
+    Scheduler(size_t);
+
+    vector<thread> workers{};
+    vector<unique_ptr<mutex>> queueLocks{};
+    vector<deque<Fiber*>> queues{};
+    atomic<size_t> ready{0};
+    atomic<size_t> nextQueue{0};
+    mutex lock{};
+    condition_variable wakeup{};
+    condition_variable finished{};
+    size_t live{0};
+    // sleeping fibers, soonest first
+    typedef pair<chrono::steady_clock::time_point, Fiber*> Timer;
+    priority_queue<Timer, vector<Timer>, greater<Timer>> timers{};
+    vector<void*> spareStacks{};
+
+    void push(Fiber*);
+    Fiber* next(size_t);
+    void resume(Fiber*);
+    void work(size_t);
+};
+
+// A one-shot signal. Fibers wait on it by parking, other threads by blocking.
+class Event {
+  public:
+    void set();
+    void wait();
+    bool isSet();
+
+  private:
+    mutex lock{};
+    condition_variable signal{};
+    vector<Fiber*> waiters{};
+    bool done{false};
+};
+
+// Callers waiting for an attempt to succeed, such as a receive from a channel
+// that is empty. until() retries the attempt, and between tries it parks a
+// fiber or blocks a thread until another thread calls notifyOne() or
+// notifyAll() after changing whatever the attempt depends on. A caller can
+// wait on several queues at once and is woken by whichever notifies first.
+class WaitQueue {
+  public:
+    void until(const function<bool()>&);
+    static void untilAny(const vector<WaitQueue*>&, const function<bool()>&);
+    void notifyOne();
+    void notifyAll();
+
+  private:
+    // one per waiting caller, listed in every queue it waits on until it is woken
+    typedef struct Waiter {
+        mutex lock{};
+        condition_variable signal{};
+        Fiber* fiber{nullptr};
+        bool sleeping{false};
+        bool woken{false};
+    } Waiter;
+
+    mutex lock{};
+    deque<shared_ptr<Waiter>> waiters{};
+    // read without the lock, so notifying nobody stays cheap
+    atomic<size_t> waiting{0};
+
+    bool wakeNext();
+};
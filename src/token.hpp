@@ -32,7 +32,11 @@ enum TokenType {
     DO,
     WHILE,
     FOR,
+    PFOR,
     IN,
+    SPAWN,
+    ASYNC,
+    AWAIT,
 
     // Operators
     EQ,
@@ -92,7 +96,11 @@ const std::unordered_map<std::string, TokenType> KEYWORD_MAP = {
     {"do",      ::DO           },
     {"while",   ::WHILE        },
     {"for",     ::FOR          },
+    {"pfor",    ::PFOR         },
     {"in",      ::IN           },
+    {"spawn",   ::SPAWN        },
+    {"async",   ::ASYNC        },
+    {"await",   ::AWAIT        },
     {"==",      ::EQ           },
     {"!=",      ::NOT_EQ       },
     {"//",      ::COMMENT      },
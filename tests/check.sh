@@ -0,0 +1,34 @@
+#!/bin/bash
+# Runs every program in tests/corpus and compares its output with the
+# .expected file next to it. Any arguments are flags for a second run of each
+# program, such as --closures or --no-jit, whose output must match the first:
+#
+#   tests/check.sh --closures
+#
+# CIMPL names the interpreter to run, by default the one in _gate_build.
+# native.cimpl imports the modules built next to it, in the build's
+# tests/native, which is linked into the corpus as native while this runs.
+root=$(cd "$(dirname "$0")/.." && pwd)
+bin=$(realpath "${CIMPL:-$root/_gate_build/bin/cimpl}")
+out=$(mktemp -d)
+trap 'rm -rf "$out" "$root/tests/corpus/native"' EXIT
+cd "$root/tests/corpus"
+ln -sfn "$(dirname "$bin")/../tests/native" native
+ok=1
+for f in *.cimpl; do
+    name=${f%.cimpl}
+    "$bin" "$f" > "$out/$name.tree" 2>&1
+    if ! diff -q "$out/$name.tree" "$name.expected" > /dev/null; then
+        echo "REGRESSION $f"
+        diff "$name.expected" "$out/$name.tree" | head
+        ok=0
+    fi
+    [ $# -eq 0 ] && continue
+    "$bin" "$@" "$f" > "$out/$name.other" 2>&1
+    if ! diff -q "$out/$name.tree" "$out/$name.other" > /dev/null; then
+        echo "DIFF $f $*"
+        diff "$out/$name.tree" "$out/$name.other" | head
+        ok=0
+    fi
+done
+[ $ok = 1 ] && echo "ALL-SAME" || exit 1
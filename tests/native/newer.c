@@ -0,0 +1,8 @@
+/* A module that needs a newer table than any interpreter has, and says so by
+ * failing its init, as modules are meant to check api->version. */
+#include "cimpl_native.h"
+
+int cimpl_native_init(const cimpl_api* api, cimpl_module* module) {
+    if (api->version < CIMPL_NATIVE_VERSION + 1) return -1;
+    return 0;
+}
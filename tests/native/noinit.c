@@ -0,0 +1,2 @@
+/* A shared object without cimpl_native_init, which import_native refuses. */
+int cimpl_native_start(void) { return 0; }
@@ -0,0 +1,8 @@
+/* A module registering a name that is already a builtin. */
+#include "cimpl_native.h"
+
+static cimpl_value* len(cimpl_call* call, cimpl_value* const* args, size_t count) { return NULL; }
+
+int cimpl_native_init(const cimpl_api* api, cimpl_module* module) {
+    return api->register_builtin(module, "len", len, 1, NULL, 0);
+}
@@ -0,0 +1,57 @@
+/* The module tests/corpus/native.cimpl imports: a few builtins covering the
+ * values that cross over, and the checks made before a call. */
+#include "cimpl_native.h"
+
+#include <math.h>
+#include <string.h>
+
+static const cimpl_api* api;
+
+static cimpl_value* norm(cimpl_call* call, cimpl_value* const* args, size_t count) {
+    const double* xs = api->array_floats(call, args[0]);
+    if (xs == NULL) return api->make_error(call, "norm() needs an array of numbers");
+    double total = 0;
+    for (size_t i = 0; i < api->array_length(args[0]); i++)
+        total += xs[i] * xs[i];
+    return api->make_float(call, sqrt(total));
+}
+
+static cimpl_value* scale(cimpl_call* call, cimpl_value* const* args, size_t count) {
+    const int32_t* xs = api->array_ints(call, args[0]);
+    if (xs == NULL) return api->make_error(call, "scale() needs an array of integers");
+    size_t length = api->array_length(args[0]);
+    int32_t scaled[16];
+    if (length > 16) return api->make_error(call, "scale() takes at most 16 integers");
+    for (size_t i = 0; i < length; i++)
+        scaled[i] = xs[i] * (int32_t)api->get_int(args[1]);
+    return api->make_int_array(call, scaled, length);
+}
+
+/* a hash of the type and the size of each argument */
+static cimpl_value* describe(cimpl_call* call, cimpl_value* const* args, size_t count) {
+    static const char* names[] = {"other", "null", "bool", "int", "float", "string", "array", "hash"};
+    cimpl_value* described[8];
+    for (size_t i = 0; i < count && i < 8; i++) {
+        cimpl_type type = api->type_of(args[i]);
+        size_t size     = 0;
+        if (type == CIMPL_STRING) api->get_string(args[i], &size);
+        if (type == CIMPL_ARRAY) size = api->array_length(args[i]);
+        if (type == CIMPL_HASH) size = api->hash_size(args[i]);
+        cimpl_value* hash = api->make_hash(call);
+        cimpl_value* key  = api->make_string(call, "type", 4);
+        api->hash_set(call, hash, key, api->make_string(call, names[type], strlen(names[type])));
+        api->hash_set(call, hash, api->make_string(call, "size", 4), api->make_int(call, (int64_t)size));
+        described[i] = hash;
+    }
+    return api->make_array(call, described, count < 8 ? count : 8);
+}
+
+static cimpl_value* nothing(cimpl_call* call, cimpl_value* const* args, size_t count) { return NULL; }
+
+int cimpl_native_init(const cimpl_api* a, cimpl_module* module) {
+    api = a;
+    if (api->register_builtin(module, "norm", norm, 1, "a", CIMPL_PURE) != 0) return -1;
+    if (api->register_builtin(module, "scale", scale, 2, "ai", CIMPL_PURE) != 0) return -1;
+    if (api->register_builtin(module, "describe", describe, -1, NULL, 0) != 0) return -1;
+    return api->register_builtin(module, "nothing", nothing, 0, NULL, 0);
+}